@@ -68,6 +68,8 @@ First checked in.
 
 #if KERNEL
     #include <kern/assert.h>
+    #include <libkern/OSAtomic.h>
+    #include <kern/thread.h>
 #endif
 
 /////////////////////////////////////////////////////////////////////
@@ -85,7 +87,7 @@ First checked in.
     #endif
 #else
     #ifndef LCK_MTX_ASSERT                  /** ditto. */
-    #define LCK_MTX_ASSERT(gHashMutex, LCK_MTX_ASSERT_OWNED) do { } while (0)
+    #define LCK_MTX_ASSERT(lck, type) do { } while (0)
     #endif
 #endif
 
@@ -101,7 +103,32 @@ First checked in.
 // 
 // This data structure is effectively reference counted by the forkVNodesCount 
 // field.  When the last vnode that references this HNode is reclaimed, the HNode 
-// itself is reclaimed (along with the associated FSNode).
+// itself is reclaimed (along with the associated FSNode).  However, the memory is 
+// not freed immediately, because a lock-free lookup might still be looking at it; 
+// see "Deferred Free", below.  HNode blocks come from a dedicated allocator; see 
+// "Node Allocator", below.
+
+// An HNodeDeferredFree record describes a block of memory that's been removed from 
+// the hash table, but can't be freed until all lock-free lookups that might be 
+// using it have finished.
+
+struct HNodeDeferredFree {
+    struct HNodeDeferredFree *  next;       // next pointer for gDeferredFreeList
+    void *                      addr;       // block to free
+    size_t                      size;       // size of that block
+    uint32_t                    epoch;      // value of gEpoch when the block was retired
+    boolean_t                   nodeBlock;  // true if addr is an HNode block, which goes back to HNodeBlockFree 
+                                            // rather than OSFree
+};
+typedef struct HNodeDeferredFree HNodeDeferredFree;
+
+// MFS files have at most two forks (data and resource), so the fork vnode array 
+// for the first kHNodeInternalForkCount forks is embedded in the HNode.  Only 
+// higher forks need a separately allocated array.
+
+enum {
+    kHNodeInternalForkCount = 2
+};
 
 struct HNode {
     uint32_t            magic;                  // [1] -> gMagic, that is, client supplied magic number
@@ -112,11 +139,14 @@ struct HNode {
     boolean_t           waiting;                // [2] true if someone is waiting for attachOutstanding to go false
     size_t              forkVNodesSize;         // [2] size of forkVNodes array, must be non-zero
     size_t              forkVNodesCount;        // [2] number of non-NULL vnodes in array (plus one if attachOutstanding is true)
-    vnode_t *           forkVNodes;             // [2] array of vnodes, indexed by forkIndex
-    union {
-        vnode_t         internal;               // [2] if forkVNodesSize == 1, the vnode is stored internally
-        vnode_t *       external;               // [2] if forkVNodesSize > 1, the vnodes are stored in a separately allocated array
-    } forkVNodesStorage;
+    vnode_t *           forkVNodes;             // [2] [4] array of vnodes, indexed by forkIndex
+    struct {
+        vnode_t         internal[kHNodeInternalForkCount];
+                                                // [2] if forkVNodesSize == kHNodeInternalForkCount, the vnodes are stored internally
+        vnode_t *       external;               // [2] if forkVNodesSize > kHNodeInternalForkCount, the vnodes are stored in a 
+                                                //     separately allocated array; see HNodeForkBufferAlloc
+    } forkVNodesStorage;                        // [4]
+    HNodeDeferredFree   deferredFree;           // used by HNodeScrubDone to defer freeing the HNode
 };
 typedef struct HNode HNode;
 
@@ -126,13 +156,21 @@ typedef struct HNode HNode;
 //     creating an HNode, and is not modified after that.  Thus, it doesn't need 
 //     to be protected from concurrent access.
 //
-// [2] The gHashMutex lock protects this field in /all/ HNodes.
+// [2] This field is protected by the mutex of the hash stripe that owns the HNode; 
+//     see HNodeGetStripe.
 //
 // [3] This is true if HNodeLookupCreatingIfNecessary has return success but with a 
 //     NULL vnode.  In this case, we're expecting the client to call either 
 //     HNodeAttachVNodeSucceeded or HNodeAttachVNodeFailed at some time in the future. 
 //     While this is true, forkVNodesCount is incremented to prevent the HNode from 
 //     going away.
+//
+// [4] These fields are read without any lock by HNodeLookupLockFree.  When the 
+//     forkVNodes array is expanded, the new array is published before 
+//     forkVNodesSize is increased, and the old array is freed via the deferred free 
+//     list.  forkVNodesStorage used to be a union but, if internal and external 
+//     shared storage, a lock-free reader that picked up the old forkVNodes pointer 
+//     could read the new array pointer and mistake it for a vnode.
 
 // The following client globals are set by the client when it calls HNodeInit.
 // See the header comments for HNodeInit for more details.
@@ -142,32 +180,951 @@ static lck_grp_t *      gLockGroup;
 static size_t           gFSNodeSize;
 static OSMallocTag      gOSMallocTag;
 
-// gHashMutex is a single mutex that protects all fields (except the immutable ones) of 
-// all HNodes, the hash table itself (all elements of the gHashTable array), and gHashNodeCount.
+// The hash table is protected by an array of mutexes, rather than a single mutex, 
+// so that lookups of unrelated fsobjs don't serialise on one lock.  Each hash chain 
+// belongs to exactly one stripe (the stripe index is the low bits of the chain index), 
+// and that stripe's mutex protects the chain itself, all fields (except the immutable 
+// ones) of every HNode on the chain, and the stripe's nodeCount.  An HNode never moves 
+// between chains, so the stripe that owns an HNode can be calculated from its 
+// (immutable) dev and ino fields without holding any lock.
+//
+// Lock Order
+// ----------
+// A code path that holds more than one of our mutexes must take them in this order:
+//
+// 1. gResizeMutex
+// 2. the stripe mutexes, in index order
+// 3. gSlabMutex
+//
+// HNodeHashTableMaintain takes gResizeMutex and then either a single stripe mutex, 
+// to migrate that stripe's chains, or all of them (via HNodeLockAllStripes), to 
+// start or finish a resize.  HNodePrintState takes all of the stripe mutexes without 
+// gResizeMutex.  HNodeBlockFree takes gSlabMutex inside a stripe mutex when it 
+// spills a full magazine to the depot.  Apart from HNodeLockAllStripes, nothing 
+// holds two stripe mutexes at once.  gDeferredFreeMutex is never held along with 
+// any other mutex.
+
+enum {
+    kHNodeHashStripeCount = 64,             // must be a power of two
+    kHNodeHashStripeAlign = 64              // a typical cache line size
+};
 
-static lck_mtx_t *      gHashMutex;
+struct HNodeHashStripe {
+    lck_mtx_t *     mutex;                  // protects the stripe's chains, their HNodes, and nodeCount
+    size_t          nodeCount;              // number of HNodes on the stripe's chains; used solely for debugging 
+                                            // (if it's non-zero when HNodeTerm is called, the debug version of the 
+                                            // code will panic) and by HNodePrintState
+    char            pad[kHNodeHashStripeAlign - sizeof(lck_mtx_t *) - sizeof(size_t)];
+                                            // stops threads using adjacent stripes from fighting over a cache line
+};
+typedef struct HNodeHashStripe HNodeHashStripe;
+
+static HNodeHashStripe  gHashStripes[kHNodeHashStripeCount];
+
+// Reader Slots
+// ------------
+// Every lookup touches a reader slot, so the lock-free path doesn't write to any 
+// cache line that's shared with other threads looking up the same fsobj.  The slot 
+// is chosen by hashing the current thread, not (dev, ino); if we used the stripe, 
+// all of the threads hammering on a hot file would fight over that stripe's cache 
+// line.  A slot holds the reader counts for the deferred free mechanism (see 
+// "Deferred Free") and the lookup count for HNodeGetStatistics.  Two threads may 
+// share a slot, which is fine because all of its fields are updated atomically.
+
+enum {
+    kHNodeReaderSlotCount = 64              // must be a power of two
+};
 
-// gHashNodeCount is a count of the number of HNodes in the hash table. 
-// This is used solely for debugging (if it's non-zero when HNodeTerm is called, 
-// the debug version of the code will panic).
+struct HNodeReaderSlot {
+    volatile int32_t readers[2];            // number of lock-free lookups in progress using this slot, indexed by 
+                                            // the low bit of the epoch that they started in
+    volatile int64_t lookups;               // calls to HNodeLookupCreatingIfNecessary, plus requests passed to 
+                                            // HNodeLookupMany
+    char            pad[kHNodeHashStripeAlign - (2 * sizeof(int32_t)) - sizeof(int64_t)];
+                                            // stops threads using adjacent slots from fighting over a cache line
+};
+typedef struct HNodeReaderSlot HNodeReaderSlot;
+
+static HNodeReaderSlot  gReaderSlots[kHNodeReaderSlotCount];
+
+// Statistics
+// ----------
+// Apart from lookups, which is in the reader slots, the counters returned by 
+// HNodeGetStatistics are kept per stripe, which spreads the increments across cache 
+// lines.  None of them are touched by a lock-free hit; HNodeGetStatistics derives 
+// hits from the other counters.  They're updated atomically because some of them are 
+// changed without the stripe mutex held.  They're not in HNodeHashStripe itself 
+// because they'd push it over a cache line.
+
+struct HNodeStripeStatistics {
+    volatile int64_t    misses;             // lookups that left the caller to attach a vnode
+    volatile int64_t    failures;           // lookups that returned an error
+    volatile int64_t    vidRetries;         // times vnode_getwithvid failed because the vnode was being recycled
+    volatile int64_t    attachSleeps;       // times a lookup slept waiting for another thread's attach
+    volatile int64_t    racesLost;          // HNodes allocated but discarded because another thread inserted first
+    volatile int64_t    detaches;           // calls to HNodeDetachVNode
+    volatile int64_t    reclaims;           // calls to HNodeScrubDone
+};
+typedef struct HNodeStripeStatistics HNodeStripeStatistics;
 
-static size_t           gHashNodeCount;
+static HNodeStripeStatistics gStripeStatistics[kHNodeHashStripeCount];
 
-// gHashTable is a pointer to an array of HNodeHashHead structures that represent 
-// the heads of all the hash chains.  This structure, and the associated 
-// gHashTableMask, are all a consequence of my use of hashinit.  I wouldd point you 
-// to the hashinit documentation, but there isn't any yet (-:
+static HNodeStripeStatistics * HNodeGetStripeStatistics(HNodeHashStripe *stripe)
+    // Returns the statistics counters for stripe.
+{
+    assert( (stripe >= &gHashStripes[0]) && (stripe < &gHashStripes[kHNodeHashStripeCount]) );
+    
+    return &gStripeStatistics[stripe - gHashStripes];
+}
 
-static LIST_HEAD(HNodeHashHead, HNode) *   gHashTable;
+// Deferred Free
+// -------------
+// HNodeLookupLockFree walks the hash chains, and reads HNodes and their fork arrays, 
+// without taking any lock.  So, memory that's been removed from the hash table can't 
+// be freed until every lock-free lookup that might have seen it has finished.  We 
+// track this using epochs.  A lock-free lookup registers itself in the current 
+// epoch (by incrementing a per-slot, per-epoch reader count) for the duration of 
+// the lookup.  Memory removed from the hash table is put on gDeferredFreeList, 
+// tagged with the epoch at the time of removal.  gEpoch is only advanced when all 
+// of the lookups registered in the previous epoch have finished.  Thus, once gEpoch 
+// is two greater than the epoch that a block was retired in, no lookup can hold 
+// a reference to it and it can be freed.  HNodeDeferredFreeReclaim does this, and 
+// it's called at quiescent points (when an HNode is scrubbed or a fork array is 
+// replaced).
+//
+// The reader counts live in the reader slots, which spreads the atomic increments 
+// across cache lines; the reclaim path has to sum them, but it runs rarely.
+
+static volatile uint32_t    gEpoch;             // current epoch; only ever incremented, under gDeferredFreeMutex
+static lck_mtx_t *          gDeferredFreeMutex; // protects gDeferredFreeList
+static HNodeDeferredFree *  gDeferredFreeList;  // blocks waiting to be freed, newest first
+
+// An HNodeHashTable holds the heads of all the hash chains.  We used to get this 
+// array from hashinit, sized for desiredvnodes, but that was far too big for a single 
+// floppy and far too small for thousands of pseudo-mounted disk images.  Now the table 
+// resizes itself based on the number of HNodes.  Each table has a power of two number 
+// of chains, and at least kHNodeHashStripeCount of them, so that chain N of any table 
+// always belongs to stripe (N % kHNodeHashStripeCount).
+//
+// Resizing is incremental.  HNodeHashTableMaintain, called after an HNode is inserted 
+// or removed, decides whether the table needs to grow or shrink.  If it does, it 
+// allocates a new table and, with all of the stripe mutexes held, makes the current 
+// table gOldHashTable and the new one gHashTable.  From then on, new HNodes go into 
+// gHashTable, and every subsequent call to HNodeHashTableMaintain migrates a few chains 
+// from gOldHashTable (taking the mutex of the stripe that owns them).  Until that's 
+// done, lookups have to search both tables.  Once it's done, the old table is retired 
+// via the deferred free list, because a lock-free lookup might still be looking at it.
+
+LIST_HEAD(HNodeHashHead, HNode);
 typedef struct HNodeHashHead HNodeHashHead;
 
-static u_long           gHashTableMask;
+struct HNodeHashTable {
+    HNodeDeferredFree   deferredFree;           // used to free the table once it's been replaced
+    u_long              mask;                   // number of chains minus one
+    HNodeHashHead       chains[1];              // actually (mask + 1) entries
+};
+typedef struct HNodeHashTable HNodeHashTable;
+
+enum {
+    kHNodeHashTableMinChains        = kHNodeHashStripeCount,
+    kHNodeHashTableMaxChains        = 1024 * 1024,
+    kHNodeHashTableGrowLoad         = 2,        // grow when there are more than this many HNodes per chain
+    kHNodeHashTableShrinkDivisor    = 8,        // shrink when there are fewer than 1/this HNodes per chain
+    kHNodeHashTableMigrateChunk     = 64        // maximum number of chains each call to HNodeHashTableMaintain migrates; 
+                                                // must be at least kHNodeHashTableShrinkDivisor
+};
 
-static HNodeHashHead * HNodeGetFirstFromHashTable(dev_t dev, ino_t ino)
-    // Given a device number and an inode number, return a pointer to the 
+static HNodeHashTable * volatile gHashTable;    // current table; new HNodes always go here
+static HNodeHashTable * volatile gOldHashTable; // table being migrated from, or NULL if no resize is in progress
+static volatile u_long  gHashTableMask;         // copy of gHashTable->mask, which is safe to read without a lock
+static lck_mtx_t *      gResizeMutex;           // serialises resizes and protects gMigrateNext; 
+                                                // first in the lock order (see "Lock Order" above)
+static u_long           gMigrateNext;           // migration progress through gOldHashTable; see HNodeHashTableMaintain
+
+static uint32_t HNodeHash(dev_t dev, ino_t ino)
+    // Given a device number and an inode number, return a hash value in which 
+    // every bit depends on every bit of both inputs.  We used to just add dev and 
+    // ino, but MFS inode numbers are dense (starting at kMFSFirstFileInodeName), and 
+    // device numbers for disk images tend to be adjacent, so multiple volumes ended 
+    // up sharing the same small range of hash chains.  This is the 64-bit finaliser 
+    // from MurmurHash3, which is cheap and mixes well.
+{
+    uint64_t    x;
+    
+    x = (((uint64_t) (uint32_t) dev) << 32) ^ ((uint64_t) ino);
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (uint32_t) x;
+}
+
+static HNodeHashHead * HNodeGetFirstFromHashTable(HNodeHashTable *table, dev_t dev, ino_t ino)
+    // Given a table, a device number and an inode number, return a pointer to the 
     // hash chain head.
 {
-    return (HNodeHashHead *) &gHashTable[(dev + ino) & gHashTableMask];
+    return &table->chains[HNodeHash(dev, ino) & table->mask];
+}
+
+static HNodeHashStripe * HNodeGetStripe(dev_t dev, ino_t ino)
+    // Given a device number and an inode number, return a pointer to the 
+    // stripe that owns the corresponding hash chain.  This doesn't depend on 
+    // the table size; see the comments for HNodeHashTable.
+{
+    return &gHashStripes[HNodeHash(dev, ino) & (kHNodeHashStripeCount - 1)];
+}
+
+static HNodeReaderSlot * HNodeGetReaderSlot(void)
+    // Returns the reader slot for the current thread.  Thread pointers are 
+    // aligned, and threads tend to be allocated next to each other, so we run 
+    // the pointer through HNodeHash rather than just taking its low bits.
+{
+    return &gReaderSlots[HNodeHash(0, (ino_t) (uintptr_t) current_thread()) & (kHNodeReaderSlotCount - 1)];
+}
+
+static HNodeRef HNodeFindInTables(dev_t dev, ino_t ino)
+    // Returns the HNode for (dev, ino), or NULL if there isn't one.  If a resize is 
+    // in progress, this searches both tables.
+    //
+    // If the caller holds the stripe mutex, the result is definitive.  If not (that 
+    // is, the caller is HNodeLookupLockFree), the HNode might be moved from one chain 
+    // to another while we're looking at it, so this might miss an HNode that's 
+    // actually present, but it'll never return the wrong one.
+{
+    HNodeHashTable *    table;
+    HNodeRef            thisNode;
+    
+    thisNode = NULL;
+    
+    table = gOldHashTable;
+    if (table != NULL) {
+        thisNode = LIST_FIRST(HNodeGetFirstFromHashTable(table, dev, ino));
+        while (thisNode != NULL) {
+            assert(thisNode->magic == gMagic);
+            
+            if ( (thisNode->dev == dev) && (thisNode->ino == ino) ) {
+                break;
+            }
+            thisNode = LIST_NEXT(thisNode, hashLink);
+        }
+    }
+    
+    if (thisNode == NULL) {
+        table = gHashTable;
+        thisNode = LIST_FIRST(HNodeGetFirstFromHashTable(table, dev, ino));
+        while (thisNode != NULL) {
+            assert(thisNode->magic == gMagic);
+            
+            if ( (thisNode->dev == dev) && (thisNode->ino == ino) ) {
+                break;
+            }
+            thisNode = LIST_NEXT(thisNode, hashLink);
+        }
+    }
+    
+    return thisNode;
+}
+
+static void HNodeInsertAtHead(HNodeHashHead *head, HNodeRef hnode)
+    // Inserts hnode at the head of the chain.  The caller must hold the mutex 
+    // for the stripe that owns the chain.
+{
+    // Lock-free lookups can see hnode as soon as it's on the chain, so its fields 
+    // (including its next pointer) must be visible first.
+    
+    LIST_NEXT(hnode, hashLink) = LIST_FIRST(head);
+    OSMemoryBarrier();
+    LIST_INSERT_HEAD(head, hnode, hashLink);
+}
+
+// Node Allocator
+// --------------
+// Every miss in HNodeLookupCreatingIfNecessary needs an HNode block (the HNode plus 
+// gFSNodeSize bytes for the FSNode), and every reclaim frees one.  Rather than hitting 
+// OSMalloc for each of these, we carve the blocks out of slabs of kHNodeSlabBlockCount 
+// blocks.  Free blocks are cached in per-stripe magazines, each protected by the 
+// corresponding stripe mutex, backed by a global depot (gSlabFreeList) protected 
+// by gSlabMutex.  Allocation tries the magazine for the stripe that the new HNode 
+// belongs to (which, because it doesn't call the allocator, can be done with the 
+// stripe mutex held), then the depot, and only allocates a new slab if both are 
+// empty.  A freed block goes back to the magazine for its old HNode's stripe; if 
+// that's full, half of it moves to the depot.
+//
+// The kernel KPI doesn't give us per-CPU data, so per-stripe magazines are the 
+// closest thing.  Because the hash spreads HNodes evenly across the stripes, they 
+// spread the allocation traffic in the same way.
+//
+// Slabs are never returned to the system until HNodeTerm.  That's the same trade-off 
+// as a kernel zone, and the number of HNodes is bounded by the number of vnodes.
+
+enum {
+    kHNodeSlabBlockCount    = 32,       // HNode blocks per slab
+    kHNodeMagazineSize      = 16        // size of an HNodeMagazine in pointers, which makes it a whole 
+                                        // number of cache lines on both 32- and 64-bit systems
+};
+
+union HNodeSlabHeader {
+    union HNodeSlabHeader * next;       // next pointer for gSlabList
+    uint64_t                alignment;  // makes sure that the blocks that follow are 8 byte aligned
+};
+typedef union HNodeSlabHeader HNodeSlabHeader;
+
+struct HNodeFreeBlock {
+    struct HNodeFreeBlock * next;       // next pointer for gSlabFreeList
+};
+typedef struct HNodeFreeBlock HNodeFreeBlock;
+
+struct HNodeMagazine {
+    size_t      count;                              // number of valid entries in blocks
+    HNodeRef    blocks[kHNodeMagazineSize - 1];     // free HNode blocks
+};
+typedef struct HNodeMagazine HNodeMagazine;
+
+static HNodeMagazine        gMagazines[kHNodeHashStripeCount];  // gMagazines[i] is protected by gHashStripes[i].mutex
+static size_t               gNodeBlockSize;                     // sizeof(HNode) + gFSNodeSize, rounded up to a multiple of 8
+static lck_mtx_t *          gSlabMutex;                         // protects gSlabList and gSlabFreeList; last in 
+                                                                // the lock order (see "Lock Order" above)
+static HNodeSlabHeader *    gSlabList;                          // all slabs, so that HNodeTerm can free them
+static HNodeFreeBlock *     gSlabFreeList;                      // the depot
+
+static size_t HNodeSlabGetSize(void)
+    // Returns the size, in bytes, of a slab.
+{
+    return sizeof(HNodeSlabHeader) + (gNodeBlockSize * kHNodeSlabBlockCount);
+}
+
+static HNodeRef HNodeBlockAllocFromMagazine(HNodeHashStripe *stripe)
+    // Allocates an HNode block from the magazine of the specified stripe.  The 
+    // caller must hold the stripe mutex.  Returns NULL if the magazine is empty. 
+    // The block's contents are undefined.
+{
+    HNodeMagazine * magazine;
+    HNodeRef        result;
+    
+    LCK_MTX_ASSERT(stripe->mutex, LCK_MTX_ASSERT_OWNED);
+    
+    result = NULL;
+    magazine = &gMagazines[stripe - gHashStripes];
+    if (magazine->count != 0) {
+        magazine->count -= 1;
+        result = magazine->blocks[magazine->count];
+    }
+    return result;
+}
+
+static void HNodeSlabAddToDepot(HNodeSlabHeader *newSlab)
+    // Adds a newly allocated slab to gSlabList and all of its blocks to the 
+    // depot.  The caller must hold gSlabMutex.
+{
+    size_t              blockIndex;
+    HNodeFreeBlock *    thisBlock;
+    
+    LCK_MTX_ASSERT(gSlabMutex, LCK_MTX_ASSERT_OWNED);
+    
+    newSlab->next = gSlabList;
+    gSlabList = newSlab;
+    
+    for (blockIndex = 0; blockIndex < kHNodeSlabBlockCount; blockIndex++) {
+        thisBlock = (HNodeFreeBlock *) (((char *) &newSlab[1]) + (gNodeBlockSize * blockIndex));
+        thisBlock->next = gSlabFreeList;
+        gSlabFreeList = thisBlock;
+    }
+}
+
+static HNodeRef HNodeBlockAlloc(void)
+    // Allocates an HNode block from the depot, allocating a new slab if the 
+    // depot is empty.  The caller must not hold any locks.  Returns NULL if 
+    // there's no memory.  The block's contents are undefined.
+{
+    HNodeSlabHeader *   newSlab;
+    HNodeFreeBlock *    result;
+    
+    newSlab = NULL;
+    do {
+        lck_mtx_lock(gSlabMutex);
+        
+        // If we allocated a slab last time around, add its blocks to the depot.
+        
+        if (newSlab != NULL) {
+            HNodeSlabAddToDepot(newSlab);
+            newSlab = NULL;
+        }
+        
+        result = gSlabFreeList;
+        if (result != NULL) {
+            gSlabFreeList = result->next;
+        }
+        
+        lck_mtx_unlock(gSlabMutex);
+        
+        // If the depot was empty, allocate a new slab (outside of the lock) 
+        // and try again.
+        
+        if (result == NULL) {
+            newSlab = OSMalloc(HNodeSlabGetSize(), gOSMallocTag);
+            if (newSlab == NULL) {
+                break;
+            }
+        }
+    } while (result == NULL);
+    
+    return (HNodeRef) result;
+}
+
+static errno_t HNodeBlockAllocMany(size_t count, HNodeFreeBlock **listPtr)
+    // Allocates count HNode blocks from the depot, allocating new slabs as 
+    // necessary, and pushes them on to the list at *listPtr.  This takes gSlabMutex 
+    // once per slab rather than once per block.  The caller must not hold any 
+    // locks.  On error, any blocks that were allocated are still on the list.
+{
+    errno_t             err;
+    HNodeSlabHeader *   newSlab;
+    HNodeFreeBlock *    thisBlock;
+    
+    assert(listPtr != NULL);
+    
+    err = 0;
+    newSlab = NULL;
+    while ( (count != 0) && (err == 0) ) {
+        lck_mtx_lock(gSlabMutex);
+        
+        if (newSlab != NULL) {
+            HNodeSlabAddToDepot(newSlab);
+            newSlab = NULL;
+        }
+        
+        while ( (count != 0) && (gSlabFreeList != NULL) ) {
+            thisBlock = gSlabFreeList;
+            gSlabFreeList = thisBlock->next;
+            
+            thisBlock->next = *listPtr;
+            *listPtr = thisBlock;
+            count -= 1;
+        }
+        
+        lck_mtx_unlock(gSlabMutex);
+        
+        if (count != 0) {
+            newSlab = OSMalloc(HNodeSlabGetSize(), gOSMallocTag);
+            if (newSlab == NULL) {
+                err = ENOMEM;
+            }
+        }
+    }
+    
+    return err;
+}
+
+static size_t HNodeBlockFreeMany(HNodeFreeBlock *list)
+    // Returns a list of unused HNode blocks, as built by HNodeBlockAllocMany, 
+    // to the depot.  The caller must not hold any locks.  Returns the number 
+    // of blocks freed.
+{
+    size_t              count;
+    HNodeFreeBlock *    thisBlock;
+    
+    count = 0;
+    if (list != NULL) {
+        lck_mtx_lock(gSlabMutex);
+        
+        while (list != NULL) {
+            thisBlock = list;
+            list = thisBlock->next;
+            
+            thisBlock->next = gSlabFreeList;
+            gSlabFreeList = thisBlock;
+            count += 1;
+        }
+        
+        lck_mtx_unlock(gSlabMutex);
+    }
+    return count;
+}
+
+static void HNodeBlockFree(HNodeRef hnode)
+    // Returns an HNode block to the magazine of the stripe that the HNode belonged 
+    // to.  The caller must not hold any locks.  hnode's dev and ino fields must be 
+    // valid.
+{
+    HNodeHashStripe *   stripe;
+    HNodeMagazine *     magazine;
+    HNodeFreeBlock *    thisBlock;
+    
+    assert(hnode != NULL);
+    assert(hnode->magic == gMagic);
+    
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+    magazine = &gMagazines[stripe - gHashStripes];
+    
+    lck_mtx_lock(stripe->mutex);
+    
+    // If the magazine is full, move half of it to the depot.
+    
+    if ( magazine->count == (sizeof(magazine->blocks) / sizeof(magazine->blocks[0])) ) {
+        lck_mtx_lock(gSlabMutex);
+        
+        while ( magazine->count > ((sizeof(magazine->blocks) / sizeof(magazine->blocks[0])) / 2) ) {
+            magazine->count -= 1;
+            thisBlock = (HNodeFreeBlock *) magazine->blocks[magazine->count];
+            thisBlock->next = gSlabFreeList;
+            gSlabFreeList = thisBlock;
+        }
+        
+        lck_mtx_unlock(gSlabMutex);
+    }
+    
+    magazine->blocks[magazine->count] = hnode;
+    magazine->count += 1;
+    
+    lck_mtx_unlock(stripe->mutex);
+}
+
+static void HNodeSlabTerm(void)
+    // Frees all of the slabs.  There must be no HNodes left.
+{
+    HNodeSlabHeader *   thisSlab;
+    size_t              stripeIndex;
+    
+    while (gSlabList != NULL) {
+        thisSlab = gSlabList;
+        gSlabList = thisSlab->next;
+        
+        OSFree(thisSlab, HNodeSlabGetSize(), gOSMallocTag);
+    }
+    gSlabFreeList = NULL;
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        gMagazines[stripeIndex].count = 0;
+    }
+}
+
+static uint32_t HNodeReadBegin(HNodeReaderSlot *slot)
+    // Registers a lock-free lookup in the current epoch and returns that epoch, 
+    // which you must pass to HNodeReadEnd.  Until then, nothing that's removed 
+    // from the hash table will be freed.
+{
+    uint32_t    epoch;
+    
+    do {
+        epoch = gEpoch;
+        (void) OSIncrementAtomic(&slot->readers[epoch & 1]);
+        
+        // If the epoch advanced between us reading it and registering, 
+        // HNodeDeferredFreeReclaim may not have seen our registration, so 
+        // back out and try again.
+        
+        OSMemoryBarrier();
+        if (gEpoch == epoch) {
+            break;
+        }
+        (void) OSDecrementAtomic(&slot->readers[epoch & 1]);
+    } while (TRUE);
+    
+    return epoch;
+}
+
+static void HNodeReadEnd(HNodeReaderSlot *slot, uint32_t epoch)
+    // Ends a lock-free lookup started by HNodeReadBegin.  slot must be the one 
+    // that was passed to HNodeReadBegin.
+{
+    OSMemoryBarrier();                  // all of our reads must be done before we deregister
+    (void) OSDecrementAtomic(&slot->readers[epoch & 1]);
+}
+
+static void HNodeDeferFree(HNodeDeferredFree *record, void *addr, size_t size, boolean_t nodeBlock)
+    // Puts the size byte block at addr on the deferred free list, using record 
+    // (which may be within the block) to track it.  The caller must already have 
+    // removed every reference to the block from the hash table.  If nodeBlock is 
+    // true, the block is an HNode that came from HNodeBlockAlloc.
+{
+    assert(record != NULL);
+    assert(addr != NULL);
+    
+    record->addr = addr;
+    record->size = size;
+    record->nodeBlock = nodeBlock;
+
+    lck_mtx_lock(gDeferredFreeMutex);
+
+    OSMemoryBarrier();                  // the block's removal must be visible before we sample gEpoch
+    record->epoch = gEpoch;
+    record->next  = gDeferredFreeList;
+    gDeferredFreeList = record;
+
+    lck_mtx_unlock(gDeferredFreeMutex);
+}
+
+static void HNodeDeferredFreeReclaim(boolean_t freeAll)
+    // Advances the epoch, if possible, and then frees any blocks on the deferred 
+    // free list that no lock-free lookup can still be using.  If freeAll is true, 
+    // the caller guarantees that there are no lookups in progress, and we free 
+    // everything.
+{
+    HNodeDeferredFree *     toFree;
+    HNodeDeferredFree **    link;
+    HNodeDeferredFree *     thisRecord;
+    size_t                  slotIndex;
+    int32_t                 previousEpochReaders;
+    
+    toFree = NULL;
+
+    lck_mtx_lock(gDeferredFreeMutex);
+    
+    if (gDeferredFreeList != NULL) {
+    
+        // We can advance the epoch if every lookup that registered in the previous 
+        // epoch has finished.  (gEpoch + 1) has the same low bit as (gEpoch - 1).
+        
+        previousEpochReaders = 0;
+        for (slotIndex = 0; slotIndex < kHNodeReaderSlotCount; slotIndex++) {
+            previousEpochReaders += gReaderSlots[slotIndex].readers[(gEpoch + 1) & 1];
+        }
+        if (previousEpochReaders == 0) {
+            OSMemoryBarrier();
+            gEpoch += 1;
+            OSMemoryBarrier();
+        }
+        
+        // The list is sorted newest first, so once we find a block that was retired 
+        // at least two epochs ago, it and all the blocks after it can be freed.
+        
+        link = &gDeferredFreeList;
+        while ( (*link != NULL) && ! freeAll && ((gEpoch - (*link)->epoch) < 2) ) {
+            link = &(*link)->next;
+        }
+        toFree = *link;
+        *link = NULL;
+    }
+
+    lck_mtx_unlock(gDeferredFreeMutex);
+    
+    // Free the blocks outside of the lock.  Be careful to get the next pointer 
+    // first, because the record is usually within the block.
+    
+    while (toFree != NULL) {
+        thisRecord = toFree;
+        toFree = thisRecord->next;
+        
+        if (thisRecord->nodeBlock) {
+            HNodeBlockFree((HNodeRef) thisRecord->addr);
+        } else {
+            OSFree(thisRecord->addr, thisRecord->size, gOSMallocTag);
+        }
+    }
+}
+
+static vnode_t * HNodeForkBufferAlloc(size_t forkCount)
+    // Allocates an external fork array with room for forkCount vnodes, all NULL. 
+    // The array is preceded by an HNodeDeferredFree record, so that 
+    // HNodeForkBufferRetire doesn't have to allocate memory.  Returns NULL if 
+    // there's no memory.
+{
+    HNodeDeferredFree * header;
+    vnode_t *           result;
+    
+    assert(forkCount > kHNodeInternalForkCount);
+    
+    result = NULL;
+    header = OSMalloc(sizeof(*header) + (sizeof(*result) * forkCount), gOSMallocTag);
+    if (header != NULL) {
+        memset(header, 0, sizeof(*header) + (sizeof(*result) * forkCount));
+        result = (vnode_t *) &header[1];
+    }
+    return result;
+}
+
+static void HNodeForkBufferFree(vnode_t *forkBuffer, size_t forkCount)
+    // Frees an array allocated by HNodeForkBufferAlloc immediately.  Only use 
+    // this if the array has never been visible to a lock-free lookup.
+{
+    assert(forkBuffer != NULL);
+
+    OSFree(((HNodeDeferredFree *) forkBuffer) - 1, sizeof(HNodeDeferredFree) + (sizeof(*forkBuffer) * forkCount), gOSMallocTag);
+}
+
+static void HNodeForkBufferRetire(vnode_t *forkBuffer, size_t forkCount)
+    // Frees an array allocated by HNodeForkBufferAlloc once no lock-free lookup 
+    // can be using it.
+{
+    HNodeDeferredFree * header;
+    
+    assert(forkBuffer != NULL);
+
+    header = ((HNodeDeferredFree *) forkBuffer) - 1;
+    HNodeDeferFree(header, header, sizeof(*header) + (sizeof(*forkBuffer) * forkCount), FALSE);
+}
+
+static errno_t HNodeBlockInit(HNodeRef newNode, dev_t dev, ino_t ino, size_t forkIndex)
+    // Initialises a newly allocated HNode block for (dev, ino), with a fork vnode 
+    // array big enough for forkIndex.  If forkIndex is beyond the internal array, 
+    // this allocates an external array, so the caller must not hold any locks. 
+    // If that fails, newNode is still valid enough to pass to HNodeBlockFree.
+{
+    errno_t     err;
+    
+    memset(newNode, 0, sizeof(*newNode) + gFSNodeSize);
+    
+    newNode->magic          = gMagic;
+    newNode->dev            = dev;
+    newNode->ino            = ino;
+    
+    // If we're dealing with one of the first few forks, use the internal buffer.  
+    // Otherwise allocate an external buffer.
+    
+    err = 0;
+    if (forkIndex < kHNodeInternalForkCount) {
+        newNode->forkVNodesSize = kHNodeInternalForkCount;
+        newNode->forkVNodes     = newNode->forkVNodesStorage.internal;
+    } else {
+        newNode->forkVNodesStorage.external = HNodeForkBufferAlloc(forkIndex + 1);
+        if (newNode->forkVNodesStorage.external == NULL) {
+            newNode->forkVNodesSize = kHNodeInternalForkCount;
+            newNode->forkVNodes     = newNode->forkVNodesStorage.internal;
+            err = ENOMEM;
+        } else {
+            newNode->forkVNodesSize = forkIndex + 1;
+            newNode->forkVNodes     = newNode->forkVNodesStorage.external;
+        }
+    }
+    return err;
+}
+
+static size_t HNodeGetTotalNodeCount(void)
+    // Returns the total number of HNodes in the hash table.  Unless the caller 
+    // holds all of the stripe mutexes, this is only a hint.
+{
+    size_t  stripeIndex;
+    size_t  nodeCount;
+    
+    nodeCount = 0;
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        nodeCount += gHashStripes[stripeIndex].nodeCount;
+    }
+    return nodeCount;
+}
+
+static void HNodeLockAllStripes(void)
+    // Takes all of the stripe mutexes, in index order, as required by the lock 
+    // order (see "Lock Order" above).
+{
+    size_t  stripeIndex;
+
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        lck_mtx_lock(gHashStripes[stripeIndex].mutex);
+    }
+}
+
+static void HNodeUnlockAllStripes(void)
+    // Undoes HNodeLockAllStripes.
+{
+    size_t  stripeIndex;
+
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        lck_mtx_unlock(gHashStripes[stripeIndex].mutex);
+    }
+}
+
+static size_t HNodeHashTableGetSize(u_long mask)
+    // Returns the size, in bytes, of a table with (mask + 1) chains.
+{
+    return sizeof(HNodeHashTable) + (sizeof(HNodeHashHead) * mask);
+}
+
+static HNodeHashTable * HNodeHashTableAlloc(u_long mask, boolean_t canBlock)
+    // Allocates a table with (mask + 1) empty chains.  Returns NULL if there's 
+    // no memory.  If canBlock is false, this fails rather than waiting for memory.
+{
+    HNodeHashTable *    table;
+    u_long              chainIndex;
+    
+    assert( ((mask + 1) & mask) == 0 );                 // power of two
+    assert( (mask + 1) >= kHNodeHashTableMinChains );
+    
+    if (canBlock) {
+        table = OSMalloc(HNodeHashTableGetSize(mask), gOSMallocTag);
+    } else {
+        table = OSMalloc_noblock(HNodeHashTableGetSize(mask), gOSMallocTag);
+    }
+    if (table != NULL) {
+        memset(&table->deferredFree, 0, sizeof(table->deferredFree));
+        table->mask = mask;
+        for (chainIndex = 0; chainIndex <= mask; chainIndex++) {
+            LIST_INIT(&table->chains[chainIndex]);
+        }
+    }
+    return table;
+}
+
+static void HNodeHashTableFree(HNodeHashTable *table)
+    // Frees a table immediately.  Only use this if the table has never been 
+    // visible to a lookup, or if there can't be any lookups in progress.
+{
+    #if MACH_ASSERT
+        {
+            u_long      chainIndex;
+            
+            for (chainIndex = 0; chainIndex <= table->mask; chainIndex++) {
+                assert(LIST_FIRST(&table->chains[chainIndex]) == NULL);
+            }
+        }
+    #endif
+    OSFree(table, HNodeHashTableGetSize(table->mask), gOSMallocTag);
+}
+
+static u_long HNodeHashTableGetTargetMask(size_t nodeCount)
+    // Returns the mask of a table that's the right size for nodeCount HNodes, 
+    // that is, with roughly one HNode per chain.
+{
+    u_long  chainCount;
+    
+    chainCount = kHNodeHashTableMinChains;
+    while ( (chainCount < nodeCount) && (chainCount < kHNodeHashTableMaxChains) ) {
+        chainCount *= 2;
+    }
+    return chainCount - 1;
+}
+
+static boolean_t HNodeHashTableNeedsResize(size_t nodeCount, u_long mask)
+    // Returns true if a table with (mask + 1) chains is too small, or much too big, 
+    // for nodeCount HNodes.  The gap between the grow and shrink thresholds stops 
+    // the table bouncing back and forth between sizes.
+{
+    u_long  chainCount;
+    
+    chainCount = mask + 1;
+    return ( (nodeCount > (chainCount * kHNodeHashTableGrowLoad))      && (chainCount < kHNodeHashTableMaxChains) )
+        || ( (nodeCount < (chainCount / kHNodeHashTableShrinkDivisor)) && (chainCount > kHNodeHashTableMinChains) );
+}
+
+static void HNodeHashTableMaintain(HNodeHashStripe *stripe, boolean_t canBlock)
+    // Called after an HNode has been added to, or removed from, stripe.  If no 
+    // resize is in progress, this checks whether the table needs to be resized 
+    // and, if so, starts a resize.  If a resize is in progress, it migrates the 
+    // next few chains to the new table, and finishes the resize if there are no 
+    // chains left.  The caller must not hold any locks.  canBlock is false on the 
+    // reclaim path, where we mustn't wait for memory.
+{
+    HNodeHashTable *    newTable;
+    HNodeHashTable *    retiredTable;
+    u_long              mask;
+    size_t              nodeCount;
+    u_long              chunk;
+    u_long              chainsPerStripe;
+    size_t              stripeIndex;
+    u_long              chainIndex;
+    HNodeHashStripe *   migrateStripe;
+    HNodeRef            thisNode;
+    
+    newTable = NULL;
+    retiredTable = NULL;
+    mask = 0;
+    
+    // The common case is that the table is fine.  To check that cheaply, we 
+    // estimate the total number of HNodes from this stripe's count (which works 
+    // because the hash spreads HNodes evenly across the stripes) and only sum 
+    // the stripe counts if that looks like it's out of range.
+    
+    if (gOldHashTable == NULL) {
+        mask = gHashTableMask;
+        if ( ! HNodeHashTableNeedsResize(stripe->nodeCount * kHNodeHashStripeCount, mask) ) {
+            return;
+        }
+        nodeCount = HNodeGetTotalNodeCount();
+        if ( ! HNodeHashTableNeedsResize(nodeCount, mask) ) {
+            return;
+        }
+        
+        // If this allocation fails, we just carry on with the current table.
+        
+        newTable = HNodeHashTableAlloc(HNodeHashTableGetTargetMask(nodeCount), canBlock);
+        if (newTable == NULL) {
+            return;
+        }
+    }
+    
+    lck_mtx_lock(gResizeMutex);
+    
+    // Start the resize, unless someone beat us to it.
+    
+    if ( (newTable != NULL) && (gOldHashTable == NULL) && (gHashTableMask == mask) ) {
+        HNodeLockAllStripes();
+
+        OSMemoryBarrier();              // newTable's empty chains must be visible before newTable is
+        gOldHashTable  = gHashTable;
+        gHashTable     = newTable;
+        gHashTableMask = newTable->mask;
+        gMigrateNext   = 0;
+
+        HNodeUnlockAllStripes();
+        
+        newTable = NULL;
+    }
+    
+    // Migrate some chains.  Each chain in the old table maps to exactly one stripe, 
+    // which also owns all of the chains in the new table that its HNodes map to. 
+    // We migrate the chains stripe by stripe (that is, gMigrateNext counts through 
+    // stripe 0's chains, then stripe 1's, and so on), so that we take each stripe 
+    // mutex once for a run of chains, and a chunk can span several stripes.
+    //
+    // The chunk has to be big enough for the migration to finish before the node 
+    // count changes enough to need another resize; otherwise a mass unmount would 
+    // leave the table half shrunk.  A shrink from N chains starts with fewer than 
+    // N / kHNodeHashTableShrinkDivisor HNodes, each of whose removal calls us, so 
+    // a chunk of at least kHNodeHashTableShrinkDivisor chains is enough.  Growing 
+    // has even more slack.
+    
+    if (gOldHashTable != NULL) {
+        chainsPerStripe = (gOldHashTable->mask + 1) / kHNodeHashStripeCount;
+        
+        chunk = 0;
+        while ( (chunk < kHNodeHashTableMigrateChunk) && (gMigrateNext <= gOldHashTable->mask) ) {
+            stripeIndex   = gMigrateNext / chainsPerStripe;
+            migrateStripe = &gHashStripes[stripeIndex];
+            
+            lck_mtx_lock(migrateStripe->mutex);
+            
+            do {
+                chainIndex = ((gMigrateNext % chainsPerStripe) * kHNodeHashStripeCount) + stripeIndex;
+                
+                while ( (thisNode = LIST_FIRST(&gOldHashTable->chains[chainIndex])) != NULL ) {
+                    assert(thisNode->magic == gMagic);
+                    assert(HNodeGetStripe(thisNode->dev, thisNode->ino) == migrateStripe);
+                    
+                    LIST_REMOVE(thisNode, hashLink);
+                    HNodeInsertAtHead(HNodeGetFirstFromHashTable(gHashTable, thisNode->dev, thisNode->ino), thisNode);
+                }
+                
+                gMigrateNext += 1;
+                chunk += 1;
+            } while ( (chunk < kHNodeHashTableMigrateChunk) && ((gMigrateNext % chainsPerStripe) != 0) );
+            
+            lck_mtx_unlock(migrateStripe->mutex);
+        }
+        
+        // If that was the last chain, the resize is complete.  Take all of the 
+        // stripe mutexes so that no locked lookup is looking at the old table, and 
+        // retire it.
+        
+        if (gMigrateNext > gOldHashTable->mask) {
+            HNodeLockAllStripes();
+
+            retiredTable = gOldHashTable;
+            gOldHashTable = NULL;
+
+            HNodeUnlockAllStripes();
+        }
+    }
+    
+    lck_mtx_unlock(gResizeMutex);
+    
+    // Clean up.
+    
+    if (newTable != NULL) {
+        HNodeHashTableFree(newTable);
+    }
+    if (retiredTable != NULL) {
+        HNodeDeferFree(&retiredTable->deferredFree, retiredTable, HNodeHashTableGetSize(retiredTable->mask), FALSE);
+    }
 }
 
 extern errno_t HNodeInit(
@@ -180,6 +1137,7 @@ extern errno_t HNodeInit(
     // See comments in header.
 {
     errno_t     err;
+    size_t      stripeIndex;
     
     assert(lockGroup != NULL);
     // lockAttr may be NULL
@@ -190,47 +1148,113 @@ extern errno_t HNodeInit(
     gFSNodeSize  = fsNodeSize;
     gOSMallocTag = mallocTag;
     gLockGroup   = lockGroup;
+    
+    gNodeBlockSize = (sizeof(HNode) + fsNodeSize + 7) & ~((size_t) 7);
+    
+    memset(gStripeStatistics, 0, sizeof(gStripeStatistics));
+    memset(gReaderSlots, 0, sizeof(gReaderSlots));
 
-    gHashMutex = lck_mtx_alloc_init(lockGroup, lockAttr);
-    gHashTable = hashinit(desiredvnodes, M_TEMP, &gHashTableMask);
     err = 0;
-    if ( (gHashMutex == NULL) || (gHashTable == NULL) ) {
-        HNodeTerm();                        // clean up any partial allocations
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        gHashStripes[stripeIndex].mutex = lck_mtx_alloc_init(lockGroup, lockAttr);
+        if (gHashStripes[stripeIndex].mutex == NULL) {
+            err = ENOMEM;
+        }
+    }
+    gDeferredFreeMutex = lck_mtx_alloc_init(lockGroup, lockAttr);
+    if (gDeferredFreeMutex == NULL) {
+        err = ENOMEM;
+    }
+    gResizeMutex = lck_mtx_alloc_init(lockGroup, lockAttr);
+    if (gResizeMutex == NULL) {
         err = ENOMEM;
     }
+    gSlabMutex = lck_mtx_alloc_init(lockGroup, lockAttr);
+    if (gSlabMutex == NULL) {
+        err = ENOMEM;
+    }
+    
+    // Start with the smallest table; it'll grow as HNodes are created.
+    
+    gHashTable = HNodeHashTableAlloc(kHNodeHashTableMinChains - 1, TRUE);
+    if (gHashTable == NULL) {
+        err = ENOMEM;
+    } else {
+        gHashTableMask = gHashTable->mask;
+    }
+    if (err != 0) {
+        HNodeTerm();                        // clean up any partial allocations
+    }
     return err;
 }
 
 extern void    HNodeTerm(void)
     // See comments in header.
 {
-    // Free the hash table.  Also, if there are any hash nodes left, we shouldn't 
-    // be terminating.
+    size_t      stripeIndex;
+    size_t      slotIndex;
+    
+    // Free the hash table (or tables, if we're in the middle of a resize).  Also, 
+    // if there are any hash nodes left, we shouldn't be terminating, and 
+    // HNodeHashTableFree will panic in the debug build.
+    
+    if (gOldHashTable != NULL) {
+        HNodeHashTableFree(gOldHashTable);
+        gOldHashTable = NULL;
+    }
+    if (gHashTable != NULL) {
+        HNodeHashTableFree(gHashTable);
+        gHashTable = NULL;
+        gHashTableMask = 0;
+    }
+    if (gResizeMutex != NULL) {
+        assert(gLockGroup != NULL);
+        
+        lck_mtx_free(gResizeMutex, gLockGroup);
+        gResizeMutex = NULL;
+    }
+    
+    // There can't be any lookups in progress, so free everything on the 
+    // deferred free list.
     
-    if (gHashTable != NULL) {
-        assert(gHashNodeCount == 0);
-        #if MACH_ASSERT
-            {
-                u_long      i;
-                
-                for (i = 0; i < (gHashTableMask + 1); i++) {
-                    assert(gHashTable[i].lh_first == NULL);
-                }
-            }
-        #endif
-        FREE(gHashTable, M_TEMP);
-        gHashTable = NULL;
+    if (gDeferredFreeMutex != NULL) {
+        HNodeDeferredFreeReclaim(TRUE);
+        assert(gDeferredFreeList == NULL);
+
+        assert(gLockGroup != NULL);
+        
+        lck_mtx_free(gDeferredFreeMutex, gLockGroup);
+        gDeferredFreeMutex = NULL;
     }
     
-    if (gHashMutex != NULL) {
+    // That returned all of the HNode blocks to the magazines and the depot, so 
+    // we can free the slabs that contain them.
+    
+    HNodeSlabTerm();
+    if (gSlabMutex != NULL) {
         assert(gLockGroup != NULL);
         
-        lck_mtx_free(gHashMutex, gLockGroup);
-        gHashMutex = NULL;
+        lck_mtx_free(gSlabMutex, gLockGroup);
+        gSlabMutex = NULL;
+    }
+    
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        assert(gHashStripes[stripeIndex].nodeCount == 0);
+        if (gHashStripes[stripeIndex].mutex != NULL) {
+            assert(gLockGroup != NULL);
+            
+            lck_mtx_free(gHashStripes[stripeIndex].mutex, gLockGroup);
+            gHashStripes[stripeIndex].mutex = NULL;
+        }
+    }
+    for (slotIndex = 0; slotIndex < kHNodeReaderSlotCount; slotIndex++) {
+        assert(gReaderSlots[slotIndex].readers[0] == 0);
+        assert(gReaderSlots[slotIndex].readers[1] == 0);
     }
 
     gLockGroup = NULL;
     gOSMallocTag = NULL;
+    gNodeBlockSize = 0;
     gFSNodeSize = 0;
     gMagic = 0;
 }
@@ -289,22 +1313,25 @@ extern ino_t HNodeGetInodeNumber(HNodeRef hnode)
 extern vnode_t HNodeGetVNodeForForkAtIndex(HNodeRef hnode, size_t forkIndex)
     // See comments in header.
 {
-    vnode_t     vn;
+    vnode_t             vn;
+    HNodeHashStripe *   stripe;
     
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
     assert(forkIndex < hnode->forkVNodesSize);
     
-    // Locking and unlocking gHashMutex /is/ needed, because another thread might 
+    // Locking and unlocking the stripe mutex /is/ needed, because another thread might 
     // be swapping in an expanded forkVNodes array.  Because of the multi-threaded 
     // nature of the kernel, no amount of clever ordering of this swap can prevent 
     // the possibility of us seeing inconsistent data.
     
-    lck_mtx_lock(gHashMutex);
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    lck_mtx_lock(stripe->mutex);
 
     vn = hnode->forkVNodes[forkIndex];
 
-    lck_mtx_unlock(gHashMutex);
+    lck_mtx_unlock(stripe->mutex);
     
     return vn;
 }
@@ -316,18 +1343,21 @@ extern size_t HNodeGetForkIndexForVNode(vnode_t vn)
     // prevents the vnode from being reclaimed, which means that we're 
     // guaranteed to find the vnode in the fork array.
 {
-    HNodeRef    hnode;
-    size_t      forkCount;
-    size_t      forkIndex;
+    HNodeRef            hnode;
+    HNodeHashStripe *   stripe;
+    size_t              forkCount;
+    size_t              forkIndex;
     
     assert(vn != NULL);
     
     hnode = HNodeFromVNode(vn);         // HNodeFromVNode asserts the validity of its result
     
-    // Locking and unlocking gHashMutex is needed, because another thread might 
+    // Locking and unlocking the stripe mutex is needed, because another thread might 
     // be switching in an expanded forkVNodes array.
     
-    lck_mtx_lock(gHashMutex);
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    lck_mtx_lock(stripe->mutex);
 
     forkCount = hnode->forkVNodesSize;
     for (forkIndex = 0; forkIndex < forkCount; forkIndex++) {
@@ -337,56 +1367,122 @@ extern size_t HNodeGetForkIndexForVNode(vnode_t vn)
     }
     assert(forkIndex != forkCount);     // that is, that vn is in forkVNodes
 
-    lck_mtx_unlock(gHashMutex);
+    lck_mtx_unlock(stripe->mutex);
     
     return forkIndex;
 }
 
-extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkIndex, HNodeRef *hnodePtr, vnode_t *vnPtr)
-    // See comments in header.
+static boolean_t HNodeLookupLockFree(
+    HNodeReaderSlot *   slot, 
+    HNodeHashStripe *   stripe, 
+    dev_t               dev, 
+    ino_t               ino, 
+    size_t              forkIndex, 
+    HNodeRef *          hnodePtr, 
+    vnode_t *           vnPtr
+)
+    // The fast path of HNodeLookupCreatingIfNecessary.  This handles the common case, 
+    // where the HNode exists, no attach is outstanding, and there's already a vnode 
+    // attached to the fork, without taking the stripe mutex.  For anything else, it 
+    // returns FALSE and the caller must use the locked path.  On success, the caller 
+    // has an I/O reference on *vnPtr.  slot is the current thread's reader slot, 
+    // which the caller has already used to count the lookup.
 {
-    errno_t         err;
-    HNodeRef        thisNode;
-    HNodeRef        newNode;
-    vnode_t *       newForkBuffer;
-    boolean_t       needsUnlock;
-    vnode_t         resultVN;
-    uint32_t        vid;
+    boolean_t   result;
+    uint32_t    epoch;
+    HNodeRef    thisNode;
+    size_t      forkVNodesSize;
+    vnode_t     candidateVN;
+    uint32_t    vid;
     
-    assert( hnodePtr != NULL);
-    assert(*hnodePtr == NULL);
-    assert( vnPtr    != NULL);
-    assert(*vnPtr    == NULL);
+    result = FALSE;
+    candidateVN = NULL;
+    vid = 0;
+    
+    epoch = HNodeReadBegin(slot);
 
-    // If you forget to call HNodeInit, it's likely that the first call you'll make is 
-    // HNodeLookupCreatingIfNecessary (to set up your root vnode), and this assert will 
-    // fire (rather than you dying inside with a memory access exception inside lck_mtx_lock).
+    thisNode = HNodeFindInTables(dev, ino);
+    
+    if ( (thisNode != NULL) && ! thisNode->attachOutstanding ) {
+
+        // Read forkVNodesSize before forkVNodes.  The array only ever grows, and a new 
+        // array is published before the size is increased, so forkIndex is always 
+        // within whichever array we see.
+        
+        forkVNodesSize = thisNode->forkVNodesSize;
+        OSMemoryBarrier();
+        if (forkIndex < forkVNodesSize) {
+            candidateVN = thisNode->forkVNodes[forkIndex];
+        }
+        
+        // Get the vnode's ID and then check that the vnode is still attached to this 
+        // fork.  A vnode is always detached from its HNode before it's recycled (which 
+        // changes its ID), so if it's still attached then the ID we got is the one 
+        // for this fsobj.  This is what the locked path gets by holding the mutex.
+        
+        if (candidateVN != NULL) {
+            vid = vnode_vid(candidateVN);
+            OSMemoryBarrier();
+            if (thisNode->forkVNodes[forkIndex] != candidateVN) {
+                candidateVN = NULL;
+            }
+        }
+    }
+    
+    HNodeReadEnd(slot, epoch);
+
+    // Get an I/O reference on the vnode.  This fails if the vnode was recycled after 
+    // we got its ID, in which case we let the locked path sort things out.  If it 
+    // succeeds, the vnode (and thus the HNode) can't go away until the caller 
+    // calls vnode_put.
+    
+    if (candidateVN != NULL) {
+        if ( vnode_getwithvid(candidateVN, vid) == 0 ) {
+            *hnodePtr = thisNode;
+            *vnPtr    = candidateVN;
+            result = TRUE;
+        } else {
+            (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->vidRetries);
+        }
+    }
     
-    assert(gHashMutex != NULL);
+    return result;
+}
 
+static errno_t HNodeLookupLocked(
+    HNodeHashStripe *   stripe, 
+    dev_t               dev, 
+    ino_t               ino, 
+    size_t              forkIndex, 
+    HNodeRef *          hnodePtr, 
+    vnode_t *           vnPtr
+)
+    // The slow path of HNodeLookupCreatingIfNecessary, which handles every case 
+    // with the stripe mutex held.
+{
+    errno_t             err;
+    HNodeRef            thisNode;
+    HNodeRef            newNode;
+    vnode_t *           newForkBuffer;
+    boolean_t           needsUnlock;
+    vnode_t             resultVN;
+    uint32_t            vid;
+    
     newNode = NULL;
     newForkBuffer = NULL;
     needsUnlock = TRUE;
     resultVN = NULL;
     
-    lck_mtx_lock(gHashMutex);
+    lck_mtx_lock(stripe->mutex);
     
     do {
-        LCK_MTX_ASSERT(gHashMutex, LCK_MTX_ASSERT_OWNED);
+        LCK_MTX_ASSERT(stripe->mutex, LCK_MTX_ASSERT_OWNED);
 
         err = EAGAIN;
         
         // First look it up in the hash table.
         
-        thisNode = LIST_FIRST(HNodeGetFirstFromHashTable(dev, ino));
-        while (thisNode != NULL) {
-            assert(thisNode->magic == gMagic);
-            
-            if ( (thisNode->dev == dev) && (thisNode->ino == ino) ) {
-                break;
-            }
-            thisNode = LIST_NEXT(thisNode, hashLink);
-        }
+        thisNode = HNodeFindInTables(dev, ino);
         
         // If we didn't find it, we're creating a new HNode.  If we haven't already 
         // allocated newNode, we must do so.  This drops the mutex, so the hash table 
@@ -396,48 +1492,42 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
         
         if (thisNode == NULL) {
             if (newNode == NULL) {
-                lck_mtx_unlock(gHashMutex);
-
-                // Allocate a new node.
+                // Allocate a new node.  Usually we can get one from the stripe's 
+                // magazine, which doesn't require us to drop the mutex (although 
+                // we still loop, which is cheap).  If not, we drop the mutex and 
+                // get one from the depot.
+                
+                if (forkIndex < kHNodeInternalForkCount) {
+                    newNode = HNodeBlockAllocFromMagazine(stripe);
+                    if (newNode != NULL) {
+                        err = HNodeBlockInit(newNode, dev, ino, forkIndex);
+                        assert(err == 0);       // can't fail because it doesn't need an external fork buffer
+                        err = EAGAIN;
+                    }
+                }
                 
-                newNode = OSMalloc(sizeof(*newNode) + gFSNodeSize, gOSMallocTag);
                 if (newNode == NULL) {
-                    err = ENOMEM;
-                } else {
-                    // Fill it in.
-                    
-                    memset(newNode, 0, sizeof(*newNode) + gFSNodeSize);
-                    
-                    newNode->magic          = gMagic;
-                    newNode->dev            = dev;
-                    newNode->ino            = ino;
-                    
-                    // If we're dealing with the first fork, use the internal buffer.  
-                    // Otherwise allocate an external buffer.
-                    
-                    if (forkIndex == 0) {
-                        newNode->forkVNodesSize = 1;
-                        newNode->forkVNodes     = &newNode->forkVNodesStorage.internal;
-                        newNode->forkVNodesStorage.internal = NULL;
+                    lck_mtx_unlock(stripe->mutex);
+
+                    newNode = HNodeBlockAlloc();
+                    if (newNode == NULL) {
+                        err = ENOMEM;
                     } else {
-                        newNode->forkVNodesSize = forkIndex + 1;
-                        newNode->forkVNodesStorage.external = OSMalloc(sizeof(*newNode->forkVNodesStorage.external) * (forkIndex + 1), gOSMallocTag);
-                        newNode->forkVNodes = newNode->forkVNodesStorage.external;
-                        if (newNode->forkVNodesStorage.external == NULL) {
-                            // If this allocation fails, we don't have to clean up newNode, 
-                            // because we'll fall out of the loop and newNode will get cleaned 
-                            // up at the end.
-                            err = ENOMEM;
-                        } else {
-                            memset(newNode->forkVNodesStorage.external, 0, sizeof(*newNode->forkVNodesStorage.external) * (forkIndex + 1));
+                        // If this fails, we don't have to clean up newNode, because 
+                        // we'll fall out of the loop and newNode will get cleaned up 
+                        // at the end.
+                        
+                        err = HNodeBlockInit(newNode, dev, ino, forkIndex);
+                        if (err == 0) {
+                            err = EAGAIN;
                         }
                     }
-                }
 
-                lck_mtx_lock(gHashMutex);
+                    lck_mtx_lock(stripe->mutex);
+                }
             } else {
-                LIST_INSERT_HEAD(HNodeGetFirstFromHashTable(dev, ino), newNode, hashLink);
-                gHashNodeCount += 1;
+                HNodeInsertAtHead(HNodeGetFirstFromHashTable(gHashTable, dev, ino), newNode);
+                stripe->nodeCount += 1;
 
                 // Set thisNode to the node that we inserted, and clear newNode so it 
                 // doesn't get freed.
@@ -449,7 +1539,7 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
                 // There's a /really/ subtle point here.  Once we've inserted the new node 
                 // into the hash table, it can be discovered by other threads.  This would 
                 // be bad, because it's only partially constructed at this point.  We prevent 
-                // this problem by not dropping gHashMutex from this point to the point that 
+                // this problem by not dropping the stripe mutex from this point to the point that 
                 // we're done.  This only works because we allocate the new node with a fork 
                 // buffer that's adequate to meet our needs.
             }
@@ -471,7 +1561,8 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
 
                 thisNode->waiting = TRUE;
                 
-                (void) msleep(thisNode, gHashMutex, PINOD, "HNodeLookupCreatingIfNecessary", NULL);
+                (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->attachSleeps);
+                (void) msleep(thisNode, stripe->mutex, PINOD, "HNodeLookupCreatingIfNecessary", NULL);
                 
                 // msleep drops and reacquires the mutex; the hash table may have changed, 
                 // so we loop.
@@ -485,25 +1576,22 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
                     // Because this drops the mutex, we have to loop and start again 
                     // from scratch.
 
-                    lck_mtx_unlock(gHashMutex);
+                    lck_mtx_unlock(stripe->mutex);
 
-                    newForkBuffer = OSMalloc(sizeof(*newForkBuffer) * (forkIndex + 1), gOSMallocTag);
+                    newForkBuffer = HNodeForkBufferAlloc(forkIndex + 1);
                     if (newForkBuffer == NULL) {
                         err = ENOMEM;
-                    } else {
-                        memset(newForkBuffer, 0, sizeof(*newForkBuffer) * (forkIndex + 1));
                     }
                     
-                    lck_mtx_lock(gHashMutex);
+                    lck_mtx_lock(stripe->mutex);
                 } else {
-                    // Insert the newForkBuffer into theNode.  This only works because 
-                    // readers of the thisNode->forkVNodes array (notably this routine 
-                    // and HNodeGetVNodeForForkAtIndex) always take gHashMutex.  If that 
-                    // wasn't the case, you could get into some subtle race conditions 
-                    // as thread A brings a copy of thisNode->forkVNodes into a register 
-                    // and then gets blocked, then thread B runs and expands the array 
-                    // and frees the buffer that is being pointed to be thread A's 
-                    // register.
+                    // Insert the newForkBuffer into theNode.  Most readers of the 
+                    // thisNode->forkVNodes array (notably this routine and 
+                    // HNodeGetVNodeForForkAtIndex) take the stripe mutex, but 
+                    // HNodeLookupLockFree does not.  It might have a copy of the old 
+                    // thisNode->forkVNodes in a register, so we can't free the old 
+                    // buffer until it's done (see "Deferred Free"), and we must publish 
+                    // the new buffer before the new size (see HNodeLookupLockFree).
                     
                     vnode_t *   oldForkBuffer;
                     size_t      oldForkBufferSize;
@@ -511,29 +1599,32 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
                     oldForkBufferSize = 0;          // quieten a false warning
                     
                     // We only free the old fork buffer if it was external, rather than 
-                    // the single vnode buffer embedded in the HNode.
+                    // the vnode buffer embedded in the HNode.
                     
                     oldForkBuffer = NULL;
-                    if (thisNode->forkVNodesSize > 1) {
+                    if (thisNode->forkVNodesSize > kHNodeInternalForkCount) {
                         oldForkBuffer = thisNode->forkVNodesStorage.external;
                         oldForkBufferSize = thisNode->forkVNodesSize;
                     }
                     memcpy(newForkBuffer, thisNode->forkVNodes, sizeof(*thisNode->forkVNodes) * thisNode->forkVNodesSize);
+                    OSMemoryBarrier();
                     thisNode->forkVNodes = newForkBuffer;
-                    thisNode->forkVNodesSize = (forkIndex + 1);
                     thisNode->forkVNodesStorage.external = newForkBuffer;
+                    OSMemoryBarrier();
+                    thisNode->forkVNodesSize = (forkIndex + 1);
                     
                     newForkBuffer = NULL;           // so we don't free it at the end
 
                     // Drop the mutex around the free, and then start again from scratch.
 
-                    lck_mtx_unlock(gHashMutex);
+                    lck_mtx_unlock(stripe->mutex);
                     
                     if (oldForkBuffer != NULL) {
-                        OSFree(oldForkBuffer, sizeof(*oldForkBuffer) * oldForkBufferSize, gOSMallocTag);
+                        HNodeForkBufferRetire(oldForkBuffer, oldForkBufferSize);
+                        HNodeDeferredFreeReclaim(FALSE);
                     }
                     
-                    lck_mtx_lock(gHashMutex);                       
+                    lck_mtx_lock(stripe->mutex);                       
                 }
             } else if (thisNode->forkVNodes[forkIndex] == NULL) {
                 // If there's no existing vnode associated with this fork of the HNode, 
@@ -564,12 +1655,12 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
                 
                 // Check that our vnode hasn't been recycled.  If this succeeds, it 
                 // acquires a reference on the vnode, which is the one we return to 
-                // our caller.  We do this with gHashMutex unlocked to avoid any 
+                // our caller.  We do this with the stripe mutex unlocked to avoid any 
                 // deadlock concerns.
                 
                 vid = vnode_vid(candidateVN);
                 
-                lck_mtx_unlock(gHashMutex);
+                lck_mtx_unlock(stripe->mutex);
                 
                 err = vnode_getwithvid(candidateVN, vid);
 
@@ -582,7 +1673,9 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
                 } else {
                     // We're going to loop and retry, so relock the mutex.
                     
-                    lck_mtx_lock(gHashMutex);
+                    (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->vidRetries);
+
+                    lck_mtx_lock(stripe->mutex);
 
                     err = EAGAIN;
                 }
@@ -595,24 +1688,42 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
     if (err == 0) {
         *hnodePtr = thisNode;
         *vnPtr    = resultVN;
+        
+        if (resultVN == NULL) {
+            (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->misses);
+        }
+        
+        // If we succeeded and still have newNode, someone else inserted an HNode 
+        // for (dev, ino) while we had the mutex dropped to allocate it.
+        
+        if (newNode != NULL) {
+            (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->racesLost);
+        }
+    } else {
+        (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->failures);
     }
     
     // Clean up.
     
     if (needsUnlock) {
-        lck_mtx_unlock(gHashMutex);
+        lck_mtx_unlock(stripe->mutex);
     }
 
     // Free newForkBuffer if we allocated it but didn't use it.
     
     if (newForkBuffer != NULL) {
-        OSFree(newForkBuffer, sizeof(*newForkBuffer) * (forkIndex + 1), gOSMallocTag);
+        HNodeForkBufferFree(newForkBuffer, forkIndex + 1);
     }
 
-    // Free newNode if we allocated it but didn't put it into the table.
+    // Free newNode (and its external fork buffer, if any) if we allocated it but 
+    // didn't put it into the table.  No one else has seen it, so there's no need 
+    // to defer this.
     
     if (newNode != NULL) {
-        OSFree(newNode, sizeof(*newNode) + gFSNodeSize, gOSMallocTag); 
+        if (newNode->forkVNodesSize > kHNodeInternalForkCount) {
+            HNodeForkBufferFree(newNode->forkVNodesStorage.external, newNode->forkVNodesSize);
+        }
+        HNodeBlockFree(newNode);
     }
     
     assert( (err == 0) == (*hnodePtr != NULL) );
@@ -620,6 +1731,288 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
     return err;
 }
 
+extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkIndex, HNodeRef *hnodePtr, vnode_t *vnPtr)
+    // See comments in header.
+{
+    errno_t             err;
+    HNodeHashStripe *   stripe;
+    HNodeReaderSlot *   slot;
+    
+    assert( hnodePtr != NULL);
+    assert(*hnodePtr == NULL);
+    assert( vnPtr    != NULL);
+    assert(*vnPtr    == NULL);
+
+    // If you forget to call HNodeInit, it's likely that the first call you'll make is 
+    // HNodeLookupCreatingIfNecessary (to set up your root vnode), and this assert will 
+    // fire (rather than you dying inside with a memory access exception inside lck_mtx_lock).
+    
+    assert(gHashTable != NULL);
+
+    // Everything we do here is confined to the one hash chain, and thus the one 
+    // stripe, that (dev, ino) hashes to.
+    
+    stripe = HNodeGetStripe(dev, ino);
+    assert(stripe->mutex != NULL);
+    
+    slot = HNodeGetReaderSlot();
+    (void) OSAddAtomic64(1, &slot->lookups);
+
+    // Try the lock-free path first, which handles the common case of a hit on a 
+    // vnode that's already attached, and fall back to the locked path for everything 
+    // else.
+    
+    if ( HNodeLookupLockFree(slot, stripe, dev, ino, forkIndex, hnodePtr, vnPtr) ) {
+        err = 0;
+    } else {
+        err = HNodeLookupLocked(stripe, dev, ino, forkIndex, hnodePtr, vnPtr);
+        
+        // The locked path may have added an HNode, so check whether the table 
+        // needs resizing.
+        
+        HNodeHashTableMaintain(stripe, TRUE);
+    }
+    
+    return err;
+}
+
+// HNodeLookupMany uses the err field of each request to track its progress.  These 
+// values can't be confused with a real errno.
+
+enum {
+    kHNodeLookupPending     = -1,       // request not yet resolved
+    kHNodeLookupCandidate   = -2        // request has found a vnode but doesn't yet have a reference on it
+};
+
+static size_t HNodeLookupManyInStripe(
+    HNodeHashStripe *       stripe, 
+    HNodeLookupRequest      requests[], 
+    size_t                  firstIndex, 
+    size_t                  requestCount, 
+    HNodeFreeBlock **       freeBlocksPtr
+)
+    // Resolves the pending requests for stripe, which are linked together through 
+    // their next fields, starting at firstIndex and ending with requestCount.  It 
+    // holds the stripe mutex once for the lot.  This follows the same logic as 
+    // HNodeLookupLocked, except that, where that routine would sleep or drop the 
+    // mutex, this one sets the request's err to EAGAIN.  New HNodes come from the 
+    // stripe's magazine or, failing that, from *freeBlocksPtr.  If both are empty, 
+    // the request is left pending.  Returns the number of requests left pending 
+    // for that reason.
+{
+    errno_t                 junk;
+    size_t                  blocksNeeded;
+    size_t                  requestIndex;
+    HNodeLookupRequest *    thisRequest;
+    HNodeRef                thisNode;
+    HNodeRef                newNode;
+    HNodeStripeStatistics * stats;
+    
+    assert(freeBlocksPtr != NULL);
+    
+    stats = HNodeGetStripeStatistics(stripe);
+    blocksNeeded = 0;
+    
+    lck_mtx_lock(stripe->mutex);
+    
+    for (requestIndex = firstIndex; requestIndex != requestCount; requestIndex = thisRequest->next) {
+        thisRequest = &requests[requestIndex];
+        assert(thisRequest->err == kHNodeLookupPending);
+        assert(HNodeGetStripe(thisRequest->dev, thisRequest->ino) == stripe);
+        
+        thisNode = HNodeFindInTables(thisRequest->dev, thisRequest->ino);
+        
+        // If there's no HNode, create one, as long as we can do that without 
+        // dropping the mutex.
+        
+        if (thisNode == NULL) {
+            if (thisRequest->forkIndex >= kHNodeInternalForkCount) {
+                thisRequest->err = EAGAIN;          // needs an external fork buffer
+            } else {
+                newNode = HNodeBlockAllocFromMagazine(stripe);
+                if ( (newNode == NULL) && (*freeBlocksPtr != NULL) ) {
+                    newNode = (HNodeRef) *freeBlocksPtr;
+                    *freeBlocksPtr = (*freeBlocksPtr)->next;
+                }
+                
+                if (newNode == NULL) {
+                    blocksNeeded += 1;
+                } else {
+                    junk = HNodeBlockInit(newNode, thisRequest->dev, thisRequest->ino, thisRequest->forkIndex);
+                    assert(junk == 0);              // can't fail because it doesn't need an external fork buffer
+                    
+                    HNodeInsertAtHead(HNodeGetFirstFromHashTable(gHashTable, thisRequest->dev, thisRequest->ino), newNode);
+                    stripe->nodeCount += 1;
+                    
+                    thisNode = newNode;
+                }
+            }
+        }
+        
+        // If we have an HNode, check its status, just like HNodeLookupLocked.
+        
+        if (thisNode != NULL) {
+            if ( thisNode->attachOutstanding || (thisRequest->forkIndex >= thisNode->forkVNodesSize) ) {
+                thisRequest->err = EAGAIN;
+            } else if (thisNode->forkVNodes[thisRequest->forkIndex] == NULL) {
+                thisNode->attachOutstanding = TRUE;
+                thisNode->forkVNodesCount += 1;
+                
+                thisRequest->hnode = thisNode;
+                thisRequest->err   = 0;
+                
+                (void) OSAddAtomic64(1, &stats->misses);
+            } else {
+                thisRequest->hnode = thisNode;
+                thisRequest->vn    = thisNode->forkVNodes[thisRequest->forkIndex];
+                thisRequest->vid   = vnode_vid(thisRequest->vn);
+                thisRequest->err   = kHNodeLookupCandidate;
+            }
+        }
+    }
+    
+    lck_mtx_unlock(stripe->mutex);
+    
+    // Get a reference on each vnode that we found.  As in HNodeLookupLocked, we do 
+    // this with the stripe mutex unlocked.  If the vnode has been recycled, we leave 
+    // it to the caller to retry.
+    
+    for (requestIndex = firstIndex; requestIndex != requestCount; requestIndex = thisRequest->next) {
+        thisRequest = &requests[requestIndex];
+        if (thisRequest->err == kHNodeLookupCandidate) {
+            if ( vnode_getwithvid(thisRequest->vn, thisRequest->vid) == 0 ) {
+                thisRequest->err = 0;
+            } else {
+                thisRequest->hnode = NULL;
+                thisRequest->vn    = NULL;
+                thisRequest->err   = EAGAIN;
+                (void) OSAddAtomic64(1, &stats->vidRetries);
+            }
+        }
+    }
+    
+    return blocksNeeded;
+}
+
+extern void HNodeLookupMany(HNodeLookupRequest requests[], size_t requestCount)
+    // See comments in header.
+    //
+    // First we try each request on the lock-free path.  Then we make a pass over 
+    // the rest, sorting them into a list per stripe (linked through their next 
+    // fields, with requestCount as the terminator) and handling each stripe in 
+    // turn.  If any requests need a new HNode but the stripe's magazine is empty, 
+    // we allocate blocks for all of them in one go and make a second pass.  That 
+    // pass either uses those blocks or finds that someone else created the HNode 
+    // in the meantime, so there's never a third.
+{
+    errno_t             err;
+    size_t              requestIndex;
+    HNodeLookupRequest *thisRequest;
+    HNodeHashStripe *   stripe;
+    size_t              stripeIndex;
+    size_t              stripeHeads[kHNodeHashStripeCount];
+    size_t              blocksNeeded;
+    HNodeFreeBlock *    freeBlocks;
+    boolean_t           allocFailed;
+    size_t              blocksWasted;
+    HNodeReaderSlot *   slot;
+    size_t              failureCount;
+    
+    assert( (requests != NULL) || (requestCount == 0) );
+    assert(gHashTable != NULL);
+    
+    slot = HNodeGetReaderSlot();
+    (void) OSAddAtomic64( (int64_t) requestCount, &slot->lookups);
+
+    for (requestIndex = 0; requestIndex < requestCount; requestIndex++) {
+        thisRequest = &requests[requestIndex];
+        
+        thisRequest->err   = kHNodeLookupPending;
+        thisRequest->hnode = NULL;
+        thisRequest->vn    = NULL;
+        thisRequest->vid   = 0;
+        thisRequest->next  = requestCount;
+        
+        stripe = HNodeGetStripe(thisRequest->dev, thisRequest->ino);
+        if ( HNodeLookupLockFree(slot, stripe, thisRequest->dev, thisRequest->ino, thisRequest->forkIndex, &thisRequest->hnode, &thisRequest->vn) ) {
+            thisRequest->err = 0;
+        }
+    }
+    
+    freeBlocks = NULL;
+    allocFailed = FALSE;
+    do {
+        // Sort the pending requests by stripe.  We go backwards so that each 
+        // list is in request order.
+        
+        for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+            stripeHeads[stripeIndex] = requestCount;
+        }
+        requestIndex = requestCount;
+        while (requestIndex != 0) {
+            requestIndex -= 1;
+            thisRequest = &requests[requestIndex];
+            if (thisRequest->err == kHNodeLookupPending) {
+                stripeIndex = HNodeGetStripe(thisRequest->dev, thisRequest->ino) - gHashStripes;
+                thisRequest->next = stripeHeads[stripeIndex];
+                stripeHeads[stripeIndex] = requestIndex;
+            }
+        }
+        
+        // Resolve each stripe's requests.
+        
+        blocksNeeded = 0;
+        for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+            if (stripeHeads[stripeIndex] != requestCount) {
+                blocksNeeded += HNodeLookupManyInStripe(&gHashStripes[stripeIndex], requests, stripeHeads[stripeIndex], requestCount, &freeBlocks);
+            }
+        }
+        
+        if (blocksNeeded != 0) {
+            err = HNodeBlockAllocMany(blocksNeeded, &freeBlocks);
+            if (err != 0) {
+                for (requestIndex = 0; requestIndex < requestCount; requestIndex++) {
+                    if (requests[requestIndex].err == kHNodeLookupPending) {
+                        requests[requestIndex].err = err;
+                    }
+                }
+                allocFailed = TRUE;
+                blocksNeeded = 0;
+            }
+        }
+    } while (blocksNeeded != 0);
+    
+    // Return any blocks that we didn't use.  Normally each of these was allocated 
+    // for an HNode that someone else created first (possibly an earlier request for 
+    // the same HNode), so it counts as a lost race.  The statistics are only ever 
+    // summed, so it doesn't matter which stripe we charge it to.  If the allocation 
+    // failed, these are just what HNodeBlockAllocMany got before it ran out, so 
+    // they're not lost races.
+    
+    blocksWasted = HNodeBlockFreeMany(freeBlocks);
+    if ( (blocksWasted != 0) && ! allocFailed ) {
+        (void) OSAddAtomic64( (int64_t) blocksWasted, &gStripeStatistics[0].racesLost);
+    }
+    
+    // As in HNodeLookupCreatingIfNecessary, each miss might have added an HNode, 
+    // so give the table a chance to resize.  Also count the failures, so that 
+    // HNodeGetStatistics can work out the hits.
+    
+    failureCount = 0;
+    for (requestIndex = 0; requestIndex < requestCount; requestIndex++) {
+        thisRequest = &requests[requestIndex];
+        if ( (thisRequest->err == 0) && (thisRequest->vn == NULL) ) {
+            HNodeHashTableMaintain(HNodeGetStripe(thisRequest->dev, thisRequest->ino), TRUE);
+        } else if (thisRequest->err != 0) {
+            failureCount += 1;
+        }
+        assert( (thisRequest->err == 0) == (thisRequest->hnode != NULL) );
+    }
+    if (failureCount != 0) {
+        (void) OSAddAtomic64( (int64_t) failureCount, &gStripeStatistics[0].failures);
+    }
+}
+
 static void HNodeAttachComplete(HNodeRef hnode)
     // An attach operate has completed.  If there is someone waiting for 
     // the HNode, wake them up.
@@ -627,7 +2020,7 @@ static void HNodeAttachComplete(HNodeRef hnode)
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
     
-    LCK_MTX_ASSERT(gHashMutex, LCK_MTX_ASSERT_OWNED);
+    LCK_MTX_ASSERT(HNodeGetStripe(hnode->dev, hnode->ino)->mutex, LCK_MTX_ASSERT_OWNED);
 
     assert(hnode->attachOutstanding);
     hnode->attachOutstanding = FALSE;
@@ -643,21 +2036,27 @@ static boolean_t HNodeForkVNodeDecrement(HNodeRef hnode)
     // the HNode is gone and we remove it from the hash table and return 
     // true indicating to our caller that they need to clean it up.
 {
-    boolean_t   scrubIt;
+    boolean_t           scrubIt;
+    HNodeHashStripe *   stripe;
 
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
 
-    LCK_MTX_ASSERT(gHashMutex, LCK_MTX_ASSERT_OWNED);
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    LCK_MTX_ASSERT(stripe->mutex, LCK_MTX_ASSERT_OWNED);
 
     scrubIt = FALSE;
 
     hnode->forkVNodesCount -= 1;
     assert(hnode->forkVNodesCount >= 0);
     if (hnode->forkVNodesCount == 0) {
+        // LIST_REMOVE leaves hnode's own next pointer intact, so a lock-free lookup 
+        // that's currently looking at hnode can still continue down the chain.
+        
         LIST_REMOVE(hnode, hashLink);
-        assert(gHashNodeCount > 0);     // we test for this case before decrementing it because it's unsigned
-        gHashNodeCount -= 1;
+        assert(stripe->nodeCount > 0);  // we test for this case before decrementing it because it's unsigned
+        stripe->nodeCount -= 1;
 
         scrubIt = TRUE;
     }
@@ -668,18 +2067,22 @@ static boolean_t HNodeForkVNodeDecrement(HNodeRef hnode)
 extern void HNodeAttachVNodeSucceeded(HNodeRef hnode, size_t forkIndex, vnode_t vn)
     // See comments in header.
 {
-    errno_t     junk;
+    errno_t             junk;
+    HNodeHashStripe *   stripe;
     
-    lck_mtx_lock(gHashMutex);
-
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
+
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    lck_mtx_lock(stripe->mutex);
+
     assert(forkIndex < hnode->forkVNodesSize);
     assert(vn != NULL);
     assert(vnode_fsnode(vn) == hnode);
     
     // If someone is waiting for the HNode, wake them up.  They won't actually 
-    // start running until we drop gHashMutex.
+    // start running until we drop the stripe mutex.
     
     HNodeAttachComplete(hnode);
 
@@ -690,22 +2093,26 @@ extern void HNodeAttachVNodeSucceeded(HNodeRef hnode, size_t forkIndex, vnode_t
     junk = vnode_addfsref(vn);
     assert(junk == 0);
     
-    lck_mtx_unlock(gHashMutex);
+    lck_mtx_unlock(stripe->mutex);
 }
 
 extern boolean_t HNodeAttachVNodeFailed(HNodeRef hnode, size_t forkIndex)
     // See comments in header.
 {
-    boolean_t   scrubIt;
+    boolean_t           scrubIt;
+    HNodeHashStripe *   stripe;
     
-    lck_mtx_lock(gHashMutex);
-
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
+
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    lck_mtx_lock(stripe->mutex);
+
     assert(forkIndex < hnode->forkVNodesSize);
     
     // If someone is waiting for the HNode, wake them up.  They won't actually 
-    // start running until we drop gHashMutex.
+    // start running until we drop the stripe mutex.
     
     HNodeAttachComplete(hnode);
 
@@ -714,7 +2121,7 @@ extern boolean_t HNodeAttachVNodeFailed(HNodeRef hnode, size_t forkIndex)
 
     scrubIt = HNodeForkVNodeDecrement(hnode);
 
-    lck_mtx_unlock(gHashMutex);
+    lck_mtx_unlock(stripe->mutex);
 
     return scrubIt;
 }
@@ -722,16 +2129,19 @@ extern boolean_t HNodeAttachVNodeFailed(HNodeRef hnode, size_t forkIndex)
 extern boolean_t HNodeDetachVNode(HNodeRef hnode, vnode_t vn)
     // See comments in header.
 {
-    errno_t     junk;
-    size_t      forkIndex;
-    boolean_t   scrubIt;
+    errno_t             junk;
+    size_t              forkIndex;
+    boolean_t           scrubIt;
+    HNodeHashStripe *   stripe;
     
-    lck_mtx_lock(gHashMutex);
-
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
     assert(vn != NULL);
 
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+
+    lck_mtx_lock(stripe->mutex);
+
     // Find the fork index for vn.
     
     for (forkIndex = 0; forkIndex < hnode->forkVNodesSize; forkIndex++) {
@@ -740,6 +2150,8 @@ extern boolean_t HNodeDetachVNode(HNodeRef hnode, vnode_t vn)
         }
     }
     assert(forkIndex < hnode->forkVNodesSize);      // if this trips, vn isn't in the forkVNodes array
+    
+    (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->detaches);
 
     // Disassociate the vnode with this fork of the HNode.
     
@@ -753,7 +2165,7 @@ extern boolean_t HNodeDetachVNode(HNodeRef hnode, vnode_t vn)
 
     scrubIt = HNodeForkVNodeDecrement(hnode);
 
-    lck_mtx_unlock(gHashMutex);
+    lck_mtx_unlock(stripe->mutex);
 
     return scrubIt;
 }
@@ -761,11 +2173,21 @@ extern boolean_t HNodeDetachVNode(HNodeRef hnode, vnode_t vn)
 extern void HNodeScrubDone(HNodeRef hnode)
     // See comments in header.
 {
+    HNodeHashStripe *   stripe;
+    
     assert(hnode != NULL);
     assert(hnode->magic == gMagic);
     
-    if (hnode->forkVNodesSize > 1) {
-        OSFree(hnode->forkVNodesStorage.external, sizeof(*hnode->forkVNodesStorage.external) * hnode->forkVNodesSize, gOSMallocTag);
+    stripe = HNodeGetStripe(hnode->dev, hnode->ino);
+    
+    (void) OSAddAtomic64(1, &HNodeGetStripeStatistics(stripe)->reclaims);
+    
+    // The HNode is no longer in the hash table, but a lock-free lookup that found 
+    // it earlier might still be looking at it (or its fork buffer), so we put them 
+    // on the deferred free list rather than freeing them immediately.
+    
+    if (hnode->forkVNodesSize > kHNodeInternalForkCount) {
+        HNodeForkBufferRetire(hnode->forkVNodesStorage.external, hnode->forkVNodesSize);
     }
 
     // If anyone is waiting on this HNode, that would be bad.
@@ -775,7 +2197,119 @@ extern void HNodeScrubDone(HNodeRef hnode)
     // just add it blindly.
 
     assert( ! hnode->waiting );
-    OSFree(hnode, sizeof(*hnode) + gFSNodeSize, gOSMallocTag);
+    HNodeDeferFree(&hnode->deferredFree, hnode, gNodeBlockSize, TRUE);
+
+    // We've removed an HNode, so the table might now be too big.  We're typically 
+    // on the reclaim path, so we mustn't block waiting for memory.
+    
+    HNodeHashTableMaintain(stripe, FALSE);
+
+    // This is a quiescent point for the calling thread, so it's a good time to 
+    // free anything whose time has come.
+    
+    HNodeDeferredFreeReclaim(FALSE);
+}
+
+extern void HNodeGetChainStatistics(HNodeChainStatistics *stats)
+    // See comments in header.
+    //
+    // We hold gResizeMutex throughout.  Every resize, and every step of a 
+    // migration, happens under that mutex, so neither table can be replaced and 
+    // no chain can move between them while we're running.  We only hold one 
+    // stripe mutex at a time, so the contents of the chains can change as we go; 
+    // the result isn't an atomic snapshot, but each chain is measured consistently.
+{
+    HNodeHashTable *    tables[2];
+    size_t              tableIndex;
+    size_t              stripeIndex;
+    u_long              hashBucketIndex;
+    size_t              chainLength;
+    HNode *             thisNode;
+    
+    assert(stats != NULL);
+    assert(gHashTable != NULL);
+    
+    memset(stats, 0, sizeof(*stats));
+    
+    lck_mtx_lock(gResizeMutex);
+
+    tables[0] = gOldHashTable;
+    tables[1] = gHashTable;
+    
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        lck_mtx_lock(gHashStripes[stripeIndex].mutex);
+        
+        for (tableIndex = 0; tableIndex < 2; tableIndex++) {
+            if (tables[tableIndex] == NULL) {
+                continue;
+            }
+            for (hashBucketIndex = stripeIndex; hashBucketIndex <= tables[tableIndex]->mask; hashBucketIndex += kHNodeHashStripeCount) {
+                chainLength = 0;
+                LIST_FOREACH(thisNode, &tables[tableIndex]->chains[hashBucketIndex], hashLink) {
+                    chainLength += 1;
+                }
+                
+                stats->bucketCount += 1;
+                if (tables[tableIndex] == gOldHashTable) {
+                    stats->oldBucketCount += 1;
+                }
+                stats->nodeCount += chainLength;
+                if (chainLength > stats->longestChain) {
+                    stats->longestChain = chainLength;
+                }
+                if (chainLength >= kHNodeChainLengthHistogramSize) {
+                    stats->chainLengths[kHNodeChainLengthHistogramSize - 1] += 1;
+                } else {
+                    stats->chainLengths[chainLength] += 1;
+                }
+            }
+        }
+        
+        lck_mtx_unlock(gHashStripes[stripeIndex].mutex);
+    }
+
+    lck_mtx_unlock(gResizeMutex);
+}
+
+extern void HNodeGetStatistics(HNodeStatistics *stats)
+    // See comments in header.
+    //
+    // We don't take any locks; each counter is summed across the stripes (or the 
+    // reader slots) with plain reads, which is good enough for statistics.
+{
+    size_t                          stripeIndex;
+    size_t                          slotIndex;
+    const HNodeStripeStatistics *   stripeStats;
+    uint64_t                        failures;
+    
+    assert(stats != NULL);
+    
+    memset(stats, 0, sizeof(*stats));
+    
+    failures = 0;
+    for (stripeIndex = 0; stripeIndex < kHNodeHashStripeCount; stripeIndex++) {
+        stripeStats = &gStripeStatistics[stripeIndex];
+        
+        stats->misses       += (uint64_t) stripeStats->misses;
+        failures            += (uint64_t) stripeStats->failures;
+        stats->vidRetries   += (uint64_t) stripeStats->vidRetries;
+        stats->attachSleeps += (uint64_t) stripeStats->attachSleeps;
+        stats->racesLost    += (uint64_t) stripeStats->racesLost;
+        stats->detaches     += (uint64_t) stripeStats->detaches;
+        stats->reclaims     += (uint64_t) stripeStats->reclaims;
+    }
+    
+    // Every lookup is counted before its outcome, so reading the lookup counts 
+    // after the outcomes means that hits can't go negative.  It may include 
+    // lookups that are still in progress, but that's good enough for statistics.
+    
+    OSMemoryBarrier();
+    for (slotIndex = 0; slotIndex < kHNodeReaderSlotCount; slotIndex++) {
+        stats->lookups += (uint64_t) gReaderSlots[slotIndex].lookups;
+    }
+    stats->hits = stats->lookups - stats->misses - failures;
+
+    stats->nodeCount = (uint64_t) HNodeGetTotalNodeCount();
 }
 
 extern void HNodePrintState(void)
@@ -792,12 +2326,13 @@ extern void HNodePrintState(void)
     HNode * nodes;
     u_long  hashBucketIndex;
     
-    // Take a snapshot.
+    // Take a snapshot.  To get a consistent picture, we hold all of the stripe 
+    // mutexes while we copy.
     
     do {
         err = 0;
         
-        nodeCount = gHashNodeCount;
+        nodeCount = HNodeGetTotalNodeCount();
         
         nodes = OSMalloc(sizeof(*nodes) * nodeCount, gOSMallocTag);
         if (nodes == NULL) {
@@ -805,28 +2340,42 @@ extern void HNodePrintState(void)
         }
         
         if (err == 0) {
-            lck_mtx_lock(gHashMutex);
+            HNodeLockAllStripes();
             
-            if (gHashNodeCount > nodeCount) {
+            if (HNodeGetTotalNodeCount() != nodeCount) {
                 // Whoops, it changed size, let's try again.
                 OSFree(nodes, sizeof(*nodes) * nodeCount, gOSMallocTag);
                 err = EAGAIN;
             } else {
+                HNodeHashTable *    tables[2];
+                size_t              tableIndex;
+
+                // If a resize is in progress, some of the HNodes are still in 
+                // the old table.
+                
+                tables[0] = gOldHashTable;
+                tables[1] = gHashTable;
+
                 nodeIndex = 0;
-                for (hashBucketIndex = 0; hashBucketIndex < gHashTableMask; hashBucketIndex++) {
-                    HNode *     thisNode;
-                    
-                    LIST_FOREACH(thisNode, &gHashTable[hashBucketIndex], hashLink) {
-                        assert(nodeIndex < nodeCount);
+                for (tableIndex = 0; tableIndex < 2; tableIndex++) {
+                    if (tables[tableIndex] == NULL) {
+                        continue;
+                    }
+                    for (hashBucketIndex = 0; hashBucketIndex <= tables[tableIndex]->mask; hashBucketIndex++) {
+                        HNode *     thisNode;
                         
-                        nodes[nodeIndex] = *thisNode;
-                        nodeIndex += 1;
+                        LIST_FOREACH(thisNode, &tables[tableIndex]->chains[hashBucketIndex], hashLink) {
+                            assert(nodeIndex < nodeCount);
+                            
+                            nodes[nodeIndex] = *thisNode;
+                            nodeIndex += 1;
+                        }
                     }
                 }
                 assert(nodeIndex == nodeCount);
             }
             
-            lck_mtx_unlock(gHashMutex);
+            HNodeUnlockAllStripes();
         }
     } while (err == EAGAIN);
 
@@ -860,4 +2409,39 @@ extern void HNodePrintState(void)
     if (nodes != NULL) {
         OSFree(nodes, sizeof(*nodes) * nodeCount, gOSMallocTag);
     }
+    
+    // Print the chain length distribution and the counters.
+    
+    if (err == 0) {
+        HNodeChainStatistics    stats;
+        size_t                  chainLength;
+        HNodeStatistics         counters;
+        
+        HNodeGetChainStatistics(&stats);
+        
+        printf("%zu nodes in %zu chains, longest chain %zu\n", stats.nodeCount, stats.bucketCount, stats.longestChain);
+        for (chainLength = 0; chainLength < kHNodeChainLengthHistogramSize; chainLength++) {
+            printf("  %zu%s: %zu\n", 
+                chainLength, 
+                (chainLength == (kHNodeChainLengthHistogramSize - 1)) ? "+" : "", 
+                stats.chainLengths[chainLength]
+            );
+        }
+        
+        HNodeGetStatistics(&counters);
+        
+        printf("%llu lookups, %llu hits, %llu misses, %llu vid retries, %llu attach sleeps, %llu races lost\n", 
+            (unsigned long long) counters.lookups, 
+            (unsigned long long) counters.hits, 
+            (unsigned long long) counters.misses, 
+            (unsigned long long) counters.vidRetries, 
+            (unsigned long long) counters.attachSleeps, 
+            (unsigned long long) counters.racesLost
+        );
+        printf("%llu detaches, %llu reclaims, %llu nodes\n", 
+            (unsigned long long) counters.detaches, 
+            (unsigned long long) counters.reclaims, 
+            (unsigned long long) counters.nodeCount
+        );
+    }
 }
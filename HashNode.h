@@ -113,7 +113,13 @@ First checked in.
     of VNOPLookup to quickly determine where an FSNode exists for the fsobj 
     referenced by a given directory entry.
     
-    The hash table in protected by a single (per VFS plug-in) lock.  For good performance, 
+    The hash table is protected by a set of (per VFS plug-in) locks.  Each hash chain, 
+    and every FSNode on it, belongs to one of a fixed number of stripes, each with its 
+    own lock, so lookups of unrelated fsobjs don't contend with each other.  In the 
+    rest of this discussion "the hash lock" means the lock of the stripe that owns the 
+    fsobj in question.  The table itself starts small and resizes automatically as 
+    FSNodes come and go.  Resizing is incremental, moving a few chains at a time, so 
+    no single operation pays for rehashing the whole table.  For good performance, 
     it's critical that the VFS plug-in not hold this lock for long.  Furthermore, to 
     prevent deadlock the VFS plug-in should not call out to other parts of the system 
     while holding this lock.  For example, a VFS plug-in /must/ drop its hash lock 
@@ -154,6 +160,17 @@ First checked in.
         restarts).  It may, however, change what fsobj it refers to, but in 
         that case its vnode ID will change.
     
+    The common case, where the FSNode exists and already has a vnode attached, 
+    doesn't take the hash lock at all.  Instead, the module walks the hash chain 
+    without a lock, gets the vnode's ID, and then confirms that the vnode is still 
+    attached to the FSNode.  Because a vnode is always detached from its FSNode 
+    before it's recycled, this gives the same guarantee as getting the ID with the 
+    lock held.  To make this safe, the module doesn't free an HNode (or its fork 
+    array) immediately; rather, it defers the free until every lock-free lookup 
+    that might have seen it has finished.  Any other case (a miss, an FSNode in the 
+    attaching state, or a fork with no vnode) falls back to the locked path described 
+    above.
+    
     On the subject of vnode reclaiming, it's important to get three pieces of 
     terminology correct:
     
@@ -487,7 +504,7 @@ extern vnode_t HNodeGetVNodeForForkAtIndex(HNodeRef hnode, size_t forkIndex);
     //
     // Note:
     // This routine is more expensive than you might think because it has to take the 
-    // global hash table lock; if possible, it's better to remember the result from 
+    // HNode's hash lock; if possible, it's better to remember the result from 
     // another routine (like HNodeLookupCreatingIfNecessary) rather than call this routine 
     // to recover the same information.
 
@@ -500,7 +517,7 @@ extern size_t HNodeGetForkIndexForVNode(vnode_t vn);
     //
     // Note:
     // This routine is more expensive than you might think because it has to take the 
-    // global hash table lock; if possible, it's better to remember the result from 
+    // HNode's hash lock; if possible, it's better to remember the result from 
     // another routine (like HNodeLookupCreatingIfNecessary) rather than call this routine 
     // to recover the same information.
 
@@ -546,6 +563,53 @@ extern errno_t HNodeLookupCreatingIfNecessary(dev_t dev, ino_t ino, size_t forkI
     // file system object that has been deleted.  This is not the case here.  If you have an 
     // FSNode "is deleted" flag, you are responsible for checking it upon return from this routine.
 
+// HNodeLookupRequest describes one item in a call to HNodeLookupMany.  The first three 
+// fields are inputs, the next three are outputs, and the last two are private.
+
+struct HNodeLookupRequest {
+    dev_t       dev;                    // hash table key
+    ino_t       ino;                    // hash table key
+    size_t      forkIndex;              // fork to look up
+    errno_t     err;                    // result for this item
+    HNodeRef    hnode;                  // on success, the HNode
+    vnode_t     vn;                     // on success, the vnode, or NULL if you must attach one
+    uint32_t    vid;                    // used internally by HNodeLookupMany
+    size_t      next;                   // used internally by HNodeLookupMany
+};
+typedef struct HNodeLookupRequest HNodeLookupRequest;
+
+extern void HNodeLookupMany(HNodeLookupRequest requests[], size_t requestCount);
+    // Does the equivalent of HNodeLookupCreatingIfNecessary for each element of requests, 
+    // but more cheaply.  For example, use this to materialise vnodes for all of the 
+    // entries in a directory.  Hits are resolved without locking, as they are by 
+    // HNodeLookupCreatingIfNecessary.  The remaining requests that hash to the same 
+    // stripe are resolved while the stripe mutex is held once, and the HNodes for 
+    // any misses are allocated as a single batch.
+    //
+    // requests must not be NULL unless requestCount is 0.
+    //
+    // On entry, the dev, ino and forkIndex fields of each request must be set; the 
+    // remaining fields are ignored.
+    //
+    // On return, the err, hnode and vn fields of each request are set as follows:
+    //
+    //   o If err is 0, hnode and vn have exactly the same meaning as *hnodePtr and *vnPtr 
+    //     on successful return from HNodeLookupCreatingIfNecessary.  In particular, if 
+    //     vn is NULL, you have an attach obligation: you must call HNodeAttachVNodeSucceeded 
+    //     or HNodeAttachVNodeFailed for that HNode.  Otherwise you must call vnode_put on vn.
+    //
+    //   o If err is EAGAIN, hnode and vn are NULL, and the request could not be resolved 
+    //     without blocking.  This happens if another thread (or an earlier request in the 
+    //     same call) is attaching a vnode to the HNode, if the fork array must grow, or if 
+    //     the vnode is being recycled.  You must resolve it by calling 
+    //     HNodeLookupCreatingIfNecessary, but only after you have discharged all of the 
+    //     attach obligations returned by this call.  Otherwise you may deadlock.
+    //
+    //   o For any other value of err, hnode and vn are NULL.
+    //
+    // HNodeLookupMany never sleeps waiting for an attach, so it's fine to pass it multiple 
+    // requests for the same HNode.
+
 extern void HNodeAttachVNodeSucceeded(HNodeRef hnode, size_t forkIndex, vnode_t vn);
     // Attaches a vnode to an HNode.  You can only call this routine after calling 
     // HNodeLookupCreatingIfNecessary and having it succeed but not return a vnode. 
@@ -589,12 +653,69 @@ extern boolean_t HNodeDetachVNode(HNodeRef hnode, vnode_t vn);
 
 extern void HNodeScrubDone(HNodeRef hnode);
     // Deallocates an HNode.  You must call this routine on an HNode if either 
-    // HNodeAttachVNodeFailed or HNodeDetachVNode returns true.
+    // HNodeAttachVNodeFailed or HNodeDetachVNode returns true.  The memory may 
+    // not be freed immediately (concurrent lookups might still be looking at 
+    // the HNode), but you must not access the HNode or its FSNode after calling 
+    // this routine.
 
 #pragma mark - Debugging
 
 extern void HNodePrintState(void);
     // Prints the current state of this module using printf.  This is a debugging aid 
     // only.  It makes a best attempt to be thead safe, but there are still race conditions.
+    // It ends with the chain length distribution returned by HNodeGetChainStatistics 
+    // and the counters returned by HNodeGetStatistics.
+
+enum {
+    kHNodeChainLengthHistogramSize = 8
+};
+
+struct HNodeChainStatistics {
+    size_t  bucketCount;                                        // number of hash chains in the table
+    size_t  oldBucketCount;                                     // number of those chains that are in the table being 
+                                                                // migrated from, or zero if no resize is in progress
+    size_t  nodeCount;                                          // number of HNodes on those chains
+    size_t  longestChain;                                       // length of the longest chain
+    size_t  chainLengths[kHNodeChainLengthHistogramSize];       // chainLengths[i] is the number of chains of length i; 
+                                                                // the last entry also counts all longer chains
+};
+typedef struct HNodeChainStatistics HNodeChainStatistics;
+
+extern void HNodeGetChainStatistics(HNodeChainStatistics *stats);
+    // Returns the distribution of hash chain lengths, which lets you check that 
+    // the (dev, ino) hash is spreading HNodes evenly across the table.  Each 
+    // chain is measured with its hash lock held, but the table as a whole can 
+    // change while this is running, so the result is only a good approximation 
+    // if the table is quiescent.
+    //
+    // stats must not be NULL
+    // On return, *stats holds the statistics
+
+// All of the fields of HNodeStatistics are 64 bits, so it's invariant between 
+// 32- and 64-bit clients.
+
+struct HNodeStatistics {
+    uint64_t    lookups;                // calls to HNodeLookupCreatingIfNecessary, plus requests passed to HNodeLookupMany
+    uint64_t    hits;                   // lookups that returned an existing vnode; derived from the other counters
+    uint64_t    misses;                 // lookups that returned no vnode, leaving the caller to attach one
+    uint64_t    vidRetries;             // times a lookup found a vnode that was being recycled and had to retry
+    uint64_t    attachSleeps;           // times a lookup slept waiting for another thread's attach to complete
+    uint64_t    racesLost;              // HNodes that a lookup allocated but then discarded because 
+                                        // another thread inserted one for the same (dev, ino) first
+    uint64_t    detaches;               // calls to HNodeDetachVNode
+    uint64_t    reclaims;               // calls to HNodeScrubDone, that is, HNodes freed
+    uint64_t    nodeCount;              // number of HNodes currently in the hash table
+};
+typedef struct HNodeStatistics HNodeStatistics;
+
+extern void HNodeGetStatistics(HNodeStatistics *stats);
+    // Returns counters describing how the HNode cache has behaved since HNodeInit.  
+    // The counters are cheap to maintain (they're spread across cache lines, and 
+    // a hit only bumps lookups) but they're read without any locking, so the result 
+    // isn't an atomic snapshot; for example, a lookup that's still in progress 
+    // might be counted as a hit.
+    //
+    // stats must not be NULL
+    // On return, *stats holds the statistics
 
 #endif
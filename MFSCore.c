@@ -86,68 +86,274 @@ First checked in.
 
 // These tables are explained in detail in comments in the header.
 
+// Each k<Encoding>ToUTF8 entry holds the UTF-8 for one character of that encoding, 
+// along with its length, in a fixed 5 byte stride.  That way MFSNameToUTF8 can find 
+// the entry by indexing, and copy it without calling strlen.  utf8 is not null 
+// terminated; k<Encoding>ToUTF8Expansion is the longest sequence in the table.
+
+struct CharToUTF8Entry {
+    uint8_t     length;
+    char        utf8[4];
+};
+typedef struct CharToUTF8Entry CharToUTF8Entry;
+
 // These tables were generated by the TableGenerator program (see "TableGenerator.c").
 
-static const char * kMacRomanToUTF8[128] = {
-    /* 0x80 */ /* U+0041 U+0308 */ "A\xCC\x88",    /* U+0041 U+030A */ "A\xCC\x8A",    /* U+0043 U+0327 */ "C\xCC\xA7",    /* U+0045 U+0301 */ "E\xCC\x81",    
-    /* 0x84 */ /* U+004E U+0303 */ "N\xCC\x83",    /* U+004F U+0308 */ "O\xCC\x88",    /* U+0055 U+0308 */ "U\xCC\x88",    /* U+0061 U+0301 */ "a\xCC\x81",    
-    /* 0x88 */ /* U+0061 U+0300 */ "a\xCC\x80",    /* U+0061 U+0302 */ "a\xCC\x82",    /* U+0061 U+0308 */ "a\xCC\x88",    /* U+0061 U+0303 */ "a\xCC\x83",    
-    /* 0x8C */ /* U+0061 U+030A */ "a\xCC\x8A",    /* U+0063 U+0327 */ "c\xCC\xA7",    /* U+0065 U+0301 */ "e\xCC\x81",    /* U+0065 U+0300 */ "e\xCC\x80",    
-    /* 0x90 */ /* U+0065 U+0302 */ "e\xCC\x82",    /* U+0065 U+0308 */ "e\xCC\x88",    /* U+0069 U+0301 */ "i\xCC\x81",    /* U+0069 U+0300 */ "i\xCC\x80",    
-    /* 0x94 */ /* U+0069 U+0302 */ "i\xCC\x82",    /* U+0069 U+0308 */ "i\xCC\x88",    /* U+006E U+0303 */ "n\xCC\x83",    /* U+006F U+0301 */ "o\xCC\x81",    
-    /* 0x98 */ /* U+006F U+0300 */ "o\xCC\x80",    /* U+006F U+0302 */ "o\xCC\x82",    /* U+006F U+0308 */ "o\xCC\x88",    /* U+006F U+0303 */ "o\xCC\x83",    
-    /* 0x9C */ /* U+0075 U+0301 */ "u\xCC\x81",    /* U+0075 U+0300 */ "u\xCC\x80",    /* U+0075 U+0302 */ "u\xCC\x82",    /* U+0075 U+0308 */ "u\xCC\x88",    
-    /* 0xA0 */ /* U+2020 */        "\xE2\x80\xA0", /* U+00B0 */        "\xC2\xB0",     /* U+00A2 */        "\xC2\xA2",     /* U+00A3 */        "\xC2\xA3",     
-    /* 0xA4 */ /* U+00A7 */        "\xC2\xA7",     /* U+2022 */        "\xE2\x80\xA2", /* U+00B6 */        "\xC2\xB6",     /* U+00DF */        "\xC3\x9F",     
-    /* 0xA8 */ /* U+00AE */        "\xC2\xAE",     /* U+00A9 */        "\xC2\xA9",     /* U+2122 */        "\xE2\x84\xA2", /* U+00B4 */        "\xC2\xB4",     
-    /* 0xAC */ /* U+00A8 */        "\xC2\xA8",     /* U+003D U+0338 */ "=\xCC\xB8",    /* U+00C6 */        "\xC3\x86",     /* U+00D8 */        "\xC3\x98",     
-    /* 0xB0 */ /* U+221E */        "\xE2\x88\x9E", /* U+00B1 */        "\xC2\xB1",     /* U+2264 */        "\xE2\x89\xA4", /* U+2265 */        "\xE2\x89\xA5", 
-    /* 0xB4 */ /* U+00A5 */        "\xC2\xA5",     /* U+00B5 */        "\xC2\xB5",     /* U+2202 */        "\xE2\x88\x82", /* U+2211 */        "\xE2\x88\x91", 
-    /* 0xB8 */ /* U+220F */        "\xE2\x88\x8F", /* U+03C0 */        "\xCF\x80",     /* U+222B */        "\xE2\x88\xAB", /* U+00AA */        "\xC2\xAA",     
-    /* 0xBC */ /* U+00BA */        "\xC2\xBA",     /* U+03A9 */        "\xCE\xA9",     /* U+00E6 */        "\xC3\xA6",     /* U+00F8 */        "\xC3\xB8",     
-    /* 0xC0 */ /* U+00BF */        "\xC2\xBF",     /* U+00A1 */        "\xC2\xA1",     /* U+00AC */        "\xC2\xAC",     /* U+221A */        "\xE2\x88\x9A", 
-    /* 0xC4 */ /* U+0192 */        "\xC6\x92",     /* U+2248 */        "\xE2\x89\x88", /* U+2206 */        "\xE2\x88\x86", /* U+00AB */        "\xC2\xAB",     
-    /* 0xC8 */ /* U+00BB */        "\xC2\xBB",     /* U+2026 */        "\xE2\x80\xA6", /* U+00A0 */        "\xC2\xA0",     /* U+0041 U+0300 */ "A\xCC\x80",    
-    /* 0xCC */ /* U+0041 U+0303 */ "A\xCC\x83",    /* U+004F U+0303 */ "O\xCC\x83",    /* U+0152 */        "\xC5\x92",     /* U+0153 */        "\xC5\x93",     
-    /* 0xD0 */ /* U+2013 */        "\xE2\x80\x93", /* U+2014 */        "\xE2\x80\x94", /* U+201C */        "\xE2\x80\x9C", /* U+201D */        "\xE2\x80\x9D", 
-    /* 0xD4 */ /* U+2018 */        "\xE2\x80\x98", /* U+2019 */        "\xE2\x80\x99", /* U+00F7 */        "\xC3\xB7",     /* U+25CA */        "\xE2\x97\x8A", 
-    /* 0xD8 */ /* U+0079 U+0308 */ "y\xCC\x88",    /* U+0059 U+0308 */ "Y\xCC\x88",    /* U+2044 */        "\xE2\x81\x84", /* U+20AC */        "\xE2\x82\xAC", 
-    /* 0xDC */ /* U+2039 */        "\xE2\x80\xB9", /* U+203A */        "\xE2\x80\xBA", /* U+FB01 */        "\xEF\xAC\x81", /* U+FB02 */        "\xEF\xAC\x82", 
-    /* 0xE0 */ /* U+2021 */        "\xE2\x80\xA1", /* U+00B7 */        "\xC2\xB7",     /* U+201A */        "\xE2\x80\x9A", /* U+201E */        "\xE2\x80\x9E", 
-    /* 0xE4 */ /* U+2030 */        "\xE2\x80\xB0", /* U+0041 U+0302 */ "A\xCC\x82",    /* U+0045 U+0302 */ "E\xCC\x82",    /* U+0041 U+0301 */ "A\xCC\x81",    
-    /* 0xE8 */ /* U+0045 U+0308 */ "E\xCC\x88",    /* U+0045 U+0300 */ "E\xCC\x80",    /* U+0049 U+0301 */ "I\xCC\x81",    /* U+0049 U+0302 */ "I\xCC\x82",    
-    /* 0xEC */ /* U+0049 U+0308 */ "I\xCC\x88",    /* U+0049 U+0300 */ "I\xCC\x80",    /* U+004F U+0301 */ "O\xCC\x81",    /* U+004F U+0302 */ "O\xCC\x82",    
-    /* 0xF0 */ /* U+F8FF */        "\xEF\xA3\xBF", /* U+004F U+0300 */ "O\xCC\x80",    /* U+0055 U+0301 */ "U\xCC\x81",    /* U+0055 U+0302 */ "U\xCC\x82",    
-    /* 0xF4 */ /* U+0055 U+0300 */ "U\xCC\x80",    /* U+0131 */        "\xC4\xB1",     /* U+02C6 */        "\xCB\x86",     /* U+02DC */        "\xCB\x9C",     
-    /* 0xF8 */ /* U+00AF */        "\xC2\xAF",     /* U+02D8 */        "\xCB\x98",     /* U+02D9 */        "\xCB\x99",     /* U+02DA */        "\xCB\x9A",     
-    /* 0xFC */ /* U+00B8 */        "\xC2\xB8",     /* U+02DD */        "\xCB\x9D",     /* U+02DB */        "\xCB\x9B",     /* U+02C7 */        "\xCB\x87"      
+static const CharToUTF8Entry kMacRomanToUTF8[128] = {
+    /* 0x80 */ /* U+0041 U+0308 */ { 3, "A\xCC\x88" },     /* U+0041 U+030A */ { 3, "A\xCC\x8A" },     /* U+0043 U+0327 */ { 3, "C\xCC\xA7" },     /* U+0045 U+0301 */ { 3, "E\xCC\x81" },     
+    /* 0x84 */ /* U+004E U+0303 */ { 3, "N\xCC\x83" },     /* U+004F U+0308 */ { 3, "O\xCC\x88" },     /* U+0055 U+0308 */ { 3, "U\xCC\x88" },     /* U+0061 U+0301 */ { 3, "a\xCC\x81" },     
+    /* 0x88 */ /* U+0061 U+0300 */ { 3, "a\xCC\x80" },     /* U+0061 U+0302 */ { 3, "a\xCC\x82" },     /* U+0061 U+0308 */ { 3, "a\xCC\x88" },     /* U+0061 U+0303 */ { 3, "a\xCC\x83" },     
+    /* 0x8C */ /* U+0061 U+030A */ { 3, "a\xCC\x8A" },     /* U+0063 U+0327 */ { 3, "c\xCC\xA7" },     /* U+0065 U+0301 */ { 3, "e\xCC\x81" },     /* U+0065 U+0300 */ { 3, "e\xCC\x80" },     
+    /* 0x90 */ /* U+0065 U+0302 */ { 3, "e\xCC\x82" },     /* U+0065 U+0308 */ { 3, "e\xCC\x88" },     /* U+0069 U+0301 */ { 3, "i\xCC\x81" },     /* U+0069 U+0300 */ { 3, "i\xCC\x80" },     
+    /* 0x94 */ /* U+0069 U+0302 */ { 3, "i\xCC\x82" },     /* U+0069 U+0308 */ { 3, "i\xCC\x88" },     /* U+006E U+0303 */ { 3, "n\xCC\x83" },     /* U+006F U+0301 */ { 3, "o\xCC\x81" },     
+    /* 0x98 */ /* U+006F U+0300 */ { 3, "o\xCC\x80" },     /* U+006F U+0302 */ { 3, "o\xCC\x82" },     /* U+006F U+0308 */ { 3, "o\xCC\x88" },     /* U+006F U+0303 */ { 3, "o\xCC\x83" },     
+    /* 0x9C */ /* U+0075 U+0301 */ { 3, "u\xCC\x81" },     /* U+0075 U+0300 */ { 3, "u\xCC\x80" },     /* U+0075 U+0302 */ { 3, "u\xCC\x82" },     /* U+0075 U+0308 */ { 3, "u\xCC\x88" },     
+    /* 0xA0 */ /* U+2020 */        { 3, "\xE2\x80\xA0" },  /* U+00B0 */        { 2, "\xC2\xB0" },      /* U+00A2 */        { 2, "\xC2\xA2" },      /* U+00A3 */        { 2, "\xC2\xA3" },      
+    /* 0xA4 */ /* U+00A7 */        { 2, "\xC2\xA7" },      /* U+2022 */        { 3, "\xE2\x80\xA2" },  /* U+00B6 */        { 2, "\xC2\xB6" },      /* U+00DF */        { 2, "\xC3\x9F" },      
+    /* 0xA8 */ /* U+00AE */        { 2, "\xC2\xAE" },      /* U+00A9 */        { 2, "\xC2\xA9" },      /* U+2122 */        { 3, "\xE2\x84\xA2" },  /* U+00B4 */        { 2, "\xC2\xB4" },      
+    /* 0xAC */ /* U+00A8 */        { 2, "\xC2\xA8" },      /* U+003D U+0338 */ { 3, "=\xCC\xB8" },     /* U+00C6 */        { 2, "\xC3\x86" },      /* U+00D8 */        { 2, "\xC3\x98" },      
+    /* 0xB0 */ /* U+221E */        { 3, "\xE2\x88\x9E" },  /* U+00B1 */        { 2, "\xC2\xB1" },      /* U+2264 */        { 3, "\xE2\x89\xA4" },  /* U+2265 */        { 3, "\xE2\x89\xA5" },  
+    /* 0xB4 */ /* U+00A5 */        { 2, "\xC2\xA5" },      /* U+00B5 */        { 2, "\xC2\xB5" },      /* U+2202 */        { 3, "\xE2\x88\x82" },  /* U+2211 */        { 3, "\xE2\x88\x91" },  
+    /* 0xB8 */ /* U+220F */        { 3, "\xE2\x88\x8F" },  /* U+03C0 */        { 2, "\xCF\x80" },      /* U+222B */        { 3, "\xE2\x88\xAB" },  /* U+00AA */        { 2, "\xC2\xAA" },      
+    /* 0xBC */ /* U+00BA */        { 2, "\xC2\xBA" },      /* U+03A9 */        { 2, "\xCE\xA9" },      /* U+00E6 */        { 2, "\xC3\xA6" },      /* U+00F8 */        { 2, "\xC3\xB8" },      
+    /* 0xC0 */ /* U+00BF */        { 2, "\xC2\xBF" },      /* U+00A1 */        { 2, "\xC2\xA1" },      /* U+00AC */        { 2, "\xC2\xAC" },      /* U+221A */        { 3, "\xE2\x88\x9A" },  
+    /* 0xC4 */ /* U+0192 */        { 2, "\xC6\x92" },      /* U+2248 */        { 3, "\xE2\x89\x88" },  /* U+2206 */        { 3, "\xE2\x88\x86" },  /* U+00AB */        { 2, "\xC2\xAB" },      
+    /* 0xC8 */ /* U+00BB */        { 2, "\xC2\xBB" },      /* U+2026 */        { 3, "\xE2\x80\xA6" },  /* U+00A0 */        { 2, "\xC2\xA0" },      /* U+0041 U+0300 */ { 3, "A\xCC\x80" },     
+    /* 0xCC */ /* U+0041 U+0303 */ { 3, "A\xCC\x83" },     /* U+004F U+0303 */ { 3, "O\xCC\x83" },     /* U+0152 */        { 2, "\xC5\x92" },      /* U+0153 */        { 2, "\xC5\x93" },      
+    /* 0xD0 */ /* U+2013 */        { 3, "\xE2\x80\x93" },  /* U+2014 */        { 3, "\xE2\x80\x94" },  /* U+201C */        { 3, "\xE2\x80\x9C" },  /* U+201D */        { 3, "\xE2\x80\x9D" },  
+    /* 0xD4 */ /* U+2018 */        { 3, "\xE2\x80\x98" },  /* U+2019 */        { 3, "\xE2\x80\x99" },  /* U+00F7 */        { 2, "\xC3\xB7" },      /* U+25CA */        { 3, "\xE2\x97\x8A" },  
+    /* 0xD8 */ /* U+0079 U+0308 */ { 3, "y\xCC\x88" },     /* U+0059 U+0308 */ { 3, "Y\xCC\x88" },     /* U+2044 */        { 3, "\xE2\x81\x84" },  /* U+20AC */        { 3, "\xE2\x82\xAC" },  
+    /* 0xDC */ /* U+2039 */        { 3, "\xE2\x80\xB9" },  /* U+203A */        { 3, "\xE2\x80\xBA" },  /* U+FB01 */        { 3, "\xEF\xAC\x81" },  /* U+FB02 */        { 3, "\xEF\xAC\x82" },  
+    /* 0xE0 */ /* U+2021 */        { 3, "\xE2\x80\xA1" },  /* U+00B7 */        { 2, "\xC2\xB7" },      /* U+201A */        { 3, "\xE2\x80\x9A" },  /* U+201E */        { 3, "\xE2\x80\x9E" },  
+    /* 0xE4 */ /* U+2030 */        { 3, "\xE2\x80\xB0" },  /* U+0041 U+0302 */ { 3, "A\xCC\x82" },     /* U+0045 U+0302 */ { 3, "E\xCC\x82" },     /* U+0041 U+0301 */ { 3, "A\xCC\x81" },     
+    /* 0xE8 */ /* U+0045 U+0308 */ { 3, "E\xCC\x88" },     /* U+0045 U+0300 */ { 3, "E\xCC\x80" },     /* U+0049 U+0301 */ { 3, "I\xCC\x81" },     /* U+0049 U+0302 */ { 3, "I\xCC\x82" },     
+    /* 0xEC */ /* U+0049 U+0308 */ { 3, "I\xCC\x88" },     /* U+0049 U+0300 */ { 3, "I\xCC\x80" },     /* U+004F U+0301 */ { 3, "O\xCC\x81" },     /* U+004F U+0302 */ { 3, "O\xCC\x82" },     
+    /* 0xF0 */ /* U+F8FF */        { 3, "\xEF\xA3\xBF" },  /* U+004F U+0300 */ { 3, "O\xCC\x80" },     /* U+0055 U+0301 */ { 3, "U\xCC\x81" },     /* U+0055 U+0302 */ { 3, "U\xCC\x82" },     
+    /* 0xF4 */ /* U+0055 U+0300 */ { 3, "U\xCC\x80" },     /* U+0131 */        { 2, "\xC4\xB1" },      /* U+02C6 */        { 2, "\xCB\x86" },      /* U+02DC */        { 2, "\xCB\x9C" },      
+    /* 0xF8 */ /* U+00AF */        { 2, "\xC2\xAF" },      /* U+02D8 */        { 2, "\xCB\x98" },      /* U+02D9 */        { 2, "\xCB\x99" },      /* U+02DA */        { 2, "\xCB\x9A" },      
+    /* 0xFC */ /* U+00B8 */        { 2, "\xC2\xB8" },      /* U+02DD */        { 2, "\xCB\x9D" },      /* U+02DB */        { 2, "\xCB\x9B" },      /* U+02C7 */        { 2, "\xCB\x87" }       
 };
 
-const int kMacRomanToUTF8Expansion = 3;
-
-struct UniCharInfo {
-    uint16_t   utf16Char;
-    uint8_t    macRomanChar;
+enum { kMacRomanToUTF8Expansion = 3 };
+
+static const uint8_t kUTF16ToMacRomanPageIndex[256] = {
+    /* 0x00xx */  1,  2,  3,  4,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x10xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x20xx */  5,  6,  7,  0,  0,  8,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x30xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x40xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x50xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x60xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x70xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x80xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x90xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xA0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xB0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xC0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xD0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xE0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xF0xx */  0,  0,  0,  0,  0,  0,  0,  0,  9,  0,  0, 10,  0,  0,  0,  0
 };
 
-typedef struct UniCharInfo UniCharInfo;
-static const UniCharInfo kUTF16ToMacRoman[128] = {
-    {0x00A0, 0xCA}, {0x00A1, 0xC1}, {0x00A2, 0xA2}, {0x00A3, 0xA3}, {0x00A5, 0xB4}, {0x00A7, 0xA4}, {0x00A8, 0xAC}, {0x00A9, 0xA9},
-    {0x00AA, 0xBB}, {0x00AB, 0xC7}, {0x00AC, 0xC2}, {0x00AE, 0xA8}, {0x00AF, 0xF8}, {0x00B0, 0xA1}, {0x00B1, 0xB1}, {0x00B4, 0xAB},
-    {0x00B5, 0xB5}, {0x00B6, 0xA6}, {0x00B7, 0xE1}, {0x00B8, 0xFC}, {0x00BA, 0xBC}, {0x00BB, 0xC8}, {0x00BF, 0xC0}, {0x00C0, 0xCB},
-    {0x00C1, 0xE7}, {0x00C2, 0xE5}, {0x00C3, 0xCC}, {0x00C4, 0x80}, {0x00C5, 0x81}, {0x00C6, 0xAE}, {0x00C7, 0x82}, {0x00C8, 0xE9},
-    {0x00C9, 0x83}, {0x00CA, 0xE6}, {0x00CB, 0xE8}, {0x00CC, 0xED}, {0x00CD, 0xEA}, {0x00CE, 0xEB}, {0x00CF, 0xEC}, {0x00D1, 0x84},
-    {0x00D2, 0xF1}, {0x00D3, 0xEE}, {0x00D4, 0xEF}, {0x00D5, 0xCD}, {0x00D6, 0x85}, {0x00D8, 0xAF}, {0x00D9, 0xF4}, {0x00DA, 0xF2},
-    {0x00DB, 0xF3}, {0x00DC, 0x86}, {0x00DF, 0xA7}, {0x00E0, 0x88}, {0x00E1, 0x87}, {0x00E2, 0x89}, {0x00E3, 0x8B}, {0x00E4, 0x8A},
-    {0x00E5, 0x8C}, {0x00E6, 0xBE}, {0x00E7, 0x8D}, {0x00E8, 0x8F}, {0x00E9, 0x8E}, {0x00EA, 0x90}, {0x00EB, 0x91}, {0x00EC, 0x93},
-    {0x00ED, 0x92}, {0x00EE, 0x94}, {0x00EF, 0x95}, {0x00F1, 0x96}, {0x00F2, 0x98}, {0x00F3, 0x97}, {0x00F4, 0x99}, {0x00F5, 0x9B},
-    {0x00F6, 0x9A}, {0x00F7, 0xD6}, {0x00F8, 0xBF}, {0x00F9, 0x9D}, {0x00FA, 0x9C}, {0x00FB, 0x9E}, {0x00FC, 0x9F}, {0x00FF, 0xD8},
-    {0x0131, 0xF5}, {0x0152, 0xCE}, {0x0153, 0xCF}, {0x0178, 0xD9}, {0x0192, 0xC4}, {0x02C6, 0xF6}, {0x02C7, 0xFF}, {0x02D8, 0xF9},
-    {0x02D9, 0xFA}, {0x02DA, 0xFB}, {0x02DB, 0xFE}, {0x02DC, 0xF7}, {0x02DD, 0xFD}, {0x03A9, 0xBD}, {0x03C0, 0xB9}, {0x2013, 0xD0},
-    {0x2014, 0xD1}, {0x2018, 0xD4}, {0x2019, 0xD5}, {0x201A, 0xE2}, {0x201C, 0xD2}, {0x201D, 0xD3}, {0x201E, 0xE3}, {0x2020, 0xA0},
-    {0x2021, 0xE0}, {0x2022, 0xA5}, {0x2026, 0xC9}, {0x2030, 0xE4}, {0x2039, 0xDC}, {0x203A, 0xDD}, {0x2044, 0xDA}, {0x20AC, 0xDB},
-    {0x2122, 0xAA}, {0x2202, 0xB6}, {0x2206, 0xC6}, {0x220F, 0xB8}, {0x2211, 0xB7}, {0x221A, 0xC3}, {0x221E, 0xB0}, {0x222B, 0xBA},
-    {0x2248, 0xC5}, {0x2260, 0xAD}, {0x2264, 0xB2}, {0x2265, 0xB3}, {0x25CA, 0xD7}, {0xF8FF, 0xF0}, {0xFB01, 0xDE}, {0xFB02, 0xDF},
+static const uint8_t kUTF16ToMacRomanPages[11][256] = {
+    {   // page 0, no MacRoman equivalents
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 1, U+00xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0xCA, 0xC1, 0xA2, 0xA3, 0x00, 0xB4, 0x00, 0xA4, 0xAC, 0xA9, 0xBB, 0xC7, 0xC2, 0x00, 0xA8, 0xF8,
+        /* 0xB0 */ 0xA1, 0xB1, 0x00, 0x00, 0xAB, 0xB5, 0xA6, 0xE1, 0xFC, 0x00, 0xBC, 0xC8, 0x00, 0x00, 0x00, 0xC0,
+        /* 0xC0 */ 0xCB, 0xE7, 0xE5, 0xCC, 0x80, 0x81, 0xAE, 0x82, 0xE9, 0x83, 0xE6, 0xE8, 0xED, 0xEA, 0xEB, 0xEC,
+        /* 0xD0 */ 0x00, 0x84, 0xF1, 0xEE, 0xEF, 0xCD, 0x85, 0x00, 0xAF, 0xF4, 0xF2, 0xF3, 0x86, 0x00, 0x00, 0xA7,
+        /* 0xE0 */ 0x88, 0x87, 0x89, 0x8B, 0x8A, 0x8C, 0xBE, 0x8D, 0x8F, 0x8E, 0x90, 0x91, 0x93, 0x92, 0x94, 0x95,
+        /* 0xF0 */ 0x00, 0x96, 0x98, 0x97, 0x99, 0x9B, 0x9A, 0xD6, 0xBF, 0x9D, 0x9C, 0x9E, 0x9F, 0x00, 0x00, 0xD8
+    },
+    {   // page 2, U+01xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0xF5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0xCE, 0xCF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0xC4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 3, U+02xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF6, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF9, 0xFA, 0xFB, 0xFE, 0xF7, 0xFD, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 4, U+03xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xBD, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 5, U+20xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0xD0, 0xD1, 0x00, 0x00, 0x00, 0xD4, 0xD5, 0xE2, 0x00, 0xD2, 0xD3, 0xE3, 0x00,
+        /* 0x20 */ 0xA0, 0xE0, 0xA5, 0x00, 0x00, 0x00, 0xC9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0xE4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0xDD, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0xDA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xDB, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 6, U+21xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 7, U+22xx
+        /* 0x00 */ 0x00, 0x00, 0xB6, 0x00, 0x00, 0x00, 0xC6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB8,
+        /* 0x10 */ 0x00, 0xB7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x00, 0x00, 0x00, 0xB0, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xBA, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0xAD, 0x00, 0x00, 0x00, 0xB2, 0xB3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 8, U+25xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD7, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 9, U+F8xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xF0
+    },
+    {   // page 10, U+FBxx
+        /* 0x00 */ 0x00, 0xDE, 0xDF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
 };
 
 static const uint16_t kMacRomanToUpper[256] = {
@@ -169,15 +375,460 @@ static const uint16_t kMacRomanToUpper[256] = {
     /* 0xF0 */ 0xF0, 0x98, 0x9C, 0x9E, 0x9D, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF
 };
 
+static const CharToUTF8Entry kMacCentralEuropeToUTF8[128] = {
+    /* 0x80 */ /* U+0041 U+0308 */ { 3, "A\xCC\x88" },     /* U+0041 U+0304 */ { 3, "A\xCC\x84" },     /* U+0061 U+0304 */ { 3, "a\xCC\x84" },     /* U+0045 U+0301 */ { 3, "E\xCC\x81" },     
+    /* 0x84 */ /* U+0041 U+0328 */ { 3, "A\xCC\xA8" },     /* U+004F U+0308 */ { 3, "O\xCC\x88" },     /* U+0055 U+0308 */ { 3, "U\xCC\x88" },     /* U+0061 U+0301 */ { 3, "a\xCC\x81" },     
+    /* 0x88 */ /* U+0061 U+0328 */ { 3, "a\xCC\xA8" },     /* U+0043 U+030C */ { 3, "C\xCC\x8C" },     /* U+0061 U+0308 */ { 3, "a\xCC\x88" },     /* U+0063 U+030C */ { 3, "c\xCC\x8C" },     
+    /* 0x8C */ /* U+0043 U+0301 */ { 3, "C\xCC\x81" },     /* U+0063 U+0301 */ { 3, "c\xCC\x81" },     /* U+0065 U+0301 */ { 3, "e\xCC\x81" },     /* U+005A U+0301 */ { 3, "Z\xCC\x81" },     
+    /* 0x90 */ /* U+007A U+0301 */ { 3, "z\xCC\x81" },     /* U+0044 U+030C */ { 3, "D\xCC\x8C" },     /* U+0069 U+0301 */ { 3, "i\xCC\x81" },     /* U+0064 U+030C */ { 3, "d\xCC\x8C" },     
+    /* 0x94 */ /* U+0045 U+0304 */ { 3, "E\xCC\x84" },     /* U+0065 U+0304 */ { 3, "e\xCC\x84" },     /* U+0045 U+0307 */ { 3, "E\xCC\x87" },     /* U+006F U+0301 */ { 3, "o\xCC\x81" },     
+    /* 0x98 */ /* U+0065 U+0307 */ { 3, "e\xCC\x87" },     /* U+006F U+0302 */ { 3, "o\xCC\x82" },     /* U+006F U+0308 */ { 3, "o\xCC\x88" },     /* U+006F U+0303 */ { 3, "o\xCC\x83" },     
+    /* 0x9C */ /* U+0075 U+0301 */ { 3, "u\xCC\x81" },     /* U+0045 U+030C */ { 3, "E\xCC\x8C" },     /* U+0065 U+030C */ { 3, "e\xCC\x8C" },     /* U+0075 U+0308 */ { 3, "u\xCC\x88" },     
+    /* 0xA0 */ /* U+2020 */        { 3, "\xE2\x80\xA0" },  /* U+00B0 */        { 2, "\xC2\xB0" },      /* U+0045 U+0328 */ { 3, "E\xCC\xA8" },     /* U+00A3 */        { 2, "\xC2\xA3" },      
+    /* 0xA4 */ /* U+00A7 */        { 2, "\xC2\xA7" },      /* U+2022 */        { 3, "\xE2\x80\xA2" },  /* U+00B6 */        { 2, "\xC2\xB6" },      /* U+00DF */        { 2, "\xC3\x9F" },      
+    /* 0xA8 */ /* U+00AE */        { 2, "\xC2\xAE" },      /* U+00A9 */        { 2, "\xC2\xA9" },      /* U+2122 */        { 3, "\xE2\x84\xA2" },  /* U+0065 U+0328 */ { 3, "e\xCC\xA8" },     
+    /* 0xAC */ /* U+00A8 */        { 2, "\xC2\xA8" },      /* U+003D U+0338 */ { 3, "=\xCC\xB8" },     /* U+0067 U+0327 */ { 3, "g\xCC\xA7" },     /* U+0049 U+0328 */ { 3, "I\xCC\xA8" },     
+    /* 0xB0 */ /* U+0069 U+0328 */ { 3, "i\xCC\xA8" },     /* U+0049 U+0304 */ { 3, "I\xCC\x84" },     /* U+2264 */        { 3, "\xE2\x89\xA4" },  /* U+2265 */        { 3, "\xE2\x89\xA5" },  
+    /* 0xB4 */ /* U+0069 U+0304 */ { 3, "i\xCC\x84" },     /* U+004B U+0327 */ { 3, "K\xCC\xA7" },     /* U+2202 */        { 3, "\xE2\x88\x82" },  /* U+2211 */        { 3, "\xE2\x88\x91" },  
+    /* 0xB8 */ /* U+0142 */        { 2, "\xC5\x82" },      /* U+004C U+0327 */ { 3, "L\xCC\xA7" },     /* U+006C U+0327 */ { 3, "l\xCC\xA7" },     /* U+004C U+030C */ { 3, "L\xCC\x8C" },     
+    /* 0xBC */ /* U+006C U+030C */ { 3, "l\xCC\x8C" },     /* U+004C U+0301 */ { 3, "L\xCC\x81" },     /* U+006C U+0301 */ { 3, "l\xCC\x81" },     /* U+004E U+0327 */ { 3, "N\xCC\xA7" },     
+    /* 0xC0 */ /* U+006E U+0327 */ { 3, "n\xCC\xA7" },     /* U+004E U+0301 */ { 3, "N\xCC\x81" },     /* U+00AC */        { 2, "\xC2\xAC" },      /* U+221A */        { 3, "\xE2\x88\x9A" },  
+    /* 0xC4 */ /* U+006E U+0301 */ { 3, "n\xCC\x81" },     /* U+004E U+030C */ { 3, "N\xCC\x8C" },     /* U+2206 */        { 3, "\xE2\x88\x86" },  /* U+00AB */        { 2, "\xC2\xAB" },      
+    /* 0xC8 */ /* U+00BB */        { 2, "\xC2\xBB" },      /* U+2026 */        { 3, "\xE2\x80\xA6" },  /* U+00A0 */        { 2, "\xC2\xA0" },      /* U+006E U+030C */ { 3, "n\xCC\x8C" },     
+    /* 0xCC */ /* U+004F U+030B */ { 3, "O\xCC\x8B" },     /* U+004F U+0303 */ { 3, "O\xCC\x83" },     /* U+006F U+030B */ { 3, "o\xCC\x8B" },     /* U+004F U+0304 */ { 3, "O\xCC\x84" },     
+    /* 0xD0 */ /* U+2013 */        { 3, "\xE2\x80\x93" },  /* U+2014 */        { 3, "\xE2\x80\x94" },  /* U+201C */        { 3, "\xE2\x80\x9C" },  /* U+201D */        { 3, "\xE2\x80\x9D" },  
+    /* 0xD4 */ /* U+2018 */        { 3, "\xE2\x80\x98" },  /* U+2019 */        { 3, "\xE2\x80\x99" },  /* U+00F7 */        { 2, "\xC3\xB7" },      /* U+25CA */        { 3, "\xE2\x97\x8A" },  
+    /* 0xD8 */ /* U+006F U+0304 */ { 3, "o\xCC\x84" },     /* U+0052 U+0301 */ { 3, "R\xCC\x81" },     /* U+0072 U+0301 */ { 3, "r\xCC\x81" },     /* U+0052 U+030C */ { 3, "R\xCC\x8C" },     
+    /* 0xDC */ /* U+2039 */        { 3, "\xE2\x80\xB9" },  /* U+203A */        { 3, "\xE2\x80\xBA" },  /* U+0072 U+030C */ { 3, "r\xCC\x8C" },     /* U+0052 U+0327 */ { 3, "R\xCC\xA7" },     
+    /* 0xE0 */ /* U+0072 U+0327 */ { 3, "r\xCC\xA7" },     /* U+0053 U+030C */ { 3, "S\xCC\x8C" },     /* U+201A */        { 3, "\xE2\x80\x9A" },  /* U+201E */        { 3, "\xE2\x80\x9E" },  
+    /* 0xE4 */ /* U+0073 U+030C */ { 3, "s\xCC\x8C" },     /* U+0053 U+0301 */ { 3, "S\xCC\x81" },     /* U+0073 U+0301 */ { 3, "s\xCC\x81" },     /* U+0041 U+0301 */ { 3, "A\xCC\x81" },     
+    /* 0xE8 */ /* U+0054 U+030C */ { 3, "T\xCC\x8C" },     /* U+0074 U+030C */ { 3, "t\xCC\x8C" },     /* U+0049 U+0301 */ { 3, "I\xCC\x81" },     /* U+005A U+030C */ { 3, "Z\xCC\x8C" },     
+    /* 0xEC */ /* U+007A U+030C */ { 3, "z\xCC\x8C" },     /* U+0055 U+0304 */ { 3, "U\xCC\x84" },     /* U+004F U+0301 */ { 3, "O\xCC\x81" },     /* U+004F U+0302 */ { 3, "O\xCC\x82" },     
+    /* 0xF0 */ /* U+0075 U+0304 */ { 3, "u\xCC\x84" },     /* U+0055 U+030A */ { 3, "U\xCC\x8A" },     /* U+0055 U+0301 */ { 3, "U\xCC\x81" },     /* U+0075 U+030A */ { 3, "u\xCC\x8A" },     
+    /* 0xF4 */ /* U+0055 U+030B */ { 3, "U\xCC\x8B" },     /* U+0075 U+030B */ { 3, "u\xCC\x8B" },     /* U+0055 U+0328 */ { 3, "U\xCC\xA8" },     /* U+0075 U+0328 */ { 3, "u\xCC\xA8" },     
+    /* 0xF8 */ /* U+0059 U+0301 */ { 3, "Y\xCC\x81" },     /* U+0079 U+0301 */ { 3, "y\xCC\x81" },     /* U+006B U+0327 */ { 3, "k\xCC\xA7" },     /* U+005A U+0307 */ { 3, "Z\xCC\x87" },     
+    /* 0xFC */ /* U+0141 */        { 2, "\xC5\x81" },      /* U+007A U+0307 */ { 3, "z\xCC\x87" },     /* U+0047 U+0327 */ { 3, "G\xCC\xA7" },     /* U+02C7 */        { 2, "\xCB\x87" }       
+};
+
+enum { kMacCentralEuropeToUTF8Expansion = 3 };
+
+static const uint8_t kUTF16ToMacCentralEuropePageIndex[256] = {
+    /* 0x00xx */  1,  2,  3,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x10xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x20xx */  4,  5,  6,  0,  0,  7,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x30xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x40xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x50xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x60xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x70xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x80xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x90xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xA0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xB0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xC0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xD0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xE0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xF0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+static const uint8_t kUTF16ToMacCentralEuropePages[8][256] = {
+    {   // page 0, no MacCentralEurope equivalents
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 1, U+00xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0xCA, 0x00, 0x00, 0xA3, 0x00, 0x00, 0x00, 0xA4, 0xAC, 0xA9, 0x00, 0xC7, 0xC2, 0x00, 0xA8, 0x00,
+        /* 0xB0 */ 0xA1, 0x00, 0x00, 0x00, 0x00, 0x00, 0xA6, 0x00, 0x00, 0x00, 0x00, 0xC8, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0xE7, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x83, 0x00, 0x00, 0x00, 0xEA, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0xEE, 0xEF, 0xCD, 0x85, 0x00, 0x00, 0x00, 0xF2, 0x00, 0x86, 0xF8, 0x00, 0xA7,
+        /* 0xE0 */ 0x00, 0x87, 0x00, 0x00, 0x8A, 0x00, 0x00, 0x00, 0x00, 0x8E, 0x00, 0x00, 0x00, 0x92, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x97, 0x99, 0x9B, 0x9A, 0xD6, 0x00, 0x00, 0x9C, 0x00, 0x9F, 0xF9, 0x00, 0x00
+    },
+    {   // page 2, U+01xx
+        /* 0x00 */ 0x81, 0x82, 0x00, 0x00, 0x84, 0x88, 0x8C, 0x8D, 0x00, 0x00, 0x00, 0x00, 0x89, 0x8B, 0x91, 0x93,
+        /* 0x10 */ 0x00, 0x00, 0x94, 0x95, 0x00, 0x00, 0x96, 0x98, 0xA2, 0xAB, 0x9D, 0x9E, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0xFE, 0xAE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB1, 0xB4, 0x00, 0x00, 0xAF, 0xB0,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xB5, 0xFA, 0x00, 0xBD, 0xBE, 0xB9, 0xBA, 0xBB, 0xBC, 0x00,
+        /* 0x40 */ 0x00, 0xFC, 0xB8, 0xC1, 0xC4, 0xBF, 0xC0, 0xC5, 0xCB, 0x00, 0x00, 0x00, 0xCF, 0xD8, 0x00, 0x00,
+        /* 0x50 */ 0xCC, 0xCE, 0x00, 0x00, 0xD9, 0xDA, 0xDF, 0xE0, 0xDB, 0xDE, 0xE5, 0xE6, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0xE1, 0xE4, 0x00, 0x00, 0xE8, 0xE9, 0x00, 0x00, 0x00, 0x00, 0xED, 0xF0, 0x00, 0x00, 0xF1, 0xF3,
+        /* 0x70 */ 0xF4, 0xF5, 0xF6, 0xF7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8F, 0x90, 0xFB, 0xFD, 0xEB, 0xEC, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 3, U+02xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 4, U+20xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0xD0, 0xD1, 0x00, 0x00, 0x00, 0xD4, 0xD5, 0xE2, 0x00, 0xD2, 0xD3, 0xE3, 0x00,
+        /* 0x20 */ 0xA0, 0x00, 0xA5, 0x00, 0x00, 0x00, 0xC9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0xDD, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 5, U+21xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 6, U+22xx
+        /* 0x00 */ 0x00, 0x00, 0xB6, 0x00, 0x00, 0x00, 0xC6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0xB7, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0xAD, 0x00, 0x00, 0x00, 0xB2, 0xB3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 7, U+25xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD7, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
+};
+
+static const uint16_t kMacCentralEuropeToUpper[256] = {
+    /* 0x00 */ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    /* 0x10 */ 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+    /* 0x20 */ 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+    /* 0x30 */ 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+    /* 0x40 */ 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+    /* 0x50 */ 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+    /* 0x60 */ 0x60, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+    /* 0x70 */ 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+    /* 0x80 */ 0x80, 0x81, 0x81, 0x83, 0x84, 0x85, 0x86, 0x87, 0x84, 0x89, 0x80, 0x89, 0x8C, 0x8C, 0x83, 0x8F,
+    /* 0x90 */ 0x8F, 0x91, 0x92, 0x91, 0x94, 0x94, 0x96, 0x97, 0x96, 0x99, 0x85, 0x9B, 0x9C, 0x9D, 0x9D, 0x86,
+    /* 0xA0 */ 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xA2, 0xAC, 0xAD, 0xAE, 0xAF,
+    /* 0xB0 */ 0xAF, 0xB1, 0xB2, 0xB3, 0xB1, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xB9, 0xBB, 0xBB, 0xBD, 0xBD, 0xBF,
+    /* 0xC0 */ 0xBF, 0xC1, 0xC2, 0xC3, 0xC1, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xC5, 0xCC, 0x9B, 0xCC, 0xCF,
+    /* 0xD0 */ 0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xCF, 0xD9, 0xD9, 0xDB, 0xDC, 0xDD, 0xDB, 0xDF,
+    /* 0xE0 */ 0xDF, 0xE1, 0xE2, 0xE3, 0xE1, 0xE5, 0xE5, 0x87, 0xE8, 0xE8, 0x92, 0xEB, 0xEB, 0xED, 0x97, 0x99,
+    /* 0xF0 */ 0xED, 0xF1, 0x9C, 0xF1, 0xF4, 0xF4, 0xF6, 0xF6, 0xF8, 0xF8, 0xB5, 0xFB, 0xB8, 0xFB, 0xAE, 0xFF
+};
+
+static const CharToUTF8Entry kMacCyrillicToUTF8[128] = {
+    /* 0x80 */ /* U+0410 */        { 2, "\xD0\x90" },      /* U+0411 */        { 2, "\xD0\x91" },      /* U+0412 */        { 2, "\xD0\x92" },      /* U+0413 */        { 2, "\xD0\x93" },      
+    /* 0x84 */ /* U+0414 */        { 2, "\xD0\x94" },      /* U+0415 */        { 2, "\xD0\x95" },      /* U+0416 */        { 2, "\xD0\x96" },      /* U+0417 */        { 2, "\xD0\x97" },      
+    /* 0x88 */ /* U+0418 */        { 2, "\xD0\x98" },      /* U+0418 U+0306 */ { 4, "\xD0\x98\xCC\x86" }, /* U+041A */        { 2, "\xD0\x9A" },      /* U+041B */        { 2, "\xD0\x9B" },      
+    /* 0x8C */ /* U+041C */        { 2, "\xD0\x9C" },      /* U+041D */        { 2, "\xD0\x9D" },      /* U+041E */        { 2, "\xD0\x9E" },      /* U+041F */        { 2, "\xD0\x9F" },      
+    /* 0x90 */ /* U+0420 */        { 2, "\xD0\xA0" },      /* U+0421 */        { 2, "\xD0\xA1" },      /* U+0422 */        { 2, "\xD0\xA2" },      /* U+0423 */        { 2, "\xD0\xA3" },      
+    /* 0x94 */ /* U+0424 */        { 2, "\xD0\xA4" },      /* U+0425 */        { 2, "\xD0\xA5" },      /* U+0426 */        { 2, "\xD0\xA6" },      /* U+0427 */        { 2, "\xD0\xA7" },      
+    /* 0x98 */ /* U+0428 */        { 2, "\xD0\xA8" },      /* U+0429 */        { 2, "\xD0\xA9" },      /* U+042A */        { 2, "\xD0\xAA" },      /* U+042B */        { 2, "\xD0\xAB" },      
+    /* 0x9C */ /* U+042C */        { 2, "\xD0\xAC" },      /* U+042D */        { 2, "\xD0\xAD" },      /* U+042E */        { 2, "\xD0\xAE" },      /* U+042F */        { 2, "\xD0\xAF" },      
+    /* 0xA0 */ /* U+2020 */        { 3, "\xE2\x80\xA0" },  /* U+00B0 */        { 2, "\xC2\xB0" },      /* U+0490 */        { 2, "\xD2\x90" },      /* U+00A3 */        { 2, "\xC2\xA3" },      
+    /* 0xA4 */ /* U+00A7 */        { 2, "\xC2\xA7" },      /* U+2022 */        { 3, "\xE2\x80\xA2" },  /* U+00B6 */        { 2, "\xC2\xB6" },      /* U+0406 */        { 2, "\xD0\x86" },      
+    /* 0xA8 */ /* U+00AE */        { 2, "\xC2\xAE" },      /* U+00A9 */        { 2, "\xC2\xA9" },      /* U+2122 */        { 3, "\xE2\x84\xA2" },  /* U+0402 */        { 2, "\xD0\x82" },      
+    /* 0xAC */ /* U+0452 */        { 2, "\xD1\x92" },      /* U+003D U+0338 */ { 3, "=\xCC\xB8" },     /* U+0413 U+0301 */ { 4, "\xD0\x93\xCC\x81" }, /* U+0433 U+0301 */ { 4, "\xD0\xB3\xCC\x81" }, 
+    /* 0xB0 */ /* U+221E */        { 3, "\xE2\x88\x9E" },  /* U+00B1 */        { 2, "\xC2\xB1" },      /* U+2264 */        { 3, "\xE2\x89\xA4" },  /* U+2265 */        { 3, "\xE2\x89\xA5" },  
+    /* 0xB4 */ /* U+0456 */        { 2, "\xD1\x96" },      /* U+00B5 */        { 2, "\xC2\xB5" },      /* U+0491 */        { 2, "\xD2\x91" },      /* U+0408 */        { 2, "\xD0\x88" },      
+    /* 0xB8 */ /* U+0404 */        { 2, "\xD0\x84" },      /* U+0454 */        { 2, "\xD1\x94" },      /* U+0406 U+0308 */ { 4, "\xD0\x86\xCC\x88" }, /* U+0456 U+0308 */ { 4, "\xD1\x96\xCC\x88" }, 
+    /* 0xBC */ /* U+0409 */        { 2, "\xD0\x89" },      /* U+0459 */        { 2, "\xD1\x99" },      /* U+040A */        { 2, "\xD0\x8A" },      /* U+045A */        { 2, "\xD1\x9A" },      
+    /* 0xC0 */ /* U+0458 */        { 2, "\xD1\x98" },      /* U+0405 */        { 2, "\xD0\x85" },      /* U+00AC */        { 2, "\xC2\xAC" },      /* U+221A */        { 3, "\xE2\x88\x9A" },  
+    /* 0xC4 */ /* U+0192 */        { 2, "\xC6\x92" },      /* U+2248 */        { 3, "\xE2\x89\x88" },  /* U+2206 */        { 3, "\xE2\x88\x86" },  /* U+00AB */        { 2, "\xC2\xAB" },      
+    /* 0xC8 */ /* U+00BB */        { 2, "\xC2\xBB" },      /* U+2026 */        { 3, "\xE2\x80\xA6" },  /* U+00A0 */        { 2, "\xC2\xA0" },      /* U+040B */        { 2, "\xD0\x8B" },      
+    /* 0xCC */ /* U+045B */        { 2, "\xD1\x9B" },      /* U+041A U+0301 */ { 4, "\xD0\x9A\xCC\x81" }, /* U+043A U+0301 */ { 4, "\xD0\xBA\xCC\x81" }, /* U+0455 */        { 2, "\xD1\x95" },      
+    /* 0xD0 */ /* U+2013 */        { 3, "\xE2\x80\x93" },  /* U+2014 */        { 3, "\xE2\x80\x94" },  /* U+201C */        { 3, "\xE2\x80\x9C" },  /* U+201D */        { 3, "\xE2\x80\x9D" },  
+    /* 0xD4 */ /* U+2018 */        { 3, "\xE2\x80\x98" },  /* U+2019 */        { 3, "\xE2\x80\x99" },  /* U+00F7 */        { 2, "\xC3\xB7" },      /* U+201E */        { 3, "\xE2\x80\x9E" },  
+    /* 0xD8 */ /* U+0423 U+0306 */ { 4, "\xD0\xA3\xCC\x86" }, /* U+0443 U+0306 */ { 4, "\xD1\x83\xCC\x86" }, /* U+040F */        { 2, "\xD0\x8F" },      /* U+045F */        { 2, "\xD1\x9F" },      
+    /* 0xDC */ /* U+2116 */        { 3, "\xE2\x84\x96" },  /* U+0415 U+0308 */ { 4, "\xD0\x95\xCC\x88" }, /* U+0435 U+0308 */ { 4, "\xD0\xB5\xCC\x88" }, /* U+044F */        { 2, "\xD1\x8F" },      
+    /* 0xE0 */ /* U+0430 */        { 2, "\xD0\xB0" },      /* U+0431 */        { 2, "\xD0\xB1" },      /* U+0432 */        { 2, "\xD0\xB2" },      /* U+0433 */        { 2, "\xD0\xB3" },      
+    /* 0xE4 */ /* U+0434 */        { 2, "\xD0\xB4" },      /* U+0435 */        { 2, "\xD0\xB5" },      /* U+0436 */        { 2, "\xD0\xB6" },      /* U+0437 */        { 2, "\xD0\xB7" },      
+    /* 0xE8 */ /* U+0438 */        { 2, "\xD0\xB8" },      /* U+0438 U+0306 */ { 4, "\xD0\xB8\xCC\x86" }, /* U+043A */        { 2, "\xD0\xBA" },      /* U+043B */        { 2, "\xD0\xBB" },      
+    /* 0xEC */ /* U+043C */        { 2, "\xD0\xBC" },      /* U+043D */        { 2, "\xD0\xBD" },      /* U+043E */        { 2, "\xD0\xBE" },      /* U+043F */        { 2, "\xD0\xBF" },      
+    /* 0xF0 */ /* U+0440 */        { 2, "\xD1\x80" },      /* U+0441 */        { 2, "\xD1\x81" },      /* U+0442 */        { 2, "\xD1\x82" },      /* U+0443 */        { 2, "\xD1\x83" },      
+    /* 0xF4 */ /* U+0444 */        { 2, "\xD1\x84" },      /* U+0445 */        { 2, "\xD1\x85" },      /* U+0446 */        { 2, "\xD1\x86" },      /* U+0447 */        { 2, "\xD1\x87" },      
+    /* 0xF8 */ /* U+0448 */        { 2, "\xD1\x88" },      /* U+0449 */        { 2, "\xD1\x89" },      /* U+044A */        { 2, "\xD1\x8A" },      /* U+044B */        { 2, "\xD1\x8B" },      
+    /* 0xFC */ /* U+044C */        { 2, "\xD1\x8C" },      /* U+044D */        { 2, "\xD1\x8D" },      /* U+044E */        { 2, "\xD1\x8E" },      /* U+20AC */        { 3, "\xE2\x82\xAC" }   
+};
+
+enum { kMacCyrillicToUTF8Expansion = 4 };
+
+static const uint8_t kUTF16ToMacCyrillicPageIndex[256] = {
+    /* 0x00xx */  1,  2,  0,  0,  3,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x10xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x20xx */  4,  5,  6,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x30xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x40xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x50xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x60xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x70xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x80xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0x90xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xA0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xB0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xC0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xD0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xE0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    /* 0xF0xx */  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+static const uint8_t kUTF16ToMacCyrillicPages[7][256] = {
+    {   // page 0, no MacCyrillic equivalents
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 1, U+00xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0xCA, 0x00, 0x00, 0xA3, 0x00, 0x00, 0x00, 0xA4, 0x00, 0xA9, 0x00, 0xC7, 0xC2, 0x00, 0xA8, 0x00,
+        /* 0xB0 */ 0xA1, 0xB1, 0x00, 0x00, 0x00, 0xB5, 0xA6, 0x00, 0x00, 0x00, 0x00, 0xC8, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xD6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 2, U+01xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0xC4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 3, U+04xx
+        /* 0x00 */ 0x00, 0xDD, 0xAB, 0xAE, 0xB8, 0xC1, 0xA7, 0xBA, 0xB7, 0xBC, 0xBE, 0xCB, 0xCD, 0x00, 0xD8, 0xDA,
+        /* 0x10 */ 0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+        /* 0x20 */ 0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+        /* 0x30 */ 0xE0, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xEB, 0xEC, 0xED, 0xEE, 0xEF,
+        /* 0x40 */ 0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xDF,
+        /* 0x50 */ 0x00, 0xDE, 0xAC, 0xAF, 0xB9, 0xCF, 0xB4, 0xBB, 0xC0, 0xBD, 0xBF, 0xCC, 0xCE, 0x00, 0xD9, 0xDB,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0xA2, 0xB6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 4, U+20xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0xD0, 0xD1, 0x00, 0x00, 0x00, 0xD4, 0xD5, 0x00, 0x00, 0xD2, 0xD3, 0xD7, 0x00,
+        /* 0x20 */ 0xA0, 0x00, 0xA5, 0x00, 0x00, 0x00, 0xC9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 5, U+21xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0xAA, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    },
+    {   // page 6, U+22xx
+        /* 0x00 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x10 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC3, 0x00, 0x00, 0x00, 0xB0, 0x00,
+        /* 0x20 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x30 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x40 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x50 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x60 */ 0xAD, 0x00, 0x00, 0x00, 0xB2, 0xB3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x70 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x80 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0x90 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xA0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xB0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xC0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xD0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xE0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        /* 0xF0 */ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    }
+};
+
+static const uint16_t kMacCyrillicToUpper[256] = {
+    /* 0x00 */ 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    /* 0x10 */ 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F,
+    /* 0x20 */ 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F,
+    /* 0x30 */ 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+    /* 0x40 */ 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+    /* 0x50 */ 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F,
+    /* 0x60 */ 0x60, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F,
+    /* 0x70 */ 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F,
+    /* 0x80 */ 0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    /* 0x90 */ 0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F,
+    /* 0xA0 */ 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAB, 0xAD, 0xAE, 0xAE,
+    /* 0xB0 */ 0xB0, 0xB1, 0xB2, 0xB3, 0xA7, 0xB5, 0xA2, 0xB7, 0xB8, 0xB8, 0xBA, 0xBA, 0xBC, 0xBC, 0xBE, 0xBE,
+    /* 0xC0 */ 0xB7, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCB, 0xCD, 0xCD, 0xC1,
+    /* 0xD0 */ 0xD0, 0xD1, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD8, 0xDA, 0xDA, 0xDC, 0xDD, 0xDD, 0x9F,
+    /* 0xE0 */ 0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F,
+    /* 0xF0 */ 0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0xFF
+};
+
 // End of automatically generated tables.
 
+// kTextEncodingTables gathers up the tables for each encoding, indexed by 
+// MFSTextEncoding.
+
+struct TextEncodingTables {
+    const CharToUTF8Entry * toUTF8;             // k<Encoding>ToUTF8
+    size_t                  toUTF8Expansion;    // k<Encoding>ToUTF8Expansion
+    const uint8_t *         utf16PageIndex;     // kUTF16To<Encoding>PageIndex
+    const uint8_t        (* utf16Pages)[256];   // kUTF16To<Encoding>Pages
+    const uint16_t *        toUpper;            // k<Encoding>ToUpper
+    uint32_t                textEncoding;       // for va_encoding; a Text Encoding Converter TextEncoding value
+};
+typedef struct TextEncodingTables TextEncodingTables;
+
+static const TextEncodingTables kTextEncodingTables[kMFSTextEncodingCount] = {
+    { kMacRomanToUTF8,         kMacRomanToUTF8Expansion,         kUTF16ToMacRomanPageIndex,         kUTF16ToMacRomanPages,         kMacRomanToUpper,          0 },
+    { kMacCentralEuropeToUTF8, kMacCentralEuropeToUTF8Expansion, kUTF16ToMacCentralEuropePageIndex, kUTF16ToMacCentralEuropePages, kMacCentralEuropeToUpper, 29 },
+    { kMacCyrillicToUTF8,      kMacCyrillicToUTF8Expansion,      kUTF16ToMacCyrillicPageIndex,      kUTF16ToMacCyrillicPages,      kMacCyrillicToUpper,       7 }
+};
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** String Manipulation
 
-extern size_t MFSNameToUTF8(const uint8_t *name, char *utf8Name, size_t utf8NameSize)
+extern size_t MFSNameToUTF8(const uint8_t *name, MFSTextEncoding encoding, char *utf8Name, size_t utf8NameSize)
     // Converts an MFS name to its UTF-8 equivalent.
     //
-    // name must be a MacRoman encoded Pascal string.
+    // name must be a Pascal string in the specified encoding.
     //
     // utf8Name must be a pointer to a buffer of utf8NameSize bytes.  On 
     // return, this will hold a UTF-8 (decomposed) C string equivalent to 
@@ -188,45 +839,90 @@ extern size_t MFSNameToUTF8(const uint8_t *name, char *utf8Name, size_t utf8Name
     //
     // Returns the size of the buffer that would be needed to hold a full 
     // conversion of name.  If this is less than utf8NameSize, the string 
-    // was truncated.  If it was truncated, it was truncated at a MacRoman 
-    // character boundary.
+    // was truncated.  If it was truncated, it was truncated at a character 
+    // boundary.
     //
     // This routine is carefully crafted to drop any null characters embeddedd 
     // in name.  null characters are valid in MFS names (yikes!) but not in 
     // C strings.
 {
-    int             nameLen;
-    int             i;
-    char *          outputPtr;
-    size_t          outputTotalSize;
-    const char *    thisStr;
-    size_t          thisStrLen;
+    size_t                          nameLen;
+    size_t                          nameIndex;
+    size_t                          runStart;
+    size_t                          runLen;
+    size_t                          bytesToCopy;
+    uint64_t                        word;
+    char *                          outputPtr;
+    size_t                          outputTotalSize;
+    const CharToUTF8Entry *         toUTF8;
+    const CharToUTF8Entry *         entry;
     
     assert(name != NULL);
+    assert(encoding < kMFSTextEncodingCount);
     assert(utf8Name != NULL);
     assert(utf8NameSize > 0);       // must at least give us room for null terminator
     
+    toUTF8 = kTextEncodingTables[encoding].toUTF8;
+    
     outputPtr       = utf8Name;
     outputTotalSize = 0;
     
-    nameLen = name[0];
-    for (i = 1; i <= nameLen; i++) {
-        uint8_t ch;
+    nameLen   = name[0];
+    nameIndex = 1;
+    while (nameIndex <= nameLen) {
         
-        ch = name[i];
-        if (ch < 128) {
-            thisStr    = (const char *) &ch;
-            thisStrLen = (ch != 0);                 // if ch is 0, thisStrLen is 0, so we add no bytes to the string
-        } else {
-            thisStr    = kMacRomanToUTF8[ch - 128];
-            thisStrLen = strlen(thisStr);
+        // Find the run of ASCII characters starting at nameIndex.  A run ends at 
+        // a high-bit character (which needs a table lookup) or a null character 
+        // (which we drop).  We check a word at a time; ((word - 0x01...) | word) 
+        // has a top bit set in every byte that's either null or high-bit (and 
+        // maybe some others, which is harmless because we then check byte-by-byte).
+        
+        runStart = nameIndex;
+        while ( (nameIndex + sizeof(word)) <= (nameLen + 1) ) {
+            memcpy(&word, &name[nameIndex], sizeof(word));
+            if ( ((word - 0x0101010101010101ULL) | word) & 0x8080808080808080ULL ) {
+                break;
+            }
+            nameIndex += sizeof(word);
         }
+        while ( (nameIndex <= nameLen) && (name[nameIndex] != 0) && (name[nameIndex] < 128) ) {
+            nameIndex += 1;
+        }
+        runLen = nameIndex - runStart;
         
-        outputTotalSize += thisStrLen;
-    
-        if (outputTotalSize < utf8NameSize) {       // strictly less than guarantees that we always have space for null terminator
-            memcpy(outputPtr, thisStr, thisStrLen);
-            outputPtr += thisStrLen;
+        // Copy the run across in one go.  If we need to truncate, we truncate at 
+        // a character boundary, which for ASCII means we copy as much as fits. 
+        // Note that, if we've already truncated, outputTotalSize is greater than 
+        // or equal to utf8NameSize, and thus we don't copy anything.
+        
+        if (runLen != 0) {
+            if ( (outputTotalSize + runLen) < utf8NameSize ) {
+                bytesToCopy = runLen;
+            } else if ( outputTotalSize < (utf8NameSize - 1) ) {
+                bytesToCopy = (utf8NameSize - 1) - outputTotalSize;
+            } else {
+                bytesToCopy = 0;
+            }
+            memcpy(outputPtr, &name[runStart], bytesToCopy);
+            outputPtr       += bytesToCopy;
+            outputTotalSize += runLen;
+        }
+        
+        // Then deal with the character that ended the run, if any.
+        
+        if (nameIndex <= nameLen) {
+            if (name[nameIndex] >= 128) {
+                entry = &toUTF8[name[nameIndex] - 128];
+
+                outputTotalSize += entry->length;
+                if (outputTotalSize < utf8NameSize) {       // strictly less than guarantees that we always have space for null terminator
+                    memcpy(outputPtr, entry->utf8, entry->length);
+                    outputPtr += entry->length;
+                }
+            } else {
+                assert(name[nameIndex] == 0);               // null characters add no bytes to the string
+            }
+            nameIndex += 1;
         }
     }
     assert(outputPtr < (utf8Name + utf8NameSize));  
@@ -235,9 +931,33 @@ extern size_t MFSNameToUTF8(const uint8_t *name, char *utf8Name, size_t utf8Name
     return outputTotalSize + 1;                         // including null terminator
 }
 
-extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, void *tempBuffer, uint8_t *mfsName)
+static boolean_t UTF8IsASCII(const char *utf8Name, size_t utf8NameLen)
+    // Returns true if utf8Name (which contains utf8NameLen bytes) is pure 7-bit 
+    // ASCII.  This ORs the string together a 64-bit word at a time and then tests 
+    // the top bit of each byte of the result.  This has the same effect as 
+    // doing it with vector instructions, but it works on every architecture 
+    // we build for, and in the kernel (where using vector registers is not 
+    // an option).  The memcpy makes it safe regardless of the alignment of 
+    // utf8Name; the compiler turns it into a single load.
+{
+    uint64_t    word;
+    uint64_t    accumulator;
+    size_t      byteIndex;
+    
+    accumulator = 0;
+    for (byteIndex = 0; (byteIndex + sizeof(word)) <= utf8NameLen; byteIndex += sizeof(word)) {
+        memcpy(&word, &utf8Name[byteIndex], sizeof(word));
+        accumulator |= word;
+    }
+    for ( ; byteIndex < utf8NameLen; byteIndex++) {
+        accumulator |= (uint8_t) utf8Name[byteIndex];
+    }
+    return (accumulator & 0x8080808080808080ULL) == 0;
+}
+
+extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, MFSTextEncoding encoding, void *tempBuffer, uint8_t *mfsName)
     // Converts a UTF-8 encoding string (either precomposed or decomposed) to 
-    // an MFS name (a MacRoman encoded Pascal string).
+    // an MFS name (a Pascal string in the specified encoding).
     //
     // utf8Name must point to a UTF-8 string containing utf8NameLen characters.
     //
@@ -245,12 +965,12 @@ extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, void *tem
     // bytes.  On entry, its value is ignored.  On return, its value is undefined.
     //
     // mfsName must point to a buffer of 256 bytes.  On entry, its value is ignored. 
-    // On success, this contains the MacRoman Pascal string equivalent to utf8Name.
+    // On success, this contains the Pascal string equivalent to utf8Name.
     //
     // Likely error results include:
     //
     // o EINVAL, which means that utf8Name contains Unicode characters that can't 
-    //   be mapped into MacRoman
+    //   be mapped into the encoding
     //
     // o ENAMETOOLONG, which mean that utf8Name is too longer to be held in a 
     //   MFS name
@@ -261,61 +981,52 @@ extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, void *tem
     size_t      utf16Index;
     
     assert(utf8Name != NULL);
+    assert(encoding < kMFSTextEncodingCount);
     assert(tempBuffer != NULL);
     assert(mfsName != NULL);
     
-    utf16Ptr = (uint16_t *) tempBuffer;
+    // Most names are pure ASCII, and ASCII maps to every supported encoding 
+    // byte-for-byte.  Also, precomposition can't change a string that contains 
+    // no combining characters, and there are no combining characters in ASCII. 
+    // So, if the name is pure ASCII and short enough, just copy it across. 
+    // Otherwise do it the hard way, using utf8_decodestr to parse and precompose 
+    // the UTF-8.
     
-    err = utf8_decodestr( (const uint8_t *) utf8Name, utf8NameLen, utf16Ptr, &utf16Count, kUTF8ToMFSNameTempBufferSize, 0, UTF_PRECOMPOSED);
-    if (err == 0) {
-        utf16Count /= sizeof(utf16Ptr[0]);      // it comes back as bytes, and we want chars
+    if ( (utf8NameLen <= 255) && UTF8IsASCII(utf8Name, utf8NameLen) ) {
+        mfsName[0] = (uint8_t) utf8NameLen;
+        memcpy(&mfsName[1], utf8Name, utf8NameLen);
+        err = 0;
+    } else {
+        utf16Ptr = (uint16_t *) tempBuffer;
+    
+        err = utf8_decodestr( (const uint8_t *) utf8Name, utf8NameLen, utf16Ptr, &utf16Count, kUTF8ToMFSNameTempBufferSize, 0, UTF_PRECOMPOSED);
+        if (err == 0) {
+            utf16Count /= sizeof(utf16Ptr[0]);      // it comes back as bytes, and we want chars
         
-        assert(utf16Count <= 255);              // because it's limited by kUTF8ToMFSNameTempBufferSize
-        mfsName[0] = (uint8_t) utf16Count;      // set up length byte
+            assert(utf16Count <= 255);              // because it's limited by kUTF8ToMFSNameTempBufferSize
+            mfsName[0] = (uint8_t) utf16Count;      // set up length byte
         
-        for (utf16Index = 0; utf16Index < utf16Count; utf16Index++) {
-            uint16_t            key;
-            
-            // Binary search kUTF16ToMacRoman for this UTF-16 character.
-            // This scary algorithm was stolen from the libc implementation 
-            // of <x-man-page://3/bsearch>.
+            for (utf16Index = 0; utf16Index < utf16Count; utf16Index++) {
+                uint16_t            key;
+                uint8_t             mfsChar;
             
-            key = utf16Ptr[utf16Index];
-            if (key < 128) {
-                // Both MacRoman and UTF-8 inherit their bottom 128 characters from 
-                // ASCII, so you can just copy it across.
+                key = utf16Ptr[utf16Index];
+                if (key < 128) {
+                    // Both the encoding and UTF-8 inherit their bottom 128 characters 
+                    // from ASCII, so you can just copy it across.
                 
-                mfsName[utf16Index + 1] = (uint8_t) key;
-            } else {
-                size_t              limit;
-                int                 compareResult;
-                const UniCharInfo * base;
-                const UniCharInfo * this;
-                boolean_t           found;
-
-                // Otherwise, we have to do it the hard way.
+                    mfsName[utf16Index + 1] = (uint8_t) key;
+                } else {
+                    // Otherwise, look it up in the two-level page table.  A result of 
+                    // 0 means there's no equivalent in the encoding.
                 
-                found = FALSE;
-                base = &kUTF16ToMacRoman[0];
-                for (limit = (sizeof(kUTF16ToMacRoman) / sizeof(kUTF16ToMacRoman[0])); limit != 0; limit >>= 1) {
-                    this = base + (limit >> 1);
-                    
-                    compareResult = ((int) key) - ((int) this->utf16Char);
-                    if (compareResult == 0) {
-                        found = TRUE;
+                    mfsChar = kTextEncodingTables[encoding].utf16Pages[kTextEncodingTables[encoding].utf16PageIndex[key >> 8]][key & 0xFF];
+                    if (mfsChar != 0) {
+                        mfsName[utf16Index + 1] = mfsChar;                  // + 1 because the output is a Pascal string
+                    } else {
+                        err = EINVAL;
                         break;
                     }
-                    if (compareResult > 0) {
-                        base = this + 1;
-                        limit -= 1;
-                    }
-                }
-                
-                if (found) {
-                    mfsName[utf16Index + 1] = this->macRomanChar;       // + 1 because the output is a Pascal string
-                } else {
-                    err = EINVAL;
-                    break;
                 }
             }
         }
@@ -324,49 +1035,132 @@ extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, void *tem
     return err;
 }
 
-extern void MFSNameToUpper(uint8_t *mfsName)
-    // Converts the MFS name (a MacRoman encoding Pascal string) pointed to by 
-    // mfsName to upper case.
+// The case folding routines below work a 64-bit word (8 characters) at a time.  If 
+// none of the characters in the word has its high bit set, the word is all ASCII, 
+// and ASCIIWordToUpper can fold all of the characters at once, without touching 
+// the encoding's ToUpper table.  Otherwise we fall back to the table for that word. 
+// This works for every supported encoding because they all agree with ASCII for 
+// the bottom 128 characters.  All of this arithmetic is done within each byte 
+// (there are no carries or borrows between bytes), so it works regardless of 
+// the byte order of the word.
+
+static const uint64_t kEachByte01 = 0x0101010101010101ULL;
+static const uint64_t kEachByte80 = 0x8080808080808080ULL;
+
+static uint64_t ASCIIWordToUpper(uint64_t word)
+    // Returns word with each of its 8 characters converted to upper case.  word 
+    // must not have the high bit set in any byte.
+{
+    uint64_t    atLeastA;
+    uint64_t    aboveZ;
+    uint64_t    isLower;
+
+    assert( (word & kEachByte80) == 0 );
+    
+    // Adding (0x80 - x) to a byte sets its high bit if and only if the byte 
+    // was >= x; that can't carry out of the byte because the byte is < 0x80. 
+    // So isLower ends up with 0x80 in each byte that's in 'a'..'z', and 
+    // subtracting that shifted down by 2 (that is, 0x20) converts it to 
+    // 'A'..'Z'.
+    
+    atLeastA = word + ((0x80 - 'a')       * kEachByte01);
+    aboveZ   = word + ((0x80 - ('z' + 1)) * kEachByte01);
+    isLower  = atLeastA & ~aboveZ & kEachByte80;
+    
+    return word - (isLower >> 2);
+}
+
+extern void MFSNameToUpper(uint8_t *mfsName, MFSTextEncoding encoding)
+    // Converts the MFS name (a Pascal string in the specified encoding) pointed 
+    // to by mfsName to upper case.
     //
     // mfsName must point to a valid MFS name.  This routine makes no assumptions 
     // about the size of the buffer containing this name (for example, if you 
     // have a Str63, it's fine to call this routine on it as long as the 
     // length of the string is 63 or less).
 {
-    int     charCount;
-    int     charIndex;
+    int                 charCount;
+    int                 charIndex;
+    int                 wordCharIndex;
+    uint64_t            word;
+    const uint16_t *    toUpper;
+    
+    assert(encoding < kMFSTextEncodingCount);
+    
+    toUpper = kTextEncodingTables[encoding].toUpper;
     
     charCount = mfsName[0];
-    for (charIndex = 1; charIndex <= charCount; charIndex++) {
-        mfsName[charIndex] = kMacRomanToUpper[mfsName[charIndex]];
+    charIndex = 1;
+    while ( (charIndex + (int) sizeof(word)) <= (charCount + 1) ) {
+        memcpy(&word, &mfsName[charIndex], sizeof(word));
+        if ( (word & kEachByte80) == 0 ) {
+            word = ASCIIWordToUpper(word);
+            memcpy(&mfsName[charIndex], &word, sizeof(word));
+        } else {
+            for (wordCharIndex = charIndex; wordCharIndex < (charIndex + (int) sizeof(word)); wordCharIndex++) {
+                mfsName[wordCharIndex] = toUpper[mfsName[wordCharIndex]];
+            }
+        }
+        charIndex += sizeof(word);
+    }
+    for ( ; charIndex <= charCount; charIndex++) {
+        mfsName[charIndex] = toUpper[mfsName[charIndex]];
     }
 }
 
-extern boolean_t MFSNameEqualToUpper(const uint8_t *mfsName, const uint8_t *mfsNameUpper)
+extern boolean_t MFSNameEqualToUpper(const uint8_t *mfsName, const uint8_t *mfsNameUpper, MFSTextEncoding encoding)
     // Does a case sensitive comparison of mfsName and mfsNameUpper. 
     //
-    // mfsName must point to a valid MFS name.
+    // mfsName must point to a valid MFS name in the specified encoding.
     //
     // mfsNameUpper must point to a valid MFS name that has already been 
-    // uppercased by calling MFSNameToUpper.
+    // uppercased by calling MFSNameToUpper with the same encoding.
     //
     // Returns true if the strings are equal.
+    //
+    // Most calls compare against a name that doesn't match, so we reject on the 
+    // length and then on the first character before doing any real work.
 {
-    boolean_t   result;
-    int         charCount;
-    int         charIndex;
+    boolean_t           result;
+    int                 charCount;
+    int                 charIndex;
+    int                 wordCharIndex;
+    uint64_t            word;
+    uint64_t            wordUpper;
+    const uint16_t *    toUpper;
+
+    assert(encoding < kMFSTextEncodingCount);
+    
+    toUpper = kTextEncodingTables[encoding].toUpper;
 
     charCount = mfsName[0];
-    if (charCount == mfsNameUpper[0]) {
+    if (charCount != mfsNameUpper[0]) {
+        result = FALSE;
+    } else if ( (charCount != 0) && (toUpper[mfsName[1]] != mfsNameUpper[1]) ) {
+        result = FALSE;
+    } else {
         result = TRUE;
-        for (charIndex = 1; charIndex <= charCount; charIndex++) {
-            if ( kMacRomanToUpper[mfsName[charIndex]] != mfsNameUpper[charIndex] ) {
+        charIndex = 1;
+        while ( result && ((charIndex + (int) sizeof(word)) <= (charCount + 1)) ) {
+            memcpy(&word,      &mfsName[charIndex],      sizeof(word));
+            memcpy(&wordUpper, &mfsNameUpper[charIndex], sizeof(wordUpper));
+            if ( (word & kEachByte80) == 0 ) {
+                result = (ASCIIWordToUpper(word) == wordUpper);
+            } else {
+                for (wordCharIndex = charIndex; wordCharIndex < (charIndex + (int) sizeof(word)); wordCharIndex++) {
+                    if ( toUpper[mfsName[wordCharIndex]] != mfsNameUpper[wordCharIndex] ) {
+                        result = FALSE;
+                        break;
+                    }
+                }
+            }
+            charIndex += sizeof(word);
+        }
+        for ( ; result && (charIndex <= charCount); charIndex++) {
+            if ( toUpper[mfsName[charIndex]] != mfsNameUpper[charIndex] ) {
                 result = FALSE;
-                break;
             }
         }
-    } else {
-        result = FALSE;
     }
     
     return result;
@@ -873,6 +1667,7 @@ static const struct timespec kZeroTime = {0, 0};
 
 extern int MFSMDBGetAttr(
     const void *        mdbBlockPtr,
+    MFSTextEncoding     encoding,
     struct vfs_attr *   attr
 )
     // See comments in header.
@@ -882,6 +1677,7 @@ extern int MFSMDBGetAttr(
 
     mdbPtr = (const MFSMasterDirectoryBlock *) mdbBlockPtr;
     assert( MFSMDBValid(mdbPtr) );
+    assert(encoding < kMFSTextEncodingCount);
 
     VFSATTR_RETURN(attr, f_objcount,    OSSwapBigToHostInt16(mdbPtr->fileCount) + 1);   // +1 for root directory
     VFSATTR_RETURN(attr, f_filecount,   OSSwapBigToHostInt16(mdbPtr->fileCount));
@@ -913,11 +1709,11 @@ extern int MFSMDBGetAttr(
 
     if ( VFSATTR_IS_ACTIVE(attr, f_vol_name) ) {
         // Maximum volume name length is 27 characters; with a maximum UTF-8 expansion 
-        // of 3x, this yields 81, for a buffer size of 82, which is way less than MAXPATHLEN.
+        // of 4x, this yields 108, for a buffer size of 109, which is way less than MAXPATHLEN.
         
-        assert( ((27 * kMacRomanToUTF8Expansion) + 1) <= MAXPATHLEN );
+        assert( ((27 * kTextEncodingTables[encoding].toUTF8Expansion) + 1) <= MAXPATHLEN );
         
-        junkSize = MFSNameToUTF8(&mdbPtr->nameLength, attr->f_vol_name, MAXPATHLEN);
+        junkSize = MFSNameToUTF8(&mdbPtr->nameLength, encoding, attr->f_vol_name, MAXPATHLEN);
         assert(junkSize < MAXPATHLEN);
         
         VFSATTR_SET_SUPPORTED(attr, f_vol_name);
@@ -960,21 +1756,16 @@ enum {
     kMFSDirectoryAllocationBlock = 0x0FFF
 };
 
-static uint16_t MFSVABMNextAllocationBlock(const void *mdbAndVABMPtr, uint16_t allocationBlock)
-    // Looks up allocation block in the VABM and returns the next allocation block. 
-    // The result can might be kMFSLastAllocationBlock.  See the pre- and post-condition 
-    // asserts for the specifics.
+static uint16_t MFSVABMGetEntry(const MFSMasterDirectoryBlock *mdbPtr, uint16_t allocationBlock)
+    // Returns the raw VABM entry for allocationBlock.  Unlike 
+    // MFSVABMNextAllocationBlock, this makes no assumptions about the value 
+    // of the entry, so it's safe to use on a volume that might be corrupt.
 {
     uint16_t                            result;
-    const MFSMasterDirectoryBlock *     mdbPtr;
     const uint8_t *                     vabmBase;
     size_t                              byteIndex;
 
-    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
-    assert( MFSMDBValid(mdbPtr) );
-    assert(allocationBlock != kMFSEmptyAllocationBlock);
-    assert(allocationBlock != kMFSLastAllocationBlock);
-    assert(allocationBlock <= kMFSMaximumAllocationBlock);
+    assert(allocationBlock >= kMFSFirstAllocationBlock);
     assert(allocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
     
     // VABM starts immediately after the MDB.
@@ -997,6 +1788,26 @@ static uint16_t MFSVABMNextAllocationBlock(const void *mdbAndVABMPtr, uint16_t a
         result = ((vabmBase[byteIndex] & 0x0F) << 8) | vabmBase[byteIndex + 1];
     }
     
+    return result;
+}
+
+static uint16_t MFSVABMNextAllocationBlock(const void *mdbAndVABMPtr, uint16_t allocationBlock)
+    // Looks up allocation block in the VABM and returns the next allocation block. 
+    // The result can might be kMFSLastAllocationBlock.  See the pre- and post-condition 
+    // asserts for the specifics.
+{
+    uint16_t                            result;
+    const MFSMasterDirectoryBlock *     mdbPtr;
+
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(allocationBlock != kMFSEmptyAllocationBlock);
+    assert(allocationBlock != kMFSLastAllocationBlock);
+    assert(allocationBlock <= kMFSMaximumAllocationBlock);
+    assert(allocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
+    
+    result = MFSVABMGetEntry(mdbPtr, allocationBlock);
+    
     assert(result != kMFSEmptyAllocationBlock);
     assert(result < kMFSMaximumAllocationBlock);
     assert(result < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
@@ -1004,6 +1815,83 @@ static uint16_t MFSVABMNextAllocationBlock(const void *mdbAndVABMPtr, uint16_t a
     return result;
 }
 
+extern int MFSVABMDecode(
+    const void *        mdbAndVABMPtr,
+    uint16_t            vabmTable[],
+    size_t              vabmTableSize
+)
+    // See comments in header.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    const uint8_t *                 vabmBase;
+    size_t                          allocationBlockCount;
+    size_t                          pairCount;
+    size_t                          pairIndex;
+
+    // Pre-conditions
+
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert( (vabmTable != NULL) || (vabmTableSize == 0) );
+
+    // Implementation
+
+    allocationBlockCount = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+    if (allocationBlockCount > vabmTableSize) {
+        err = EINVAL;
+    } else {
+        vabmBase = (const uint8_t *) (&mdbPtr[1]);
+
+        // Every three bytes of the VABM hold two 12 bit entries, so we unpack 
+        // a pair at a time.  This loop has no branches and no data dependencies 
+        // between iterations, which lets the compiler vectorise it.  If the 
+        // number of allocation blocks is odd, the last pair has only one valid 
+        // entry.  The VABM still contains all three bytes of that pair (see 
+        // the calculation of mdbAndVABMSizeInBytes in MFSMDBCheckCore), but the 
+        // table might not have room for the second entry, so we handle it 
+        // separately.
+
+        pairCount = allocationBlockCount / 2;
+        for (pairIndex = 0; pairIndex < pairCount; pairIndex++) {
+            const uint8_t *     bytes;
+            
+            bytes = &vabmBase[pairIndex * 3];
+            vabmTable[pairIndex * 2]     = (uint16_t) ( (bytes[0] << 4)          | (bytes[1] >> 4) );
+            vabmTable[pairIndex * 2 + 1] = (uint16_t) (((bytes[1] & 0x0F) << 8) |  bytes[2]      );
+        }
+        if ( (allocationBlockCount % 2) != 0 ) {
+            vabmTable[pairCount * 2] = (uint16_t) ( (vabmBase[pairCount * 3] << 4) | (vabmBase[pairCount * 3 + 1] >> 4) );
+        }
+        err = 0;
+    }
+
+    return err;
+}
+
+static uint16_t MFSNextAllocationBlock(
+    const MFSMasterDirectoryBlock * mdbPtr, 
+    const uint16_t *                vabmTable, 
+    uint16_t                        allocationBlock
+)
+    // Returns the next allocation block in the chain.  If vabmTable is not NULL, 
+    // it's a table built by MFSVABMDecode and we look the answer up there; 
+    // otherwise we fall back to the packed VABM.
+{
+    uint16_t    result;
+    
+    if (vabmTable == NULL) {
+        result = MFSVABMNextAllocationBlock(mdbPtr, allocationBlock);
+    } else {
+        assert(allocationBlock >= kMFSFirstAllocationBlock);
+        assert(allocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
+
+        result = vabmTable[allocationBlock - kMFSFirstAllocationBlock];
+    }
+    return result;
+}
+
 
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Directory Entry Routines
@@ -1012,6 +1900,7 @@ extern int MFSDirectoryBlockIterate(
     const void *        directoryBlockPtr, 
     size_t              directoryBlockSizeInBytes, 
     size_t *            dirOffsetPtr, 
+    MFSTextEncoding     encoding,
     struct vnode_attr * attr
 )
     // See comments in header.
@@ -1099,7 +1988,7 @@ extern int MFSDirectoryBlockIterate(
             assert( (thisDirRec->attributes & kMFSDirectoryRecordReservedAttr) == 0);
             
             if (attr != NULL) {
-                err = MFSDirectoryEntryGetAttr(directoryBlockPtr, dirOffset, attr);
+                err = MFSDirectoryEntryGetAttr(directoryBlockPtr, dirOffset, encoding, attr);
             }
         }
     }
@@ -1179,11 +2068,72 @@ extern int MFSDirectoryBlockCheckDirOffset(
     return err;
 }
 
+extern size_t MFSDirectoryBlockGetOffsetBitmapSize(size_t directoryBlockSizeInBytes)
+    // See comments in header.
+{
+    // One bit for every even offset.
+    
+    return ((directoryBlockSizeInBytes / 2) + 7) / 8;
+}
+
+extern void MFSDirectoryBlockBuildOffsetBitmap(
+    const void *        directoryBlockPtr, 
+    size_t              directoryBlockSizeInBytes, 
+    uint8_t             bitmap[]
+)
+    // See comments in header.
+{
+    int         err;
+    size_t      dirOffset;
+    
+    assert(directoryBlockPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(bitmap != NULL);
+    
+    memset(bitmap, 0, MFSDirectoryBlockGetOffsetBitmapSize(directoryBlockSizeInBytes));
+    
+    // The valid offsets are exactly the ones that MFSDirectoryBlockIterate 
+    // returns, so let it do the work.
+    
+    dirOffset = kMFSDirectoryBlockIterateFromStart;
+    do {
+        err = MFSDirectoryBlockIterate(directoryBlockPtr, directoryBlockSizeInBytes, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+        if (err == 0) {
+            assert( (dirOffset % 2) == 0 );
+            bitmap[(dirOffset / 2) / 8] |= (uint8_t) (1 << ((dirOffset / 2) % 8));
+        }
+    } while (err == 0);
+    assert(err == ENOENT);
+}
+
+extern int MFSDirectoryBlockOffsetBitmapCheckDirOffset(
+    const uint8_t       bitmap[], 
+    size_t              directoryBlockSizeInBytes, 
+    size_t              candidateDirOffset
+)
+    // See comments in header.
+{
+    int     err;
+    
+    assert(bitmap != NULL);
+    assert(candidateDirOffset != kMFSDirectoryBlockIterateFromStart);       // just don't call us in this case
+    assert(candidateDirOffset < directoryBlockSizeInBytes);                 // ditto
+    
+    err = EINVAL;
+    if ( (candidateDirOffset % 2) == 0 ) {
+        if ( bitmap[(candidateDirOffset / 2) / 8] & (1 << ((candidateDirOffset / 2) % 8)) ) {
+            err = 0;
+        }
+    }
+    return err;
+}
+
 extern int MFSDirectoryBlockFindEntryByName(
     const void *        directoryBlockPtr, 
     size_t              directoryBlockSizeInBytes, 
     const char *        utf8Name,
     size_t              utf8NameLen,
+    MFSTextEncoding     encoding,
     void *              tempBuffer,
     size_t *            dirOffsetPtr, 
     struct vnode_attr * attr
@@ -1197,6 +2147,7 @@ extern int MFSDirectoryBlockFindEntryByName(
     assert(directoryBlockPtr != NULL);
     assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
     assert(utf8Name != NULL);
+    assert(encoding < kMFSTextEncodingCount);
     assert(tempBuffer != NULL);
     assert(dirOffsetPtr != NULL);
     // *dirOffsetPtr ignored on input
@@ -1204,7 +2155,7 @@ extern int MFSDirectoryBlockFindEntryByName(
 
     // If this is the first time we've seen tempBuffer, its first byte will be 0.
     // In that case, use it to cache a copy of the uppercased MFS name associated 
-    // with utf8Name.  This avoids the cost of the UTF-8 -> MacRoman -> upper case 
+    // with utf8Name.  This avoids the cost of the UTF-8 -> MFS name -> upper case 
     // if you're scanning multiple directory blocks.
 
     mfsNameUpper = (uint8_t *) tempBuffer;
@@ -1214,9 +2165,9 @@ extern int MFSDirectoryBlockFindEntryByName(
         // Use tempBuffer + 256 as the tempory buffer for UTF8ToMFSName, and 
         // tempBuffer + 0 as the place to store the resulting MFS name.
     
-        err = UTF8ToMFSName(utf8Name, utf8NameLen, ((char *) tempBuffer) + 256, mfsNameUpper);
+        err = UTF8ToMFSName(utf8Name, utf8NameLen, encoding, ((char *) tempBuffer) + 256, mfsNameUpper);
         if (err == 0) {
-            MFSNameToUpper(mfsNameUpper);
+            MFSNameToUpper(mfsNameUpper, encoding);
             
             // Empty names are unacceptable, in general /and/ because we use the first 
             // byte to determine if tempBuffer has been initialised yet.
@@ -1239,6 +2190,7 @@ extern int MFSDirectoryBlockFindEntryByName(
                 directoryBlockPtr,
                 directoryBlockSizeInBytes,
                 &dirOffset,
+                encoding,
                 NULL
             );
             
@@ -1247,7 +2199,7 @@ extern int MFSDirectoryBlockFindEntryByName(
                 
                 dirRec = ((const MFSDirectoryRecord *) (((const char *) directoryBlockPtr) + dirOffset));
                 
-                found = MFSNameEqualToUpper(&dirRec->nameLength, mfsNameUpper);
+                found = MFSNameEqualToUpper(&dirRec->nameLength, mfsNameUpper, encoding);
             }
         } while ( (err == 0) && ! found);
 
@@ -1259,7 +2211,7 @@ extern int MFSDirectoryBlockFindEntryByName(
     if (err == 0) {
         *dirOffsetPtr = dirOffset;
         if (attr != NULL) {
-            err = MFSDirectoryEntryGetAttr(directoryBlockPtr, dirOffset, attr);
+            err = MFSDirectoryEntryGetAttr(directoryBlockPtr, dirOffset, encoding, attr);
         }
     }
 
@@ -1271,6 +2223,7 @@ extern int MFSDirectoryBlockFindEntryByName(
 extern int MFSDirectoryEntryGetAttr(
     const void *        directoryBlockPtr, 
     size_t              dirOffset, 
+    MFSTextEncoding     encoding,
     struct vnode_attr * attr
 )
     // See comments in header.
@@ -1279,6 +2232,7 @@ extern int MFSDirectoryEntryGetAttr(
     size_t                      junkSize;
     
     assert(directoryBlockPtr != NULL);
+    assert(encoding < kMFSTextEncodingCount);
     assert(attr != NULL);
     
     dirRec = ((const MFSDirectoryRecord *) (((const char *) directoryBlockPtr) + dirOffset));
@@ -1318,17 +2272,17 @@ extern int MFSDirectoryEntryGetAttr(
 //  VATTR_RETURN(attr, va_fsid,     xxx);
 //  VATTR_RETURN(attr, va_filerev,  xxx);
 //  VATTR_RETURN(attr, va_gen,      xxx);
-    VATTR_RETURN(attr, va_encoding, 0);         // 0 -> MacRoman
+    VATTR_RETURN(attr, va_encoding, kTextEncodingTables[encoding].textEncoding);
 
     VATTR_RETURN(attr, va_type, VREG);
     if ( VATTR_IS_ACTIVE(attr, va_name) ) {
         // Maximum volume name length is 255 characters; with a maximum UTF-8 expansion 
-        // of 3x, this yields 765, for a buffer size of 766, which is definitely less than 
+        // of 4x, this yields 1020, for a buffer size of 1021, which is (just) less than 
         // MAXPATHLEN.
         
-        assert( ((255 * kMacRomanToUTF8Expansion) + 1) <= MAXPATHLEN );
+        assert( ((255 * kTextEncodingTables[encoding].toUTF8Expansion) + 1) <= MAXPATHLEN );
         
-        junkSize = MFSNameToUTF8(&dirRec->nameLength, attr->va_name, MAXPATHLEN);
+        junkSize = MFSNameToUTF8(&dirRec->nameLength, encoding, attr->va_name, MAXPATHLEN);
         assert(junkSize < MAXPATHLEN);
         
         VATTR_SET_SUPPORTED(attr, va_name);
@@ -1401,31 +2355,696 @@ extern int MFSDirectoryEntryGetForkInfo(
     return 0;
 }
 
-/////////////////////////////////////////////////////////////////////
-#pragma mark ***** File Fork Routines
+static void MFSDirectoryRecordDecode(const MFSDirectoryRecord *dirRec, size_t dirOffset, MFSDirectoryEntryInfo *entry)
+    // Decodes a directory record into *entry.  This is the common core of 
+    // MFSDirectoryBlockDecodeAll and MFSDirectoryIndexBuild.
+{
+    assert(dirRec != NULL);
+    assert(dirOffset < 65536);                          // entry->dirOffset is 16 bits
+    assert(entry != NULL);
+    
+    entry->fileNumber       = OSSwapBigToHostInt32(dirRec->fileNumber);
+    entry->dirOffset        = (uint16_t) dirOffset;
+    entry->attributes       = dirRec->attributes;
+    entry->reserved         = 0;
+    entry->creationDate     = OSSwapBigToHostInt32(dirRec->creationDate);
+    entry->modificationDate = OSSwapBigToHostInt32(dirRec->modificationDate);
+    memcpy(entry->finderInfo, dirRec->finderInfo, sizeof(entry->finderInfo));
+    entry->name             = &dirRec->nameLength;
+
+    entry->forkInfos[0].firstAllocationBlock  = OSSwapBigToHostInt16(dirRec->dataFirstAllocationBlock);
+    entry->forkInfos[0].lengthInBytes         = OSSwapBigToHostInt32(dirRec->dataLengthInBytes);
+    entry->forkInfos[0].physicalLengthInBytes = OSSwapBigToHostInt32(dirRec->dataPhysicalLengthInBytes);
+    entry->forkInfos[1].firstAllocationBlock  = OSSwapBigToHostInt16(dirRec->rsrcFirstAllocationBlock);
+    entry->forkInfos[1].lengthInBytes         = OSSwapBigToHostInt32(dirRec->rsrcLengthInBytes);
+    entry->forkInfos[1].physicalLengthInBytes = OSSwapBigToHostInt32(dirRec->rsrcPhysicalLengthInBytes);
+}
 
-extern int MFSForkGetExtent(
-    const void *        mdbAndVABMPtr,
-    const MFSForkInfo * forkInfo,
-    uint32_t            forkOffsetInBytes,
-    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
-    uint32_t *          contiguousPhysicalBytesPtr
+extern size_t MFSDirectoryBlockGetMaximumEntryCount(size_t directoryBlockSizeInBytes)
+    // See comments in header.
+{
+    // The smallest directory entry is kMFSDirectoryRecordMinimumSize rounded 
+    // up to an even number.
+    
+    return directoryBlockSizeInBytes / ((kMFSDirectoryRecordMinimumSize + 1) & ~1);
+}
+
+extern int MFSDirectoryBlockDecodeAll(
+    const void *            directoryBlockPtr, 
+    size_t                  directoryBlockSizeInBytes, 
+    MFSDirectoryEntryInfo   entries[],
+    size_t                  entriesSize,
+    size_t *                entryCountPtr
 )
     // See comments in header.
 {
-    int                             err;
-    const MFSMasterDirectoryBlock * mdbPtr;
-    uint32_t                        allocationBlockSizeInBytes;
-    uint16_t                        currentAllocationBlock;
-    uint32_t                        currentForkOffsetInBytes;
-    uint32_t                        contiguousPhysicalBytes;
+    int         err;
+    size_t      dirOffset;
+    size_t      entryCount;
+    
+    assert(directoryBlockPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(directoryBlockSizeInBytes < 65536);          // dirOffsets are 16 bits
+    assert( (entriesSize == 0) || (entries != NULL) );
+    assert(entryCountPtr != NULL);
+    
+    // MFSDirectoryBlockIterate does all of the validation and stepping for us; 
+    // passing it a NULL attr means it doesn't do any decoding of its own.
+    
+    entryCount = 0;
+    dirOffset = kMFSDirectoryBlockIterateFromStart;
+    do {
+        err = MFSDirectoryBlockIterate(directoryBlockPtr, directoryBlockSizeInBytes, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+        if (err == 0) {
+            if (entryCount < entriesSize) {
+                MFSDirectoryRecordDecode(
+                    (const MFSDirectoryRecord *) (((const char *) directoryBlockPtr) + dirOffset), 
+                    dirOffset, 
+                    &entries[entryCount]
+                );
+            }
+            entryCount += 1;
+        }
+    } while (err == 0);
+    if (err == ENOENT) {
+        err = 0;
+    }
+    
+    if (err == 0) {
+        *entryCountPtr = entryCount;
+    }
+    
+    assert( (err != 0) || (*entryCountPtr <= MFSDirectoryBlockGetMaximumEntryCount(directoryBlockSizeInBytes)) );
+    
+    return err;
+}
 
-    // Pre-conditions
+// Directory index buffer layout.  Each array is sized for the maximum number of 
+// entries that can fit in the directory.  The arrays are laid out in order of 
+// decreasing alignment, and each element size is a multiple of the alignment 
+// of the following arrays, so as long as the buffer itself is uint32_t aligned, 
+// every array is correctly aligned.  The upper cased names go at the end; 
+// each name occupies no more bytes than the directory entry that holds it, 
+// so the directory size is a bound on the space they need.
 
-    assert(mdbAndVABMPtr != NULL);
-    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
-    assert( MFSMDBValid(mdbPtr) );
-    assert(forkInfo != NULL);
+enum {
+    kMFSDirectoryIndexFinderInfoSize = 16
+};
+
+static size_t MFSDirectoryIndexMaximumEntryCount(uint16_t directoryBlockCount, size_t directoryBlockSizeInBytes)
+    // Returns the maximum number of directory entries that can fit in the 
+    // directory.
+{
+    return directoryBlockCount * MFSDirectoryBlockGetMaximumEntryCount(directoryBlockSizeInBytes);
+}
+
+static size_t MFSDirectoryIndexCarve(
+    uint16_t            directoryBlockCount,
+    size_t              directoryBlockSizeInBytes,
+    char *              buffer,
+    MFSDirectoryIndex * index
+)
+    // Lays out the index arrays in buffer and returns the number of bytes they 
+    // take.  If buffer is NULL, it just calculates the size.
+{
+    size_t      maxEntries;
+    size_t      offset;
+    
+    maxEntries = MFSDirectoryIndexMaximumEntryCount(directoryBlockCount, directoryBlockSizeInBytes);
+
+    #define CARVE(field, type, elementsPerEntry)                    \
+        do {                                                        \
+            if (buffer != NULL) {                                   \
+                index->field = (type *) (buffer + offset);          \
+            }                                                       \
+            offset += maxEntries * (elementsPerEntry) * sizeof(type); \
+        } while (0)
+
+    offset = 0;
+    CARVE(forkInfos[0],      MFSForkInfo, 1);
+    CARVE(forkInfos[1],      MFSForkInfo, 1);
+    CARVE(fileNumbers,       uint32_t,    1);
+    CARVE(upperNameOffsets,  uint32_t,    1);
+    CARVE(creationDates,     uint32_t,    1);
+    CARVE(modificationDates, uint32_t,    1);
+    CARVE(dirBlocks,         uint16_t,    1);
+    CARVE(dirOffsets,        uint16_t,    1);
+    CARVE(finderInfos,       uint8_t,     kMFSDirectoryIndexFinderInfoSize);
+    CARVE(attributes,        uint8_t,     1);
+    
+    #undef CARVE
+    
+    if (buffer != NULL) {
+        index->upperNames = (uint8_t *) (buffer + offset);
+    }
+    offset += directoryBlockCount * directoryBlockSizeInBytes;
+    
+    return offset;
+}
+
+extern size_t MFSDirectoryIndexGetBufferSize(
+    uint16_t            directoryBlockCount,
+    size_t              directoryBlockSizeInBytes
+)
+    // See comments in header.
+{
+    return MFSDirectoryIndexCarve(directoryBlockCount, directoryBlockSizeInBytes, NULL, NULL);
+}
+
+extern int MFSDirectoryIndexBuild(
+    const void *        directoryPtr,
+    uint16_t            directoryStartBlock,
+    uint16_t            directoryBlockCount,
+    size_t              directoryBlockSizeInBytes,
+    MFSTextEncoding     encoding,
+    void *              buffer,
+    size_t              bufferSize,
+    MFSDirectoryIndex * index
+)
+    // See comments in header.
+{
+    int                         err;
+    uint16_t                    dirBlockIndex;
+    size_t                      entryIndex;
+    size_t                      upperNamesSize;
+    
+    // Pre-conditions
+    
+    assert(directoryPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(directoryBlockSizeInBytes < 65536);          // dirOffsets are 16 bits
+    assert(encoding < kMFSTextEncodingCount);
+    assert(buffer != NULL);
+    assert( (((uintptr_t) buffer) % sizeof(uint32_t)) == 0 );
+    assert(index != NULL);
+    
+    // Implementation
+    
+    err = 0;
+    if (bufferSize < MFSDirectoryIndexGetBufferSize(directoryBlockCount, directoryBlockSizeInBytes)) {
+        err = EINVAL;
+    }
+    if (err == 0) {
+        (void) MFSDirectoryIndexCarve(directoryBlockCount, directoryBlockSizeInBytes, (char *) buffer, index);
+        index->encoding = encoding;
+
+        entryIndex = 0;
+        upperNamesSize = 0;
+        for (dirBlockIndex = 0; dirBlockIndex < directoryBlockCount; dirBlockIndex++) {
+            const char *    directoryBlockPtr;
+            size_t          dirOffset;
+            
+            directoryBlockPtr = ((const char *) directoryPtr) + (dirBlockIndex * directoryBlockSizeInBytes);
+            
+            dirOffset = kMFSDirectoryBlockIterateFromStart;
+            do {
+                err = MFSDirectoryBlockIterate(directoryBlockPtr, directoryBlockSizeInBytes, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+                if (err == 0) {
+                    MFSDirectoryEntryInfo   entry;
+                    
+                    MFSDirectoryRecordDecode((const MFSDirectoryRecord *) (directoryBlockPtr + dirOffset), dirOffset, &entry);
+                    
+                    assert(entryIndex < MFSDirectoryIndexMaximumEntryCount(directoryBlockCount, directoryBlockSizeInBytes));
+                    assert( (upperNamesSize + 1 + entry.name[0]) <= (directoryBlockCount * directoryBlockSizeInBytes) );
+
+                    index->fileNumbers[entryIndex]       = entry.fileNumber;
+                    index->dirBlocks[entryIndex]         = (uint16_t) (directoryStartBlock + dirBlockIndex);
+                    index->dirOffsets[entryIndex]        = entry.dirOffset;
+                    index->attributes[entryIndex]        = entry.attributes;
+                    index->creationDates[entryIndex]     = entry.creationDate;
+                    index->modificationDates[entryIndex] = entry.modificationDate;
+                    index->forkInfos[0][entryIndex]      = entry.forkInfos[0];
+                    index->forkInfos[1][entryIndex]      = entry.forkInfos[1];
+                    memcpy(&index->finderInfos[entryIndex * kMFSDirectoryIndexFinderInfoSize], entry.finderInfo, kMFSDirectoryIndexFinderInfoSize);
+
+                    index->upperNameOffsets[entryIndex] = (uint32_t) upperNamesSize;
+                    memcpy(&index->upperNames[upperNamesSize], entry.name, 1 + entry.name[0]);
+                    MFSNameToUpper(&index->upperNames[upperNamesSize], encoding);
+                    upperNamesSize += 1 + entry.name[0];
+                    
+                    entryIndex += 1;
+                }
+            } while (err == 0);
+            assert(err == ENOENT);
+        }
+        index->entryCount = entryIndex;
+        err = 0;
+    }
+    
+    return err;
+}
+
+static uint32_t MFSDirectoryNameHashFunction(const uint8_t *mfsNameUpper)
+    // Returns the hash of an upper cased MFS name, including its length byte. 
+    // This is 32 bit FNV-1a, which is cheap and spreads short names well.
+{
+    uint32_t    hash;
+    size_t      charIndex;
+    
+    hash = 2166136261U;
+    for (charIndex = 0; charIndex <= mfsNameUpper[0]; charIndex++) {
+        hash ^= mfsNameUpper[charIndex];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+extern size_t MFSDirectoryNameHashGetSlotCount(size_t entryCount)
+    // See comments in header.
+{
+    size_t  result;
+    
+    // At least twice the number of entries, so that the table is never more 
+    // than half full and there's always at least one empty slot.
+    
+    result = 2;
+    while (result < (entryCount * 2)) {
+        result *= 2;
+    }
+    return result;
+}
+
+extern void MFSDirectoryNameHashBuild(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    slots[],
+    size_t                      slotCount
+)
+    // See comments in header.
+{
+    size_t      entryIndex;
+    size_t      slotIndex;
+    
+    assert(index != NULL);
+    assert(slots != NULL);
+    assert(slotCount == MFSDirectoryNameHashGetSlotCount(index->entryCount));
+    
+    memset(slots, 0, slotCount * sizeof(*slots));
+
+    // Insert the entries in directory order.  With linear probing, an entry 
+    // inserted earlier is always found before an entry inserted later that 
+    // probes the same slots, which gives us the first-in-directory-order 
+    // behaviour described in the header.
+
+    for (entryIndex = 0; entryIndex < index->entryCount; entryIndex++) {
+        slotIndex = MFSDirectoryNameHashFunction(&index->upperNames[index->upperNameOffsets[entryIndex]]) & (slotCount - 1);
+        while (slots[slotIndex] != 0) {
+            slotIndex = (slotIndex + 1) & (slotCount - 1);
+        }
+        slots[slotIndex] = (uint32_t) (entryIndex + 1);
+    }
+}
+
+extern int MFSDirectoryNameHashLookup(
+    const MFSDirectoryIndex *   index,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    const uint8_t *             mfsNameUpper,
+    size_t *                    entryIndexPtr
+)
+    // See comments in header.
+{
+    int             err;
+    size_t          slotIndex;
+    const uint8_t * thisName;
+    
+    assert(index != NULL);
+    assert(slots != NULL);
+    assert(slotCount == MFSDirectoryNameHashGetSlotCount(index->entryCount));
+    assert(mfsNameUpper != NULL);
+    assert(entryIndexPtr != NULL);
+    
+    // Probe until we find the name or hit an empty slot.  Both names are 
+    // already upper cased, so a byte-wise compare does the job.  Comparing the 
+    // length byte first rejects most mismatches without looking any further.
+    
+    slotIndex = MFSDirectoryNameHashFunction(mfsNameUpper) & (slotCount - 1);
+    do {
+        if (slots[slotIndex] == 0) {
+            err = ENOENT;
+        } else {
+            thisName = &index->upperNames[index->upperNameOffsets[slots[slotIndex] - 1]];
+            if ( (thisName[0] == mfsNameUpper[0]) && (memcmp(&thisName[1], &mfsNameUpper[1], mfsNameUpper[0]) == 0) ) {
+                *entryIndexPtr = slots[slotIndex] - 1;
+                err = 0;
+            } else {
+                slotIndex = (slotIndex + 1) & (slotCount - 1);
+                err = EAGAIN;
+            }
+        }
+    } while (err == EAGAIN);
+    
+    assert( (err != 0) || (*entryIndexPtr < index->entryCount) );
+    
+    return err;
+}
+
+extern int MFSDirectoryNameHashLookupUTF8(
+    const MFSDirectoryIndex *   index,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    const char *                utf8Name,
+    size_t                      utf8NameLen,
+    void *                      tempBuffer,
+    size_t *                    entryIndexPtr
+)
+    // See comments in header.
+{
+    int         err;
+    uint8_t *   mfsNameUpper;
+    
+    assert(utf8Name != NULL);
+    assert(tempBuffer != NULL);
+    
+    // Use tempBuffer + 0 for the MFS name and tempBuffer + 256 as the temporary 
+    // buffer for UTF8ToMFSName, just like MFSDirectoryBlockFindEntryByName.
+    
+    mfsNameUpper = (uint8_t *) tempBuffer;
+    err = UTF8ToMFSName(utf8Name, utf8NameLen, index->encoding, ((char *) tempBuffer) + 256, mfsNameUpper);
+    if (err == 0) {
+        MFSNameToUpper(mfsNameUpper, index->encoding);
+        if (mfsNameUpper[0] == 0) {
+            err = EINVAL;
+        }
+    }
+    if (err == 0) {
+        err = MFSDirectoryNameHashLookup(index, slots, slotCount, mfsNameUpper, entryIndexPtr);
+    }
+    
+    return err;
+}
+
+static size_t MFSDirectoryNameCacheCarve(
+    const MFSDirectoryIndex *   index,
+    char *                      buffer,
+    MFSDirectoryNameCache *     cache
+)
+    // Lays out the name cache arrays in buffer and returns the number of bytes 
+    // they take.  If buffer is NULL, it just calculates the size.  Each entry's 
+    // slot in the arena is big enough for the worst case expansion of its 
+    // name, plus a null terminator.
+{
+    size_t      expansion;
+    size_t      offset;
+    size_t      entryIndex;
+    
+    expansion = kTextEncodingTables[index->encoding].toUTF8Expansion;
+    
+    offset = 0;
+    if (buffer != NULL) {
+        cache->utf8NameOffsets = (uint32_t *) (buffer + offset);
+    }
+    offset += index->entryCount * sizeof(uint32_t);
+    if (buffer != NULL) {
+        cache->utf8NameLengths = (uint16_t *) (buffer + offset);
+    }
+    offset += index->entryCount * sizeof(uint16_t);
+    if (buffer != NULL) {
+        cache->utf8Names = buffer + offset;
+    }
+    for (entryIndex = 0; entryIndex < index->entryCount; entryIndex++) {
+        if (buffer != NULL) {
+            cache->utf8NameOffsets[entryIndex] = (uint32_t) ((buffer + offset) - cache->utf8Names);
+        }
+        offset += (index->upperNames[index->upperNameOffsets[entryIndex]] * expansion) + 1;
+    }
+    
+    return offset;
+}
+
+extern size_t MFSDirectoryNameCacheGetBufferSize(const MFSDirectoryIndex *index)
+    // See comments in header.
+{
+    assert(index != NULL);
+    assert(index->encoding < kMFSTextEncodingCount);
+
+    return MFSDirectoryNameCacheCarve(index, NULL, NULL);
+}
+
+extern int MFSDirectoryNameCacheInit(
+    const MFSDirectoryIndex *   index,
+    const void *                directoryPtr,
+    uint16_t                    directoryStartBlock,
+    size_t                      directoryBlockSizeInBytes,
+    void *                      buffer,
+    size_t                      bufferSize,
+    MFSDirectoryNameCache *     cache
+)
+    // See comments in header.
+{
+    int         err;
+    size_t      entryIndex;
+    
+    assert(index != NULL);
+    assert(index->encoding < kMFSTextEncodingCount);
+    assert(directoryPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(buffer != NULL);
+    assert( (((uintptr_t) buffer) % sizeof(uint32_t)) == 0 );
+    assert(cache != NULL);
+    
+    err = 0;
+    if (bufferSize < MFSDirectoryNameCacheGetBufferSize(index)) {
+        err = EINVAL;
+    }
+    if (err == 0) {
+        cache->index                     = index;
+        cache->directoryPtr              = directoryPtr;
+        cache->directoryStartBlock       = directoryStartBlock;
+        cache->directoryBlockSizeInBytes = directoryBlockSizeInBytes;
+        (void) MFSDirectoryNameCacheCarve(index, (char *) buffer, cache);
+        
+        for (entryIndex = 0; entryIndex < index->entryCount; entryIndex++) {
+            cache->utf8NameLengths[entryIndex] = kMFSDirectoryNameCacheNotConverted;
+        }
+    }
+    
+    return err;
+}
+
+extern const char * MFSDirectoryNameCacheGetName(
+    MFSDirectoryNameCache *     cache,
+    size_t                      entryIndex,
+    size_t *                    utf8NameLenPtr
+)
+    // See comments in header.
+{
+    const MFSDirectoryIndex *   index;
+    char *                      utf8Name;
+    
+    assert(cache != NULL);
+    index = cache->index;
+    assert(entryIndex < index->entryCount);
+    
+    utf8Name = &cache->utf8Names[cache->utf8NameOffsets[entryIndex]];
+    if (cache->utf8NameLengths[entryIndex] == kMFSDirectoryNameCacheNotConverted) {
+        const MFSDirectoryRecord *  dirRec;
+        size_t                      utf8NameSize;
+        size_t                      sizeNeeded;
+        
+        dirRec = (const MFSDirectoryRecord *) (
+              ((const char *) cache->directoryPtr) 
+            + ((index->dirBlocks[entryIndex] - cache->directoryStartBlock) * cache->directoryBlockSizeInBytes)
+            + index->dirOffsets[entryIndex]
+        );
+        assert(dirRec->nameLength == index->upperNames[index->upperNameOffsets[entryIndex]]);
+        
+        utf8NameSize = (dirRec->nameLength * kTextEncodingTables[index->encoding].toUTF8Expansion) + 1;
+        sizeNeeded = MFSNameToUTF8(&dirRec->nameLength, index->encoding, utf8Name, utf8NameSize);
+        assert(sizeNeeded <= utf8NameSize);         // the slot is always big enough
+        
+        cache->utf8NameLengths[entryIndex] = (uint16_t) (sizeNeeded - 1);
+    }
+    if (utf8NameLenPtr != NULL) {
+        *utf8NameLenPtr = cache->utf8NameLengths[entryIndex];
+    }
+    
+    return utf8Name;
+}
+
+extern int MFSDirectoryIndexFindEntry(
+    const MFSDirectoryIndex *   index,
+    uint16_t                    dirBlock,
+    size_t                      dirOffset,
+    size_t *                    entryIndexPtr
+)
+    // See comments in header.
+{
+    int         err;
+    size_t      low;
+    size_t      high;
+    size_t      mid;
+    
+    assert(index != NULL);
+    assert(entryIndexPtr != NULL);
+    
+    // Binary search for the first entry that's not before (dirBlock, dirOffset).
+    
+    low  = 0;
+    high = index->entryCount;
+    while (low < high) {
+        mid = low + ((high - low) / 2);
+        if ( (index->dirBlocks[mid] < dirBlock) || ((index->dirBlocks[mid] == dirBlock) && (index->dirOffsets[mid] < dirOffset)) ) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    err = ENOENT;
+    if ( (low < index->entryCount) && (index->dirBlocks[low] == dirBlock) && (index->dirOffsets[low] == dirOffset) ) {
+        *entryIndexPtr = low;
+        err = 0;
+    }
+    
+    return err;
+}
+
+extern size_t MFSDirectoryFileNumberTableGetSlotCount(
+    const MFSDirectoryIndex *   index, 
+    uint32_t *                  firstFileNumberPtr
+)
+    // See comments in header.
+{
+    size_t      result;
+    size_t      entryIndex;
+    uint32_t    minFileNumber;
+    uint32_t    maxFileNumber;
+    
+    assert(index != NULL);
+    assert(firstFileNumberPtr != NULL);
+    
+    result = 0;
+    *firstFileNumberPtr = 0;
+    if (index->entryCount != 0) {
+        minFileNumber = index->fileNumbers[0];
+        maxFileNumber = index->fileNumbers[0];
+        for (entryIndex = 1; entryIndex < index->entryCount; entryIndex++) {
+            if (index->fileNumbers[entryIndex] < minFileNumber) {
+                minFileNumber = index->fileNumbers[entryIndex];
+            }
+            if (index->fileNumbers[entryIndex] > maxFileNumber) {
+                maxFileNumber = index->fileNumbers[entryIndex];
+            }
+        }
+        
+        // Do the range check in 32 bits so that it can't overflow.
+        
+        if ( (maxFileNumber - minFileNumber) < kMFSDirectoryFileNumberTableMaximumSlotCount ) {
+            result = ((size_t) (maxFileNumber - minFileNumber)) + 1;
+            *firstFileNumberPtr = minFileNumber;
+        }
+    }
+    return result;
+}
+
+extern void MFSDirectoryFileNumberTableBuild(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    firstFileNumber,
+    uint32_t                    slots[],
+    size_t                      slotCount
+)
+    // See comments in header.
+{
+    size_t      entryIndex;
+    size_t      slotIndex;
+    
+    assert(index != NULL);
+    assert( (slots != NULL) || (slotCount == 0) );
+    assert(slotCount <= kMFSDirectoryFileNumberTableMaximumSlotCount);
+    
+    if (slotCount != 0) {
+        memset(slots, 0, slotCount * sizeof(*slots));
+
+        // As with the name hash, slots hold the entry index plus one, so that 
+        // zero means "no entry".  Only fill empty slots, so that the first 
+        // entry in directory order wins.
+
+        for (entryIndex = 0; entryIndex < index->entryCount; entryIndex++) {
+            slotIndex = index->fileNumbers[entryIndex] - firstFileNumber;
+            assert(slotIndex < slotCount);
+            if (slots[slotIndex] == 0) {
+                slots[slotIndex] = (uint32_t) (entryIndex + 1);
+            }
+        }
+    }
+}
+
+extern int MFSDirectoryFileNumberTableLookup(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    firstFileNumber,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    uint32_t                    fileNumber,
+    size_t *                    entryIndexPtr
+)
+    // See comments in header.
+{
+    int         err;
+    size_t      entryIndex;
+    
+    assert(index != NULL);
+    assert( (slots != NULL) || (slotCount == 0) );
+    assert(entryIndexPtr != NULL);
+    
+    err = ENOENT;
+    if (slotCount != 0) {
+        // The subtraction wraps for file numbers below firstFileNumber, so the 
+        // one comparison against slotCount catches both ends of the range.
+        
+        if ( ((uint32_t) (fileNumber - firstFileNumber)) < slotCount ) {
+            entryIndex = slots[fileNumber - firstFileNumber];
+            if (entryIndex != 0) {
+                *entryIndexPtr = entryIndex - 1;
+                err = 0;
+            }
+        }
+    } else {
+        // No table, either because the directory is empty or because the 
+        // file numbers are too spread out.  Search the index instead, which 
+        // is still much quicker than iterating through the directory blocks.
+        
+        for (entryIndex = 0; entryIndex < index->entryCount; entryIndex++) {
+            if (index->fileNumbers[entryIndex] == fileNumber) {
+                *entryIndexPtr = entryIndex;
+                err = 0;
+                break;
+            }
+        }
+    }
+    
+    assert( (err != 0) || (*entryIndexPtr < index->entryCount) );
+    assert( (err != 0) || (index->fileNumbers[*entryIndexPtr] == fileNumber) );
+    
+    return err;
+}
+
+/////////////////////////////////////////////////////////////////////
+#pragma mark ***** File Fork Routines
+
+static int MFSForkGetExtentCore(
+    const void *        mdbAndVABMPtr,
+    const uint16_t *    vabmTable,
+    const MFSForkInfo * forkInfo,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+)
+    // The guts of MFSForkGetExtent and MFSForkGetExtentWithVABMTable.  vabmTable 
+    // may be NULL, in which case we use the packed VABM.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    uint32_t                        allocationBlockSizeInBytes;
+    uint16_t                        currentAllocationBlock;
+    uint32_t                        currentForkOffsetInBytes;
+    uint32_t                        contiguousPhysicalBytes;
+
+    // Pre-conditions
+
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(forkInfo != NULL);
     assert(forkInfo->firstAllocationBlock != kMFSLastAllocationBlock);
     assert(forkInfo->firstAllocationBlock <= kMFSMaximumAllocationBlock);
     assert(forkInfo->firstAllocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
@@ -1457,7 +3076,7 @@ extern int MFSForkGetExtent(
             if (forkOffsetInBytes < (currentForkOffsetInBytes + allocationBlockSizeInBytes)) {
                 err = 0;
             } else {
-                currentAllocationBlock = MFSVABMNextAllocationBlock(mdbPtr, currentAllocationBlock);
+                currentAllocationBlock = MFSNextAllocationBlock(mdbPtr, vabmTable, currentAllocationBlock);
                 
                 if (currentAllocationBlock == kMFSLastAllocationBlock) {
                     err = EPIPE;            // that is, end of file
@@ -1482,7 +3101,7 @@ extern int MFSForkGetExtent(
                 assert(currentContiguousAllocationBlock <= kMFSMaximumAllocationBlock);
                 assert(currentContiguousAllocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
 
-                nextContiguousAllocationBlock = MFSVABMNextAllocationBlock(mdbPtr, currentContiguousAllocationBlock);
+                nextContiguousAllocationBlock = MFSNextAllocationBlock(mdbPtr, vabmTable, currentContiguousAllocationBlock);
                 
                 if (nextContiguousAllocationBlock == kMFSLastAllocationBlock) {
                     err = 0;
@@ -1516,3 +3135,684 @@ extern int MFSForkGetExtent(
     
     return err;
 }
+
+extern int MFSForkGetExtent(
+    const void *        mdbAndVABMPtr,
+    const MFSForkInfo * forkInfo,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+)
+    // See comments in header.
+{
+    return MFSForkGetExtentCore(
+        mdbAndVABMPtr, 
+        NULL, 
+        forkInfo, 
+        forkOffsetInBytes, 
+        offsetFromFirstAllocationBlockInBytesPtr, 
+        contiguousPhysicalBytesPtr
+    );
+}
+
+extern int MFSForkGetExtentWithVABMTable(
+    const void *        mdbAndVABMPtr,
+    const uint16_t      vabmTable[],
+    const MFSForkInfo * forkInfo,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+)
+    // See comments in header.
+{
+    assert(vabmTable != NULL);
+
+    return MFSForkGetExtentCore(
+        mdbAndVABMPtr, 
+        vabmTable, 
+        forkInfo, 
+        forkOffsetInBytes, 
+        offsetFromFirstAllocationBlockInBytesPtr, 
+        contiguousPhysicalBytesPtr
+    );
+}
+
+static int MFSForkExtentCursorInitCore(
+    MFSForkExtentCursor *   cursor,
+    const void *            mdbAndVABMPtr,
+    const uint16_t *        vabmTable,
+    const MFSForkInfo *     forkInfo
+)
+    // The guts of MFSForkExtentCursorInit and MFSForkExtentCursorInitWithVABMTable. 
+    // vabmTable may be NULL, in which case we use the packed VABM.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+
+    // Pre-conditions
+
+    assert(cursor != NULL);
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(forkInfo != NULL);
+    assert(forkInfo->firstAllocationBlock != kMFSLastAllocationBlock);
+    assert(forkInfo->firstAllocationBlock <= kMFSMaximumAllocationBlock);
+    assert(forkInfo->firstAllocationBlock < (kMFSFirstAllocationBlock + OSSwapBigToHostInt16(mdbPtr->allocationBlockCount)));
+    assert(forkInfo->lengthInBytes <= forkInfo->physicalLengthInBytes);
+
+    // Implementation
+
+    if (forkInfo->firstAllocationBlock == 0) {
+        assert(forkInfo->lengthInBytes == 0);
+        assert(forkInfo->physicalLengthInBytes == 0);
+        err = EINVAL;                       // asking for the on-disk extents of an empty fork is bogus
+    } else {
+        cursor->mdbAndVABMPtr          = mdbAndVABMPtr;
+        cursor->vabmTable              = vabmTable;
+        cursor->currentAllocationBlock = forkInfo->firstAllocationBlock;
+        cursor->chainLength            = 1;
+        cursor->forkOffsetInBytes      = 0;
+        err = 0;
+    }
+
+    return err;
+}
+
+extern int MFSForkExtentCursorInit(
+    MFSForkExtentCursor *   cursor,
+    const void *            mdbAndVABMPtr,
+    const MFSForkInfo *     forkInfo
+)
+    // See comments in header.
+{
+    return MFSForkExtentCursorInitCore(cursor, mdbAndVABMPtr, NULL, forkInfo);
+}
+
+extern int MFSForkExtentCursorInitWithVABMTable(
+    MFSForkExtentCursor *   cursor,
+    const void *            mdbAndVABMPtr,
+    const uint16_t          vabmTable[],
+    const MFSForkInfo *     forkInfo
+)
+    // See comments in header.
+{
+    assert(vabmTable != NULL);
+
+    return MFSForkExtentCursorInitCore(cursor, mdbAndVABMPtr, vabmTable, forkInfo);
+}
+
+extern int MFSForkExtentCursorNext(
+    MFSForkExtentCursor *   cursor,
+    MFSForkExtent *         extent
+)
+    // See comments in header.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    uint32_t                        allocationBlockSizeInBytes;
+    uint16_t                        allocationBlockCount;
+    uint16_t                        nextAllocationBlock;
+    uint16_t                        runStartAllocationBlock;
+    uint32_t                        runAllocationBlockCount;
+
+    // Pre-conditions
+
+    assert(cursor != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) cursor->mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(extent != NULL);
+
+    // Implementation
+
+    allocationBlockSizeInBytes = OSSwapBigToHostInt32(mdbPtr->allocationBlockSizeInBytes);
+    allocationBlockCount       = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+
+    if (cursor->currentAllocationBlock == kMFSLastAllocationBlock) {
+        err = EPIPE;                        // that is, end of file
+    } else {
+        // Continue the chain from where we left off, coalescing consecutive 
+        // allocation blocks into a run.  The run ends when the next allocation 
+        // block isn't the one immediately after the current one.  We count 
+        // the number of allocation blocks we've visited so that a loop in 
+        // the chain can't send us into an infinite loop.
+
+        runStartAllocationBlock = cursor->currentAllocationBlock;
+        runAllocationBlockCount = 1;
+        do {
+            assert(cursor->currentAllocationBlock != kMFSEmptyAllocationBlock);
+            assert(cursor->currentAllocationBlock != kMFSLastAllocationBlock);
+            assert(cursor->currentAllocationBlock <= kMFSMaximumAllocationBlock);
+            assert(cursor->currentAllocationBlock < (kMFSFirstAllocationBlock + allocationBlockCount));
+
+            nextAllocationBlock = MFSNextAllocationBlock(mdbPtr, cursor->vabmTable, cursor->currentAllocationBlock);
+
+            if (nextAllocationBlock == kMFSLastAllocationBlock) {
+                err = 0;
+            } else {
+                cursor->chainLength += 1;
+                if (cursor->chainLength > allocationBlockCount) {
+                    err = EIO;              // chain is longer than the volume, so it must loop
+                } else if (nextAllocationBlock == (cursor->currentAllocationBlock + 1)) {
+                    runAllocationBlockCount += 1;
+                    err = EAGAIN;
+                } else {
+                    err = 0;
+                }
+            }
+            cursor->currentAllocationBlock = nextAllocationBlock;
+        } while (err == EAGAIN);
+
+        if (err == 0) {
+            extent->forkOffsetInBytes                     = cursor->forkOffsetInBytes;
+            extent->offsetFromFirstAllocationBlockInBytes = (runStartAllocationBlock - kMFSFirstAllocationBlock) * allocationBlockSizeInBytes;
+            extent->contiguousPhysicalBytes               = runAllocationBlockCount * allocationBlockSizeInBytes;
+
+            cursor->forkOffsetInBytes += extent->contiguousPhysicalBytes;
+        }
+    }
+
+    // Post-conditions
+
+    if (err == 0) {
+        assert(extent->contiguousPhysicalBytes != 0);
+    }
+
+    return err;
+}
+
+static int MFSForkGetExtentMapCore(
+    const void *        mdbAndVABMPtr,
+    const uint16_t *    vabmTable,
+    const MFSForkInfo * forkInfo,
+    MFSForkExtent       extents[],
+    size_t              extentsSize,
+    size_t *            extentCountPtr
+)
+    // The guts of MFSForkGetExtentMap and MFSForkGetExtentMapWithVABMTable.  
+    // vabmTable may be NULL, in which case we use the packed VABM.
+{
+    int                     err;
+    MFSForkExtentCursor     cursor;
+    MFSForkExtent           extent;
+    size_t                  extentCount;
+
+    // Pre-conditions
+
+    assert( (extents != NULL) || (extentsSize == 0) );
+    assert(extentCountPtr != NULL);
+
+    // Implementation -- Run a cursor over the fork, storing as many extents 
+    // as will fit and counting the rest.
+
+    extentCount = 0;
+    err = MFSForkExtentCursorInitCore(&cursor, mdbAndVABMPtr, vabmTable, forkInfo);
+    while (err == 0) {
+        err = MFSForkExtentCursorNext(&cursor, &extent);
+        if (err == 0) {
+            if (extentCount < extentsSize) {
+                extents[extentCount] = extent;
+            }
+            extentCount += 1;
+        }
+    }
+    if (err == EPIPE) {
+        err = 0;
+    }
+
+    if (err == 0) {
+        *extentCountPtr = extentCount;
+    }
+
+    // Post-conditions
+
+    if (err == 0) {
+        assert(*extentCountPtr > 0);
+        assert( (extentsSize < *extentCountPtr) || ((extents[0].forkOffsetInBytes == 0) && ((extents[*extentCountPtr - 1].forkOffsetInBytes + extents[*extentCountPtr - 1].contiguousPhysicalBytes) == cursor.forkOffsetInBytes)) );
+    }
+
+    return err;
+}
+
+extern int MFSForkGetExtentMap(
+    const void *        mdbAndVABMPtr,
+    const MFSForkInfo * forkInfo,
+    MFSForkExtent       extents[],
+    size_t              extentsSize,
+    size_t *            extentCountPtr
+)
+    // See comments in header.
+{
+    return MFSForkGetExtentMapCore(mdbAndVABMPtr, NULL, forkInfo, extents, extentsSize, extentCountPtr);
+}
+
+extern int MFSForkGetExtentMapWithVABMTable(
+    const void *        mdbAndVABMPtr,
+    const uint16_t      vabmTable[],
+    const MFSForkInfo * forkInfo,
+    MFSForkExtent       extents[],
+    size_t              extentsSize,
+    size_t *            extentCountPtr
+)
+    // See comments in header.
+{
+    assert(vabmTable != NULL);
+
+    return MFSForkGetExtentMapCore(mdbAndVABMPtr, vabmTable, forkInfo, extents, extentsSize, extentCountPtr);
+}
+
+extern int MFSForkExtentMapLookup(
+    const MFSForkExtent extents[],
+    size_t              extentCount,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+)
+    // See comments in header.
+{
+    int                     err;
+    size_t                  low;
+    size_t                  high;
+    size_t                  mid;
+    const MFSForkExtent *   thisExtent;
+    uint32_t                offsetWithinExtent;
+
+    // Pre-conditions
+
+    assert(extents != NULL);
+    assert(extentCount > 0);
+    assert(extents[0].forkOffsetInBytes == 0);
+    assert(offsetFromFirstAllocationBlockInBytesPtr != NULL);
+    assert(contiguousPhysicalBytesPtr != NULL);
+
+    // Implementation -- Find the last extent whose forkOffsetInBytes is less than 
+    // or equal to forkOffsetInBytes.  extents[low] always satisfies that 
+    // condition and extents[high] (if it exists) never does.
+
+    low  = 0;
+    high = extentCount;
+    while ( (high - low) > 1 ) {
+        mid = low + (high - low) / 2;
+        if (extents[mid].forkOffsetInBytes <= forkOffsetInBytes) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    thisExtent = &extents[low];
+    assert(thisExtent->forkOffsetInBytes <= forkOffsetInBytes);
+
+    // The offset might still be beyond the end of the last extent.
+
+    offsetWithinExtent = forkOffsetInBytes - thisExtent->forkOffsetInBytes;
+    if (offsetWithinExtent >= thisExtent->contiguousPhysicalBytes) {
+        assert(low == (extentCount - 1));
+        err = EPIPE;                        // that is, end of file
+    } else {
+        *offsetFromFirstAllocationBlockInBytesPtr = thisExtent->offsetFromFirstAllocationBlockInBytes + offsetWithinExtent;
+        *contiguousPhysicalBytesPtr               = thisExtent->contiguousPhysicalBytes - offsetWithinExtent;
+        err = 0;
+    }
+
+    // Post-conditions
+
+    if (err == 0) {
+        assert(*contiguousPhysicalBytesPtr != 0);
+    }
+
+    return err;
+}
+
+/////////////////////////////////////////////////////////////////////
+#pragma mark ***** Allocation Map Routines
+
+extern int MFSAllocationMapInit(
+    const void *            mdbAndVABMPtr,
+    MFSAllocationBlockOwner owners[],
+    size_t                  ownersSize
+)
+    // See comments in header.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    size_t                          allocationBlockCount;
+
+    // Pre-conditions
+
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert( (owners != NULL) || (ownersSize == 0) );
+
+    // Implementation
+
+    allocationBlockCount = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+    if (allocationBlockCount > ownersSize) {
+        err = EINVAL;
+    } else {
+        memset(owners, 0, allocationBlockCount * sizeof(*owners));
+        err = 0;
+    }
+
+    return err;
+}
+
+static int MFSAllocationMapAddFork(
+    const MFSMasterDirectoryBlock * mdbPtr,
+    const uint16_t                  vabmTable[],
+    uint32_t                        fileNumber,
+    uint32_t                        forkIndex,
+    uint16_t                        firstAllocationBlock,
+    MFSAllocationBlockOwner         owners[]
+)
+    // Claims every allocation block in the chain starting at firstAllocationBlock 
+    // for the specified fork.  Unlike the fork routines, this doesn't assert 
+    // that the chain is well formed; a bogus VABM entry results in EIO.  It 
+    // doesn't need a chain length counter to guard against loops because a 
+    // loop must, by definition, revisit an allocation block that this fork 
+    // has already claimed.
+{
+    int         err;
+    uint16_t    allocationBlockCount;
+    uint16_t    currentAllocationBlock;
+
+    assert(fileNumber != 0);
+    assert( (forkIndex == 0) || (forkIndex == 1) );
+
+    allocationBlockCount   = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+    currentAllocationBlock = firstAllocationBlock;
+    do {
+        if ( (currentAllocationBlock < kMFSFirstAllocationBlock) || (currentAllocationBlock >= (kMFSFirstAllocationBlock + allocationBlockCount)) ) {
+            err = EIO;                      // chain points to a free or non-existent allocation block
+        } else if (owners[currentAllocationBlock - kMFSFirstAllocationBlock].fileNumber != 0) {
+            err = EIO;                      // allocation block is cross-linked, or the chain loops
+        } else {
+            owners[currentAllocationBlock - kMFSFirstAllocationBlock].fileNumber = fileNumber;
+            owners[currentAllocationBlock - kMFSFirstAllocationBlock].forkIndex  = forkIndex;
+
+            currentAllocationBlock = vabmTable[currentAllocationBlock - kMFSFirstAllocationBlock];
+            if (currentAllocationBlock == kMFSLastAllocationBlock) {
+                err = 0;
+            } else {
+                err = EAGAIN;
+            }
+        }
+    } while (err == EAGAIN);
+
+    return err;
+}
+
+extern int MFSAllocationMapAddDirectoryBlock(
+    const void *            mdbAndVABMPtr,
+    const uint16_t          vabmTable[],
+    const void *            directoryBlockPtr,
+    size_t                  directoryBlockSizeInBytes,
+    MFSAllocationBlockOwner owners[]
+)
+    // See comments in header.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    const MFSDirectoryRecord *      dirRec;
+    size_t                          dirOffset;
+
+    // Pre-conditions
+
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(vabmTable != NULL);
+    assert(directoryBlockPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(owners != NULL);
+
+    // Implementation
+
+    dirOffset = kMFSDirectoryBlockIterateFromStart;
+    do {
+        err = MFSDirectoryBlockIterate(directoryBlockPtr, directoryBlockSizeInBytes, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+        if (err == 0) {
+            dirRec = ((const MFSDirectoryRecord *) (((const char *) directoryBlockPtr) + dirOffset));
+
+            if (OSSwapBigToHostInt32(dirRec->fileNumber) == 0) {
+                err = EIO;                  // 0 is our "free" marker, so it can't be a real file number
+            }
+            if ( (err == 0) && (dirRec->dataFirstAllocationBlock != 0) ) {
+                err = MFSAllocationMapAddFork(mdbPtr, vabmTable, OSSwapBigToHostInt32(dirRec->fileNumber), 0, OSSwapBigToHostInt16(dirRec->dataFirstAllocationBlock), owners);
+            }
+            if ( (err == 0) && (dirRec->rsrcFirstAllocationBlock != 0) ) {
+                err = MFSAllocationMapAddFork(mdbPtr, vabmTable, OSSwapBigToHostInt32(dirRec->fileNumber), 1, OSSwapBigToHostInt16(dirRec->rsrcFirstAllocationBlock), owners);
+            }
+        }
+    } while (err == 0);
+    if (err == ENOENT) {
+        err = 0;
+    }
+
+    return err;
+}
+
+/////////////////////////////////////////////////////////////////////
+#pragma mark ***** Volume Verification
+
+// The visited bitmap used by MFSVolumeVerify.  A chain can only reach 
+// allocation blocks up to kMFSMaximumAllocationBlock, so the bitmap never 
+// needs more than kMFSVolumeVerifyTempBufferSize bytes, regardless of what 
+// the MDB claims for allocationBlockCount.
+
+static boolean_t VisitedTestAndSet(uint8_t *visited, uint16_t allocationBlock)
+    // Marks allocationBlock as visited, returning true if it was already marked.
+{
+    size_t      bitIndex;
+    uint8_t     mask;
+    boolean_t   result;
+    
+    assert(allocationBlock >= kMFSFirstAllocationBlock);
+    assert(allocationBlock <= kMFSMaximumAllocationBlock);
+
+    bitIndex = allocationBlock - kMFSFirstAllocationBlock;
+    mask     = (uint8_t) (1 << (bitIndex % 8));
+    result   = (visited[bitIndex / 8] & mask) != 0;
+    visited[bitIndex / 8] |= mask;
+    return result;
+}
+
+static boolean_t ChainContains(
+    const MFSMasterDirectoryBlock * mdbPtr, 
+    uint16_t                        firstAllocationBlock, 
+    uint32_t                        chainLength, 
+    uint16_t                        allocationBlock
+)
+    // Returns true if allocationBlock is one of the first chainLength allocation 
+    // blocks of the chain starting at firstAllocationBlock.  The caller has 
+    // already checked that that part of the chain is well formed.  We only 
+    // call this when things have gone wrong, to decide whether a revisited 
+    // block is a loop or a cross-link, so its cost doesn't matter.
+{
+    boolean_t   result;
+    uint16_t    currentAllocationBlock;
+    
+    result = FALSE;
+    currentAllocationBlock = firstAllocationBlock;
+    while ( !result && (chainLength > 0) ) {
+        result = (currentAllocationBlock == allocationBlock);
+        chainLength -= 1;
+        if (chainLength > 0) {
+            currentAllocationBlock = MFSVABMGetEntry(mdbPtr, currentAllocationBlock);
+        }
+    }
+    return result;
+}
+
+static void VerifyFork(
+    const MFSMasterDirectoryBlock * mdbPtr,
+    uint32_t                        fileNumber,
+    uint16_t                        firstAllocationBlock,
+    uint32_t                        lengthInBytes,
+    uint32_t                        physicalLengthInBytes,
+    uint8_t *                       visited,
+    MFSVolumeVerifyReport *         report
+)
+    // Walks a fork's allocation block chain, marking each allocation block in 
+    // visited and recording any problems in report.  We stop at the first 
+    // problem, so each fork is counted against at most one problem.
+{
+    uint32_t    allocationBlockCount;
+    uint32_t    allocationBlockSizeInBytes;
+    uint32_t    chainLength;
+    uint16_t    currentAllocationBlock;
+    uint32_t *  problemCountPtr;
+    
+    allocationBlockCount       = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+    allocationBlockSizeInBytes = OSSwapBigToHostInt32(mdbPtr->allocationBlockSizeInBytes);
+
+    report->forkCount += 1;
+    
+    problemCountPtr = NULL;
+    chainLength = 0;
+    currentAllocationBlock = firstAllocationBlock;
+    do {
+        if (  (currentAllocationBlock < kMFSFirstAllocationBlock) 
+           || (currentAllocationBlock > kMFSMaximumAllocationBlock) 
+           || (currentAllocationBlock >= (kMFSFirstAllocationBlock + allocationBlockCount)) ) {
+            problemCountPtr = &report->badChainCount;
+        } else if ( VisitedTestAndSet(visited, currentAllocationBlock) ) {
+            if ( ChainContains(mdbPtr, firstAllocationBlock, chainLength, currentAllocationBlock) ) {
+                problemCountPtr = &report->loopCount;
+            } else {
+                problemCountPtr = &report->crossLinkCount;
+            }
+        } else {
+            report->usedAllocationBlockCount += 1;
+            chainLength += 1;
+            currentAllocationBlock = MFSVABMGetEntry(mdbPtr, currentAllocationBlock);
+        }
+    } while ( (problemCountPtr == NULL) && (currentAllocationBlock != kMFSLastAllocationBlock) );
+    
+    // The chain must cover exactly the fork's physical length, and the logical 
+    // length can't be beyond that.  Comparing in 64 bits avoids any overflow 
+    // in the multiplication.
+    
+    if ( (problemCountPtr == NULL) 
+      && (   (((uint64_t) chainLength * allocationBlockSizeInBytes) != physicalLengthInBytes) 
+          || (lengthInBytes > physicalLengthInBytes) ) ) {
+        problemCountPtr = &report->lengthMismatchCount;
+    }
+    
+    if (problemCountPtr != NULL) {
+        *problemCountPtr += 1;
+        if (report->firstBadFileNumber == 0) {
+            report->firstBadFileNumber = fileNumber;
+        }
+    }
+}
+
+extern int MFSVolumeVerify(
+    const void *            mdbAndVABMPtr,
+    const void *            directoryPtr,
+    size_t                  directoryBlockSizeInBytes,
+    void *                  tempBuffer,
+    MFSVolumeVerifyReport * report
+)
+    // See comments in header.
+{
+    int                             err;
+    const MFSMasterDirectoryBlock * mdbPtr;
+    uint8_t *                       visited;
+    uint16_t                        allocationBlockCount;
+    uint16_t                        directoryBlockCount;
+    uint16_t                        dirBlockIndex;
+    uint16_t                        allocationBlock;
+    
+    // Pre-conditions
+    
+    assert(mdbAndVABMPtr != NULL);
+    mdbPtr = (const MFSMasterDirectoryBlock *) mdbAndVABMPtr;
+    assert( MFSMDBValid(mdbPtr) );
+    assert(directoryPtr != NULL);
+    assert(directoryBlockSizeInBytes > kMFSDirectoryRecordFixedSize);
+    assert(tempBuffer != NULL);
+    assert(report != NULL);
+    
+    // Implementation
+    
+    visited = (uint8_t *) tempBuffer;
+    memset(visited, 0, kMFSVolumeVerifyTempBufferSize);
+    memset(report, 0, sizeof(*report));
+
+    allocationBlockCount = OSSwapBigToHostInt16(mdbPtr->allocationBlockCount);
+    directoryBlockCount  = OSSwapBigToHostInt16(mdbPtr->directoryBlockCount);
+
+    // Walk the chain of every fork of every file in the directory.
+    
+    err = 0;
+    for (dirBlockIndex = 0; dirBlockIndex < directoryBlockCount; dirBlockIndex++) {
+        const char *    directoryBlockPtr;
+        size_t          dirOffset;
+        
+        directoryBlockPtr = ((const char *) directoryPtr) + (dirBlockIndex * directoryBlockSizeInBytes);
+
+        dirOffset = kMFSDirectoryBlockIterateFromStart;
+        do {
+            err = MFSDirectoryBlockIterate(directoryBlockPtr, directoryBlockSizeInBytes, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+            if (err == 0) {
+                const MFSDirectoryRecord *  dirRec;
+                
+                dirRec = (const MFSDirectoryRecord *) (directoryBlockPtr + dirOffset);
+
+                report->fileCount += 1;
+                if (dirRec->dataFirstAllocationBlock != 0) {
+                    VerifyFork(
+                        mdbPtr, 
+                        OSSwapBigToHostInt32(dirRec->fileNumber), 
+                        OSSwapBigToHostInt16(dirRec->dataFirstAllocationBlock), 
+                        OSSwapBigToHostInt32(dirRec->dataLengthInBytes), 
+                        OSSwapBigToHostInt32(dirRec->dataPhysicalLengthInBytes), 
+                        visited, 
+                        report
+                    );
+                }
+                if (dirRec->rsrcFirstAllocationBlock != 0) {
+                    VerifyFork(
+                        mdbPtr, 
+                        OSSwapBigToHostInt32(dirRec->fileNumber), 
+                        OSSwapBigToHostInt16(dirRec->rsrcFirstAllocationBlock), 
+                        OSSwapBigToHostInt32(dirRec->rsrcLengthInBytes), 
+                        OSSwapBigToHostInt32(dirRec->rsrcPhysicalLengthInBytes), 
+                        visited, 
+                        report
+                    );
+                }
+            }
+        } while (err == 0);
+        assert(err == ENOENT);
+    }
+    
+    // Count the free allocation blocks in the VABM.
+    
+    for (allocationBlock = kMFSFirstAllocationBlock; allocationBlock < (kMFSFirstAllocationBlock + allocationBlockCount); allocationBlock++) {
+        if (MFSVABMGetEntry(mdbPtr, allocationBlock) == kMFSEmptyAllocationBlock) {
+            report->freeAllocationBlockCount += 1;
+        }
+    }
+    report->mdbFreeAllocationBlockCount = OSSwapBigToHostInt16(mdbPtr->freeAllocationBlockCount);
+
+    // Decide whether the volume is consistent.  Note that, if every block 
+    // is either free or claimed by exactly one fork, usedAllocationBlockCount 
+    // plus freeAllocationBlockCount must add up to allocationBlockCount.  If 
+    // it's less, there are blocks marked as in use in the VABM that don't 
+    // belong to any fork.
+    
+    if (   (report->badChainCount       != 0) 
+        || (report->loopCount           != 0) 
+        || (report->crossLinkCount      != 0) 
+        || (report->lengthMismatchCount != 0) 
+        || (report->freeAllocationBlockCount != report->mdbFreeAllocationBlockCount) 
+        || ((report->usedAllocationBlockCount + report->freeAllocationBlockCount) != allocationBlockCount) ) {
+        err = EIO;
+    } else {
+        err = 0;
+    }
+    
+    return err;
+}
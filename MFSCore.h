@@ -129,13 +129,17 @@ First checked in.
         MFS master directory block (64 bytes).
     
       o Text Encodings -- MFS stores a name (file and volume) as a Pascal string, 
-        with no associated text encoding.  For simplicity's sake, I assume that 
-        this string is MacRoman.  If you have MFS disks from a Japanese system, 
-        you are out of luck.
+        with no associated text encoding.  Every routine that deals with names 
+        takes an MFSTextEncoding parameter that says how to interpret these 
+        strings.  I support MacRoman, MacCentralEurope and MacCyrillic, that is, 
+        the single byte encodings whose bottom 128 characters are ASCII.  If you 
+        have MFS disks from a Japanese system, you are still out of luck; 
+        MacJapanese is a double byte encoding, which would break a lot of the 
+        assumptions described below.
         
-        If this was production code, I'd allow you to specify the encoding at mount 
-        time.  However, given the paucity of text encoding conversion support within 
-        the kernel, that's just too much work for this sample code.
+        The kernel code always uses MacRoman, because there's no mount option to 
+        choose the encoding.  MFSLivesPseudoMount, and hence MFSLives.util, let you 
+        specify it.
         
         There's a big discussion of how I implement text encoding conversion below.
     
@@ -218,8 +222,11 @@ First checked in.
     
     <http://developer.apple.com/qa/qa2001/qa1173.html>
     
-    As I mentioned above, I assume that all names on MFS volumes are in MacRoman. 
-    As VFS expects to work in UTF-8, I need to be able to:
+    As I mentioned above, names on MFS volumes are in one of a small set of 
+    legacy encodings.  The discussion below talks about MacRoman, but every 
+    supported encoding has its own copy of each table, generated in exactly the 
+    same way, and the code picks the set of tables based on the MFSTextEncoding 
+    parameter.  As VFS expects to work in UTF-8, I need to be able to:
     
      1. convert from UTF-8 (decomposed or precomposed) to MacRoman
      2. convert from MacRoman to UTF-8 (decomposed)
@@ -238,9 +245,14 @@ First checked in.
       o For UTF-8 (decomposed or precomposed) to MacRoman conversion, I first use the 
         kernel routine utf_decodestr to convert the string to precomposed UTF-16. 
         Each valid MacRoman has a unique precomposed UTF-16 value, so I have a 
-        table that maps valid UTF-16 values to their MacRoman equivalents 
-        (kUTF16ToMacRoman).  As the UTF-16 space is huge, this table is sparse, 
-        so I generate a sorted table and binary search it.
+        table that maps valid UTF-16 values to their MacRoman equivalents.  As 
+        the UTF-16 space is huge, this table is sparse, so I split it into two 
+        levels: the high byte of the UTF-16 code point selects a 256 entry page 
+        (kUTF16ToMacRomanPageIndex) and the low byte selects the MacRoman 
+        character within that page (kUTF16ToMacRomanPages).  Only 10 high bytes 
+        have any MacRoman equivalents; all of the others share a single page of 
+        zeros, zero being the 'no equivalent' marker.  So a lookup is two loads, 
+        and the whole thing is less than 3 KB.
     
         This approach means that I don't have to parse UTF-8, or do canonical 
         composition; utf_decodestr takes care of that.  It also means that I don't 
@@ -249,6 +261,10 @@ First checked in.
     
       o For MacRoman to UTF-8 (decomposed) conversion, I simply have a table that 
         maps the MacRoman character to its corresponding UTF-8 (decomposed) string. 
+        Each entry holds the length of the string followed by its (at most 4) 
+        bytes, so the table has a fixed stride and I never need to call strlen. 
+        Runs of ASCII characters, which don't need the table, are found a word 
+        at a time and copied in one go.
         
         One interesting case here is truncation.  If I have to truncate a string, 
         I make sure that I truncate it at a MacRoman boundary.  That is, you either 
@@ -291,6 +307,18 @@ enum {
     kMFSFirstFileInodeName    = 16
 };
 
+// Text encodings -- MFS names carry no encoding information, so the routines that 
+// convert or compare names require you to specify the encoding.  See the "Text 
+// Encodings" discussion above.
+
+enum {
+    kMFSTextEncodingMacRoman         = 0,
+    kMFSTextEncodingMacCentralEurope = 1,
+    kMFSTextEncodingMacCyrillic      = 2,
+    kMFSTextEncodingCount            = 3
+};
+typedef uint32_t MFSTextEncoding;
+
 // Special block numbers -- There's only one, allowing the caller to find the 
 // master directory block (MDB) to pass to MFSMDBCheck.
 
@@ -367,12 +395,15 @@ extern void MFSMDBGetError(
 
 extern int MFSMDBGetAttr(
     const void *        mdbBlockPtr,
+    MFSTextEncoding     encoding,
     struct vfs_attr *   attr
 );
     // Returns information about the MFS volume.
     //
     // mdbBlockPtr is as per MFSMDBCheck.
     //
+    // encoding is the text encoding of the volume name.
+    //
     // attr must not be NULL; it is handled as per the VFS plug-in's vfs_getattr 
     // entry point.
     //
@@ -380,7 +411,7 @@ extern int MFSMDBGetAttr(
     // attributes that are available for the MFS volume, because the cost of 
     // returns those values is trivial.  That is, it (typically) ignores 
     // the f_active field of attr.  The one exception is f_vol_name; because getting 
-    // the volume requires MacRoman to UTF-8 conversion, which is potentially 
+    // the volume requires conversion to UTF-8, which is potentially 
     // time consuming, this routine only returns f_vol_name if you request it.
 
 #define kMFSDirectoryBlockIterateFromStart ((size_t)-1)
@@ -389,6 +420,7 @@ extern int MFSDirectoryBlockIterate(
     const void *        directoryBlockPtr, 
     size_t              directoryBlockSizeInBytes, 
     size_t *            dirOffsetPtr, 
+    MFSTextEncoding     encoding,
     struct vnode_attr * attr
 );
     // Allows you to iterate over every directory entry within an MFS directory block.
@@ -410,6 +442,9 @@ extern int MFSDirectoryBlockIterate(
     // next directory entry within the directory block.  On failure, its 
     // value is unchanged.
     //
+    // encoding is the text encoding of the directory entry names.  It's only 
+    // used if attr is not NULL.
+    //
     // On entry, if attr is NULL, no attributes are returned.  OTOH, if attr is not 
     // NULL then, on success, the directory entry's attributes will be returned 
     // in *attr.  See MFSDirectoryEntryGetAttr for specific details on this.
@@ -431,6 +466,48 @@ extern int MFSDirectoryBlockCheckDirOffset(
     // candidateDirOffset must be less than directoryBlockSizeInBytes.
     //
     // Returns EINVAL if candidateDirOffset is not valid, and 0 otherwise.
+    //
+    // This has to iterate the block from the start, so if you check offsets 
+    // often (for example, to validate a directory seek offset supplied by an 
+    // untrusted client), build an offset bitmap for the block once, using 
+    // MFSDirectoryBlockBuildOffsetBitmap, and check against that instead.
+
+// A directory block offset bitmap records, in one bit per even offset, which 
+// offsets within a directory block are the start of a valid directory entry. 
+// Directory entries always start on an even offset, so the bitmap for a 512 
+// byte block is just 32 bytes.  Checking an offset against the bitmap is a 
+// single bit test, regardless of where the offset falls in the block.
+
+extern size_t MFSDirectoryBlockGetOffsetBitmapSize(size_t directoryBlockSizeInBytes);
+    // Returns the size, in bytes, of the offset bitmap for a directory block of 
+    // the specified size.
+
+extern void MFSDirectoryBlockBuildOffsetBitmap(
+    const void *        directoryBlockPtr, 
+    size_t              directoryBlockSizeInBytes, 
+    uint8_t             bitmap[]
+);
+    // Builds the offset bitmap for a directory block.
+    //
+    // directoryBlockPtr must point to an MFS directory block.  See MFSMDBCheck 
+    // for information on how to locate these.
+    //
+    // directoryBlockSizeInBytes must be the size of that block.
+    //
+    // bitmap must point to a buffer of the size returned by 
+    // MFSDirectoryBlockGetOffsetBitmapSize.  On entry, its contents are ignored.
+
+extern int MFSDirectoryBlockOffsetBitmapCheckDirOffset(
+    const uint8_t       bitmap[], 
+    size_t              directoryBlockSizeInBytes, 
+    size_t              candidateDirOffset
+);
+    // Like MFSDirectoryBlockCheckDirOffset, except that it checks 
+    // candidateDirOffset against an offset bitmap built by 
+    // MFSDirectoryBlockBuildOffsetBitmap, rather than against the directory 
+    // block itself.
+    //
+    // Returns EINVAL if candidateDirOffset is not valid, and 0 otherwise.
 
 enum {
     kMFSDirectoryBlockFindEntryByNameTempBufferSize = MAXPATHLEN
@@ -441,6 +518,7 @@ extern int MFSDirectoryBlockFindEntryByName(
     size_t              directoryBlockSizeInBytes, 
     const char *        utf8Name,
     size_t              utf8NameLen,
+    MFSTextEncoding     encoding,
     void *              tempBuffer,
     size_t *            dirOffsetPtr, 
     struct vnode_attr * attr
@@ -455,7 +533,8 @@ extern int MFSDirectoryBlockFindEntryByName(
     // If you want to search multiple directory blocks for the same name, you 
     // can speed things up by preserving the contents of the temporary buffer 
     // across multilpe calls to this routine.  This routine uses the temporary 
-    // buffer to cache the MacRoman conversion of the UTF-8 name.
+    // buffer to cache the conversion of the UTF-8 name to the volume's encoding, 
+    // so you must pass the same encoding on each of those calls.
     //
     // directoryBlockPtr must point to an MFS directory block.  See MFSMDBCheck 
     // for information on how to locate these.
@@ -467,6 +546,8 @@ extern int MFSDirectoryBlockFindEntryByName(
     //
     // utf8NameLen is the length of that name in bytes.
     //
+    // encoding is the text encoding of the directory entry names.
+    //
     // tempBuffer must point to a buffer of at least 
     // kMFSDirectoryBlockFindEntryByNameTempBufferSize bytes.  See the discussion 
     // above for information about how to set up this buffer.
@@ -482,6 +563,7 @@ extern int MFSDirectoryBlockFindEntryByName(
 extern int MFSDirectoryEntryGetAttr(
     const void *        directoryBlockPtr, 
     size_t              dirOffset, 
+    MFSTextEncoding     encoding,
     struct vnode_attr * attr
 );
     // Gets attributes for an MFS directory entry.
@@ -493,6 +575,9 @@ extern int MFSDirectoryEntryGetAttr(
     // You typically get this by calling (MFSDirectoryBlockIterate or 
     // MFSDirectoryBlockFindEntryByName).
     // 
+    // encoding is the text encoding of the directory entry's name.  It determines 
+    // va_name and va_encoding.
+    //
     // attr must not be NULL; it is handled as per the VFS plug-in's VNOPGetattr 
     // entry point.
     //
@@ -500,7 +585,7 @@ extern int MFSDirectoryEntryGetAttr(
     // attributes that are available for the directory entry, because the cost of 
     // returns those values is trivial.  That is, it (typically) ignores 
     // the va_active field of attr.  The one exception is va_name; because getting 
-    // the directory entry's name requires MacRoman to UTF-8 conversion, which is 
+    // the directory entry's name requires conversion to UTF-8, which is 
     // potentially time consuming, this routine only returns va_name if you request it.
 
 extern int MFSDirectoryEntryGetFinderInfo(
@@ -563,6 +648,369 @@ extern int MFSDirectoryEntryGetForkInfo(
     // forkInfo must not be NULL.  On entry, *forkInfo is ignored.  On success, 
     // *forkInfo contains the fork information.
 
+// The MFSDirectoryEntryInfo structure holds everything about a directory entry, 
+// decoded to host endian, in a compact fixed-size form.  MFSDirectoryBlockDecodeAll 
+// fills in an array of these, one per entry in a directory block, which is a lot 
+// cheaper than calling MFSDirectoryEntryGetAttr, MFSDirectoryEntryGetFinderInfo 
+// and MFSDirectoryEntryGetForkInfo (twice) for each entry.
+//
+// name points to the entry's name, as an MFS name (a Pascal string in the volume's 
+// encoding), within the directory block itself, so it's only valid as long as the 
+// directory block is.  You can pass it directly to MFSNameToUTF8.
+
+struct MFSDirectoryEntryInfo {
+    uint32_t            fileNumber;                 // MFS file number; va_fileid is fileNumber - 1 + kMFSFirstFileInodeName
+    uint16_t            dirOffset;                  // offset of the directory entry within the block
+    uint8_t             attributes;                 // raw MFS attributes; 0x01 means the file is locked
+    uint8_t             reserved;
+    MFSForkInfo         forkInfos[2];               // fork information, indexed by forkIndex (0 is data, 1 is resource)
+    uint32_t            creationDate;               // MFS date/time; see MFSDateTimeToTimeSpec
+    uint32_t            modificationDate;           // ditto
+    uint8_t             finderInfo[16];             // as returned by MFSDirectoryEntryGetFinderInfo
+    const uint8_t *     name;                       // see above
+};
+typedef struct MFSDirectoryEntryInfo MFSDirectoryEntryInfo;
+
+extern size_t MFSDirectoryBlockGetMaximumEntryCount(size_t directoryBlockSizeInBytes);
+    // Returns the maximum number of entries that can fit in a directory block of 
+    // the specified size.  An entries array of this size is always big enough 
+    // for MFSDirectoryBlockDecodeAll.
+
+extern int MFSDirectoryBlockDecodeAll(
+    const void *            directoryBlockPtr, 
+    size_t                  directoryBlockSizeInBytes, 
+    MFSDirectoryEntryInfo   entries[],
+    size_t                  entriesSize,
+    size_t *                entryCountPtr
+);
+    // Decodes every entry in a directory block in one pass.
+    //
+    // directoryBlockPtr must point to an MFS directory block.  See MFSMDBCheck 
+    // for information on how to locate these.
+    //
+    // directoryBlockSizeInBytes must be the size of that block.
+    //
+    // entries may be NULL if entriesSize is 0.  entriesSize is the number of 
+    // elements in the entries array.  On success, the first 
+    // MIN(entriesSize, *entryCountPtr) elements of entries describe the entries 
+    // in the block, in directory order.
+    //
+    // entryCountPtr must not be NULL.  On entry, *entryCountPtr is ignored. 
+    // On success, *entryCountPtr is the number of entries in the block; this 
+    // may be more than entriesSize.
+
+// A directory index holds the interesting bits of every directory entry on the 
+// volume in a set of parallel arrays, one element per entry, in directory order. 
+// You build it once, by calling MFSDirectoryIndexBuild on the entire directory, 
+// and then answer metadata queries from the arrays without having to parse 
+// the directory blocks again.  The arrays live in a single buffer that you 
+// supply; MFSDirectoryIndexGetBufferSize tells you how big it must be.
+//
+// The index doesn't hold the original (that is, not upper cased) name of each 
+// entry.  If you need that, dirBlocks[i] and dirOffsets[i] tell you exactly 
+// where to find the directory entry, and hence its name, without iterating.
+
+struct MFSDirectoryIndex {
+    MFSTextEncoding encoding;                   // encoding of the names, as passed to MFSDirectoryIndexBuild
+    size_t          entryCount;                 // number of elements in each of the arrays below
+    uint32_t *      fileNumbers;                // MFS file number
+    uint16_t *      dirBlocks;                  // block that holds the directory entry; same units as directoryStartBlock
+    uint16_t *      dirOffsets;                 // offset of the directory entry within that block
+    uint8_t *       attributes;                 // raw MFS attributes; 0x01 means the file is locked
+    uint32_t *      upperNameOffsets;           // offset within upperNames of the entry's name
+    uint8_t *       upperNames;                 // packed Pascal strings, upper cased by MFSNameToUpper
+    MFSForkInfo *   forkInfos[2];               // fork information, indexed by forkIndex (0 is data, 1 is resource)
+    uint32_t *      creationDates;              // MFS date/time; see MFSDateTimeToTimeSpec
+    uint32_t *      modificationDates;          // ditto
+    uint8_t *       finderInfos;                // 16 bytes per entry; see MFSDirectoryEntryGetFinderInfo
+};
+typedef struct MFSDirectoryIndex MFSDirectoryIndex;
+
+extern size_t MFSDirectoryIndexGetBufferSize(
+    uint16_t            directoryBlockCount,
+    size_t              directoryBlockSizeInBytes
+);
+    // Returns the size of the buffer that you must pass to MFSDirectoryIndexBuild 
+    // for a directory of the specified size.  This is a worst case, based on 
+    // packing directory blocks full of entries with the shortest possible names, 
+    // so it's always big enough.
+    //
+    // directoryBlockCount is the number of directory blocks, as returned by 
+    // MFSMDBCheck.
+    //
+    // directoryBlockSizeInBytes must be the size of each directory block.
+
+extern int MFSDirectoryIndexBuild(
+    const void *        directoryPtr,
+    uint16_t            directoryStartBlock,
+    uint16_t            directoryBlockCount,
+    size_t              directoryBlockSizeInBytes,
+    MFSTextEncoding     encoding,
+    void *              buffer,
+    size_t              bufferSize,
+    MFSDirectoryIndex * index
+);
+    // Builds a directory index in one pass over the directory.
+    //
+    // directoryPtr must point to the entire directory, laid out contiguously, 
+    // as described for MFSVolumeVerify.
+    //
+    // directoryStartBlock and directoryBlockCount must be the values returned 
+    // by MFSMDBCheck.  directoryStartBlock is only used to fill in the 
+    // dirBlocks array.
+    //
+    // directoryBlockSizeInBytes must be the size of each directory block.
+    //
+    // encoding is the text encoding of the directory entry names.  The index 
+    // records it, and the name hash routines use it to convert and upper case 
+    // names.
+    //
+    // buffer must point to bufferSize bytes of memory, aligned for a uint32_t. 
+    // bufferSize must be at least the value returned by 
+    // MFSDirectoryIndexGetBufferSize.  The index's arrays point into this 
+    // buffer, so it must remain valid for as long as you use the index.
+    //
+    // index must not be NULL.  On entry, *index is ignored.  On success, 
+    // *index describes every entry in the directory.
+    //
+    // Returns 0 on success, or EINVAL if bufferSize is too small.
+
+// A directory name hash is an open addressing (linear probing) hash table over 
+// the upper cased names in a directory index.  It lets you find a directory 
+// entry by name, or determine that there's no such entry, with an expected 
+// constant number of probes, regardless of the size of the directory.  The 
+// table is just an array of slots, which you supply; each slot is either 0 
+// (empty) or 1 plus the index of a directory index entry.  The table is never 
+// more than half full, so an unsuccessful lookup terminates quickly.
+
+extern size_t MFSDirectoryNameHashGetSlotCount(size_t entryCount);
+    // Returns the number of slots needed to hash a directory index with 
+    // entryCount entries.  The result is always a power of two.
+
+extern void MFSDirectoryNameHashBuild(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    slots[],
+    size_t                      slotCount
+);
+    // Builds a name hash for a directory index.
+    //
+    // index must have been built by MFSDirectoryIndexBuild.
+    //
+    // slots must point to an array of slotCount elements, and slotCount must 
+    // be the value returned by MFSDirectoryNameHashGetSlotCount for 
+    // index->entryCount.  On entry, the contents of slots is ignored.
+    //
+    // If more than one directory entry has the same (upper cased) name, 
+    // lookups find the first one in directory order, which is what you'd get 
+    // by searching the directory with MFSDirectoryBlockFindEntryByName.
+
+extern int MFSDirectoryNameHashLookup(
+    const MFSDirectoryIndex *   index,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    const uint8_t *             mfsNameUpper,
+    size_t *                    entryIndexPtr
+);
+    // Looks up a name in a directory name hash.
+    //
+    // index, slots and slotCount must be as passed to MFSDirectoryNameHashBuild.
+    //
+    // mfsNameUpper must be an MFS name (a Pascal string in index->encoding) that's 
+    // been upper cased by MFSNameToUpper.
+    //
+    // entryIndexPtr must not be NULL.  On success, *entryIndexPtr is the index 
+    // of the matching entry in the directory index.
+    //
+    // Returns 0 on success, or ENOENT if there's no entry with that name.
+
+extern int MFSDirectoryNameHashLookupUTF8(
+    const MFSDirectoryIndex *   index,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    const char *                utf8Name,
+    size_t                      utf8NameLen,
+    void *                      tempBuffer,
+    size_t *                    entryIndexPtr
+);
+    // Like MFSDirectoryNameHashLookup, except that it takes a UTF-8 name, like 
+    // MFSDirectoryBlockFindEntryByName.  tempBuffer must point to a temporary 
+    // buffer of kMFSDirectoryBlockFindEntryByNameTempBufferSize bytes.  Returns 
+    // EINVAL if the name can't be represented as an MFS name, or is empty.
+
+// A directory name cache holds the UTF-8 name of each entry in a directory index. 
+// Directory listings convert the same names over and over again, and MFS names 
+// never change (the volume is read-only), so it makes sense to convert each name 
+// just once.  The cache is a single arena with a slot for each entry that's big 
+// enough for the worst case UTF-8 expansion of that entry's name, so filling in 
+// a name never moves any other name, and thus names are filled in lazily, the 
+// first time someone asks for them.  The cache never needs to be invalidated.
+//
+// The cache lives in a single buffer that you supply; 
+// MFSDirectoryNameCacheGetBufferSize tells you how big it must be.  The MFS core 
+// does no locking, so if you use the cache from multiple threads you must 
+// serialise calls to MFSDirectoryNameCacheGetName.
+//
+// The cache is optional.  Because every slot is sized for the worst case, the 
+// buffer is several times the size of the names it holds, so it's only worth 
+// having if you expect to list the directory repeatedly.  The MFSLives KEXT 
+// only uses it if the volume is mounted with the name cache option (-n), and 
+// otherwise converts each name as it goes, using MFSDirectoryBlockIterate or 
+// MFSDirectoryEntryGetAttr.
+
+struct MFSDirectoryNameCache {
+    const MFSDirectoryIndex *   index;                      // as passed to MFSDirectoryNameCacheInit
+    const void *                directoryPtr;               // ditto
+    uint16_t                    directoryStartBlock;        // ditto
+    size_t                      directoryBlockSizeInBytes;  // ditto
+    uint32_t *                  utf8NameOffsets;            // offset within utf8Names of each entry's slot
+    uint16_t *                  utf8NameLengths;            // length of each entry's UTF-8 name, or 
+                                                            // kMFSDirectoryNameCacheNotConverted
+    char *                      utf8Names;                  // the arena; each name is null terminated
+};
+typedef struct MFSDirectoryNameCache MFSDirectoryNameCache;
+
+enum {
+    kMFSDirectoryNameCacheNotConverted = 0xFFFF
+};
+
+extern size_t MFSDirectoryNameCacheGetBufferSize(const MFSDirectoryIndex *index);
+    // Returns the size of the buffer that you must pass to MFSDirectoryNameCacheInit 
+    // for the specified directory index.
+    //
+    // index must have been built by MFSDirectoryIndexBuild.
+
+extern int MFSDirectoryNameCacheInit(
+    const MFSDirectoryIndex *   index,
+    const void *                directoryPtr,
+    uint16_t                    directoryStartBlock,
+    size_t                      directoryBlockSizeInBytes,
+    void *                      buffer,
+    size_t                      bufferSize,
+    MFSDirectoryNameCache *     cache
+);
+    // Sets up an empty name cache for a directory index.  This doesn't convert 
+    // any names.
+    //
+    // index must have been built by MFSDirectoryIndexBuild.
+    //
+    // directoryPtr, directoryStartBlock and directoryBlockSizeInBytes must be as 
+    // passed to MFSDirectoryIndexBuild.  The cache uses them to find the original 
+    // (that is, not upper cased) name of each entry, so directoryPtr must remain 
+    // valid for as long as you use the cache.
+    //
+    // buffer must point to bufferSize bytes of memory, aligned for a uint32_t. 
+    // bufferSize must be at least the value returned by 
+    // MFSDirectoryNameCacheGetBufferSize.  The cache lives in this buffer, so it 
+    // must remain valid for as long as you use the cache.
+    //
+    // cache must not be NULL.  On entry, *cache is ignored.  On success, *cache 
+    // is an empty cache.
+    //
+    // Returns 0 on success, or EINVAL if bufferSize is too small.
+
+extern const char * MFSDirectoryNameCacheGetName(
+    MFSDirectoryNameCache *     cache,
+    size_t                      entryIndex,
+    size_t *                    utf8NameLenPtr
+);
+    // Returns the UTF-8 name (decomposed, null terminated) of an entry in the 
+    // directory index, converting it (using the index's encoding) if this is the 
+    // first time it's been requested.  The result points into the cache's buffer.
+    //
+    // cache must have been set up by MFSDirectoryNameCacheInit.
+    //
+    // entryIndex must be less than the index's entryCount.
+    //
+    // utf8NameLenPtr may be NULL.  If it's not, *utf8NameLenPtr is set to the 
+    // length of the name, not including the null terminator.
+
+extern int MFSDirectoryIndexFindEntry(
+    const MFSDirectoryIndex *   index,
+    uint16_t                    dirBlock,
+    size_t                      dirOffset,
+    size_t *                    entryIndexPtr
+);
+    // Finds the directory index entry for the directory entry at dirOffset within 
+    // dirBlock (in the same units as the index's dirBlocks array).  The index is 
+    // in directory order, so this is a binary search.
+    //
+    // entryIndexPtr must not be NULL.  On success, *entryIndexPtr is the index 
+    // of the entry.
+    //
+    // Returns 0 on success, or ENOENT if there's no such entry.
+
+// A directory file number table maps an MFS file number to the index of its 
+// entry in a directory index.  MFS allocates file numbers sequentially (from 
+// the MDB's next file number field), so the file numbers in use on a volume 
+// are densely packed and a flat array, indexed by file number, makes lookups 
+// a single array access.
+//
+// The table covers the range from the smallest to the largest file number in 
+// the directory.  A corrupt directory entry could make that range absurdly 
+// large, so MFSDirectoryFileNumberTableGetSlotCount refuses to go beyond 
+// kMFSDirectoryFileNumberTableMaximumSlotCount slots.  In that case it 
+// returns 0, and MFSDirectoryFileNumberTableLookup falls back to searching 
+// the index's fileNumbers array.
+
+enum {
+    kMFSDirectoryFileNumberTableMaximumSlotCount = 65536
+};
+
+extern size_t MFSDirectoryFileNumberTableGetSlotCount(
+    const MFSDirectoryIndex *   index, 
+    uint32_t *                  firstFileNumberPtr
+);
+    // Returns the number of slots needed for a file number table for index, 
+    // or 0 if no table is needed (the directory is empty) or the range of 
+    // file numbers is too large (see above).
+    //
+    // index must have been built by MFSDirectoryIndexBuild.
+    //
+    // firstFileNumberPtr must not be NULL.  On return, *firstFileNumberPtr 
+    // is the file number corresponding to the first slot.
+
+extern void MFSDirectoryFileNumberTableBuild(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    firstFileNumber,
+    uint32_t                    slots[],
+    size_t                      slotCount
+);
+    // Builds a file number table for a directory index.
+    //
+    // index must have been built by MFSDirectoryIndexBuild.
+    //
+    // firstFileNumber and slotCount must be the values returned by 
+    // MFSDirectoryFileNumberTableGetSlotCount.
+    //
+    // slots must point to an array of slotCount elements; it may be NULL if 
+    // slotCount is 0.  On entry, the contents of slots is ignored.
+    //
+    // If more than one directory entry has the same file number, lookups 
+    // find the first one in directory order, which is what you'd get by 
+    // iterating through the directory.
+
+extern int MFSDirectoryFileNumberTableLookup(
+    const MFSDirectoryIndex *   index,
+    uint32_t                    firstFileNumber,
+    const uint32_t              slots[],
+    size_t                      slotCount,
+    uint32_t                    fileNumber,
+    size_t *                    entryIndexPtr
+);
+    // Looks up a file number in a directory file number table.
+    //
+    // index, firstFileNumber, slots and slotCount must be as passed to 
+    // MFSDirectoryFileNumberTableBuild.
+    //
+    // fileNumber is the MFS file number to look up.  Note that this is not 
+    // the same as the va_fileid returned by MFSDirectoryEntryGetAttr; see 
+    // kMFSFirstFileInodeName.
+    //
+    // entryIndexPtr must not be NULL.  On success, *entryIndexPtr is the index 
+    // of the matching entry in the directory index.
+    //
+    // Returns 0 on success, or ENOENT if there's no entry with that file number.
+
 extern int MFSForkGetExtent(
     const void *        mdbAndVABMPtr,
     const MFSForkInfo * forkInfo,
@@ -603,17 +1051,350 @@ extern int MFSForkGetExtent(
     //
     // You can use this routine to find all of a fork's data by setting 
     // forkOffset 0, calling this routine to get the first extent, then 
-    // adding contiguousPhysicalBytes to forkOffset, and repeating the call. 
+    // adding contiguousPhysicalBytes to forkOffset, and repeating the call.
     // When you get EPIPE, you have all of the extents.
+    //
+    // IMPORTANT
+    // Each call walks the fork's allocation block chain from the start, so
+    // the loop described above is quadratic in the length of the chain.  If
+    // you need more than one extent of a fork, build an extent map (using
+    // MFSForkGetExtentMap) and look the extents up in that.
+
+// The MFSForkExtent structure describes one run of physically contiguous
+// allocation blocks within a fork.  An extent map is an array of these,
+// sorted by forkOffsetInBytes, that covers the entire fork.
+//
+// forkOffsetInBytes is the offset within the fork of the first byte of
+// the run; this is the sum of the contiguousPhysicalBytes of all of the
+// previous runs.
+//
+// offsetFromFirstAllocationBlockInBytes and contiguousPhysicalBytes have
+// the same meaning as the equivalent MFSForkGetExtent parameters.
+
+struct MFSForkExtent {
+    uint32_t            forkOffsetInBytes;
+    uint32_t            offsetFromFirstAllocationBlockInBytes;
+    uint32_t            contiguousPhysicalBytes;
+};
+typedef struct MFSForkExtent MFSForkExtent;
+
+extern int MFSForkGetExtentMap(
+    const void *        mdbAndVABMPtr,
+    const MFSForkInfo * forkInfo,
+    MFSForkExtent       extents[],
+    size_t              extentsSize,
+    size_t *            extentCountPtr
+);
+    // Builds an extent map for a fork by walking its allocation block chain once.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // forkInfo must be a pointer to the fork's information, as returned
+    // by MFSDirectoryEntryGetForkInfo.
+    //
+    // extents may be NULL if extentsSize is 0.
+    //
+    // extentsSize is the number of entries available in the extents array.
+    // A fork can never have more extents than it has allocation blocks, so
+    // forkInfo->physicalLengthInBytes divided by the allocation block size
+    // is always big enough for a well formed volume.
+    //
+    // extentCountPtr must not be NULL.  On entry, *extentCountPtr is ignored.
+    // On success, *extentCountPtr is the number of extents in the fork; this
+    // may be more than extentsSize, in which case only the first extentsSize
+    // entries of extents are valid and you should call again with a bigger
+    // array.
+    //
+    // Returns 0 on success, EINVAL if you try to get the extents of a non-
+    // existant fork (that is, one whose forkInfo->lengthInBytes is 0), or
+    // EIO if the allocation block chain is longer than the volume (that is,
+    // it contains a loop).
+
+extern int MFSForkExtentMapLookup(
+    const MFSForkExtent extents[],
+    size_t              extentCount,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+);
+    // Returns information about the location of a fork on disk using an
+    // extent map built by MFSForkGetExtentMap.  This does a binary search
+    // of the map, so its cost is logarithmic in the number of extents.
+    //
+    // extents and extentCount must describe an entire extent map, as returned
+    // by MFSForkGetExtentMap.
+    //
+    // forkOffsetInBytes is the offset into the fork whose location you
+    // wish to obtain.  Unlike MFSForkGetExtent, this need not be a multiple
+    // of the allocation block size.
+    //
+    // offsetFromFirstAllocationBlockInBytesPtr and contiguousPhysicalBytesPtr
+    // must not be NULL.  On success, they are set as per MFSForkGetExtent,
+    // except that they describe the byte at forkOffsetInBytes and the bytes
+    // that follow it (rather than the allocation block containing that byte).
+    //
+    // Returns 0 on success, or EPIPE if forkOffsetInBytes is beyond the end
+    // of the fork.
+
+// The VABM is stored on disk as packed 12 bit entries, which makes each step 
+// of a chain walk a handful of shifts and masks on unaligned bytes.  If you're 
+// going to walk a lot of chains (for example, when building extent maps for 
+// every fork on the volume), it's faster to decode the VABM once into a table 
+// of native 16 bit entries, and then pass that table to the ...WithVABMTable 
+// variants of the fork routines.
+
+extern int MFSVABMDecode(
+    const void *        mdbAndVABMPtr,
+    uint16_t            vabmTable[],
+    size_t              vabmTableSize
+);
+    // Decodes the VABM into a table of native endian 16 bit entries.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // vabmTable may be NULL if vabmTableSize is 0.
+    //
+    // vabmTableSize is the number of entries available in the vabmTable 
+    // array.  This must be at least the volume's allocation block count. 
+    // Every three bytes of VABM hold two entries, so 
+    // ((mdbAndVABMSizeInBytes - 64) / 3 * 2) entries, where 
+    // mdbAndVABMSizeInBytes is the value returned by MFSMDBCheck, is 
+    // always big enough.
+    //
+    // On success, vabmTable[i] is the VABM entry for allocation block 
+    // i + 2 (the first allocation block on an MFS volume is numbered 2). 
+    // Entries beyond the allocation block count are not touched.
+    //
+    // Returns 0 on success, or EINVAL if vabmTableSize is too small.
+
+extern int MFSForkGetExtentWithVABMTable(
+    const void *        mdbAndVABMPtr,
+    const uint16_t      vabmTable[],
+    const MFSForkInfo * forkInfo,
+    uint32_t            forkOffsetInBytes,
+    uint32_t *          offsetFromFirstAllocationBlockInBytesPtr,
+    uint32_t *          contiguousPhysicalBytesPtr
+);
+extern int MFSForkGetExtentMapWithVABMTable(
+    const void *        mdbAndVABMPtr,
+    const uint16_t      vabmTable[],
+    const MFSForkInfo * forkInfo,
+    MFSForkExtent       extents[],
+    size_t              extentsSize,
+    size_t *            extentCountPtr
+);
+    // These are equivalent to MFSForkGetExtent and MFSForkGetExtentMap, 
+    // except that they walk the allocation block chain using a table 
+    // decoded by MFSVABMDecode rather than the packed VABM.  vabmTable 
+    // must not be NULL, and must have been decoded from the VABM at 
+    // mdbAndVABMPtr.
+
+// An extent cursor lets you walk a fork's extents in order without allocating 
+// any memory.  Each call to MFSForkExtentCursorNext picks up the allocation 
+// block chain where the previous call left off, so walking an entire fork 
+// costs one pass over its chain.  This is the best way to stream a fork from 
+// start to finish; if you need random access, build an extent map instead.
+//
+// The fields of MFSForkExtentCursor are private; they're only declared here 
+// so that you can allocate a cursor on the stack.  A cursor holds on to the 
+// mdbAndVABMPtr and vabmTable you pass to the init routine, so those must 
+// remain valid for as long as you use it.
+
+struct MFSForkExtentCursor {
+    const void *        mdbAndVABMPtr;
+    const uint16_t *    vabmTable;
+    uint16_t            currentAllocationBlock;
+    uint32_t            chainLength;
+    uint32_t            forkOffsetInBytes;
+};
+typedef struct MFSForkExtentCursor MFSForkExtentCursor;
+
+extern int MFSForkExtentCursorInit(
+    MFSForkExtentCursor *   cursor,
+    const void *            mdbAndVABMPtr,
+    const MFSForkInfo *     forkInfo
+);
+extern int MFSForkExtentCursorInitWithVABMTable(
+    MFSForkExtentCursor *   cursor,
+    const void *            mdbAndVABMPtr,
+    const uint16_t          vabmTable[],
+    const MFSForkInfo *     forkInfo
+);
+    // Initialises an extent cursor so that the first call to 
+    // MFSForkExtentCursorNext returns the first extent of the fork.  The 
+    // ...WithVABMTable variant walks the chain using a table decoded by 
+    // MFSVABMDecode rather than the packed VABM.
+    //
+    // cursor must not be NULL.  On entry, *cursor is ignored.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // vabmTable must not be NULL, and must have been decoded from the VABM 
+    // at mdbAndVABMPtr.
+    //
+    // forkInfo must be a pointer to the fork's information, as returned
+    // by MFSDirectoryEntryGetForkInfo.  The cursor doesn't hold on to it.
+    //
+    // Returns 0 on success, or EINVAL if the fork is empty (that is, 
+    // forkInfo->lengthInBytes is 0).
+
+extern int MFSForkExtentCursorNext(
+    MFSForkExtentCursor *   cursor,
+    MFSForkExtent *         extent
+);
+    // Returns the next extent of the fork.
+    //
+    // cursor must have been initialised by one of the MFSForkExtentCursorInit 
+    // routines.
+    //
+    // extent must not be NULL.  On entry, *extent is ignored.  On success, 
+    // *extent describes the next run of physically contiguous allocation 
+    // blocks, exactly like the corresponding entry in an extent map built 
+    // by MFSForkGetExtentMap.
+    //
+    // Returns 0 on success, EPIPE if there are no more extents, or EIO if 
+    // the allocation block chain is longer than the volume (that is, it 
+    // contains a loop).
+
+// An allocation map is the reverse of the VABM: for each allocation block it 
+// records which fork of which file owns that block.  It's indexed the same 
+// way as a table built by MFSVABMDecode, that is, owners[i] describes 
+// allocation block i + 2.  You build one by calling MFSAllocationMapInit and 
+// then calling MFSAllocationMapAddDirectoryBlock for each directory block. 
+// This visits each directory entry once and each allocation block at most 
+// once, after which finding the owner of an allocation block is just an 
+// array index.
+
+struct MFSAllocationBlockOwner {
+    uint32_t            fileNumber;         // MFS file number; 0 if the allocation block is free
+    uint32_t            forkIndex;          // 0 for the data fork, 1 for the resource fork
+};
+typedef struct MFSAllocationBlockOwner MFSAllocationBlockOwner;
+
+extern int MFSAllocationMapInit(
+    const void *            mdbAndVABMPtr,
+    MFSAllocationBlockOwner owners[],
+    size_t                  ownersSize
+);
+    // Initialises an allocation map, marking every allocation block as free.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // owners may be NULL if ownersSize is 0.
+    //
+    // ownersSize is the number of entries available in the owners array.  The 
+    // sizing rules are the same as for the vabmTableSize parameter of 
+    // MFSVABMDecode.
+    //
+    // Returns 0 on success, or EINVAL if ownersSize is too small.
+
+extern int MFSAllocationMapAddDirectoryBlock(
+    const void *            mdbAndVABMPtr,
+    const uint16_t          vabmTable[],
+    const void *            directoryBlockPtr,
+    size_t                  directoryBlockSizeInBytes,
+    MFSAllocationBlockOwner owners[]
+);
+    // Adds the allocation blocks of every fork of every file in a directory 
+    // block to an allocation map.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // vabmTable must not be NULL, and must have been decoded from the VABM 
+    // at mdbAndVABMPtr by MFSVABMDecode.
+    //
+    // directoryBlockPtr must point to an MFS directory block.  See MFSMDBCheck 
+    // for information on how to locate these.
+    //
+    // directoryBlockSizeInBytes must be the size of that block.
+    //
+    // owners must not be NULL, and must have been initialised by 
+    // MFSAllocationMapInit.
+    //
+    // Returns 0 on success, or EIO if a fork's allocation block chain refers to 
+    // an allocation block that's free, that doesn't exist, or that's already 
+    // owned by some fork (that is, the chain loops or is cross-linked).  The 
+    // latter can happen across calls, so the order in which you add directory 
+    // blocks determines which fork gets blamed.  If this fails, owners is left 
+    // partially updated.
+
+// The MFSVolumeVerifyReport structure describes the result of verifying a volume 
+// with MFSVolumeVerify.  The problem counts count forks, not allocation blocks; 
+// a fork with a problem is counted against the first problem found in its 
+// chain, and the rest of its chain is not checked.
+
+struct MFSVolumeVerifyReport {
+    uint32_t    fileCount;                      // number of directory entries
+    uint32_t    forkCount;                      // number of non-empty forks
+    uint32_t    usedAllocationBlockCount;       // allocation blocks claimed by some fork
+    uint32_t    freeAllocationBlockCount;       // allocation blocks that are free according to the VABM
+    uint32_t    mdbFreeAllocationBlockCount;    // allocation blocks that are free according to the MDB
+    uint32_t    badChainCount;                  // forks whose chain runs into a free, reserved or non-existent allocation block
+    uint32_t    loopCount;                      // forks whose chain loops back on itself
+    uint32_t    crossLinkCount;                 // forks whose chain runs into an allocation block owned by another fork
+    uint32_t    lengthMismatchCount;            // forks whose chain length disagrees with their physical length
+    uint32_t    firstBadFileNumber;             // file number of the first file with a problem fork, or 0
+};
+typedef struct MFSVolumeVerifyReport MFSVolumeVerifyReport;
+
+enum {
+    kMFSVolumeVerifyTempBufferSize = 512
+};
+
+extern int MFSVolumeVerify(
+    const void *            mdbAndVABMPtr,
+    const void *            directoryPtr,
+    size_t                  directoryBlockSizeInBytes,
+    void *                  tempBuffer,
+    MFSVolumeVerifyReport * report
+);
+    // Checks the allocation structures of an MFS volume.  This walks every fork's 
+    // allocation block chain exactly once, marking each allocation block it visits 
+    // in a bitmap, and checks for:
+    //
+    // o chains that run into a free, reserved or non-existent allocation block
+    // o chains that loop
+    // o allocation blocks that are claimed by more than one fork
+    // o chains whose length disagrees with the fork's physical length
+    // o a free allocation block count in the MDB that disagrees with the VABM
+    // o allocation blocks that are in use but not claimed by any fork
+    //
+    // Unlike the other routines in this module, this does not assume that the 
+    // VABM is well formed; it's designed to be run on untrusted volumes.  It 
+    // does, however, assume that the directory blocks themselves are well 
+    // formed, as determined by MFSDirectoryBlockIterate.  If a volume passes 
+    // this check, it's safe to use the fork routines on any of its forks.
+    //
+    // mdbAndVABMPtr must be a pointer to the combined MDB and VABM, as
+    // described for MFSForkGetExtent.
+    //
+    // directoryPtr must point to the entire directory, that is, the 
+    // directory block count directory blocks starting at the directory 
+    // start block (both as returned by MFSMDBCheck), laid out contiguously.
+    //
+    // directoryBlockSizeInBytes must be the size of each directory block.
+    //
+    // tempBuffer must point to kMFSVolumeVerifyTempBufferSize bytes of memory; 
+    // this is used to hold the bitmap of visited allocation blocks.
+    //
+    // report must not be NULL.  On entry, *report is ignored.  On return, 
+    // *report describes the state of the volume.
+    //
+    // Returns 0 if the volume is consistent, or EIO otherwise.
 
 enum {
     kUTF8ToMFSNameTempBufferSize = 255 * sizeof(uint16_t)
 };
 
-extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, void *tempBuffer, uint8_t *mfsName);
-extern size_t  MFSNameToUTF8(const uint8_t *name, char *utf8Name, size_t utf8NameSize);
-extern void MFSNameToUpper(uint8_t *mfsName);
-extern boolean_t MFSNameEqualToUpper(const uint8_t *mfsName, const uint8_t *mfsNameUpper);
+extern errno_t UTF8ToMFSName(const char *utf8Name, size_t utf8NameLen, MFSTextEncoding encoding, void *tempBuffer, uint8_t *mfsName);
+extern size_t  MFSNameToUTF8(const uint8_t *name, MFSTextEncoding encoding, char *utf8Name, size_t utf8NameSize);
+extern void MFSNameToUpper(uint8_t *mfsName, MFSTextEncoding encoding);
+extern boolean_t MFSNameEqualToUpper(const uint8_t *mfsName, const uint8_t *mfsNameUpper, MFSTextEncoding encoding);
 extern struct timespec MFSDateTimeToTimeSpec(uint32_t mfsDateTime);
     // These are exported purely for the benefit of the test engine.  Thus, the comments 
     // are attached to the implementation.
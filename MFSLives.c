@@ -354,6 +354,9 @@ struct FSMount {
     uint32_t        fMagic;                     // [1] must be kFSMountMagic
     boolean_t       fForceMount;                // [1] copied from MFSLivesMountArgs; see "MFSLivesMountArgs.h" for details
     boolean_t       fForceFailure;              // [1] copied from MFSLivesMountArgs; see "MFSLivesMountArgs.h" for details
+    boolean_t       fNameCacheEnabled;          // [1] copied from MFSLivesMountArgs; if false, the fNameCache fields are unused
+    MFSTextEncoding fEncoding;                  // [1] text encoding of the names on the volume; there's no mount 
+                                                //     argument for this, so it's always MacRoman
     mount_t         fMountPoint;                // [1] back pointer to the mount_t
     dev_t           fBlockRDevNum;              // [1] raw dev_t of the device we're mounted on
     vnode_t         fBlockDevVNode;             // [1] a vnode for the above; we have a use count reference on this
@@ -373,6 +376,27 @@ struct FSMount {
 
     void *          fMDBVABM;                   // [1] a pointer to a buffer that holds the MDB/VABM;
                                                 //     its size is fMDBAndVABMSizeInBytes
+    uint16_t *      fVABMTable;                 // [1] the VABM, as decoded by MFSVABMDecode
+    size_t          fVABMTableSize;             // [1] number of entries in fVABMTable
+
+    void *          fDirectory;                 // [1] a copy of the entire directory; 
+                                                //     its size is fDirectoryBlockCount * fBlockDevBlockSize
+    void *          fDirectoryIndexBuffer;      // [1] memory for fDirectoryIndex
+    size_t          fDirectoryIndexBufferSize;  // [1] size of the above
+    MFSDirectoryIndex fDirectoryIndex;          // [1] built by MFSDirectoryIndexBuild from fDirectory
+    uint32_t *      fNameHashSlots;             // [1] built by MFSDirectoryNameHashBuild from fDirectoryIndex
+    size_t          fNameHashSlotCount;         // [1] number of entries in the above
+    uint32_t *      fFileNumberTableSlots;      // [1] built by MFSDirectoryFileNumberTableBuild from fDirectoryIndex; 
+                                                //     may be NULL, in which case the lookup searches fDirectoryIndex
+    size_t          fFileNumberTableSlotCount;  // [1] number of entries in the above
+    uint32_t        fFileNumberTableFirst;      // [1] file number of the first entry in the above
+    uint8_t *       fDirOffsetBitmaps;          // [1] an offset bitmap (see MFSDirectoryBlockBuildOffsetBitmap) for each 
+                                                //     directory block, each fDirOffsetBitmapSize bytes long
+    size_t          fDirOffsetBitmapSize;       // [1] size of each of the above
+    lck_mtx_t *     fNameCacheLock;             // [1] protects the contents of fNameCacheBuffer
+    void *          fNameCacheBuffer;           // [1] [2] memory for fNameCache
+    size_t          fNameCacheBufferSize;       // [1] size of the above
+    MFSDirectoryNameCache fNameCache;           // [1] [2] set up by MFSDirectoryNameCacheInit from fDirectoryIndex
 };
 typedef struct FSMount FSMount;
 
@@ -381,6 +405,11 @@ typedef struct FSMount FSMount;
 // [1] This field is immutable.  That is, it's set up as part of the initialisation 
 //     process, and is not modified after that.  Thus, it doesn't need to be 
 //     protected from concurrent access.  Yay for read-only file systems!
+//
+// [2] The pointers in fNameCache are immutable, but the UTF-8 names that 
+//     they point to are filled in lazily, the first time someone asks for 
+//     a name.  Thus the names must only be accessed with fNameCacheLock held. 
+//     See FSMountGetUTF8Name.
 
 static FSMount *   FSMountFromMount(mount_t mp)
     // Gets the FSMount from a mount_t, with appropriate runtime checks in the 
@@ -408,6 +437,44 @@ static FSMount *   FSMountFromMount(mount_t mp)
 
 #endif
 
+static errno_t FSMountGetUTF8Name(
+    FSMount *   fsmp, 
+    uint16_t    dirBlock, 
+    size_t      dirOffset, 
+    char *      utf8Name, 
+    size_t      utf8NameSize
+)
+    // Gets the UTF-8 name of the directory entry at dirOffset within dirBlock 
+    // and copies it into the buffer specified by utf8Name and utf8NameSize, 
+    // which must be big enough to hold a MAXPATHLEN size name.  The name comes 
+    // from the volume's name cache, so it's only converted from the on-disk 
+    // encoding the first time anyone asks for it.  You must only call this if 
+    // the name cache is enabled; otherwise get the name from the MFS core.
+{
+    int             err;
+    size_t          entryIndex;
+    const char *    cachedName;
+    size_t          cachedNameLen;
+    
+    assert( ValidFSMount(fsmp) );
+    assert(fsmp->fNameCacheEnabled);
+    assert(utf8Name != NULL);
+    assert(utf8NameSize >= MAXPATHLEN);
+    
+    err = MFSDirectoryIndexFindEntry(&fsmp->fDirectoryIndex, dirBlock, dirOffset, &entryIndex);
+    if (err == 0) {
+        lck_mtx_lock(fsmp->fNameCacheLock);
+        
+        cachedName = MFSDirectoryNameCacheGetName(&fsmp->fNameCache, entryIndex, &cachedNameLen);
+        assert(cachedNameLen < utf8NameSize);
+        memcpy(utf8Name, cachedName, cachedNameLen + 1);
+        
+        lck_mtx_unlock(fsmp->fNameCacheLock);
+    }
+    
+    return err;
+}
+
 #pragma mark - FSNode
 
 // FSNode holds the file system specific data that we need per vnode.  We attach this 
@@ -430,7 +497,8 @@ struct FSNode {
     size_t          fDirOffset;         // [1] offset of the file's directory entry; 0 for the root directory vnode
     MFSForkInfo     fForkInfo[2];       // [1] data (index 0) and rsrc (index 1) fork info; see the discussion 
                                         //     of MFSForkInfo in "MFSCore.h"; all zeros for the root directory FSNode
-    uint32_t        fLastDirOffset;     // [2] cache of last valid uio_offset (for directories)
+    MFSForkExtent * fExtents[2];        // [1] [2] extent map for each fork; NULL if the fork is empty
+    size_t          fExtentCount[2];    // [1] [2] number of entries in the corresponding fExtents array
 };
 typedef struct FSNode FSNode;
 
@@ -440,18 +508,10 @@ typedef struct FSNode FSNode;
 //     and is not modified after that.  Thus, it doesn't need to be protected 
 //     from concurrent access.  Yay for read-only file systems!
 //
-// [2] This is a uint32_t because that we can be sure that all reads and writes 
-//     are atomic.  We need this because, if two concurrent threads are reading 
-//     through the root directory, they might end up trying to access this field 
-//     simultaneously.  As long as those accesses are atomic, we're OK even 
-//     without a lock; the value will always be consistent (even though the threads 
-//     will 'blow' each other's cache).  If the accesse are not atomic (for example, 
-//     if this field was an off_t (which is 64 bits, which is non-atomic when accessed 
-//     by 32-bit code), you might get half of value A and half of value B, which would 
-//     be bad (What do you mean, "bad?" / Try to imagine...).
-//
-//     This is a long winded way of saying that we can avoid creating a mutex per 
-//     FSNode by keeping this field small (-:
+// [2] The extent maps are built by FSNodeSetupExtentMaps when the FSNode is 
+//     initialised, and freed by FSNodeScrub.  They let VNOPBlockmap map a 
+//     file offset with a binary search, rather than walking the fork's 
+//     allocation block chain from the start on every call.
 
 static FSNode * FSNodeFromVNode(vnode_t vn)
     // A version of FSNodeGenericFromVNode that casts the result to the 
@@ -537,12 +597,94 @@ static void FSNodeScrub(FSNode * fsn)
     // about race conditions; it is the only thread that could be accessing 
     // the FSNode at this time.
     //
-    // For MFSLives, there is no scrubbable data in the FSNode, so we don't do 
-    // much.
+    // For MFSLives, the only scrubbable data in the FSNode is the extent maps.
 {
+    size_t      forkIndex;
+    
+    for (forkIndex = 0; forkIndex < 2; forkIndex++) {
+        if (fsn->fExtents[forkIndex] != NULL) {
+            OSFree(fsn->fExtents[forkIndex], fsn->fExtentCount[forkIndex] * sizeof(*fsn->fExtents[forkIndex]), gOSMallocTag);
+            fsn->fExtents[forkIndex] = NULL;
+            fsn->fExtentCount[forkIndex] = 0;
+        }
+    }
     fsn->fMagic = kFSNodeBadMagic;
 }
 
+static errno_t FSNodeSetupExtentMaps(FSMount *fsmp, FSNode *fsn)
+    // Builds the extent maps for both forks of a file FSNode.  This is called 
+    // as part of initialising the FSNode, so we don't have to worry about 
+    // concurrent access.  On error, any maps that were built are left in 
+    // place; they'll be freed when the caller scrubs the FSNode.
+{
+    errno_t     err;
+    size_t      forkIndex;
+    size_t      extentsSize;
+    size_t      extentCount;
+    
+    assert(fsmp != NULL);
+    assert(fsn != NULL);
+    
+    err = 0;
+    for (forkIndex = 0; forkIndex < 2; forkIndex++) {
+        assert(fsn->fExtents[forkIndex] == NULL);
+        
+        // Empty forks have no extents.
+        
+        if (fsn->fForkInfo[forkIndex].lengthInBytes == 0) {
+            continue;
+        }
+        
+        // A non-empty fork has at least one extent, and can't have more extents 
+        // than it has allocation blocks.  If the directory entry or the VABM 
+        // disagrees, the volume is corrupt.  Checking for zero here also stops 
+        // us calling OSMalloc with a size of zero, below or when shrinking the map.
+        
+        extentsSize = fsn->fForkInfo[forkIndex].physicalLengthInBytes / fsmp->fAllocationBlockSizeInBytes;
+        if (extentsSize == 0) {
+            err = EIO;
+        } else {
+            fsn->fExtents[forkIndex] = OSMalloc(extentsSize * sizeof(*fsn->fExtents[forkIndex]), gOSMallocTag);
+            if (fsn->fExtents[forkIndex] == NULL) {
+                err = ENOMEM;
+            } else {
+                fsn->fExtentCount[forkIndex] = extentsSize;
+                err = MFSForkGetExtentMapWithVABMTable(
+                    fsmp->fMDBVABM, 
+                    fsmp->fVABMTable, 
+                    &fsn->fForkInfo[forkIndex], 
+                    fsn->fExtents[forkIndex], 
+                    extentsSize, 
+                    &extentCount
+                );
+                if ( (err == 0) && ((extentCount == 0) || (extentCount > extentsSize)) ) {
+                    err = EIO;
+                }
+            }
+        }
+        
+        // Give back any unused space.  We don't want to hold on to a map 
+        // sized for the worst case when the fork is typically contiguous.
+        
+        if ( (err == 0) && (extentCount < extentsSize) ) {
+            MFSForkExtent *     newExtents;
+            
+            newExtents = OSMalloc(extentCount * sizeof(*newExtents), gOSMallocTag);
+            if (newExtents != NULL) {
+                memcpy(newExtents, fsn->fExtents[forkIndex], extentCount * sizeof(*newExtents));
+                OSFree(fsn->fExtents[forkIndex], extentsSize * sizeof(*fsn->fExtents[forkIndex]), gOSMallocTag);
+                fsn->fExtents[forkIndex]     = newExtents;
+                fsn->fExtentCount[forkIndex] = extentCount;
+            }
+        }
+        if (err != 0) {
+            break;
+        }
+    }
+    
+    return err;
+}
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Core Algorithms
 
@@ -718,8 +860,7 @@ static errno_t SearchDirectoryByName(
 {
     int         err;
     void *      tempBuffer;
-    uint16_t    dirBlock;
-    size_t      dirOffset;
+    size_t      entryIndex;
     
     assert(ValidFSMount(fsmp));
     assert(cn != NULL);
@@ -728,7 +869,7 @@ static errno_t SearchDirectoryByName(
     assert(forkInfo != NULL);
     // attr can be NULL
 
-    // Create the temporary buffer used by MFSDirectoryBlockFindEntryByName.
+    // Create the temporary buffer used by MFSDirectoryNameHashLookupUTF8.
 
     err = 0;
     tempBuffer = OSMalloc(kMFSDirectoryBlockFindEntryByNameTempBufferSize, gOSMallocTag);
@@ -736,69 +877,40 @@ static errno_t SearchDirectoryByName(
         err = ENOMEM;
     }
 
-    // Iterate through the directory blocks, reading them into memory, and then calling 
-    // the MFS core to look for the directory item.
+    // Look the name up in the volume's name hash (built by FSMountSetupDirectory).  
+    // This takes the same time whether or not the name exists, which is important 
+    // because the VFS layer looks up lots of names that don't exist (for example, 
+    // "._" files and ".DS_Store").
     
     if (err == 0) {
-        // MFSDirectoryBlockFindEntryByname requires that we clear the first byte of 
-        // tempBuffer to tell it that it hasn't seen this buffer before.
-        
-        *((char *) tempBuffer) = 0;
-
-        dirBlock = fsmp->fDirectoryStartBlock;
-        do {
-            buf_t           buf;
-            const void *    bufData;
-            
-            buf = NULL;
-            
-            err = buf_meta_bread(fsmp->fBlockDevVNode, dirBlock, fsmp->fBlockDevBlockSize, NULL, &buf);
-
-            if (err == 0) {
-                bufData = (const void *) buf_dataptr(buf);
-                assert(bufData != NULL);
-
-                err = MFSDirectoryBlockFindEntryByName(
-                    bufData,
-                    fsmp->fBlockDevBlockSize,
-                    cn->cn_nameptr,
-                    cn->cn_namelen,
-                    tempBuffer,
-                    &dirOffset,
-                    attr
-                );
-                
-                // If we found the item, return its fork info as well.
-                
-                if (err == 0) {
-                    err = MFSDirectoryEntryGetForkInfo(bufData, dirOffset, 0, &forkInfo[0]);
-                }
-                if (err == 0) {
-                    err = MFSDirectoryEntryGetForkInfo(bufData, dirOffset, 1, &forkInfo[1]);
-                }
-
-                // If we didn't find the item, try the next directory block.
-                
-                if (err == ENOENT) {
-                    dirBlock += 1;
-                    
-                    if (dirBlock < (fsmp->fDirectoryStartBlock + fsmp->fDirectoryBlockCount)) {
-                        err = EAGAIN;
-                    }
-                }
-            }
-            
-            if (buf != NULL) {
-                buf_brelse(buf);
-            }
-        } while (err == EAGAIN);
+        err = MFSDirectoryNameHashLookupUTF8(
+            &fsmp->fDirectoryIndex,
+            fsmp->fNameHashSlots,
+            fsmp->fNameHashSlotCount,
+            cn->cn_nameptr,
+            cn->cn_namelen,
+            tempBuffer,
+            &entryIndex
+        );
     }
     
-    // Copy the results out to the caller.
+    // Copy the results out to the caller.  The index has everything except the 
+    // attributes; for those, we go back to our in-memory copy of the directory.
     
     if (err == 0) {
-        *dirBlockPtr  = dirBlock;
-        *dirOffsetPtr = dirOffset;
+        *dirBlockPtr  = fsmp->fDirectoryIndex.dirBlocks[entryIndex];
+        *dirOffsetPtr = fsmp->fDirectoryIndex.dirOffsets[entryIndex];
+        forkInfo[0]   = fsmp->fDirectoryIndex.forkInfos[0][entryIndex];
+        forkInfo[1]   = fsmp->fDirectoryIndex.forkInfos[1][entryIndex];
+        
+        if (attr != NULL) {
+            err = MFSDirectoryEntryGetAttr(
+                ((const char *) fsmp->fDirectory) + ((*dirBlockPtr - fsmp->fDirectoryStartBlock) * fsmp->fBlockDevBlockSize), 
+                *dirOffsetPtr, 
+                fsmp->fEncoding,
+                attr
+            );
+        }
     }
     
     // Clean up.
@@ -829,8 +941,7 @@ static errno_t SearchDirectoryByID(
     // forkInfo[1] (rsrc fork info) and, optionally, attr).
 {
     int         err;
-    uint16_t    dirBlock;
-    size_t      dirOffset;
+    size_t      entryIndex;
     
     assert(ValidFSMount(fsmp));
     // ino can be anything
@@ -839,76 +950,42 @@ static errno_t SearchDirectoryByID(
     assert(forkInfo != NULL);
     // attr can be NULL
 
-    // Iterate through the directory blocks, reading them into memory, and then calling 
-    // the MFS core to iterate through each item in the block, looking for the one 
-    // with the correct file number.
-
-    dirBlock = fsmp->fDirectoryStartBlock;
-    do {
-        buf_t           buf;
-        const void *    bufData;
-        boolean_t       found;
-        
-        buf = NULL;
-        
-        err = buf_meta_bread(fsmp->fBlockDevVNode, dirBlock, fsmp->fBlockDevBlockSize, NULL, &buf);
-
-        if (err == 0) {
-            bufData = (const void *) buf_dataptr(buf);
-            assert(bufData != NULL);
-
-            found = FALSE;
-            dirOffset = kMFSDirectoryBlockIterateFromStart;
-            do {
-                struct vnode_attr tmpAttr;
-                VATTR_INIT(&tmpAttr);
-                VATTR_WANTED(&tmpAttr, va_fileid);
-
-                err = MFSDirectoryBlockIterate(
-                    bufData,
-                    fsmp->fBlockDevBlockSize,
-                    &dirOffset,
-                    &tmpAttr
-                );
-                if (err == 0) {
-                    found = (tmpAttr.va_fileid == ino);
-                }
-            } while ( (err == 0) && ! found);
-            
-            // If we found the item, return its attributes and fork info as well.
-            
-            if ( (err == 0) && (attr != NULL) ) {
-                err = MFSDirectoryEntryGetAttr(bufData, dirOffset, attr);
-            }
-            if (err == 0) {
-                err = MFSDirectoryEntryGetForkInfo(bufData, dirOffset, 0, &forkInfo[0]);
-            }
-            if (err == 0) {
-                err = MFSDirectoryEntryGetForkInfo(bufData, dirOffset, 1, &forkInfo[1]);
-            }
-            
-            // If we didn't find the item, try the next directory block.
+    // Map the inode number back to an MFS file number (the inverse of the 
+    // translation done by MFSDirectoryEntryGetAttr) and look that up in the 
+    // volume's file number table (built by FSMountSetupDirectory).  Inode 
+    // numbers below kMFSFirstFileInodeName can't be files, and neither can 
+    // inode numbers that don't map to a 32-bit file number.
+    
+    if ( (ino < kMFSFirstFileInodeName) || ((ino - kMFSFirstFileInodeName) >= UINT32_MAX) ) {
+        err = ENOENT;
+    } else {
+        err = MFSDirectoryFileNumberTableLookup(
+            &fsmp->fDirectoryIndex,
+            fsmp->fFileNumberTableFirst,
+            fsmp->fFileNumberTableSlots,
+            fsmp->fFileNumberTableSlotCount,
+            (uint32_t) (ino - kMFSFirstFileInodeName + 1),
+            &entryIndex
+        );
+    }
+    
+    // Copy the results out to the caller.  As in SearchDirectoryByName, the 
+    // attributes come from our in-memory copy of the directory.
 
-            if (err == ENOENT) {
-                dirBlock += 1;
-                
-                if (dirBlock < (fsmp->fDirectoryStartBlock + fsmp->fDirectoryBlockCount)) {
-                    err = EAGAIN;
-                }
-            }
-        }
+    if (err == 0) {
+        *dirBlockPtr  = fsmp->fDirectoryIndex.dirBlocks[entryIndex];
+        *dirOffsetPtr = fsmp->fDirectoryIndex.dirOffsets[entryIndex];
+        forkInfo[0]   = fsmp->fDirectoryIndex.forkInfos[0][entryIndex];
+        forkInfo[1]   = fsmp->fDirectoryIndex.forkInfos[1][entryIndex];
         
-        if (buf != NULL) {
-            buf_brelse(buf);
+        if (attr != NULL) {
+            err = MFSDirectoryEntryGetAttr(
+                ((const char *) fsmp->fDirectory) + ((*dirBlockPtr - fsmp->fDirectoryStartBlock) * fsmp->fBlockDevBlockSize), 
+                *dirOffsetPtr, 
+                fsmp->fEncoding,
+                attr
+            );
         }
-
-    } while (err == EAGAIN);
-
-    // Copy the results out to the caller.
-
-    if (err == 0) {
-        *dirBlockPtr  = dirBlock;
-        *dirOffsetPtr = dirOffset;
     }
 
     // Post-conditions
@@ -998,29 +1075,33 @@ static errno_t FSNodeGetOrCreateFileVNodeByName(FSMount *fsmp, struct componentn
             fsn->fDirOffset   = dirOffset;
             fsn->fForkInfo[0] = forkInfo[0];
             fsn->fForkInfo[1] = forkInfo[1];
+
+            err = FSNodeSetupExtentMaps(fsmp, fsn);
         }
 
         // Try to create the vnode.
 
-        params.vnfs_mp         = fsmp->fMountPoint;
-        params.vnfs_vtype      = VREG;
-        params.vnfs_str        = NULL;
-        params.vnfs_dvp        = dirVN;
-        params.vnfs_fsnode     = hn;
-        params.vnfs_vops       = gVNodeOperations;
-        params.vnfs_markroot   = FALSE;
-        params.vnfs_marksystem = FALSE;
-        params.vnfs_rdev       = 0;                 // we don't currently support VBLK or VCHR
-        params.vnfs_filesize   = fsn->fForkInfo[forkIndex].lengthInBytes;
+        if (err == 0) {
+            params.vnfs_mp         = fsmp->fMountPoint;
+            params.vnfs_vtype      = VREG;
+            params.vnfs_str        = NULL;
+            params.vnfs_dvp        = dirVN;
+            params.vnfs_fsnode     = hn;
+            params.vnfs_vops       = gVNodeOperations;
+            params.vnfs_markroot   = FALSE;
+            params.vnfs_marksystem = FALSE;
+            params.vnfs_rdev       = 0;                 // we don't currently support VBLK or VCHR
+            params.vnfs_filesize   = fsn->fForkInfo[forkIndex].lengthInBytes;
 
-        // Name caching is completely disabled until I can work through all of the issues.  
-        // Specifically, HFS Plus won't cache a precomposed name, and I think I should 
-        // do the same.
-        
-        params.vnfs_cnp        = NULL;
-        params.vnfs_flags      = VNFS_NOCACHE | VNFS_CANTCACHE;
-        
-        err = vnode_create(VNCREATE_FLAVOR, sizeof(params), &params, &vn);
+            // Name caching is completely disabled until I can work through all of the issues.  
+            // Specifically, HFS Plus won't cache a precomposed name, and I think I should 
+            // do the same.
+            
+            params.vnfs_cnp        = NULL;
+            params.vnfs_flags      = VNFS_NOCACHE | VNFS_CANTCACHE;
+            
+            err = vnode_create(VNCREATE_FLAVOR, sizeof(params), &params, &vn);
+        }
         
         assert( (err == 0) == (vn != NULL) );
         
@@ -1029,9 +1110,10 @@ static errno_t FSNodeGetOrCreateFileVNodeByName(FSMount *fsmp, struct componentn
         if (err == 0) {
             HNodeAttachVNodeSucceeded(hn, forkIndex, vn);
         } else {
-            HNodeAttachVNodeFailed(hn, forkIndex);
-            FSNodeScrub(fsn);
-            HNodeScrubDone(hn);
+            if ( HNodeAttachVNodeFailed(hn, forkIndex) ) {
+                FSNodeScrub(fsn);
+                HNodeScrubDone(hn);
+            }
         }
     }
 
@@ -1100,6 +1182,10 @@ static errno_t FSNodeGetOrCreateFileVNodeByID(FSMount *fsmp, ino_t ino, size_t f
 
             err = SearchDirectoryByID(fsmp, ino, &fsn->fDirBlock, &fsn->fDirOffset, fsn->fForkInfo, NULL);
             
+            if (err == 0) {
+                err = FSNodeSetupExtentMaps(fsmp, fsn);
+            }
+
             // The parent of all file vnodes is the root.  That sounds pretty obvious, but it's 
             // actually a bit tricky.  Specifically, the vnodes that represent the resource fork 
             // of a file also have their parent set to the root, not, for example to NULL, or to the 
@@ -1382,7 +1468,7 @@ static errno_t VNOPGetattr(struct vnop_getattr_args *ap)
         VFSATTR_WANTED(&volAttr, f_access_time);
         VFSATTR_WANTED(&volAttr, f_backup_time);
         
-        err = MFSMDBGetAttr(fsmp->fMDBVABM, &volAttr);
+        err = MFSMDBGetAttr(fsmp->fMDBVABM, fsmp->fEncoding, &volAttr);
         
         if (err == 0) {
             VATTR_RETURN(vap, va_rdev,        0);
@@ -1438,11 +1524,13 @@ static errno_t VNOPGetattr(struct vnop_getattr_args *ap)
     } else {
         buf_t               buf;
         const void *        bufData;
+        boolean_t           nameWanted;
 
         // For a file vnode, call MFS core to do the real work.  Of course, we have to make 
         // sure that the file's directory block is available to the core.
 
         buf = NULL;
+        nameWanted = FALSE;
         
         err = buf_meta_bread(fsmp->fBlockDevVNode, fsn->fDirBlock, fsmp->fBlockDevBlockSize, NULL, &buf);
         
@@ -1450,13 +1538,32 @@ static errno_t VNOPGetattr(struct vnop_getattr_args *ap)
             bufData = (const void *) buf_dataptr(buf);
             assert(bufData != NULL);
 
-            err = MFSDirectoryEntryGetAttr(bufData, fsn->fDirOffset, vap);
+            // If the name cache is enabled, we get the name from it (below), so don't 
+            // ask the MFS core to convert it.
+            
+            nameWanted = fsmp->fNameCacheEnabled && VATTR_IS_ACTIVE(vap, va_name);
+            if (nameWanted) {
+                VATTR_CLEAR_ACTIVE(vap, va_name);
+            }
+            
+            err = MFSDirectoryEntryGetAttr(bufData, fsn->fDirOffset, fsmp->fEncoding, vap);
+            
+            if (nameWanted) {
+                VATTR_WANTED(vap, va_name);
+            }
         }
         
         if (buf != NULL) {
             buf_brelse(buf);
         }
         
+        if ( (err == 0) && nameWanted ) {
+            err = FSMountGetUTF8Name(fsmp, fsn->fDirBlock, fsn->fDirOffset, vap->va_name, MAXPATHLEN);
+            if (err == 0) {
+                VATTR_SET_SUPPORTED(vap, va_name);
+            }
+        }
+        
         // If this is the resource fork, override the values for va_data_size and va_data_alloc 
         // returned by MFSDirectoryEntryGetAttr (which are the data fork values) with the values 
         // for the resource fork.  This seems pretty logical, and it's what HFS does, but it goes 
@@ -1668,7 +1775,6 @@ static errno_t ReadDirectoryAndCopyOutDirEnt(
     FSMount *       fsmp, 
     uint16_t *      dirBlockPtr, 
     size_t *        dirOffsetPtr, 
-    boolean_t *     trustDirOffsetPtr,
     int *           numdirentPtr, 
     uio_t           uio, 
     struct dirent * dirEntBuf
@@ -1687,11 +1793,7 @@ static errno_t ReadDirectoryAndCopyOutDirEnt(
     // indicating that the first directory entry of a particular block should be read next.  
     // The logic here pretty much follows from that in MFSDirectoryBlockIterate.
     //
-    // Finally, if *trustDirOffsetPtr is false, we confirm that *dirOffsetPtr is valid 
-    // before using it.  If that fails, we return EINVAL.  If it succeeds, we set 
-    // *trustDirOffsetPtr to true so that a) we don't confirm dirOffset again, and 
-    // b) so that our trusted offset gets recorded in the dirOffset cache 
-    // (the fLastDirOffset of the FSNode).
+    // *dirOffsetPtr must be valid; UnpackUIOOffset checks that.
 {
     int                 err;
     uint16_t            dirBlockLimit;
@@ -1704,7 +1806,6 @@ static errno_t ReadDirectoryAndCopyOutDirEnt(
     assert( ValidFSMount(fsmp) );
     assert(dirBlockPtr       != NULL);
     assert(dirOffsetPtr      != NULL);
-    assert(trustDirOffsetPtr != NULL);
     assert(numdirentPtr      != NULL);
     assert(uio != NULL);
     assert(dirEntBuf != NULL);
@@ -1736,17 +1837,6 @@ static errno_t ReadDirectoryAndCopyOutDirEnt(
             assert(bufData != NULL);
         }
         
-        // If we don't trust dirOffset, check it now.
-        
-        if ( (err == 0) && ! *trustDirOffsetPtr ) {
-            assert(dirOffset != kMFSDirectoryBlockIterateFromStart);        // if was this, we would've trusted it
-
-            err = MFSDirectoryBlockCheckDirOffset(bufData, fsmp->fBlockDevBlockSize, dirOffset);
-            if (err == 0) {
-                *trustDirOffsetPtr = TRUE;
-            }
-        }
-        
         // Iterate the entries in this block.  Note that we start at dirOffset, which 
         // might not be the beginning.
 
@@ -1754,15 +1844,22 @@ static errno_t ReadDirectoryAndCopyOutDirEnt(
             do {
                 size_t      previousDirOffset;
 
-                // Tell the MFS core that we want the file number and the name.
+                // Tell the MFS core that we want the file number and, unless we 
+                // can get it from the name cache (which saves converting it on every 
+                // readdir), the name.
                 
                 VATTR_INIT(&attr);
                 VATTR_WANTED(&attr, va_fileid);
-                VATTR_WANTED(&attr, va_name);
-                attr.va_name = dirEntBuf->d_name;
+                if ( ! fsmp->fNameCacheEnabled ) {
+                    VATTR_WANTED(&attr, va_name);
+                    attr.va_name = dirEntBuf->d_name;
+                }
 
                 previousDirOffset = dirOffset;          // see comment below
-                err = MFSDirectoryBlockIterate(bufData, fsmp->fBlockDevBlockSize, &dirOffset, &attr);
+                err = MFSDirectoryBlockIterate(bufData, fsmp->fBlockDevBlockSize, &dirOffset, fsmp->fEncoding, &attr);
+                if ( (err == 0) && fsmp->fNameCacheEnabled ) {
+                    err = FSMountGetUTF8Name(fsmp, dirBlock, dirOffset, dirEntBuf->d_name, MAXPATHLEN);
+                }
                 
                 // Copy the entry out to the user's buffer.
                 
@@ -1821,34 +1918,35 @@ static errno_t UnpackUIOOffset(
     vnode_t     vn,
     uio_t       uio,
     uint16_t *  dirBlockPtr, 
-    size_t *    dirOffsetPtr, 
-    boolean_t * trustDirOffsetPtr
+    size_t *    dirOffsetPtr
 )
     // This routine extracts the offset from uio and unpacks it into a directory 
-    // block number (*dirBlockPtr), a directory offset (*dirOffsetPtr), and a 
-    // a value indicating whether the caller can trust the directory offset 
-    // (*trustDirOffsetPtr).  It returns EINVAL if the UIO offset is obviously 
-    // wrong.  It handles a world of special cases and validity tests.  Yetch.
+    // block number (*dirBlockPtr) and a directory offset (*dirOffsetPtr).  It 
+    // returns EINVAL if the UIO offset is wrong.  It handles a world of special 
+    // cases and validity tests.  Yetch.
+    //
+    // The UIO offset can be set by an untrusted client (using lseek), so we 
+    // validate it completely.  The last step, checking that the offset is 
+    // the start of a directory entry, is a bit test against the offset bitmap 
+    // that FSMountSetupDirectory built for the block.  That's cheap enough that 
+    // there's no need to cache the last valid offset, which is just as well, 
+    // because a single cached offset doesn't help when more than one client is 
+    // reading the directory.
 {
     int         err;
     FSMount *   fsmp;
-    FSNode *    fsn;
     off_t       uioOffset;
     uint16_t    dirBlock;
     uint16_t    dirBlockLimit;
     size_t      dirOffset;
-    boolean_t   trustDirOffset;
-    boolean_t   useCache;
     
     // Pre-conditions
     
     assert( ValidVNode(vn) );
     assert(dirBlockPtr != NULL);
     assert(dirOffsetPtr != NULL);
-    assert(trustDirOffsetPtr != NULL);
     
     fsmp = FSMountFromMount(vnode_mount(vn));
-    fsn = FSNodeFromVNode(vn);
     
     // Some basic checks of the algorithm
     
@@ -1859,27 +1957,16 @@ static errno_t UnpackUIOOffset(
     assert(kStartOfBlockMagicOffset < 65536);           // or the magic 'start of block' value exceeds 16 bits
     assert(kStartOfBlockMagicOffset >= fsmp->fBlockDevBlockSize);    // or the magic 'start of block' value is actually a valid dirOffset
 
-    // In the debug build, the client can turn off directory offset caching.  
-    // The cache was masking an interesting bug in the unpack code, so I 
-    // want to turn it off to test the fix for that bug.
-    
-    useCache = TRUE;
-    #if MACH_ASSERT
-        useCache = ! vnode_isnocache(vn);
-    #endif
-    
     // Unpack dirBlock and dirOffset from the uio_offset.
     
     uioOffset = uio_offset(uio);
     dirBlock =  (uioOffset >> 16);
     dirOffset = (uioOffset & 0x0000FFFF);
-    trustDirOffset = FALSE;
     
     dirBlockLimit = fsmp->fDirectoryStartBlock + fsmp->fDirectoryBlockCount;
     
     if ( (uioOffset < 0) || (uioOffset > 0x00000000FFFFFFFFLL) ) {
-        // This is Just Wrong (tm).  This check makes the cast to uint32_t in the second 
-        // special case acceptable.
+        // This is Just Wrong (tm).
         err = EINVAL;
     } else if ( (dirBlock == 0) && (dirOffset <= 1) ) {
         // First special case.  dirBlock 0 is assumed to hold the synthetic directory entries 
@@ -1887,30 +1974,19 @@ static errno_t UnpackUIOOffset(
         // that the uioOffset == 0 case comes through here.  You'd get the same result in 
         // both cases, but it's just nicer if it comes through the right branch.
         err = 0;
-        trustDirOffset = TRUE;
-    } else if ( useCache && ((uint32_t) uioOffset == fsn->fLastDirOffset) ) {
-        // Second special case: if the overall offset matches the last offset we returned to 
-        // to the user, everything has got to be OK because directory offsets can't change 
-        // on a read-only file system.
-        err = 0;
-        if (dirOffset == kStartOfBlockMagicOffset) {
-            dirOffset = kMFSDirectoryBlockIterateFromStart;
-        }
-        trustDirOffset = TRUE;
     } else if ( (dirBlock < fsmp->fDirectoryStartBlock) || (dirBlock > dirBlockLimit) ) {
         // dirBlock out clearly of range
         err = EINVAL;
     } else if (dirOffset == kStartOfBlockMagicOffset) {
-        // Third special case: starting at the beginning of a block is always OK (if 
+        // Second special case: starting at the beginning of a block is always OK (if 
         // dirBlock is OK, which we've just checked).  We have to do this before the 
         // following checks, because a) we want to check for the start of the block 
         // before we reject dirBlock == dirBlockLimit, and c) kStartOfBlockMagicOffset is 
         // greater than the block size.
         err = 0;
         dirOffset = kMFSDirectoryBlockIterateFromStart;
-        trustDirOffset = TRUE;
     } else if (dirBlock == dirBlockLimit) {
-        // Fourth special case: we allow dirBlock == dirBlockLimit iff dirOffset == 
+        // Third special case: we allow dirBlock == dirBlockLimit iff dirOffset == 
         // kStartOfBlockMagicOffset.  This is what you get pinned to once you've 
         // iterated the entire directory's contents.  No other dirOffset values 
         // are valid if we're off the end of the directory.
@@ -1919,14 +1995,17 @@ static errno_t UnpackUIOOffset(
         // dirOffset is too big.
         err = EINVAL;
     } else {
-        // Everything might be OK, but we can't trust dirOffset.
-        err = 0;
-        assert( ! trustDirOffset );
+        // dirBlock and dirOffset are both in range, so check that dirOffset is the 
+        // start of a directory entry.
+        err = MFSDirectoryBlockOffsetBitmapCheckDirOffset(
+            fsmp->fDirOffsetBitmaps + ((dirBlock - fsmp->fDirectoryStartBlock) * fsmp->fDirOffsetBitmapSize), 
+            fsmp->fBlockDevBlockSize, 
+            dirOffset
+        );
     }
     
-    *dirBlockPtr       = dirBlock;
-    *dirOffsetPtr      = dirOffset;
-    *trustDirOffsetPtr = trustDirOffset;
+    *dirBlockPtr  = dirBlock;
+    *dirOffsetPtr = dirOffset;
     
     return err;
 }
@@ -1935,27 +2014,18 @@ static void PackUIOOffset(
     vnode_t     vn,
     uio_t       uio,
     uint16_t    dirBlock, 
-    size_t      dirOffset,
-    boolean_t   trustDirOffset
+    size_t      dirOffset
 )
     // This routine packs the directory block number (dirBloc) and directory offset 
-    // (dirOffset) into the UIO's offset.  It also records the resulting offset 
-    // in the directory offset cache of the FSNode associated with vn (that is, the 
-    // fLastDirOffset field) if the value can be trusted.  [There are /very/ obscure 
-    // circumstances under which we can get an untrusted value in, /not/ look at it 
-    // (and therefore not check its validity and establish trust), and then write 
-    // it back out.  In such a situation, we don't want to promote the untrusted 
-    // offset to trusted by putting it in cache.]
+    // (dirOffset) into the UIO's offset.
 {
     FSMount *   fsmp;
-    FSNode *    fsn;
     off_t       uioOffset;
     
     assert(vn != NULL);
     assert(uio != NULL);
     
     fsmp = FSMountFromMount(vnode_mount(vn));
-    fsn  = FSNodeFromVNode(vn);
 
     // Complex assertions...
     
@@ -1990,12 +2060,6 @@ static void PackUIOOffset(
         uioOffset = (((off_t) dirBlock) << 16) | dirOffset;
     }
     
-    // Update the cache.
-    
-    if (trustDirOffset) {               // we implicitly trust the cache, so don't cache unless dirOffset is trusted
-        fsn->fLastDirOffset = (uint32_t) uioOffset;
-    }
-    
     // Update the UIO's offset.
     
     uio_setoffset(uio, uioOffset);
@@ -2079,6 +2143,9 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
     //       each client gets their own file descriptor, there's only one FSNode 
     //       for any given on-disk directory.
     //
+    //     MFSLives sidesteps this by building a bitmap of the valid offsets in 
+    //     each directory block at mount time; see UnpackUIOOffset.
+    //
     // o The UIO resid (residual ID, accessed by uio_resid and uio_setresid) 
     //   indicates how much space is left in the user buffer described by the UIO.  
     //   You must update this as you copy data out into that buffer (fortunately, 
@@ -2162,7 +2229,6 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
     } else {
         uint16_t        dirBlock;
         size_t          dirOffset;
-        boolean_t       trustDirOffset;
         struct dirent * dirEntBuf;
         
         // Allocate a dirent buffer that's big enough to hold the maximum possible 
@@ -2179,7 +2245,7 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
         // Unpack uio_offset and check it as best we can.
         
         if (err == 0) {
-            err = UnpackUIOOffset(vp, uio, &dirBlock, &dirOffset, &trustDirOffset);
+            err = UnpackUIOOffset(vp, uio, &dirBlock, &dirOffset);
         }
 
         if (err == 0) {
@@ -2191,12 +2257,6 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
             // Handle the "." and ".." synthetic items.
             
             if ( (err == 0) && (dirBlock == 0) ) {
-                // Because of the way unpacking works, trustDirOffset will be true when 
-                // we get here.  That's good because it means that we don't need to set it 
-                // as we modify dirOffset.
-                
-                assert(trustDirOffset);
-                
                 if (dirOffset == 0) {
                     //strcpy(dirEntBuf->d_name, ".");
                     strncpy(dirEntBuf->d_name, ".", 2);     /** strcpy() is deprecated */
@@ -2221,7 +2281,7 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
             // Handle the actual MFS directory.
             
             if (err == 0) {
-                err = ReadDirectoryAndCopyOutDirEnt(fsmp, &dirBlock, &dirOffset, &trustDirOffset, &numdirent, uio, dirEntBuf);
+                err = ReadDirectoryAndCopyOutDirEnt(fsmp, &dirBlock, &dirOffset, &numdirent, uio, dirEntBuf);
             }
             
             // We failed because there wasn't enough space in uio.  This is something that the 
@@ -2233,7 +2293,7 @@ static errno_t VNOPReadDir(struct vnop_readdir_args *ap)
             
             // Update uio_offset.
 
-            PackUIOOffset(vp, uio, dirBlock, dirOffset, trustDirOffset);
+            PackUIOOffset(vp, uio, dirBlock, dirOffset);
             
             // Determine if we're at the end of the directory.
             
@@ -2719,7 +2779,6 @@ static errno_t VNOPBlockmap(struct vnop_blockmap_args *ap)
     FSMount *       fsmp;
     FSNode *        fsn;
     size_t          forkIndex;
-    off_t           offsetWithinAllocationBlock;
     uint32_t        offsetFromFirstAllocationBlockInBytes;
     uint32_t        contiguousPhysicalBytes;
 
@@ -2763,29 +2822,25 @@ static errno_t VNOPBlockmap(struct vnop_blockmap_args *ap)
 
     assert((foffset + size) <= ((fsn->fForkInfo[forkIndex].physicalLengthInBytes + (PAGE_SIZE - 1)) / PAGE_SIZE * PAGE_SIZE));
 
-    // Implementation -- The bulk of the work is done by the MFS core.  The tricky part is 
-    // adapting the VFS pre-conditions to the MFSCore pre-conditions.  Specifically, VFS 
-    // specifies that foffset is an even multiple of the device block size, but the equivalent 
-    // value in MFSCore must be an even multiple of the allocation block size.
-    
-    offsetWithinAllocationBlock = foffset % fsmp->fAllocationBlockSizeInBytes;
-    err = MFSForkGetExtent(
-        fsmp->fMDBVABM, 
-        &fsn->fForkInfo[forkIndex], 
-        foffset - offsetWithinAllocationBlock, 
+    // Implementation -- The bulk of the work is done by the MFS core, which looks up 
+    // foffset in the extent map that we built when we initialised the FSNode.  
+    // Because the extent map lookup accepts any offset, there's no need to round 
+    // foffset down to an allocation block boundary (as we would have to do for 
+    // MFSForkGetExtent); the result already accounts for foffset falling at a 
+    // device block boundary within the allocation block.
+    
+    assert(fsn->fExtents[forkIndex] != NULL);
+    err = MFSForkExtentMapLookup(
+        fsn->fExtents[forkIndex], 
+        fsn->fExtentCount[forkIndex], 
+        (uint32_t) foffset, 
         &offsetFromFirstAllocationBlockInBytes, 
         &contiguousPhysicalBytes
     );
     if (err == 0) {
         *bpnPtr = fsmp->fAllocationBlocksStartBlock + (offsetFromFirstAllocationBlockInBytes / fsmp->fBlockDevBlockSize);
         
-        // Reduce the physically contiguous bytes to account for the fact that foffset 
-        // can fall at a device block boundary within the allocation block.
-        
-        assert(contiguousPhysicalBytes >= offsetWithinAllocationBlock);
-        contiguousPhysicalBytes -= offsetWithinAllocationBlock;
-        
-        // Now reduce it again to bound it by size, which is a requirement of the post-condition.
+        // Reduce it to bound it by size, which is a requirement of the post-condition.
         
         if (contiguousPhysicalBytes > size) {
             contiguousPhysicalBytes = size;
@@ -3121,6 +3176,8 @@ static errno_t FSMountParseArguments(FSMount *fsmp, user_addr_t data)
     if (err == 0) {
         fsmp->fForceMount   = (args.fForceMount   != 0);
         fsmp->fForceFailure = (args.fForceFailure != 0);
+        fsmp->fNameCacheEnabled = (args.fNameCache != 0);
+        fsmp->fEncoding     = kMFSTextEncodingMacRoman;
     }
     
     return err;
@@ -3180,6 +3237,7 @@ static errno_t FSMountSetupMFSCore(FSMount *fsmp, vfs_context_t context)
     
     assert( ValidFSMount(fsmp) );
     assert(fsmp->fMDBVABM == NULL);
+    assert(fsmp->fVABMTable == NULL);
     assert(context != NULL);
 
     // First, read the MDB and use it to a) check that the volume is remotely valid, and 
@@ -3252,6 +3310,176 @@ static errno_t FSMountSetupMFSCore(FSMount *fsmp, vfs_context_t context)
         }
     }
     
+    // Finally, decode the VABM into a table of native 16 bit entries.  This makes 
+    // walking allocation block chains (which we do every time we create a file 
+    // vnode, in FSNodeSetupExtentMaps) much cheaper.  fMDBAndVABMSizeInBytes has 
+    // been rounded up, so the table size we derive from it is slightly generous, 
+    // but that's harmless.
+    
+    if (err == 0) {
+        fsmp->fVABMTableSize = (fsmp->fMDBAndVABMSizeInBytes - 64) / 3 * 2;
+        fsmp->fVABMTable = OSMalloc(fsmp->fVABMTableSize * sizeof(*fsmp->fVABMTable), gOSMallocTag);
+        if (fsmp->fVABMTable == NULL) {
+            err = ENOMEM;
+        }
+    }
+    if (err == 0) {
+        err = MFSVABMDecode(fsmp->fMDBVABM, fsmp->fVABMTable, fsmp->fVABMTableSize);
+    }
+    
+    return err;
+}
+
+static errno_t FSMountSetupDirectory(FSMount *fsmp, vfs_context_t context)
+    // This routine reads the entire MFS directory into memory, and then indexes 
+    // it so that we can look up directory entries without scanning the 
+    // directory.  The directory is small (typically 12 blocks) and, because 
+    // this is a read-only file system, it can never change, so holding a 
+    // copy for the lifetime of the mount is cheap and safe.
+    //
+    // It is called as part of VFSOPMount, after FSMountSetupMFSCore.
+{
+    int     err;
+    size_t  directorySizeInBytes;
+    
+    assert( ValidFSMount(fsmp) );
+    assert(fsmp->fMDBVABM != NULL);             // FSMountSetupMFSCore must have been called
+    assert(fsmp->fDirectory == NULL);
+    assert(context != NULL);
+
+    directorySizeInBytes = fsmp->fDirectoryBlockCount * fsmp->fBlockDevBlockSize;
+
+    // Allocate all of the buffers.
+    
+    err = 0;
+    fsmp->fDirectory = OSMalloc(directorySizeInBytes, gOSMallocTag);
+    if (fsmp->fDirectory == NULL) {
+        err = ENOMEM;
+    }
+    if (err == 0) {
+        fsmp->fDirectoryIndexBufferSize = MFSDirectoryIndexGetBufferSize(fsmp->fDirectoryBlockCount, fsmp->fBlockDevBlockSize);
+        fsmp->fDirectoryIndexBuffer = OSMalloc(fsmp->fDirectoryIndexBufferSize, gOSMallocTag);
+        if (fsmp->fDirectoryIndexBuffer == NULL) {
+            err = ENOMEM;
+        }
+    }
+
+    // Read the directory, in the same way that FSMountSetupMFSCore reads the MDB/VABM.
+    
+    if (err == 0) {
+        uio_t   uio;
+        
+        uio = uio_create(1, fsmp->fBlockDevBlockSize * fsmp->fDirectoryStartBlock, UIO_SYSSPACE, UIO_READ);
+        if (uio == NULL) {
+            err = ENOMEM;
+        }
+
+        if (err == 0) {
+            err = uio_addiov(uio, CAST_USER_ADDR_T(fsmp->fDirectory), directorySizeInBytes);
+        }
+        
+        if (err == 0) {
+            err = VNOP_READ(fsmp->fBlockDevVNode, uio, 0, context);
+        }
+        
+        if (uio != NULL) {
+            uio_free(uio);
+        }
+    }
+    
+    // Build the index and then the name hash and file number table.  We can't 
+    // size either of those until we know what entries there are.
+    
+    if (err == 0) {
+        err = MFSDirectoryIndexBuild(
+            fsmp->fDirectory, 
+            fsmp->fDirectoryStartBlock, 
+            fsmp->fDirectoryBlockCount, 
+            fsmp->fBlockDevBlockSize, 
+            fsmp->fEncoding,
+            fsmp->fDirectoryIndexBuffer, 
+            fsmp->fDirectoryIndexBufferSize, 
+            &fsmp->fDirectoryIndex
+        );
+    }
+    if (err == 0) {
+        fsmp->fNameHashSlotCount = MFSDirectoryNameHashGetSlotCount(fsmp->fDirectoryIndex.entryCount);
+        fsmp->fNameHashSlots = OSMalloc(fsmp->fNameHashSlotCount * sizeof(*fsmp->fNameHashSlots), gOSMallocTag);
+        if (fsmp->fNameHashSlots == NULL) {
+            err = ENOMEM;
+        } else {
+            MFSDirectoryNameHashBuild(&fsmp->fDirectoryIndex, fsmp->fNameHashSlots, fsmp->fNameHashSlotCount);
+        }
+    }
+    
+    // Build the file number table.  If the file numbers are too spread out, 
+    // the slot count is zero and SearchDirectoryByID falls back to searching 
+    // the index.
+    
+    if (err == 0) {
+        fsmp->fFileNumberTableSlotCount = MFSDirectoryFileNumberTableGetSlotCount(&fsmp->fDirectoryIndex, &fsmp->fFileNumberTableFirst);
+        if (fsmp->fFileNumberTableSlotCount != 0) {
+            fsmp->fFileNumberTableSlots = OSMalloc(fsmp->fFileNumberTableSlotCount * sizeof(*fsmp->fFileNumberTableSlots), gOSMallocTag);
+            if (fsmp->fFileNumberTableSlots == NULL) {
+                err = ENOMEM;
+            }
+        }
+        if (err == 0) {
+            MFSDirectoryFileNumberTableBuild(&fsmp->fDirectoryIndex, fsmp->fFileNumberTableFirst, fsmp->fFileNumberTableSlots, fsmp->fFileNumberTableSlotCount);
+        }
+    }
+    
+    // Build an offset bitmap for each directory block, so that UnpackUIOOffset 
+    // can validate a directory offset without looking at the directory block.
+    
+    if (err == 0) {
+        uint16_t    dirBlockIndex;
+        
+        fsmp->fDirOffsetBitmapSize = MFSDirectoryBlockGetOffsetBitmapSize(fsmp->fBlockDevBlockSize);
+        fsmp->fDirOffsetBitmaps = OSMalloc(fsmp->fDirectoryBlockCount * fsmp->fDirOffsetBitmapSize, gOSMallocTag);
+        if (fsmp->fDirOffsetBitmaps == NULL) {
+            err = ENOMEM;
+        } else {
+            for (dirBlockIndex = 0; dirBlockIndex < fsmp->fDirectoryBlockCount; dirBlockIndex++) {
+                MFSDirectoryBlockBuildOffsetBitmap(
+                    ((const char *) fsmp->fDirectory) + (dirBlockIndex * fsmp->fBlockDevBlockSize), 
+                    fsmp->fBlockDevBlockSize, 
+                    fsmp->fDirOffsetBitmaps + (dirBlockIndex * fsmp->fDirOffsetBitmapSize)
+                );
+            }
+        }
+    }
+    
+    // If the user asked for it, set up an empty name cache, and the lock that 
+    // protects it.  The names are converted to UTF-8 lazily, by FSMountGetUTF8Name. 
+    // The cache is optional because its buffer is sized for the worst case UTF-8 
+    // expansion of every name in the directory, and it stays allocated until unmount.
+    
+    if ( (err == 0) && fsmp->fNameCacheEnabled ) {
+        fsmp->fNameCacheLock = lck_mtx_alloc_init(gLockGroup, LCK_ATTR_NULL);
+        if (fsmp->fNameCacheLock == NULL) {
+            err = ENOMEM;
+        }
+    }
+    if ( (err == 0) && fsmp->fNameCacheEnabled ) {
+        fsmp->fNameCacheBufferSize = MFSDirectoryNameCacheGetBufferSize(&fsmp->fDirectoryIndex);
+        fsmp->fNameCacheBuffer = OSMalloc(fsmp->fNameCacheBufferSize, gOSMallocTag);
+        if (fsmp->fNameCacheBuffer == NULL) {
+            err = ENOMEM;
+        }
+    }
+    if ( (err == 0) && fsmp->fNameCacheEnabled ) {
+        err = MFSDirectoryNameCacheInit(
+            &fsmp->fDirectoryIndex, 
+            fsmp->fDirectory, 
+            fsmp->fDirectoryStartBlock, 
+            fsmp->fBlockDevBlockSize, 
+            fsmp->fNameCacheBuffer, 
+            fsmp->fNameCacheBufferSize, 
+            &fsmp->fNameCache
+        );
+    }
+    
     return err;
 }
 
@@ -3299,7 +3527,7 @@ static errno_t FSMountSetupVFS(FSMount *fsmp)
     VFSATTR_WANTED(&attr, f_files);
     VFSATTR_WANTED(&attr, f_ffree);
 
-    err = MFSMDBGetAttr(fsmp->fMDBVABM, &attr);
+    err = MFSMDBGetAttr(fsmp->fMDBVABM, fsmp->fEncoding, &attr);
     if (err == 0) {
         
         // Copy those attributes out to VFS's buffer.
@@ -3483,6 +3711,9 @@ static errno_t VFSOPMount(mount_t mp, vnode_t devvp, user_addr_t data, vfs_conte
     if (err == 0) {
         err = FSMountSetupMFSCore(fsmp, context);
     }
+    if (err == 0) {
+        err = FSMountSetupDirectory(fsmp, context);
+    }
     
     // Let the VFS layer know about the specifics of this volume.
     
@@ -3603,6 +3834,30 @@ static errno_t VFSOPUnmount(mount_t mp, int mntflags, vfs_context_t context)
             if (fsmp->fMDBVABM != NULL) {
                 OSFree(fsmp->fMDBVABM, fsmp->fMDBAndVABMSizeInBytes, gOSMallocTag);
             }
+            if (fsmp->fVABMTable != NULL) {
+                OSFree(fsmp->fVABMTable, fsmp->fVABMTableSize * sizeof(*fsmp->fVABMTable), gOSMallocTag);
+            }
+            if (fsmp->fDirectory != NULL) {
+                OSFree(fsmp->fDirectory, fsmp->fDirectoryBlockCount * fsmp->fBlockDevBlockSize, gOSMallocTag);
+            }
+            if (fsmp->fDirectoryIndexBuffer != NULL) {
+                OSFree(fsmp->fDirectoryIndexBuffer, fsmp->fDirectoryIndexBufferSize, gOSMallocTag);
+            }
+            if (fsmp->fNameHashSlots != NULL) {
+                OSFree(fsmp->fNameHashSlots, fsmp->fNameHashSlotCount * sizeof(*fsmp->fNameHashSlots), gOSMallocTag);
+            }
+            if (fsmp->fFileNumberTableSlots != NULL) {
+                OSFree(fsmp->fFileNumberTableSlots, fsmp->fFileNumberTableSlotCount * sizeof(*fsmp->fFileNumberTableSlots), gOSMallocTag);
+            }
+            if (fsmp->fDirOffsetBitmaps != NULL) {
+                OSFree(fsmp->fDirOffsetBitmaps, fsmp->fDirectoryBlockCount * fsmp->fDirOffsetBitmapSize, gOSMallocTag);
+            }
+            if (fsmp->fNameCacheBuffer != NULL) {
+                OSFree(fsmp->fNameCacheBuffer, fsmp->fNameCacheBufferSize, gOSMallocTag);
+            }
+            if (fsmp->fNameCacheLock != NULL) {
+                lck_mtx_free(fsmp->fNameCacheLock, gLockGroup);
+            }
             
             fsmp->fMagic = kFSMountBadMagic;
             
@@ -3692,7 +3947,7 @@ static errno_t VFSOPGetattr(mount_t mp, struct vfs_attr *attr, vfs_context_t con
     
     // Most of the real work is done by the MFS core.
     
-    err = MFSMDBGetAttr(fsmp->fMDBVABM, attr);
+    err = MFSMDBGetAttr(fsmp->fMDBVABM, fsmp->fEncoding, attr);
     
     return err;
 }
@@ -3756,6 +4011,71 @@ static errno_t VFSOPVget(struct mount *mp, ino64_t ino, struct vnode **vpp, vfs_
     return err;
 }
 
+static int VFSOPSysctl(int *name, u_int namelen, user_addr_t oldp, size_t *oldlenp, user_addr_t newp, size_t newlen, vfs_context_t context)
+    // Called by VFS to handle sysctls in our part of the CTL_VFS namespace.  
+    // VFS has already consumed the CTL_VFS and file system type number 
+    // components of the MIB, so name[0] is our selector (see "MFSLivesMountArgs.h").  
+    // This isn't associated with any particular volume; the statistics are for 
+    // the HNode layer as a whole.
+    //
+    // name and namelen describe the remainder of the MIB.
+    //
+    // oldp is the address of the caller's buffer in the address space of the 
+    // current process, or USER_ADDR_NULL if the caller just wants the size.
+    //
+    // oldlenp points to the size of that buffer; on return, we set it to the 
+    // size of the data.
+    //
+    // newp and newlen describe the new value; we don't support setting anything.
+    // 
+    // context identifies the calling process.
+{
+    #pragma unused(newlen)
+    #pragma unused(context)
+    int                     err;
+    HNodeStatistics         stats;
+    MFSLivesHNodeStatistics result;
+
+    // Pre-conditions
+
+    assert(name != NULL);
+    assert(oldlenp != NULL);
+
+    // Implementation
+
+    if (namelen != 1) {
+        err = ENOTDIR;
+    } else if (name[0] != kMFSLivesSysctlHNodeStatistics) {
+        err = ENOTSUP;
+    } else if (newp != USER_ADDR_NULL) {
+        err = EPERM;
+    } else if (oldp == USER_ADDR_NULL) {
+        *oldlenp = sizeof(result);
+        err = 0;
+    } else if (*oldlenp < sizeof(result)) {
+        err = ENOMEM;
+    } else {
+        HNodeGetStatistics(&stats);
+        
+        result.fLookups      = stats.lookups;
+        result.fHits         = stats.hits;
+        result.fMisses       = stats.misses;
+        result.fVIDRetries   = stats.vidRetries;
+        result.fAttachSleeps = stats.attachSleeps;
+        result.fRacesLost    = stats.racesLost;
+        result.fDetaches     = stats.detaches;
+        result.fReclaims     = stats.reclaims;
+        result.fNodeCount    = stats.nodeCount;
+        
+        err = copyout(&result, oldp, sizeof(result));
+        if (err == 0) {
+            *oldlenp = sizeof(result);
+        }
+    }
+    
+    return err;
+}
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Configuration Data
 
@@ -3858,7 +4178,7 @@ static struct vfsops gVFSOps = {
     NULL,                                       // vfs_fhtovp   -- only needed if you do NFS export
     NULL,                                       // vfs_vptofh   -- ditto
     NULL,                                       // vfs_init     -- optional
-    NULL,                                       // vfs_sysctl   -- MFSLives has no custom sysctls
+    VFSOPSysctl,                                // vfs_sysctl
     NULL,                                       // vfs_setattr  -- not needed for read-only file systems
 
     //{NULL, NULL, NULL, NULL, NULL, NULL, NULL}  // vfs_reserved
@@ -1,7 +1,7 @@
 /*
     File:       MFSLivesMountArgs.h
 
-    Contains:   Definition of the mount arguments for MFSLives.
+    Contains:   Definition of the mount arguments and sysctls for MFSLives.
 
     Written by: DTS
 
@@ -67,9 +67,15 @@ First checked in.
 // fDevNodePath field, which must be a pointer).  Otherwise a mount from a 64-bit process 
 // will fail when it hits the kernel (which is always 32-bit).  For this reason, 
 // fForceFailure is a uint32_t rather than a boolean_t.
+//
+// If you change the layout of this structure, you must also change 
+// kMFSLivesMountArgsMagic.  VFSOPMount copies in sizeof(MFSLivesMountArgs) bytes, 
+// so a new kernel extension would otherwise read off the end of the arguments 
+// passed by an old mount tool.  'MFMa' was the original structure, without 
+// fNameCache.
 
 enum {
-    kMFSLivesMountArgsMagic = 'MFMa'
+    kMFSLivesMountArgsMagic = 'MFMb'
 };
 
 struct MFSLivesMountArgs {
@@ -79,7 +85,36 @@ struct MFSLivesMountArgs {
     uint32_t                fMagic;         // must be kMFSLivesMountArgsMagic
     uint32_t                fForceMount;    // allow mounting on non-512 byte block devices
     uint32_t                fForceFailure;  // if non-zero, mount will always fail
+    uint32_t                fNameCache;     // if non-zero, cache converted UTF-8 names for the life of the mount
 };
 typedef struct MFSLivesMountArgs MFSLivesMountArgs;
 
+// MFSLives implements a VFS sysctl that returns statistics about its vnode cache 
+// (the HNode layer).  To get them, look up the file system's type number using 
+// <x-man-page://3/getvfsbyname> and then call <x-man-page://3/sysctl> with the MIB 
+// { CTL_VFS, vfc_typenum, kMFSLivesSysctlHNodeStatistics }.  The sysctl is read-only; 
+// it returns an MFSLivesHNodeStatistics structure.  The fields have the same meaning 
+// as the corresponding fields of HNodeStatistics (see "HashNode.h").
+//
+// IMPORTANT:
+// Like MFSLivesMountArgs, this structure must be invariant between 32- and 64-bits, 
+// which is why every field is a uint64_t.
+
+enum {
+    kMFSLivesSysctlHNodeStatistics = 1
+};
+
+struct MFSLivesHNodeStatistics {
+    uint64_t                fLookups;
+    uint64_t                fHits;
+    uint64_t                fMisses;
+    uint64_t                fVIDRetries;
+    uint64_t                fAttachSleeps;
+    uint64_t                fRacesLost;
+    uint64_t                fDetaches;
+    uint64_t                fReclaims;
+    uint64_t                fNodeCount;
+};
+typedef struct MFSLivesHNodeStatistics MFSLivesHNodeStatistics;
+
 #endif
@@ -88,11 +88,20 @@ struct MFSPMount {
     size_t          mapSize;                        // size of the above
     bool            mapped;                         // whether it's mmap'd or malloc'd
     size_t          blockSize;                      // device block size; we require 512
+    MFSTextEncoding encoding;                       // text encoding of names, as passed to MFSPMountCreate
     size_t          mdbAndVABMSizeInBytes;          // info returned by MFSMDBCheck
     uint16_t        directoryStartBlock;            // ditto
     uint16_t        directoryBlockCount;            // ditto
     uint16_t        allocationBlocksStartBlock;     // ditto
     uint32_t        allocationBlockSizeInBytes;     // ditto
+    uint16_t *      vabmTable;                      // VABM decoded by MFSVABMDecode
+    size_t          vabmTableSize;                  // number of entries in the above
+    void *          directoryIndexBuffer;           // memory for directoryIndex
+    MFSDirectoryIndex directoryIndex;               // built by MFSDirectoryIndexBuild
+    uint32_t *      nameHashSlots;                  // built by MFSDirectoryNameHashBuild
+    size_t          nameHashSlotCount;              // number of entries in the above
+    void *          nameCacheBuffer;                // memory for nameCache; NULL until the first MFSPMountGetFileName
+    MFSDirectoryNameCache nameCache;                // UTF-8 names, filled in lazily by MFSPMountGetFileName
 };
 typedef struct MFSPMount MFSPMount;
 
@@ -254,7 +263,7 @@ static int GetContainerInfo(int fd, off_t *containerOffsetPtr, size_t *container
     return err;
 }
 
-extern int MFSPMountCreate(const char *containerPath, MFSPMountRef *pmountPtr)
+extern int MFSPMountCreate(const char *containerPath, MFSTextEncoding encoding, MFSPMountRef *pmountPtr)
     // See comment in header.
 {
     int             err;
@@ -267,7 +276,7 @@ extern int MFSPMountCreate(const char *containerPath, MFSPMountRef *pmountPtr)
     assert( pmountPtr != NULL);
     assert(*pmountPtr == NULL);
     
-    if (gLog != NULL) fprintf(gLog, "[%ld]   MFSPMountCreate '%s'\n", (long) getpid(), containerPath);
+    if (gLog != NULL) fprintf(gLog, "[%ld]   MFSPMountCreate '%s' %u\n", (long) getpid(), containerPath, (unsigned int) encoding);
 
     // Prepare for failure.
     
@@ -283,6 +292,12 @@ extern int MFSPMountCreate(const char *containerPath, MFSPMountRef *pmountPtr)
         pmount->mapAddr = MAP_FAILED;
         pmount->mapped  = true;
     }
+    if ( (err == 0) && (encoding >= kMFSTextEncodingCount) ) {
+        err = EINVAL;
+    }
+    if (err == 0) {
+        pmount->encoding = encoding;
+    }
     
     // Open up the container.
 
@@ -384,6 +399,108 @@ extern int MFSPMountCreate(const char *containerPath, MFSPMountRef *pmountPtr)
         }
     }
 
+    // Decode the VABM once, so that building extent maps doesn't have to 
+    // unpack the 12 bit entries over and over again.
+    
+    if (err == 0) {
+        pmount->vabmTableSize = (pmount->mdbAndVABMSizeInBytes - 64) / 3 * 2;
+        pmount->vabmTable = malloc(pmount->vabmTableSize * sizeof(*pmount->vabmTable));
+        if (pmount->vabmTable == NULL) {
+            err = ENOMEM;
+        }
+    }
+    if (err == 0) {
+        err = MFSVABMDecode(
+            pmount->mapAddr + (kMFSMDBBlock * pmount->blockSize),
+            pmount->vabmTable,
+            pmount->vabmTableSize
+        );
+        if (gLog != NULL) fprintf(gLog, "[%ld]     MFSVABMDecode -> %d\n", (long) getpid(), err);
+    }
+
+    // Verify the volume's allocation structures.  Cross-linked forks, forks whose 
+    // length disagrees with their chain, and a bogus free count don't stop us 
+    // reading files, so we just log those.  However, a chain that loops or runs 
+    // off into the weeds would send the fork routines off into the weeds too, so 
+    // we refuse to deal with such a volume.  This means that everything after 
+    // this point can trust the VABM.
+    
+    if (err == 0) {
+        char                    tempBuffer[kMFSVolumeVerifyTempBufferSize];
+        MFSVolumeVerifyReport   report;
+        
+        err = MFSVolumeVerify(
+            pmount->mapAddr + (kMFSMDBBlock * pmount->blockSize),
+            pmount->mapAddr + (pmount->directoryStartBlock * pmount->blockSize),
+            pmount->blockSize,
+            tempBuffer,
+            &report
+        );
+        if (gLog != NULL) {
+            fprintf(gLog, "[%ld]     MFSVolumeVerify -> %d, files %lu, forks %lu, used %lu, free %lu/%lu, bad %lu, loop %lu, cross %lu, length %lu, first %lu\n", (long) getpid(), err,
+                (unsigned long) report.fileCount,
+                (unsigned long) report.forkCount,
+                (unsigned long) report.usedAllocationBlockCount,
+                (unsigned long) report.freeAllocationBlockCount,
+                (unsigned long) report.mdbFreeAllocationBlockCount,
+                (unsigned long) report.badChainCount,
+                (unsigned long) report.loopCount,
+                (unsigned long) report.crossLinkCount,
+                (unsigned long) report.lengthMismatchCount,
+                (unsigned long) report.firstBadFileNumber
+            );
+        }
+        if ( (err == EIO) && (report.badChainCount == 0) && (report.loopCount == 0) ) {
+            err = 0;
+        }
+        if (err == EIO) {
+            fprintf(stderr, "Damaged MFS disk (%lu broken and %lu looping allocation block chains)\n", (unsigned long) report.badChainCount, (unsigned long) report.loopCount);
+            err = ECANCELED;
+        }
+    }
+
+    // Index the directory, so that we never have to parse it again.
+    
+    if (err == 0) {
+        size_t  bufferSize;
+        
+        bufferSize = MFSDirectoryIndexGetBufferSize(pmount->directoryBlockCount, pmount->blockSize);
+        pmount->directoryIndexBuffer = malloc(bufferSize);
+        if (pmount->directoryIndexBuffer == NULL) {
+            err = ENOMEM;
+        }
+        if (err == 0) {
+            err = MFSDirectoryIndexBuild(
+                pmount->mapAddr + (pmount->directoryStartBlock * pmount->blockSize),
+                pmount->directoryStartBlock,
+                pmount->directoryBlockCount,
+                pmount->blockSize,
+                pmount->encoding,
+                pmount->directoryIndexBuffer,
+                bufferSize,
+                &pmount->directoryIndex
+            );
+        }
+        if (gLog != NULL) fprintf(gLog, "[%ld]     MFSDirectoryIndexBuild -> %d, %zu\n", (long) getpid(), err, pmount->directoryIndex.entryCount);
+    }
+    
+    // And hash the names in the index, so that looking up a file by name 
+    // doesn't have to scan the directory.
+    
+    if (err == 0) {
+        pmount->nameHashSlotCount = MFSDirectoryNameHashGetSlotCount(pmount->directoryIndex.entryCount);
+        pmount->nameHashSlots = malloc(pmount->nameHashSlotCount * sizeof(*pmount->nameHashSlots));
+        if (pmount->nameHashSlots == NULL) {
+            err = ENOMEM;
+        } else {
+            MFSDirectoryNameHashBuild(&pmount->directoryIndex, pmount->nameHashSlots, pmount->nameHashSlotCount);
+        }
+    }
+    
+    // We don't set up the name cache here.  It's sized for the worst case, and many 
+    // clients (for example, extracting a single file) never ask for a name, so 
+    // MFSPMountGetFileName creates it on first use.
+
     // Clean up.
     
     if (fd != -1) {
@@ -418,23 +535,44 @@ extern void MFSPMountDestroy(MFSPMountRef pmount)
         } else {
             free(pmount->mapAddr);
         }
+        free(pmount->vabmTable);
+        free(pmount->directoryIndexBuffer);
+        free(pmount->nameHashSlots);
+        free(pmount->nameCacheBuffer);
         free(pmount);
     }
 }
 
+extern MFSTextEncoding MFSPMountGetTextEncoding(MFSPMountRef pmount)
+    // See comment in header.
+{
+    assert(pmount != NULL);
+
+    return pmount->encoding;
+}
+
 extern const void * MFSPMountGetMDBVABM(MFSPMountRef pmount)
     // See comment in header.
 {
     return pmount->mapAddr + (kMFSMDBBlock * pmount->blockSize);
 }
 
+extern const void * MFSPMountGetDirectory(MFSPMountRef pmount, size_t *dirBlockCountPtr, size_t *dirBlockSizePtr)
+    // See comment in header.
+{
+    assert(pmount != NULL);
+    assert(dirBlockCountPtr != NULL);
+    assert(dirBlockSizePtr != NULL);
+    
+    *dirBlockCountPtr = pmount->directoryBlockCount;
+    *dirBlockSizePtr  = pmount->blockSize;
+    return pmount->mapAddr + (pmount->directoryStartBlock * pmount->blockSize);
+}
+
 extern int MFSPMountListFiles(MFSPMountRef pmount, MFSPMountFileInfo files[], size_t filesSize, size_t *fileCountPtr)
     // See comment in header.
 {
-    int                 err;
-    uint16_t            dirBlock;
-    size_t              dirOffset;
-    size_t              fileCount;
+    size_t              fileIndex;
 
     if (gLog != NULL) fprintf(gLog, "[%ld]   MFSPMountListFiles %zu\n", (long) getpid(), filesSize);
     
@@ -442,60 +580,87 @@ extern int MFSPMountListFiles(MFSPMountRef pmount, MFSPMountFileInfo files[], si
     assert( (filesSize == 0) || (files != NULL) );
     assert(fileCountPtr != NULL);
 
-    fileCount = 0;
-    
-    // Iterate through each directory block.
+    // The directory index already knows where every directory entry lives, 
+    // in directory order, so we just copy that out.
     
-    err = 0;
-    for (dirBlock = pmount->directoryStartBlock; dirBlock < (pmount->directoryStartBlock + pmount->directoryBlockCount); dirBlock++) {
-        const char *    thisDirBlockPtr;
-
-        if (gLog != NULL) fprintf(gLog, "[%ld]     dirBlock %d", (long) getpid(), (int) dirBlock);
-        
-        thisDirBlockPtr = pmount->mapAddr + (dirBlock * pmount->blockSize);
-        
-        dirOffset = kMFSDirectoryBlockIterateFromStart;
-        do {
-
-            // Find the next directory entry, and gather all of the necessary information about it.
-            
-            err = MFSDirectoryBlockIterate(
-                thisDirBlockPtr,
-                pmount->blockSize,
-                &dirOffset,
-                NULL
-            );
-            if (gLog != NULL) fprintf(gLog, " (%d, %zu)", err, dirOffset);
+    for (fileIndex = 0; (fileIndex < filesSize) && (fileIndex < pmount->directoryIndex.entryCount); fileIndex++) {
+        files[fileIndex].dirBlockPtr = pmount->mapAddr + (pmount->directoryIndex.dirBlocks[fileIndex] * pmount->blockSize);
+        files[fileIndex].dirOffset   = pmount->directoryIndex.dirOffsets[fileIndex];
+    }
 
-            // Now that we have everything we need to know about this directory entry, 
-            // let's record it in the files array.
-            
-            if (err == 0) {
-                if (fileCount < filesSize) {
-                    files[fileCount].dirBlockPtr = thisDirBlockPtr;
-                    files[fileCount].dirOffset   = dirOffset;
-                }
-                fileCount += 1;
-            }
-        } while (err == 0);
+    *fileCountPtr = pmount->directoryIndex.entryCount;
 
-        if (gLog != NULL) fprintf(gLog, "\n");
+    if (gLog != NULL) fprintf(gLog, "[%ld]   MFSPMountListFiles -> %d, %zu\n", (long) getpid(), 0, *fileCountPtr);
+    
+    return 0;
+}
 
-        if (err == ENOENT) {
-            // We ran off the end of this directory block, so swallow the error and 
-            // let's go to the next directory block.
-            err = 0;
-        } else {
-            // Any other error causes us to bail out.  It would be very weird if 
-            // this was no error.
-            assert(err != 0);
-            break;
-        }
+static int MFSPMountNameCacheCreate(MFSPMountRef pmount)
+    // Sets up an empty name cache for pmount.  Names are only converted to UTF-8 
+    // when someone asks for them, and then only once.
+{
+    int         err;
+    size_t      bufferSize;
+    
+    assert(pmount != NULL);
+    assert(pmount->nameCacheBuffer == NULL);
+    
+    err = 0;
+    bufferSize = MFSDirectoryNameCacheGetBufferSize(&pmount->directoryIndex);
+    pmount->nameCacheBuffer = malloc(bufferSize);
+    if (pmount->nameCacheBuffer == NULL) {
+        err = ENOMEM;
     }
+    if (err == 0) {
+        err = MFSDirectoryNameCacheInit(
+            &pmount->directoryIndex,
+            pmount->mapAddr + (pmount->directoryStartBlock * pmount->blockSize),
+            pmount->directoryStartBlock,
+            pmount->blockSize,
+            pmount->nameCacheBuffer,
+            bufferSize,
+            &pmount->nameCache
+        );
+    }
+    
+    // If anything failed, leave the pmount as it was, so the next call can try again.
+    
+    if (err != 0) {
+        free(pmount->nameCacheBuffer);
+        pmount->nameCacheBuffer = NULL;
+    }
+    
+    return err;
+}
 
-    *fileCountPtr = fileCount;
-
-    if (gLog != NULL) fprintf(gLog, "[%ld]   MFSPMountListFiles -> %d, %zu\n", (long) getpid(), err, fileCount);
+extern int MFSPMountGetFileName(MFSPMountRef pmount, const void *dirBlockPtr, size_t dirOffset, const char **utf8NamePtr)
+    // See comment in header.
+{
+    int         err;
+    size_t      entryIndex;
+    
+    assert(pmount != NULL);
+    assert(dirBlockPtr != NULL);
+    assert(utf8NamePtr != NULL);
+    assert( ((const char *) dirBlockPtr - pmount->mapAddr) % pmount->blockSize == 0 );
+    
+    *utf8NamePtr = NULL;
+    
+    err = 0;
+    if (pmount->nameCacheBuffer == NULL) {
+        err = MFSPMountNameCacheCreate(pmount);
+    }
+    if (err == 0) {
+        err = MFSDirectoryIndexFindEntry(
+            &pmount->directoryIndex, 
+            (uint16_t) (((const char *) dirBlockPtr - pmount->mapAddr) / pmount->blockSize), 
+            dirOffset, 
+            &entryIndex
+        );
+    }
+    if (err == 0) {
+        *utf8NamePtr = MFSDirectoryNameCacheGetName(&pmount->nameCache, entryIndex, NULL);
+    }
     
     return err;
 }
@@ -517,11 +682,10 @@ static int IteratorExtents(
     // For each of the extents of the forkIndex'th fork of the file whose directory is 
     // at dirOffset within dirBlock, call the callback.
 {
-    int             err;
-    MFSForkInfo     forkInfo;
-    uint32_t        forkOffset;
-    uint32_t        offsetFromFirstAllocationBlockInBytes;
-    uint32_t        contiguousPhysicalBytes;
+    int                 err;
+    MFSForkInfo         forkInfo;
+    MFSForkExtentCursor cursor;
+    MFSForkExtent       extent;
 
     assert(pmount != NULL);
     assert( (dirBlock >= pmount->directoryStartBlock) && (dirBlock < (pmount->directoryStartBlock + pmount->directoryBlockCount)) );
@@ -533,21 +697,23 @@ static int IteratorExtents(
     
     err = MFSDirectoryEntryGetForkInfo(pmount->mapAddr + (dirBlock * pmount->blockSize), dirOffset, forkIndex, &forkInfo);
 
-    // Iterate each entry.  Note that MFSForkGetExtent errors if the fork 
-    // has no data at all, so don't call it in that case.
+    // Iterate each extent.  We only visit each extent once, in order, so an 
+    // extent cursor does the job in one pass over the fork's allocation block 
+    // chain without allocating any memory.  Note that the cursor errors if the 
+    // fork has no data at all, so don't create it in that case.
     
     if ( (err == 0) && (forkInfo.lengthInBytes > 0) ) {
-        forkOffset = 0;
+        err = MFSForkExtentCursorInitWithVABMTable(
+            &cursor,
+            pmount->mapAddr + (kMFSMDBBlock * pmount->blockSize),
+            pmount->vabmTable,
+            &forkInfo
+        );
         
         do {
-            err = MFSForkGetExtent(
-                pmount->mapAddr + (kMFSMDBBlock * pmount->blockSize),
-                &forkInfo,
-                forkOffset,
-                &offsetFromFirstAllocationBlockInBytes,
-                &contiguousPhysicalBytes
-            );
-            
+            if (err == 0) {
+                err = MFSForkExtentCursorNext(&cursor, &extent);
+            }
             if (err == 0) {
                 size_t  extentSize;
                 
@@ -555,17 +721,14 @@ static int IteratorExtents(
                 // contiguousPhysicalBytes, which is the physical length of the 
                 // extent).
                 
-                extentSize = (forkInfo.lengthInBytes - forkOffset);
-                if (extentSize > contiguousPhysicalBytes) {
-                    extentSize = contiguousPhysicalBytes;
+                extentSize = (forkInfo.lengthInBytes - extent.forkOffsetInBytes);
+                if (extentSize > extent.contiguousPhysicalBytes) {
+                    extentSize = extent.contiguousPhysicalBytes;
                 }
-                err = callback(refCon, pmount->mapAddr + (pmount->allocationBlocksStartBlock * pmount->blockSize) + offsetFromFirstAllocationBlockInBytes, extentSize);
-                if (gLog != NULL) fprintf(gLog, "[%ld]     extent %lu %zu -> %d\n", (long) getpid(), (unsigned long) forkOffset, extentSize, err);
+                err = callback(refCon, pmount->mapAddr + (pmount->allocationBlocksStartBlock * pmount->blockSize) + extent.offsetFromFirstAllocationBlockInBytes, extentSize);
+                if (gLog != NULL) fprintf(gLog, "[%ld]     extent %lu %zu -> %d\n", (long) getpid(), (unsigned long) extent.forkOffsetInBytes, extentSize, err);
             }
-            if (err == 0) {
-                forkOffset += contiguousPhysicalBytes;
-            }
-        } while ( (err == 0) && (forkOffset < forkInfo.lengthInBytes) );
+        } while ( (err == 0) && ((extent.forkOffsetInBytes + extent.contiguousPhysicalBytes) < forkInfo.lengthInBytes) );
     }
     return err;
 }
@@ -735,7 +898,7 @@ static int ExtractFile(MFSPMountRef pmount, uint16_t dirBlock, size_t dirOffset,
         VATTR_WANTED(&attr, va_create_time);
         VATTR_WANTED(&attr, va_modify_time);
         
-        err = MFSDirectoryEntryGetAttr(pmount->mapAddr + (dirBlock * pmount->blockSize), dirOffset, &attr);
+        err = MFSDirectoryEntryGetAttr(pmount->mapAddr + (dirBlock * pmount->blockSize), dirOffset, pmount->encoding, &attr);
 
         // Set them for the destination file.
         
@@ -799,8 +962,8 @@ extern int MFSPMountExtractFile(MFSPMountRef pmount, const char *fileName, const
 
     err = 0;
     
-    // Search the directory for the requested file.  Start by allocating a 
-    // temporary buffer for use by MFSDirectoryBlockFindEntryByName.
+    // Look up the requested file in the name hash.  Start by allocating a 
+    // temporary buffer for use by MFSDirectoryNameHashLookupUTF8.
     
     if (err == 0) {
         tempBuffer = malloc(kMFSDirectoryBlockFindEntryByNameTempBufferSize);
@@ -809,39 +972,26 @@ extern int MFSPMountExtractFile(MFSPMountRef pmount, const char *fileName, const
         }
     }
     if (err == 0) {
-        // MFSDirectoryBlockFindEntryByName requires the first byte of the buffer 
-        // be zero on the first call.
+        size_t  entryIndex;
         
-        *tempBuffer = 0;
-
-        dirBlock = pmount->directoryStartBlock;
-        dirOffset = 0;              // to make the logging pretty in the case of an error
-
-        do {
-            if (dirBlock >= (pmount->directoryStartBlock + pmount->directoryBlockCount)) {
-                err = ENOENT;
-                break;
-            }
-            
-            if (gLog != NULL) fprintf(gLog, "[%ld]     dirBlock %d\n", (long) getpid(), (int) dirBlock);
-            
-            err = MFSDirectoryBlockFindEntryByName(
-                pmount->mapAddr + (dirBlock * pmount->blockSize),
-                pmount->blockSize,
-                fileName,
-                strlen(fileName),
-                tempBuffer,
-                &dirOffset,
-                NULL
-            );
-
-            if (err != ENOENT) {
-                break;
-            }
-            dirBlock += 1;
-        } while (true);
+        dirBlock = 0;               // to make the logging pretty in the case of an error
+        dirOffset = 0;
+
+        err = MFSDirectoryNameHashLookupUTF8(
+            &pmount->directoryIndex,
+            pmount->nameHashSlots,
+            pmount->nameHashSlotCount,
+            fileName,
+            strlen(fileName),
+            tempBuffer,
+            &entryIndex
+        );
+        if (err == 0) {
+            dirBlock  = pmount->directoryIndex.dirBlocks[entryIndex];
+            dirOffset = pmount->directoryIndex.dirOffsets[entryIndex];
+        }
         
-        if (gLog != NULL) fprintf(gLog, "[%ld]     dirOffset %d %zu\n", (long) getpid(), err, dirOffset);
+        if (gLog != NULL) fprintf(gLog, "[%ld]     dirOffset %d %d %zu\n", (long) getpid(), err, (int) dirBlock, dirOffset);
     }
     
     // Create the extracted file.
@@ -54,8 +54,11 @@ First checked in.
 #ifndef _MFSLIVESPSEUDOMOUNT_H
 #define _MFSLIVESPSEUDOMOUNT_H
 
+#include <stdint.h>
 #include <stdio.h>
 
+#include "MFSCore.h"
+
 /////////////////////////////////////////////////////////////////////
 
 // This module provides a relatively high-level abstraction for listing the directory 
@@ -74,13 +77,15 @@ extern void MFSPMountSetLogFile(FILE *logFile);
     // call this, the module does not generate any log entries.  If logFile is NULL, 
     // logging is disabled.
 
-extern int MFSPMountCreate(const char *containerPath, MFSPMountRef *pmountPtr);
+extern int MFSPMountCreate(const char *containerPath, MFSTextEncoding encoding, MFSPMountRef *pmountPtr);
     // Creates an MFSLives pseudomount for the specified container.  The container 
     // can be a Disk Copy 4.2 disk image file (.img), a raw disk image file 
     // (typically .bin, or .cdr, or .iso), or a cooked or raw disk device 
     // (for example, '/dev/disk1' or '/dev/rdisk1').
     //
     // containerPath must not be NULL.
+    // encoding is the text encoding of the names on the volume; it must be one of 
+    // the MFSTextEncoding values from "MFSCore.h", otherwise you get EINVAL
     // pmountPtr must not be NULL
     // On entry, *pmountPtr must be NULL
     // On success, *pmountPtr will be a reference to the pseudomount
@@ -90,10 +95,26 @@ extern void MFSPMountDestroy(MFSPMountRef pmount);
     // Destroys a pseudomount created using MFSPMountCreate.  pmount may be NULL, 
     // in which case this does nothing.
 
+extern MFSTextEncoding MFSPMountGetTextEncoding(MFSPMountRef pmount);
+    // Gets the text encoding that was passed to MFSPMountCreate.  Use this when 
+    // converting names, for example, those returned by MFSDirectoryBlockDecodeAll, 
+    // to UTF-8.
+
 extern const void * MFSPMountGetMDBVABM(MFSPMountRef pmount);
     // Gets the MDB/VABM pointer for the pseudomount.  This pointer is only 
     // valid as long as pmount exists.
 
+extern const void * MFSPMountGetDirectory(MFSPMountRef pmount, size_t *dirBlockCountPtr, size_t *dirBlockSizePtr);
+    // Gets a pointer to the pseudomount's directory, which consists of 
+    // *dirBlockCountPtr contiguous blocks of *dirBlockSizePtr bytes each.  You 
+    // can pass each block to the MFS core's directory block routines (for 
+    // example, MFSDirectoryBlockDecodeAll).  This pointer is only valid as long 
+    // as pmount exists.
+    //
+    // pmount must not be NULL.
+    // dirBlockCountPtr must not be NULL.
+    // dirBlockSizePtr must not be NULL.
+
 // The MFSPMountFileInfo structure holds the information needed to location a 
 // directory entry on an MFS pseudomount.
 
@@ -118,6 +139,26 @@ extern int MFSPMountListFiles(MFSPMountRef pmount, MFSPMountFileInfo files[], si
     // The dirBlockPtr fields of the result files entries are only valid as long as 
     // pmount exists.
 
+extern int MFSPMountGetFileName(MFSPMountRef pmount, const void *dirBlockPtr, size_t dirOffset, const char **utf8NamePtr);
+    // Gets the UTF-8 name of the directory entry at dirOffset within the directory 
+    // block at dirBlockPtr.  You can get these from the fields of an 
+    // MFSPMountFileInfo returned by MFSPMountListFiles, or by walking the blocks 
+    // returned by MFSPMountGetDirectory.  Each name is converted the first time 
+    // you ask for it and cached for the life of the pseudomount, so listing a 
+    // directory repeatedly is cheap.  The cache itself is allocated by the first 
+    // call, so a pseudomount that never asks for a name doesn't pay for it.
+    //
+    // pmount must not be NULL
+    // dirBlockPtr must point to the start of one of pmount's directory blocks
+    // dirOffset must be the offset of a directory entry within that block
+    // utf8NamePtr must not be NULL
+    // On entry, *utf8NamePtr is ignored
+    // On success, *utf8NamePtr is a null terminated UTF-8 string that is only 
+    // valid as long as pmount exists
+    // On error, *utf8NamePtr will be NULL
+    //
+    // This routine is not thread safe.
+
 extern int MFSPMountExtractFile(MFSPMountRef pmount, const char *fileName, const char *outputFilePath);
     // Extracts the file named fileName from the pseudomount and writes it to the 
     // file at outputFilePath (which must not exist).
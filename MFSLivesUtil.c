@@ -71,6 +71,8 @@ First checked in.
 #include <sys/disk.h>
 #include <sys/loadable_fs.h>
 #include <sys/mman.h>
+#include <sys/mount.h>
+#include <sys/sysctl.h>
 #include <sys/xattr.h>
 
 #include <libkern/OSByteOrder.h>        /** OSReadBigInt32() */
@@ -79,6 +81,7 @@ First checked in.
 
 #include "MFSCore.h"
 #include "MFSLivesPseudoMount.h"
+#include "MFSLivesMountArgs.h"
 
 /////////////////////////////////////////////////////////////////////
 
@@ -86,6 +89,8 @@ static FILE *   gLog;
 
 static int gVerbose;
 
+static MFSTextEncoding gEncoding = kMFSTextEncodingMacRoman;     // set by the -e option
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Commands to Support DiskArb
 
@@ -221,7 +226,7 @@ static int ProbeCommand(const char *diskDeviceName)
         VFSATTR_WANTED(&attr, f_vol_name);
         attr.f_vol_name = volumeName;
         
-        err = MFSMDBGetAttr(buf, &attr);
+        err = MFSMDBGetAttr(buf, gEncoding, &attr);
         if (err != 0) {
             volumeName[0] = 0;
         }
@@ -314,7 +319,7 @@ static int ProbeCommand(const char *diskDeviceName)
 
 #pragma mark - List Command
 
-static void OSTypeToUTF8String(uint8_t *ostPtr, char *utf8Name, size_t utf8NameSize)
+static void OSTypeToUTF8String(const uint8_t *ostPtr, char *utf8Name, size_t utf8NameSize)
     // Convert an OSType to a UTF-8 string, handling byte reversal, the possibility 
     // of null characters, and the MacRoman-to-UTF-8 conversion.  Why is this so hard?
 {
@@ -342,62 +347,65 @@ static void OSTypeToUTF8String(uint8_t *ostPtr, char *utf8Name, size_t utf8NameS
         pstr[i + 1] = ch;
     }
 
-    // Convert to UTF-8.
+    // Convert to UTF-8.  OSTypes are always MacRoman, regardless of the 
+    // encoding of the file names.
     
-    sizeNeeded = MFSNameToUTF8(pstr, utf8Name, utf8NameSize);
+    sizeNeeded = MFSNameToUTF8(pstr, kMFSTextEncodingMacRoman, utf8Name, utf8NameSize);
     assert(sizeNeeded <= utf8NameSize);     // if this fails, we've truncated
 }
 
-static void PrintDirectoryEntry(const struct vnode_attr *attr, uint8_t finderInfo[], const MFSForkInfo forkInfos[])
+static void PrintDirectoryEntry(const MFSDirectoryEntryInfo *entry, const char *name)
     // Pretty prints an MFS directory entry in one of three ways depending on 
     // the setting of gVerbose.
     //
-    // finderInfo points to an array of 16 bytes.
-    // forkInfos points to an array of two elements, indexed by the forkIndex.
+    // entry points to the entry, as decoded by MFSDirectoryBlockDecodeAll.
+    // name is the entry's name, already converted to UTF-8.
 {
     char            fileTypeStr[32];
     char            fileCreatorStr[32];
     int             i;
+    time_t          dateTime;
     struct tm       tm;
     char            dateTimeStr[256];
     size_t          size;
 
-    assert(attr != NULL);
-    assert(finderInfo != NULL);
-    assert(forkInfos != NULL);
+    assert(entry != NULL);
+    assert(name != NULL);
     
     switch (gVerbose) {
         case 0:
-            fprintf(stdout, "%s\n", attr->va_name);
+            fprintf(stdout, "%s\n", name);
             break;
         case 1:
-            OSTypeToUTF8String(&finderInfo[0], fileTypeStr,    sizeof(fileTypeStr)   );
-            OSTypeToUTF8String(&finderInfo[4], fileCreatorStr, sizeof(fileCreatorStr));
+            OSTypeToUTF8String(&entry->finderInfo[0], fileTypeStr,    sizeof(fileTypeStr)   );
+            OSTypeToUTF8String(&entry->finderInfo[4], fileCreatorStr, sizeof(fileCreatorStr));
             // type crea size size name
-            fprintf(stdout, "%10u %s %s %10u %10u %s\n", (unsigned int) attr->va_fileid, fileTypeStr, fileCreatorStr, forkInfos[0].lengthInBytes, forkInfos[1].lengthInBytes, attr->va_name);
+            fprintf(stdout, "%10u %s %s %10u %10u %s\n", (unsigned int) (entry->fileNumber - 1 + kMFSFirstFileInodeName), fileTypeStr, fileCreatorStr, entry->forkInfos[0].lengthInBytes, entry->forkInfos[1].lengthInBytes, name);
             break;
         default:
-            fprintf(stdout, "name: %s\n", attr->va_name);
-            fprintf(stdout, "fileNumber: %u\n", (unsigned int) attr->va_fileid);
+            fprintf(stdout, "name: %s\n", name);
+            fprintf(stdout, "fileNumber: %u\n", (unsigned int) (entry->fileNumber - 1 + kMFSFirstFileInodeName));
             fprintf(stdout, "finderInfo:");
             for (i = 0; i < 16; i++) {
-                fprintf(stdout, " %02x", finderInfo[i]);
+                fprintf(stdout, " %02x", entry->finderInfo[i]);
             }
             fprintf(stdout, "\n");
-            fprintf(stdout, "dataLengthInBytes: %u\n", forkInfos[0].lengthInBytes);
-            fprintf(stdout, "dataPhysicalLengthInBytes: %u\n", forkInfos[0].physicalLengthInBytes);
-            fprintf(stdout, "rsrcLengthInBytes: %u\n", forkInfos[1].lengthInBytes);
-            fprintf(stdout, "rsrcPhysicalLengthInBytes: %u\n", forkInfos[1].physicalLengthInBytes);
+            fprintf(stdout, "dataLengthInBytes: %u\n", entry->forkInfos[0].lengthInBytes);
+            fprintf(stdout, "dataPhysicalLengthInBytes: %u\n", entry->forkInfos[0].physicalLengthInBytes);
+            fprintf(stdout, "rsrcLengthInBytes: %u\n", entry->forkInfos[1].lengthInBytes);
+            fprintf(stdout, "rsrcPhysicalLengthInBytes: %u\n", entry->forkInfos[1].physicalLengthInBytes);
 
             // For an explanation of why I use gmtime_r and not localtime_r here, see 
             // the "Dates/Time Values" comment in "MFSCore.h".
             
-            (void) gmtime_r(&attr->va_create_time.tv_sec, &tm);
+            dateTime = MFSDateTimeToTimeSpec(entry->creationDate).tv_sec;
+            (void) gmtime_r(&dateTime, &tm);
             size = strftime(dateTimeStr, sizeof(dateTimeStr), "%a, %d %b %Y %H:%M:%S %Z", &tm);
             assert(size != 0);
             fprintf(stdout, "creationDate: %s\n", dateTimeStr);
 
-            (void) gmtime_r(&attr->va_modify_time.tv_sec, &tm);
+            dateTime = MFSDateTimeToTimeSpec(entry->modificationDate).tv_sec;
+            (void) gmtime_r(&dateTime, &tm);
             size = strftime(dateTimeStr, sizeof(dateTimeStr), "%a, %d %b %Y %H:%M:%S %Z", &tm);
             assert(size != 0);
             fprintf(stdout, "modificationDate: %s\n", dateTimeStr);
@@ -406,84 +414,68 @@ static void PrintDirectoryEntry(const struct vnode_attr *attr, uint8_t finderInf
 }
 
 static int ListCommand(const char *containerPath)
-    // Implements the list command.  Pseudo mounts the 'volume' and iterates 
+    // Implements the list command.  Pseudo mounts the 'volume' and decodes 
     // each directory block, printing the results.
 {
-    int                 err;
-    MFSPMountRef        pmount;
-    size_t              fileCountToAlloc;
-    size_t              fileCount;
-    size_t              fileIndex;
-    MFSPMountFileInfo * files;
-    struct vnode_attr   attr;
+    int                     err;
+    MFSPMountRef            pmount;
+    const char *            directoryPtr;
+    size_t                  dirBlockCount;
+    size_t                  dirBlockSize;
+    size_t                  dirBlockIndex;
+    size_t                  entriesSize;
+    MFSDirectoryEntryInfo * entries;
+    size_t                  entryCount;
+    size_t                  entryIndex;
+    size_t                  fileIndex;
     
     assert(containerPath != NULL);
 
     if (gLog != NULL) fprintf(gLog, "[%ld] List '%s'\n", (long) getpid(), containerPath);
 
-    pmount = NULL;
-    files  = NULL;
+    pmount  = NULL;
+    entries = NULL;
     
     // Pseudo mount the 'volume'.
     
-    err = MFSPMountCreate(containerPath, &pmount);
+    err = MFSPMountCreate(containerPath, gEncoding, &pmount);
 
-    // Get the directory list.
+    // Allocate an array big enough to hold every entry in a directory block.
     
     if (err == 0) {
-        err = MFSPMountListFiles(pmount, NULL, 0, &fileCountToAlloc);
-    }
-    if (err == 0) {
-        files = malloc(fileCountToAlloc * sizeof(*files));
-        if (files == NULL) {
+        directoryPtr = (const char *) MFSPMountGetDirectory(pmount, &dirBlockCount, &dirBlockSize);
+        
+        entriesSize = MFSDirectoryBlockGetMaximumEntryCount(dirBlockSize);
+        entries = malloc(entriesSize * sizeof(*entries));
+        if (entries == NULL) {
             err = ENOMEM;
         }
     }
-    if (err == 0) {
-        err = MFSPMountListFiles(pmount, files, fileCountToAlloc, &fileCount);
-    }
     
-    // Print it.
+    // Decode each directory block in one go, and then print its entries.
     
     if (err == 0) {
-        assert(fileCount == fileCountToAlloc);
-
-        for (fileIndex = 0; fileIndex < fileCount; fileIndex++) {
-            char            name[MAXPATHLEN];
-            MFSForkInfo     forkInfos[2];
-            uint8_t         finderInfo[16];
-            
-            name[0] = 0;    // init to empty string to allow logging even if we get an error
-            
-            // Gather all of the necessary information about the directory entry.
-            
-            VATTR_INIT(&attr);
-            attr.va_name = name;
-            VATTR_WANTED(&attr, va_name);
-            VATTR_WANTED(&attr, va_fileid);
-            VATTR_WANTED(&attr, va_create_time);
-            VATTR_WANTED(&attr, va_modify_time);
-            
-            err = MFSDirectoryEntryGetAttr(
-                files[fileIndex].dirBlockPtr,
-                files[fileIndex].dirOffset,
-                &attr
-            );
-            if (err == 0) {
-                err = MFSDirectoryEntryGetFinderInfo(files[fileIndex].dirBlockPtr, files[fileIndex].dirOffset, &finderInfo);
-            }
-            if (err == 0) {
-                err = MFSDirectoryEntryGetForkInfo(files[fileIndex].dirBlockPtr, files[fileIndex].dirOffset, 0, &forkInfos[0]);
-            }
-            if (err == 0) {
-                err = MFSDirectoryEntryGetForkInfo(files[fileIndex].dirBlockPtr, files[fileIndex].dirOffset, 1, &forkInfos[1]);
+        fileIndex = 0;
+        for (dirBlockIndex = 0; dirBlockIndex < dirBlockCount; dirBlockIndex++) {
+            err = MFSDirectoryBlockDecodeAll(directoryPtr + (dirBlockIndex * dirBlockSize), dirBlockSize, entries, entriesSize, &entryCount);
+            if (err != 0) {
+                break;
             }
-            if (gLog != NULL) fprintf(gLog, "[%ld]  %3d %3zu %3zu '%s'\n", (long) getpid(), err, fileIndex, files[fileIndex].dirOffset, name);
-
-            // Now that we have everything we need to know about this directory entry, 
-            // let's print it.
+            assert(entryCount <= entriesSize);
             
-            if (err == 0) {
+            for (entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+                const char *        name;
+                
+                // Get the name from the pseudomount's name cache rather than 
+                // converting it ourselves.
+                
+                err = MFSPMountGetFileName(pmount, directoryPtr + (dirBlockIndex * dirBlockSize), entries[entryIndex].dirOffset, &name);
+                if (err != 0) {
+                    break;
+                }
+
+                if (gLog != NULL) fprintf(gLog, "[%ld]  %3d %3zu %3u '%s'\n", (long) getpid(), err, fileIndex, (unsigned int) entries[entryIndex].dirOffset, name);
+
                 // It's kinda ugly testing gVerbose here, but I prefer it to passing fileIndex 
                 // to PrintDirectoryEntry.
                 
@@ -491,14 +483,19 @@ static int ListCommand(const char *containerPath)
                     fprintf(stdout, "\n");
                 }
                 
-                PrintDirectoryEntry(&attr, finderInfo, forkInfos);
+                PrintDirectoryEntry(&entries[entryIndex], name);
+                
+                fileIndex += 1;
+            }
+            if (err != 0) {
+                break;
             }
         }
     }
     
     // Clean up.
     
-    free(files);
+    free(entries);
     MFSPMountDestroy(pmount);
     
     // Print the error, unless the underlying code has already done so (indicated 
@@ -533,7 +530,7 @@ static int ExtractCommand(const char *containerPath, const char *fileName, const
     
     // Initialise the MFS core.
     
-    err = MFSPMountCreate(containerPath, &pmount);
+    err = MFSPMountCreate(containerPath, gEncoding, &pmount);
     
     // Do the work.
     
@@ -556,9 +553,100 @@ static int ExtractCommand(const char *containerPath, const char *fileName, const
     return ((err == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
+#pragma mark - Statistics Command
+
+static int StatisticsCommand(void)
+    // Implements the statistics command.  Gets the vnode cache statistics from 
+    // the MFSLives KEXT (which must be loaded) and prints them.
+{
+    int                     err;
+    struct vfsconf          vfc;
+    int                     mib[3];
+    MFSLivesHNodeStatistics stats;
+    size_t                  statsSize;
+
+    if (gLog != NULL) fprintf(gLog, "[%ld] Statistics\n", (long) getpid());
+
+    // Find our file system's type number, which is only known once the 
+    // KEXT has registered with VFS.
+    
+    err = 0;
+    if ( getvfsbyname("MFSLives", &vfc) < 0 ) {
+        err = errno;
+    }
+    
+    // Get the statistics.
+    
+    if (err == 0) {
+        mib[0] = CTL_VFS;
+        mib[1] = vfc.vfc_typenum;
+        mib[2] = kMFSLivesSysctlHNodeStatistics;
+        
+        statsSize = sizeof(stats);
+        if ( sysctl(mib, sizeof(mib) / sizeof(*mib), &stats, &statsSize, NULL, 0) < 0 ) {
+            err = errno;
+        } else if (statsSize != sizeof(stats)) {
+            err = EINVAL;
+        }
+    }
+    
+    // Print them.
+    
+    if (err == 0) {
+        fprintf(stdout, "lookups: %llu\n",       (unsigned long long) stats.fLookups);
+        fprintf(stdout, "hits: %llu\n",          (unsigned long long) stats.fHits);
+        fprintf(stdout, "misses: %llu\n",        (unsigned long long) stats.fMisses);
+        fprintf(stdout, "vidRetries: %llu\n",    (unsigned long long) stats.fVIDRetries);
+        fprintf(stdout, "attachSleeps: %llu\n",  (unsigned long long) stats.fAttachSleeps);
+        fprintf(stdout, "racesLost: %llu\n",     (unsigned long long) stats.fRacesLost);
+        fprintf(stdout, "detaches: %llu\n",      (unsigned long long) stats.fDetaches);
+        fprintf(stdout, "reclaims: %llu\n",      (unsigned long long) stats.fReclaims);
+        fprintf(stdout, "nodeCount: %llu\n",     (unsigned long long) stats.fNodeCount);
+    }
+    
+    if (err != 0) {
+        errno = err;
+        perror(NULL);
+    }
+    
+    return ((err == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Main etc
 
+// kEncodingNames maps the names accepted by the -e option to MFSTextEncoding values.
+
+static const struct {
+    const char *        name;
+    MFSTextEncoding     encoding;
+} kEncodingNames[] = {
+    { "MacRoman",         kMFSTextEncodingMacRoman         },
+    { "MacCentralEurope", kMFSTextEncodingMacCentralEurope },
+    { "MacCyrillic",      kMFSTextEncodingMacCyrillic      }
+};
+
+static bool ParseEncodingName(const char *name, MFSTextEncoding *encodingPtr)
+    // Sets *encodingPtr to the encoding whose name (ignoring case) is name. 
+    // Returns false if there's no such encoding.
+{
+    bool        result;
+    size_t      nameIndex;
+    
+    assert(name != NULL);
+    assert(encodingPtr != NULL);
+    
+    result = false;
+    for (nameIndex = 0; nameIndex < (sizeof(kEncodingNames) / sizeof(kEncodingNames[0])); nameIndex++) {
+        if ( strcasecmp(name, kEncodingNames[nameIndex].name) == 0 ) {
+            *encodingPtr = kEncodingNames[nameIndex].encoding;
+            result = true;
+            break;
+        }
+    }
+    return result;
+}
+
 static void PrintUsage(const char *argv0)
     // Print a helpful help message.
 {
@@ -571,13 +659,17 @@ static void PrintUsage(const char *argv0)
         progName += 1;
     }
     fprintf(stderr, "usage: %s [-v] -p diskDeviceName info...\n", progName);
-    fprintf(stderr, "       %s [-v] -L containerPath\n", progName);
-    fprintf(stderr, "       %s [-v] -X containerPath fileName [ outputFilePath ]\n", progName);
+    fprintf(stderr, "       %s [-v] [-e encoding] -L containerPath\n", progName);
+    fprintf(stderr, "       %s [-v] [-e encoding] -X containerPath fileName [ outputFilePath ]\n", progName);
+    fprintf(stderr, "       %s [-v] -S\n", progName);
     fprintf(stderr, "    where:\n");
     fprintf(stderr, "        o diskDeviceName is the name of a disk device (for example, 'disk1')\n");
     fprintf(stderr, "        o containerPath is the path to a Disk Copy 4.2 file (.img), a raw disk \n");
     fprintf(stderr, "          image file (typically .bin, or .cdr, or .iso), or a cooked or raw \n");
     fprintf(stderr, "          disk device (for example, '/dev/disk1' or '/dev/rdisk1')\n");
+    fprintf(stderr, "        o encoding is the text encoding of the file names on the volume; one of \n");
+    fprintf(stderr, "          MacRoman (the default), MacCentralEurope or MacCyrillic\n");
+    fprintf(stderr, "        o -S prints the vnode cache statistics of the loaded MFSLives KEXT\n");
     
 }
 
@@ -591,7 +683,8 @@ extern int main(int argc, char **argv)
         kCommandUnspecified,
         kCommandProbe,
         kCommandList,
-        kCommandExtract
+        kCommandExtract,
+        kCommandStatistics
     } command;
     
     // Set up logging
@@ -623,12 +716,18 @@ extern int main(int argc, char **argv)
     
     retVal = FSUR_IO_SUCCESS;
     do {
-        ch = getopt(argc, argv, "vpLX");
+        ch = getopt(argc, argv, "vpLXSe:");
         if (ch != -1) {
             switch (ch) {
                 case 'v':
                     gVerbose += 1;
                     break;
+                case 'e':
+                    if ( ! ParseEncodingName(optarg, &gEncoding) ) {
+                        PrintUsage(argv[0]);
+                        retVal = FSUR_INVAL;
+                    }
+                    break;
                 case 'p':
                     if (command == kCommandUnspecified) {
                         command = kCommandProbe;
@@ -653,6 +752,14 @@ extern int main(int argc, char **argv)
                         retVal = FSUR_INVAL;
                     }
                     break;
+                case 'S':
+                    if (command == kCommandUnspecified) {
+                        command = kCommandStatistics;
+                    } else {
+                        PrintUsage(argv[0]);
+                        retVal = FSUR_INVAL;
+                    }
+                    break;
                 case '?':
                 default:
                     PrintUsage(argv[0]);
@@ -691,6 +798,13 @@ extern int main(int argc, char **argv)
                     printUsage = true;
                 }
                 break;
+            case kCommandStatistics:
+                if (optind == argc) {
+                    retVal = StatisticsCommand();
+                } else {
+                    printUsage = true;
+                }
+                break;
             default:
                 PrintUsage(argv[0]);
                 retVal = FSUR_INVAL;
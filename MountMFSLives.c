@@ -460,7 +460,7 @@ static int LoadKEXT(void)
     return err;
 }
 
-static int DoMount(const char *devNode, const char *mountPoint, int flags, bool forceMount, bool forceFailure)
+static int DoMount(const char *devNode, const char *mountPoint, int flags, bool forceMount, bool forceFailure, bool nameCache)
     // Mount the file system.  devNode, mountPoint and flags are all standard 
     // mount arguments.  The remaining arguments are MFSLives specific and 
     // are passed to the kernel as part of the mount parameter block 
@@ -486,6 +486,7 @@ static int DoMount(const char *devNode, const char *mountPoint, int flags, bool
         mountArgs.fMagic        = kMFSLivesMountArgsMagic;
         mountArgs.fForceMount   = forceMount;
         mountArgs.fForceFailure = forceFailure;
+        mountArgs.fNameCache    = nameCache;
         
         err = mount("MFSLives", realMountPoint, flags, &mountArgs);
         if (err < 0) {
@@ -528,7 +529,9 @@ static void PrintUsage(const char *argv0)
     } else {
         progName += 1;
     }
-    fprintf(stderr, "usage: %s [-v] [-F] [-o option] special-device filesystem-node\n", progName);
+    fprintf(stderr, "usage: %s [-v] [-F] [-n] [-o option] special-device filesystem-node\n", progName);
+    fprintf(stderr, "    -n caches converted file names, which speeds up repeated directory listings \n");
+    fprintf(stderr, "       at the cost of wired memory proportional to the directory size\n");
     fprintf(stderr, "    options:\n");
     MountOptionsPrintUsage(stderr, 8, kMountOptions);
 }
@@ -542,6 +545,7 @@ extern int main(int argc, char **argv)
     int         ch;
     bool        forceMount;
     bool        forceFailure;
+    bool        nameCache;
     int         mountFlags;
     
     // Set up logging
@@ -569,11 +573,12 @@ extern int main(int argc, char **argv)
     
     forceMount   = false;
     forceFailure = false;
+    nameCache    = false;
     mountFlags = 0;
     
     retVal = EXIT_SUCCESS;
     do {
-        ch = getopt(argc, argv, "vFo:");
+        ch = getopt(argc, argv, "vFno:");
         if (ch != -1) {
             switch (ch) {
                 case 'v':
@@ -585,6 +590,9 @@ extern int main(int argc, char **argv)
                 case 'F':
                     forceFailure = true;
                     break;
+                case 'n':
+                    nameCache = true;
+                    break;
                 case 'o':
                     err = MountOptionsParseString(optarg, kMountOptions, &mountFlags);
                     if (err != 0) {
@@ -635,7 +643,7 @@ extern int main(int argc, char **argv)
         
         // Do the mount.
         
-        err = DoMount(argv[optind], argv[optind + 1], mountFlags, forceMount, forceFailure);
+        err = DoMount(argv[optind], argv[optind + 1], mountFlags, forceMount, forceFailure, nameCache);
 
         // If it fails, process the error.
         
@@ -78,12 +78,16 @@ static void StrLCatHighBitPretty(char *buf, const uint8_t *str, size_t bufSize)
     }
 }
 
-static void __attribute__ ((unused)) PrintMacRomanToUTF8Table(int nf) 
+static void PrintToUTF8Table(CFStringEncoding encoding, const char *encodingName, int nf) 
+    // Prints a table that maps each of the top 128 characters of the specified 
+    // (single byte, ASCII-based) encoding to its UTF-8 equivalent, in the 
+    // normalisation form specified by nf, along with the length of the longest 
+    // such UTF-8 sequence.
 {
     UInt8   ch;
     CFIndex utf8CountMax;
     
-    fprintf(stdout, "static const char * kMacRomanToUTF8[128] = {\n");
+    fprintf(stdout, "static const CharToUTF8Entry k%sToUTF8[128] = {\n", encodingName);
     
     utf8CountMax = 0;
     ch = 128;
@@ -97,7 +101,7 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8Table(int nf)
         CFMutableStringRef  canonStr;
         char                out[256];
         
-        str = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), kCFStringEncodingMacRoman, false);
+        str = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), encoding, false);
         assert(str != NULL);
 
         canonStr = CFStringCreateMutableCopy(NULL, 0, str);
@@ -124,6 +128,7 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8Table(int nf)
         
         assert(utf8Count < (sizeof(utf8Buffer) - 1));
         utf8Buffer[utf8Count] = 0;
+        assert(utf8Count <= 4);         // must fit in CharToUTF8Entry.utf8
         
         if (utf8Count > utf8CountMax) {
             utf8CountMax = utf8Count;
@@ -144,15 +149,15 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8Table(int nf)
         fprintf(stdout, "%-19s ", out);
         // fprintf(stdout, "%s ", out);
         
-        strlcpy(out, "\"", sizeof(out));
+        snprintf(out, sizeof(out), "{ %ld, \"", (long) utf8Count);
         StrLCatHighBitPretty(out, utf8Buffer, sizeof(out));
-        strlcat(out, "\"", sizeof(out));
+        strlcat(out, "\" }", sizeof(out));
 
         if (ch != 255) {
             strlcat(out, ", ", sizeof(out));
         }
 
-        fprintf(stdout, "%-16s", out);
+        fprintf(stdout, "%-24s", out);
         
         if ( (ch % 4) == 3) {
             fprintf(stdout, "\n");
@@ -166,14 +171,14 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8Table(int nf)
 
     fprintf(stdout, "};\n");
     
-    fprintf(stdout, "\nconst int kMacRomanToUTF8Expansion = %ld;\n", (long) utf8CountMax);
+    fprintf(stdout, "\nenum { k%sToUTF8Expansion = %ld };\n", encodingName, (long) utf8CountMax);
 }
 
 static void __attribute__ ((unused)) PrintMacRomanToUTF8TableSimple(void) 
 {
     UInt8   ch;
     
-    fprintf(stdout, "static const char * kMacRomanToUTF8[128] = {\n");
+    fprintf(stdout, "static const CharToUTF8Entry kMacRomanToUTF8[128] = {\n");
     
     // The MFS core code optimises away the ASCII case (the bottom 128 characters), 
     // so we only include information about the top 128 characters.
@@ -196,6 +201,7 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8TableSimple(void)
         
         assert(utf8Count < (sizeof(utf8Buffer) - 1));
         utf8Buffer[utf8Count] = 0;
+        assert(utf8Count <= 4);         // must fit in CharToUTF8Entry.utf8
         
         if ( (ch % 4) == 0 ) {
             fprintf(stdout, "    /* 0x%02X */ ", ch);
@@ -203,15 +209,15 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF8TableSimple(void)
         
         fprintf(stdout, "/* U+%04X */ ", CFStringGetCharacterAtIndex(str, 0));
         
-        strlcpy(out, "\"", sizeof(out));
+        snprintf(out, sizeof(out), "{ %ld, \"", (long) utf8Count);
         StrLCatHighBitPretty(out, utf8Buffer, sizeof(out));
-        strlcat(out, "\"", sizeof(out));
+        strlcat(out, "\" }", sizeof(out));
 
         if (ch != 255) {
             strlcat(out, ", ", sizeof(out));
         }
 
-        fprintf(stdout, "%-16s", out);
+        fprintf(stdout, "%-24s", out);
         
         if ( (ch % 4) == 3) {
             fprintf(stdout, "\n");
@@ -457,7 +463,7 @@ static void __attribute__ ((unused)) PrintMacRomanToUTF16Table(void)
 
 struct UniCharInfo {
     uint16_t    utf16Char;
-    uint8_t     macRomanChar;
+    uint8_t     mfsChar;
 };
 typedef struct UniCharInfo UniCharInfo;
 
@@ -480,22 +486,22 @@ static int UniCharInfoSorter(const void *p1, const void *p2)
     return result;
 }
 
-static void __attribute__ ((unused)) PrintUTF16ToMacRoman(void)
+static void GetUTF16ToEncodingMap(CFStringEncoding encoding, UniCharInfo charMap[128])
+    // Fills in charMap with the UTF-16 equivalent of each of the top 128 
+    // characters of the specified encoding, sorted by UTF-16 code point.
 {
     uint8_t         ch;
     CFStringRef     str;
-    UniCharInfo     charMap[128];
-    int             i;
     
     ch = 128;
     do {
-        str = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), kCFStringEncodingMacRoman, false);
+        str = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), encoding, false);
         assert(str != NULL);
         
         assert(CFStringGetLength(str) == 1);
         
-        charMap[ch - 128].utf16Char    = CFStringGetCharacterAtIndex(str, 0);
-        charMap[ch - 128].macRomanChar = ch;
+        charMap[ch - 128].utf16Char = CFStringGetCharacterAtIndex(str, 0);
+        charMap[ch - 128].mfsChar   = ch;
         
         CFRelease(str);
         
@@ -503,37 +509,103 @@ static void __attribute__ ((unused)) PrintUTF16ToMacRoman(void)
     } while (ch != 0);
     
     qsort(charMap, 128, sizeof(UniCharInfo), UniCharInfoSorter);
+}
 
-    fprintf(stdout, "struct UniCharInfo {\n");
-    fprintf(stdout, "    uint16_t   utf16Char;\n");
-    fprintf(stdout, "    uint8_t    macRomanChar;\n");
-    fprintf(stdout, "};\n");
-    fprintf(stdout, "\n");
-    fprintf(stdout, "typedef struct UniCharInfo UniCharInfo;\n");
-    fprintf(stdout, "static const UniCharInfo kUTF16ToMacRoman[128] = {\n");
-
+static void PrintUTF16ToEncodingPageTable(CFStringEncoding encoding, const char *encodingName)
+    // Prints a two-level table that maps a UTF-16 code point to its equivalent 
+    // in the specified encoding.  The first level, indexed by the high byte of 
+    // the code point, yields a page number.  The second level, indexed by that 
+    // page number and then the low byte of the code point, yields the encoded 
+    // character, or 0 if there isn't one.  Page 0 is all zeros, and every high 
+    // byte that has no equivalents maps to it.
+    //
+    // 0 works as the 'no equivalent' sentinel because character 0 is the ASCII 
+    // null character, and the MFS core handles ASCII before it gets to this 
+    // table.
+{
+    UniCharInfo     charMap[128];
+    uint8_t         pageIndex[256];
+    uint8_t         pages[256][256];
+    uint16_t        pageHighBytes[256];
+    int             pageCount;
+    int             i;
+    int             page;
+    int             highByte;
+    int             lowByte;
+    
+    GetUTF16ToEncodingMap(encoding, charMap);
+    
+    // Build the tables.  Because charMap is sorted, pages end up in order of 
+    // increasing high byte.
+    
+    memset(pageIndex, 0, sizeof(pageIndex));
+    memset(pages, 0, sizeof(pages));
+    pageCount = 1;
     for (i = 0; i < 128; i++) {
-        if ( (i % 8) == 0 ) {
-            fprintf(stdout, "   ");
+        highByte = charMap[i].utf16Char >> 8;
+        if (pageIndex[highByte] == 0) {
+            assert(pageCount < 256);
+            pageIndex[highByte] = pageCount;
+            pageHighBytes[pageCount] = highByte;
+            pageCount += 1;
         }
-
-        fprintf(stdout, " {0x%04X, 0x%02X}", charMap[i].utf16Char, charMap[i].macRomanChar);
-
-        if (i != 255) {
+        assert(charMap[i].mfsChar != 0);
+        assert(pages[pageIndex[highByte]][charMap[i].utf16Char & 0xFF] == 0);     // each code point must map to just one character
+        pages[pageIndex[highByte]][charMap[i].utf16Char & 0xFF] = charMap[i].mfsChar;
+    }
+    
+    // Print them.
+    
+    fprintf(stdout, "static const uint8_t kUTF16To%sPageIndex[256] = {\n", encodingName);
+    for (highByte = 0; highByte < 256; highByte++) {
+        if ( (highByte % 16) == 0 ) {
+            fprintf(stdout, "    /* 0x%02Xxx */", highByte);
+        }
+        fprintf(stdout, " %2d", pageIndex[highByte]);
+        if (highByte != 255) {
             fprintf(stdout, ",");
         }
-
-        if ( (i % 8) == 7) {
+        if ( (highByte % 16) == 15) {
             fprintf(stdout, "\n");
         }
     }
-
+    fprintf(stdout, "};\n");
+    fprintf(stdout, "\n");
+    
+    fprintf(stdout, "static const uint8_t kUTF16To%sPages[%d][256] = {\n", encodingName, pageCount);
+    for (page = 0; page < pageCount; page++) {
+        if (page == 0) {
+            fprintf(stdout, "    {   // page 0, no %s equivalents\n", encodingName);
+        } else {
+            fprintf(stdout, "    {   // page %d, U+%02Xxx\n", page, pageHighBytes[page]);
+        }
+        for (lowByte = 0; lowByte < 256; lowByte++) {
+            if ( (lowByte % 16) == 0 ) {
+                fprintf(stdout, "        /* 0x%02X */", lowByte);
+            }
+            fprintf(stdout, " 0x%02X", pages[page][lowByte]);
+            if (lowByte != 255) {
+                fprintf(stdout, ",");
+            }
+            if ( (lowByte % 16) == 15) {
+                fprintf(stdout, "\n");
+            }
+        }
+        if (page != (pageCount - 1)) {
+            fprintf(stdout, "    },\n");
+        } else {
+            fprintf(stdout, "    }\n");
+        }
+    }
     fprintf(stdout, "};\n");
 }
 
 #pragma mark ***** Case Folder
 
-static void PrintMacRomanCaseFoldingTable(void)
+static void PrintCaseFoldingTable(CFStringEncoding encoding, const char *encodingName)
+    // Prints a table that maps each character of the specified encoding to the 
+    // character that's equal to it, ignoring case, with the highest code that's 
+    // not greater than its own.  For ASCII, that's the upper case version.
 {
     uint8_t             ch;
     CFStringRef         strs[256];
@@ -544,7 +616,7 @@ static void PrintMacRomanCaseFoldingTable(void)
     
     ch = 0;
     do {
-        strs[ch] = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), kCFStringEncodingMacRoman, false);
+        strs[ch] = CFStringCreateWithBytes(NULL, &ch, sizeof(ch), encoding, false);
         assert(strs[ch] != NULL);
         
         assert(CFStringGetLength(strs[ch]) == 1);
@@ -552,7 +624,7 @@ static void PrintMacRomanCaseFoldingTable(void)
         ch += 1;
     } while (ch != 0);
     
-    fprintf(stdout, "static const uint16_t kMacRomanToUpper[256] = {\n");
+    fprintf(stdout, "static const uint16_t k%sToUpper[256] = {\n", encodingName);
     for (row = 0; row < 256; row++) {
         theMatch = row;
         for (col = 0; col < row; col++) {
@@ -579,6 +651,208 @@ static void PrintMacRomanCaseFoldingTable(void)
     fprintf(stdout, "};\n");
 }
 
+#pragma mark ***** Composition
+
+struct CompositionPair {
+    UniChar     combining;
+    UniChar     base;
+    UniChar     composed;
+};
+typedef struct CompositionPair CompositionPair;
+
+static int CompositionPairSorter(const void *p1, const void *p2)
+{
+    const CompositionPair * pair1;
+    const CompositionPair * pair2;
+    int                     result;
+    
+    pair1 = (const CompositionPair *) p1;
+    pair2 = (const CompositionPair *) p2;
+    if (pair1->combining != pair2->combining) {
+        result = (pair1->combining < pair2->combining) ? -1 : 1;
+    } else if (pair1->base != pair2->base) {
+        result = (pair1->base < pair2->base) ? -1 : 1;
+    } else {
+        result = 0;
+    }
+    return result;
+}
+
+static void PrintUTF16CompositionTable(void)
+    // Prints the tables that the user space utf8_decodestr (in "utf8_decodestr.c") 
+    // uses to precompose UTF-16.  Each entry says that a base character followed 
+    // by a combining character composes to a single character.  We find these 
+    // by taking each BMP character, decomposing it (NFD), and then, for each 
+    // non-initial character of the decomposition, checking whether the rest 
+    // recomposes (NFC) to a single base character which, followed by that 
+    // character, composes back to the original.  That picks up the canonical 
+    // composition pairs without needing access to the Unicode data files, and 
+    // it naturally skips singletons and composition exclusions.
+    //
+    // Hangul syllables are skipped; utf8_decodestr composes them algorithmically.  
+    // Characters outside the BMP are also skipped; there are only a handful of 
+    // supplementary compositions, and none of them matter to MFS.
+    //
+    // The output is sorted by combining character and then by base character, 
+    // and is printed as two tables: kUTF16CompositionMarks has one entry per 
+    // combining character giving the range of kUTF16CompositionPairs that 
+    // applies to it.
+{
+    CompositionPair *   pairs;
+    CFIndex             pairCount;
+    CFIndex             pairIndex;
+    CFIndex             pairsSize;
+    CFIndex             markCount;
+    CFIndex             firstPair;
+    CFIndex             column;
+    uint32_t            ch;
+    
+    pairsSize = 4096;
+    pairs = malloc(pairsSize * sizeof(*pairs));
+    assert(pairs != NULL);
+    pairCount = 0;
+    
+    for (ch = 0; ch < 0x10000; ch++) {
+        UniChar             uch;
+        CFStringRef         str;
+        CFMutableStringRef  decomposed;
+        CFIndex             decomposedCount;
+        CFIndex             markIndex;
+        
+        if ( (ch >= 0xD800) && (ch <= 0xDFFF) ) {
+            continue;           // surrogates
+        }
+        if ( (ch >= 0xAC00) && (ch <= 0xD7A3) ) {
+            continue;           // Hangul syllables
+        }
+        uch = (UniChar) ch;
+        
+        str = CFStringCreateWithCharacters(NULL, &uch, 1);
+        assert(str != NULL);
+        
+        decomposed = CFStringCreateMutableCopy(NULL, 0, str);
+        assert(decomposed != NULL);
+        CFStringNormalize(decomposed, kCFStringNormalizationFormD);
+        decomposedCount = CFStringGetLength(decomposed);
+        
+        for (markIndex = 1; markIndex < decomposedCount; markIndex++) {
+            CFMutableStringRef  rest;
+            UniChar             mark;
+            
+            mark = CFStringGetCharacterAtIndex(decomposed, markIndex);
+            
+            rest = CFStringCreateMutableCopy(NULL, 0, decomposed);
+            assert(rest != NULL);
+            CFStringDelete(rest, CFRangeMake(markIndex, 1));
+            CFStringNormalize(rest, kCFStringNormalizationFormC);
+            
+            if (CFStringGetLength(rest) == 1) {
+                CFMutableStringRef  recomposed;
+                
+                recomposed = CFStringCreateMutableCopy(NULL, 0, rest);
+                assert(recomposed != NULL);
+                CFStringAppendCharacters(recomposed, &mark, 1);
+                CFStringNormalize(recomposed, kCFStringNormalizationFormC);
+                
+                if ( (CFStringGetLength(recomposed) == 1) && (CFStringGetCharacterAtIndex(recomposed, 0) == uch) ) {
+                    assert(pairCount < pairsSize);
+                    pairs[pairCount].combining = mark;
+                    pairs[pairCount].base      = CFStringGetCharacterAtIndex(rest, 0);
+                    pairs[pairCount].composed  = uch;
+                    pairCount += 1;
+                }
+                
+                CFRelease(recomposed);
+            }
+            
+            CFRelease(rest);
+        }
+        
+        CFRelease(decomposed);
+        CFRelease(str);
+    }
+
+    // Sort and remove duplicates (a character that decomposes to the same 
+    // combining character twice yields the same pair twice).
+    
+    qsort(pairs, pairCount, sizeof(*pairs), CompositionPairSorter);
+    if (pairCount != 0) {
+        CFIndex     uniqueCount;
+        
+        uniqueCount = 1;
+        for (pairIndex = 1; pairIndex < pairCount; pairIndex++) {
+            if ( CompositionPairSorter(&pairs[pairIndex], &pairs[uniqueCount - 1]) != 0 ) {
+                pairs[uniqueCount] = pairs[pairIndex];
+                uniqueCount += 1;
+            } else {
+                assert(pairs[pairIndex].composed == pairs[uniqueCount - 1].composed);
+            }
+        }
+        pairCount = uniqueCount;
+    }
+    
+    markCount = 0;
+    for (pairIndex = 0; pairIndex < pairCount; pairIndex++) {
+        if ( (pairIndex == 0) || (pairs[pairIndex].combining != pairs[pairIndex - 1].combining) ) {
+            markCount += 1;
+        }
+    }
+
+    // Print them.
+    
+    fprintf(stdout, "static const UTF16CompositionMark kUTF16CompositionMarks[%ld] = {\n", (long) markCount);
+    column = 0;
+    firstPair = 0;
+    for (pairIndex = 1; pairIndex <= pairCount; pairIndex++) {
+        if ( (pairIndex == pairCount) || (pairs[pairIndex].combining != pairs[firstPair].combining) ) {
+            if (column == 0) {
+                fprintf(stdout, "   ");
+            }
+            fprintf(stdout, " { 0x%04X, %4ld, %3ld }", pairs[firstPair].combining, (long) firstPair, (long) (pairIndex - firstPair));
+            if (pairIndex != pairCount) {
+                fprintf(stdout, ",");
+            }
+            column += 1;
+            if ( (column == 4) || (pairIndex == pairCount) ) {
+                fprintf(stdout, "\n");
+                column = 0;
+            }
+            firstPair = pairIndex;
+        }
+    }
+    fprintf(stdout, "};\n");
+    fprintf(stdout, "\n");
+
+    fprintf(stdout, "static const UTF16CompositionPair kUTF16CompositionPairs[%ld] = {\n", (long) pairCount);
+    column = 0;
+    for (pairIndex = 0; pairIndex < pairCount; pairIndex++) {
+        if ( (pairIndex == 0) || (pairs[pairIndex].combining != pairs[pairIndex - 1].combining) ) {
+            if (column != 0) {
+                fprintf(stdout, "\n");
+            }
+            fprintf(stdout, "    /* U+%04X */", pairs[pairIndex].combining);
+            column = 0;
+        } else if (column == 0) {
+            fprintf(stdout, "                ");
+        }
+        fprintf(stdout, " { 0x%04X, 0x%04X }", pairs[pairIndex].base, pairs[pairIndex].composed);
+        if (pairIndex != (pairCount - 1)) {
+            fprintf(stdout, ",");
+        }
+        column += 1;
+        if (column == 6) {
+            fprintf(stdout, "\n");
+            column = 0;
+        }
+    }
+    if (column != 0) {
+        fprintf(stdout, "\n");
+    }
+    fprintf(stdout, "};\n");
+    
+    free(pairs);
+}
+
 static void PrintUsage(const char *argv0)
 {
     const char *    commandStr;
@@ -589,25 +863,51 @@ static void PrintUsage(const char *argv0)
     } else {
         commandStr += 1;
     }
-    fprintf(stderr, "usage: %s\n", commandStr);
+    fprintf(stderr, "usage: %s [-c]\n", commandStr);
+    fprintf(stderr, "  With no arguments, prints the MFS core's tables (for \"MFSCore.c\").\n");
+    fprintf(stderr, "  -c prints the composition tables (for \"utf8_decodestr.c\").\n");
 }
 
+// The encodings supported by the MFS core, in the order of the MFSTextEncoding 
+// constants in "MFSCore.h".  All of them are single byte encodings whose bottom 
+// 128 characters are ASCII.
+
+static const struct {
+    CFStringEncoding    encoding;
+    const char *        name;
+} kEncodings[] = {
+    { kCFStringEncodingMacRoman,           "MacRoman"         },
+    { kCFStringEncodingMacCentralEurRoman, "MacCentralEurope" },
+    { kCFStringEncodingMacCyrillic,        "MacCyrillic"      }
+};
+
 int main(int argc, char **argv)
 {
     int     retVal;
+    size_t  encodingIndex;
     
-    if (argc != 1) {
+    if ( (argc == 2) && (strcmp(argv[1], "-c") == 0) ) {
+        fprintf(stdout, "// These tables were generated by the TableGenerator program (see \"TableGenerator.c\").\n");
+        fprintf(stdout, "\n");
+        PrintUTF16CompositionTable();
+        fprintf(stdout, "\n");
+        fprintf(stdout, "// End of automatically generated tables.");
+        
+        retVal = EXIT_SUCCESS;
+    } else if (argc != 1) {
         PrintUsage(argv[0]);
         retVal = EXIT_FAILURE;
     } else {
         fprintf(stdout, "// These tables were generated by the TableGenerator program (see \"TableGenerator.c\").\n");
         fprintf(stdout, "\n");
-        PrintMacRomanToUTF8Table(1);
-        fprintf(stdout, "\n");
-        PrintUTF16ToMacRoman();
-        fprintf(stdout, "\n");
-        PrintMacRomanCaseFoldingTable();
-        fprintf(stdout, "\n");
+        for (encodingIndex = 0; encodingIndex < (sizeof(kEncodings) / sizeof(kEncodings[0])); encodingIndex++) {
+            PrintToUTF8Table(kEncodings[encodingIndex].encoding, kEncodings[encodingIndex].name, 1);
+            fprintf(stdout, "\n");
+            PrintUTF16ToEncodingPageTable(kEncodings[encodingIndex].encoding, kEncodings[encodingIndex].name);
+            fprintf(stdout, "\n");
+            PrintCaseFoldingTable(kEncodings[encodingIndex].encoding, kEncodings[encodingIndex].name);
+            fprintf(stdout, "\n");
+        }
         fprintf(stdout, "// End of automatically generated tables.");
         
         retVal = EXIT_SUCCESS;
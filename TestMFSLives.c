@@ -75,6 +75,7 @@ First checked in.
 #include "MFSCore.h"
 #include "UserSpaceKernel.h"
 #include "MFSLivesPseudoMount.h"
+#include "utf8_decodestr.h"
 
 /////////////////////////////////////////////////////////////////////
 
@@ -154,7 +155,7 @@ static void TestHashTerm(void)
     gOSMallocTag = NULL;
 }
 
-static void TestHashBasicCore(ino_t ino, bool failTheAttach)
+static void TestHashForkCore(dev_t dev, ino_t ino, size_t forkIndex, bool failTheAttach)
 {
     int         err;
     int         junk;
@@ -163,7 +164,7 @@ static void TestHashBasicCore(ino_t ino, bool failTheAttach)
     
     hnode = NULL;
     vn    = NULL;
-    err = HNodeLookupCreatingIfNecessary(0, ino, 0, &hnode, &vn);
+    err = HNodeLookupCreatingIfNecessary(dev, ino, forkIndex, &hnode, &vn);
     
     if ( (err == 0) && (vn == NULL) ) {
         struct vnode_fsparam    params;
@@ -178,9 +179,9 @@ static void TestHashBasicCore(ino_t ino, bool failTheAttach)
         }
         
         if (err == 0) {
-            HNodeAttachVNodeSucceeded(hnode, 0, vn);
+            HNodeAttachVNodeSucceeded(hnode, forkIndex, vn);
         } else {
-            if ( HNodeAttachVNodeFailed(hnode, 0) ) {
+            if ( HNodeAttachVNodeFailed(hnode, forkIndex) ) {
                 FSNodeScrubber(hnode);
                 HNodeScrubDone(hnode);
             }
@@ -188,9 +189,10 @@ static void TestHashBasicCore(ino_t ino, bool failTheAttach)
     }
     
     if (err == 0) {
-        assert( HNodeGetDevice(hnode) == 0 );
+        assert( HNodeGetDevice(hnode) == dev );
         assert( HNodeGetInodeNumber(hnode) == ino );
-        assert( HNodeGetVNodeForForkAtIndex(hnode, 0) == vn );
+        assert( HNodeGetVNodeForForkAtIndex(hnode, forkIndex) == vn );
+        assert( HNodeGetForkIndexForVNode(vn) == forkIndex );
     }
     
     if (vn != NULL) {
@@ -202,6 +204,11 @@ static void TestHashBasicCore(ino_t ino, bool failTheAttach)
     assert( failTheAttach == (err == ENOMEM) );
 }
 
+static void TestHashBasicCore(ino_t ino, bool failTheAttach)
+{
+    TestHashForkCore(0, ino, 0, failTheAttach);
+}
+
 static void TestHashBasic(void)
 {
     TestHashBasicCore(2, false);
@@ -230,6 +237,135 @@ static void TestHashAttachFail(void)
     TestHashBasicCore(2, true);
 }
 
+static void TestHashStatistics(void)
+    // Checks that the statistics counters track a miss, a hit, a failed attach, 
+    // and the resulting detaches and reclaims.
+{
+    HNodeStatistics before;
+    HNodeStatistics after;
+    
+    DisposeAllVNodes();
+    HNodeGetStatistics(&before);
+    assert(before.nodeCount == 0);
+    
+    TestHashBasicCore(2, false);            // miss, then attach
+    TestHashBasicCore(2, false);            // hit
+    TestHashBasicCore(3, true);             // miss, then the attach fails, which reclaims the HNode
+    
+    HNodeGetStatistics(&after);
+    assert( (after.lookups - before.lookups) == 3 );
+    assert( (after.hits    - before.hits)    == 1 );
+    assert( (after.misses  - before.misses)  == 2 );
+    assert( after.detaches == before.detaches );
+    assert( (after.reclaims - before.reclaims) == 1 );
+    assert( after.nodeCount == 1 );
+    
+    DisposeAllVNodes();                     // detaches and reclaims ino 2
+    
+    HNodeGetStatistics(&after);
+    assert( (after.detaches - before.detaches) == 1 );
+    assert( (after.reclaims - before.reclaims) == 2 );
+    assert( after.nodeCount == 0 );
+}
+
+static void TestHashLookupManyAttach(HNodeLookupRequest *request)
+    // Discharges the attach obligation of a request returned by HNodeLookupMany, 
+    // and then drops our reference to the new vnode.
+{
+    int                     err;
+    vnode_t                 vn;
+    struct vnode_fsparam    params;
+    
+    assert(request->err == 0);
+    assert(request->vn == NULL);
+    
+    ((FSNode *) FSNodeGenericFromHNode(request->hnode))->magic = kFSNodeMagic;
+    
+    params.vnfs_fsnode = request->hnode;
+    err = vnode_create(VNCREATE_FLAVOR, sizeof(params), &params, &vn);
+    assert(err == 0);
+    
+    HNodeAttachVNodeSucceeded(request->hnode, request->forkIndex, vn);
+    
+    vnode_put(vn);
+}
+
+static void TestHashLookupMany(void)
+    // Checks HNodeLookupMany's results for misses, hits, and the cases it has 
+    // to punt back to the caller.
+{
+    size_t              oldVNodeLimit;
+    size_t              requestIndex;
+    HNodeStatistics     before;
+    HNodeStatistics     after;
+    enum {
+        kEntryCount = 1000
+    };
+    static HNodeLookupRequest requests[kEntryCount];
+    
+    oldVNodeLimit = SetVNodeLimit(kEntryCount);
+    DisposeAllVNodes();
+    
+    // All misses, so we must attach every one.
+    
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        requests[requestIndex].dev       = 2;
+        requests[requestIndex].ino       = kMFSFirstFileInodeName + requestIndex;
+        requests[requestIndex].forkIndex = 0;
+    }
+    HNodeGetStatistics(&before);
+    HNodeLookupMany(requests, kEntryCount);
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        assert(requests[requestIndex].err == 0);
+        assert(requests[requestIndex].hnode != NULL);
+        assert(requests[requestIndex].vn == NULL);
+        assert( HNodeGetInodeNumber(requests[requestIndex].hnode) == requests[requestIndex].ino );
+        
+        TestHashLookupManyAttach(&requests[requestIndex]);
+    }
+    HNodeGetStatistics(&after);
+    assert( (after.lookups - before.lookups) == kEntryCount );
+    assert( (after.misses  - before.misses)  == kEntryCount );
+    assert( after.nodeCount == kEntryCount );
+    
+    // All hits, so we must release every vnode.
+    
+    HNodeLookupMany(requests, kEntryCount);
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        assert(requests[requestIndex].err == 0);
+        assert(requests[requestIndex].vn != NULL);
+        assert( HNodeGetVNodeForForkAtIndex(requests[requestIndex].hnode, 0) == requests[requestIndex].vn );
+        
+        vnode_put(requests[requestIndex].vn);
+    }
+    HNodeGetStatistics(&before);
+    assert( (before.hits - after.hits) == kEntryCount );
+    
+    DisposeAllVNodes();
+    
+    // Two requests for the same HNode (the second can't be resolved until we've 
+    // attached the first) and a request for a high fork (which needs an external 
+    // fork array).  Both of the latter must be punted back to us.
+    
+    requests[0].dev = 2;    requests[0].ino = 2;    requests[0].forkIndex = 0;
+    requests[1].dev = 2;    requests[1].ino = 2;    requests[1].forkIndex = 0;
+    requests[2].dev = 2;    requests[2].ino = 3;    requests[2].forkIndex = 5;
+    HNodeLookupMany(requests, 3);
+    assert(requests[0].err == 0);
+    assert(requests[0].vn == NULL);
+    assert(requests[1].err == EAGAIN);
+    assert(requests[1].hnode == NULL);
+    assert(requests[2].err == EAGAIN);
+    assert(requests[2].hnode == NULL);
+    
+    TestHashLookupManyAttach(&requests[0]);
+    TestHashForkCore(2, 2, 0, false);
+    TestHashForkCore(2, 3, 5, false);
+    
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+}
+
 static void TestHashHighForks(void)
 {
     int                     err;
@@ -287,8 +423,8 @@ static void TestHashHighForks(void)
     
     vnode_put(vn);
     
-    // Do it again for a higher fork.  This tests the expansion of 
-    // the fork array from internal to external storage.
+    // Do it again for the next fork.  This uses the second entry 
+    // of the internal fork array.
     
     hnode = NULL;
     vn    = NULL;
@@ -308,7 +444,7 @@ static void TestHashHighForks(void)
     vnode_put(vn);
     
     // Do it again for a higher fork.  This tests the expansion of 
-    // the fork array in external storage.
+    // the fork array from internal to external storage.
     
     hnode = NULL;
     vn    = NULL;
@@ -327,6 +463,26 @@ static void TestHashHighForks(void)
     
     vnode_put(vn);
     
+    // Do it again for a higher fork.  This tests the expansion of 
+    // the fork array in external storage.
+    
+    hnode = NULL;
+    vn    = NULL;
+    err = HNodeLookupCreatingIfNecessary(0, 4, 3, &hnode, &vn);
+    assert(err == 0);
+    assert(vn == NULL);
+    
+    ((FSNode *) FSNodeGenericFromHNode(hnode))->magic = kFSNodeMagic;
+        
+    params.vnfs_fsnode = hnode;
+    err = vnode_create(VNCREATE_FLAVOR, sizeof(params), &params, &vn);
+    assert(err == 0);
+    assert(vn != NULL);
+        
+    HNodeAttachVNodeSucceeded(hnode, 3, vn);
+    
+    vnode_put(vn);
+    
     // Run the TestHashRepeatBasic to recycle all the vnodes.  This will, 
     // as a consequence, recycle the hnodes as well.
     
@@ -345,12 +501,94 @@ static void TestHashHashChain(void)
     // HNodePrintState();
 }
 
+static void TestHashChainStats(void)
+    // Creates HNodes for a set of volumes with adjacent device numbers, each 
+    // with a dense range of inode numbers, which is what you get when you mount 
+    // a bunch of MFS disk images.  Then checks that they're spread evenly across 
+    // the hash table.
+{
+    HNodeChainStatistics    stats;
+    size_t                  oldVNodeLimit;
+    dev_t                   dev;
+    ino_t                   ino;
+    size_t                  chainLength;
+    size_t                  chainCount;
+    enum {
+        kVolumeCount  = 16,
+        kFilesPerVolume = 64
+    };
+    
+    oldVNodeLimit = SetVNodeLimit(kVolumeCount * kFilesPerVolume);
+    for (dev = 1; dev <= kVolumeCount; dev++) {
+        for (ino = kMFSFirstFileInodeName; ino < (kMFSFirstFileInodeName + kFilesPerVolume); ino++) {
+            TestHashForkCore(dev, ino, 0, false);
+        }
+    }
+    
+    HNodeGetChainStatistics(&stats);
+    
+    assert(stats.nodeCount >= (kVolumeCount * kFilesPerVolume));
+    chainCount = 0;
+    for (chainLength = 0; chainLength < kHNodeChainLengthHistogramSize; chainLength++) {
+        chainCount += stats.chainLengths[chainLength];
+    }
+    assert(chainCount == stats.bucketCount);
+
+    // With (dev + ino) as the hash, these 1024 nodes landed on just 79 chains, 
+    // making the longest chain 16 nodes long.
+
+    assert(stats.longestChain <= 6);
+    
+    // Get rid of all of those vnodes (and hence their HNodes), so that later 
+    // tests start with a small vnode cache again.
+    
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+}
+
+static void TestHashTableSize(void)
+    // Checks that the auto-resizing hash table grows when lots of HNodes are 
+    // created, and that it shrinks back to its minimum size once they're gone.
+{
+    size_t                  oldVNodeLimit;
+    size_t                  nodeIndex;
+    HNodeChainStatistics    stats;
+    enum {
+        kNodeCount = 10000
+    };
+    
+    oldVNodeLimit = SetVNodeLimit(kNodeCount);
+    for (nodeIndex = 0; nodeIndex < kNodeCount; nodeIndex++) {
+        TestHashForkCore(1, kMFSFirstFileInodeName + nodeIndex, 0, false);
+    }
+    
+    HNodeGetChainStatistics(&stats);
+    assert(stats.nodeCount >= kNodeCount);
+    assert(stats.bucketCount > 64);
+    
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+    
+    HNodeGetChainStatistics(&stats);
+    assert(stats.nodeCount == 0);
+    assert(stats.bucketCount == 64);        // the minimum table size, kHNodeHashTableMinChains
+    assert(stats.oldBucketCount == 0);      // the shrink has finished
+}
+
+enum {
+    kStallingThreadCount = 256
+};
+
+static volatile int32_t gStallingThreadsStarted;
+
 static void * StallingThread(void *param)
 {
     int             err;
     vnode_t         vn;
     HNodeRef        hnode;
 
+    (void) OSIncrementAtomic(&gStallingThreadsStarted);
+    
     hnode = NULL;
     vn    = NULL;
     err = HNodeLookupCreatingIfNecessary(0, 2, 0, &hnode, &vn);
@@ -366,13 +604,16 @@ static void * StallingThread(void *param)
 static volatile bool gContinue = true;
 
 static void TestHashAttachStall(void)
+    // Starts an attach and then starts lots of threads that look up the same 
+    // HNode, all of which should stall until the attach completes.  Then completes 
+    // the attach and waits for all of the threads to wake up and get the vnode.
 {
     int                     err;
     vnode_t                 vn;
     HNodeRef                hnode;
     struct vnode_fsparam    params;
-    pthread_t               stallingThread1;
-    pthread_t               stallingThread2;
+    pthread_t               stallingThreads[kStallingThreadCount];
+    size_t                  threadIndex;
     void *                  junkPtr;
     
     hnode = NULL;
@@ -388,63 +629,124 @@ static void TestHashAttachStall(void)
     assert(err == 0);
     assert(vn != NULL);
     
-    err = pthread_create(&stallingThread1, NULL, StallingThread, vn);
-    assert(err == 0);
-    err = pthread_create(&stallingThread2, NULL, StallingThread, vn);
-    assert(err == 0);
+    gStallingThreadsStarted = 0;
+    for (threadIndex = 0; threadIndex < kStallingThreadCount; threadIndex++) {
+        err = pthread_create(&stallingThreads[threadIndex], NULL, StallingThread, vn);
+        assert(err == 0);
+    }
     
-    // Sleep for a second to give the stalling threads a chance to block. 
-    // This isn't a guarantee, but it's very likely to work.  And it has the 
-    // advantage that it's /much/ easier to code than a correct solution.
+    // Wait for all of the stalling threads to start, and then sleep for a second 
+    // to give them a chance to block.  This isn't a guarantee, but it's very likely 
+    // to work.  And it has the advantage that it's /much/ easier to code than a 
+    // correct solution.
     
+    while (gStallingThreadsStarted != kStallingThreadCount) {
+        usleep(1000);
+    }
+    sleep(1);
     while ( ! gContinue ) {
         sleep(1);
     }
-        
+    
     HNodeAttachVNodeSucceeded(hnode, 0, vn);
     
     vnode_put(vn);
     
-    // Wait for both of the stalling threads to complete.
+    // Wait for all of the stalling threads to complete.
     
-    err = pthread_join(stallingThread1, &junkPtr);
-    assert(err == 0);
-    err = pthread_join(stallingThread2, &junkPtr);
-    assert(err == 0);
+    for (threadIndex = 0; threadIndex < kStallingThreadCount; threadIndex++) {
+        err = pthread_join(stallingThreads[threadIndex], &junkPtr);
+        assert(err == 0);
+    }
 }
 
+struct StressThreadParams {
+    CFTimeInterval  duration;           // how long to run for
+    ino_t           inoBase;            // first inode number to look up
+    ino_t           inoCount;           // number of inode numbers to look up
+    bool            randomInos;         // if true, pick inode numbers at random; if false, cycle through them
+    size_t          forkCount;          // number of forks to look up on each inode
+    size_t          lookupCount;        // on return, number of lookups done
+};
+typedef struct StressThreadParams StressThreadParams;
+
 static void * StressThread(void *param)
 {
-    CFAbsoluteTime  startTime;
+    StressThreadParams *    params;
+    CFAbsoluteTime          startTime;
+    size_t                  lookupCount;
+    long                    r;
     
+    params = (StressThreadParams *) param;
+    
+    lookupCount = 0;
     startTime = CFAbsoluteTimeGetCurrent();
     do {
-        TestHashBasicCore(random() % 10 + 2, false);
-    } while ( CFAbsoluteTimeGetCurrent() < (startTime + *(CFTimeInterval *) param) );
+        if (params->randomInos) {
+            r = random();
+            TestHashForkCore(0, params->inoBase + (r % params->inoCount), (r / params->inoCount) % params->forkCount, false);
+        } else {
+            TestHashForkCore(0, params->inoBase + (lookupCount % params->inoCount), (lookupCount / params->inoCount) % params->forkCount, false);
+        }
+        lookupCount += 1;
+    } while ( CFAbsoluteTimeGetCurrent() < (startTime + params->duration) );
+
+    params->lookupCount = lookupCount;
 
     return NULL;
 }
 
-static void TestHashStressCore(CFTimeInterval duration)
+enum {
+    kStressThreadsMax = 16
+};
+
+static size_t TestHashStressCore(CFTimeInterval duration, size_t threadCount, bool sharedInos, size_t forkCount)
+    // Runs threadCount threads, each doing lookups for duration seconds, and returns 
+    // the total number of lookups done.  If sharedInos is true, all of the threads 
+    // fight over the same 10 inodes, picked at random.  Otherwise each thread 
+    // cycles through its own set of 16 inodes.  Either way, each lookup is for 
+    // one of the first forkCount forks of the inode.
 {
-    int         err;
-    int         i;
-    pthread_t   threads[10];
-    void *      junkPtr;
-    
-    for (i = 0; i < 10; i++) {
-        err = pthread_create(&threads[i], NULL, StressThread, &duration);
+    int                 err;
+    size_t              i;
+    pthread_t           threads[kStressThreadsMax];
+    StressThreadParams  params[kStressThreadsMax];
+    void *              junkPtr;
+    size_t              lookupCount;
+    
+    assert(threadCount <= kStressThreadsMax);
+    
+    for (i = 0; i < threadCount; i++) {
+        params[i].duration = duration;
+        if (sharedInos) {
+            params[i].inoBase    = 2;
+            params[i].inoCount   = 10;
+            params[i].randomInos = true;
+        } else {
+            params[i].inoBase    = 2 + (i * 16);
+            params[i].inoCount   = 16;
+            params[i].randomInos = false;
+        }
+        params[i].forkCount   = forkCount;
+        params[i].lookupCount = 0;
+        err = pthread_create(&threads[i], NULL, StressThread, &params[i]);
         assert(err == 0);
     }
-    for (i = 0; i < 10; i++) {
+    lookupCount = 0;
+    for (i = 0; i < threadCount; i++) {
         err = pthread_join(threads[i], &junkPtr);
         assert(err == 0);
+        lookupCount += params[i].lookupCount;
     }
+    
+    return lookupCount;
 }
 
 static void TestHashStress(void)
+    // Lots of threads fighting over a few inodes and even fewer vnodes, so 
+    // most lookups are misses.
 {
-    TestHashStressCore(10);
+    (void) TestHashStressCore(10, 10, true, 2);
 }
 
 #define TEST_HASH_STRESS_LONG 1
@@ -452,11 +754,212 @@ static void TestHashStress(void)
 
     static void TestHashStressLong(void)
     {
-        TestHashStressCore(60);
+        (void) TestHashStressCore(60, 10, true, 1);
     }
 
 #endif
 
+/////////////////////////////////////////////////////////////////////
+#pragma mark ***** Benchmark Hash
+
+// These only measure performance; the matching tests in the Hash group 
+// check the results.
+
+static void TestHashStressBenchmark(void)
+    // A scaling benchmark.  Each thread looks up its own set of inodes and there 
+    // are enough vnodes to go round, so almost every lookup is a hit, which is 
+    // the common case in the kernel.  Because the hash table is lock striped, 
+    // the throughput should rise with the thread count (up to the number of CPUs). 
+    // After that, we run the original stress test, which has lots of threads 
+    // fighting over a few inodes and even fewer vnodes, so most lookups are misses. 
+    // For each run, we also report how many times the allocator was called, 
+    // and for the last run we report what the HNode statistics make of it.
+{
+    size_t          oldVNodeLimit;
+    size_t          threadCount;
+    size_t          lookupCount;
+    size_t          mallocCount;
+    HNodeStatistics before;
+    HNodeStatistics after;
+    enum {
+        kSecondsPerRun = 2
+    };
+    
+    oldVNodeLimit = SetVNodeLimit(kStressThreadsMax * 16);
+    for (threadCount = 1; threadCount <= kStressThreadsMax; threadCount *= 2) {
+        mallocCount = GetOSMallocCount();
+        lookupCount = TestHashStressCore(kSecondsPerRun, threadCount, false, 1);
+        mallocCount = GetOSMallocCount() - mallocCount;
+        printf("    %2zu threads: %.0f lookups per second, %zu allocations\n", threadCount, ((double) lookupCount) / kSecondsPerRun, mallocCount);
+    }
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+
+    HNodeGetStatistics(&before);
+    mallocCount = GetOSMallocCount();
+    lookupCount = TestHashStressCore(kSecondsPerRun, 10, true, 2);
+    mallocCount = GetOSMallocCount() - mallocCount;
+    HNodeGetStatistics(&after);
+    printf("    shared: %.0f lookups per second, %zu allocations\n", ((double) lookupCount) / kSecondsPerRun, mallocCount);
+    printf("            %llu hits, %llu misses, %llu attach sleeps, %llu vid retries, %llu races lost, %llu reclaims\n", 
+        (unsigned long long) (after.hits         - before.hits), 
+        (unsigned long long) (after.misses       - before.misses), 
+        (unsigned long long) (after.attachSleeps - before.attachSleeps), 
+        (unsigned long long) (after.vidRetries   - before.vidRetries), 
+        (unsigned long long) (after.racesLost    - before.racesLost), 
+        (unsigned long long) (after.reclaims     - before.reclaims)
+    );
+}
+
+static void TestHashHotFilesBenchmark(void)
+    // A scaling benchmark for the lock-free lookup path.  All of the threads 
+    // hammer the data and resource forks of the same 10 inodes, and there are 
+    // enough vnodes to go round, so after the first few lookups every lookup 
+    // is a hit on the same few hash chains.  With a lock on the lookup path, 
+    // this would serialise on a single stripe.
+{
+    size_t          oldVNodeLimit;
+    size_t          threadCount;
+    size_t          lookupCount;
+    enum {
+        kSecondsPerRun = 2
+    };
+    
+    oldVNodeLimit = SetVNodeLimit(10 * 2);
+    for (threadCount = 1; threadCount <= kStressThreadsMax; threadCount *= 2) {
+        lookupCount = TestHashStressCore(kSecondsPerRun, threadCount, true, 2);
+        printf("    %2zu threads: %.0f lookups per second\n", threadCount, ((double) lookupCount) / kSecondsPerRun);
+    }
+    (void) SetVNodeLimit(oldVNodeLimit);
+}
+
+static void TestHashTableSizeBenchmark(void)
+    // A benchmark for the auto-resizing hash table.  For node counts from 10 to 
+    // 1,000,000, creates that many HNodes (each with its own vnode) and then does 
+    // random lookups on them.  The table should grow to keep the chains short, so 
+    // the lookup rate should be roughly independent of the node count (apart from 
+    // cache effects).
+{
+    size_t                  oldVNodeLimit;
+    size_t                  nodeCount;
+    size_t                  nodeIndex;
+    size_t                  lookupCount;
+    CFAbsoluteTime          startTime;
+    CFAbsoluteTime          createTime;
+    HNodeChainStatistics    stats;
+    enum {
+        kMaxNodeCount  = 1000000,
+        kSecondsPerRun = 1
+    };
+    
+    oldVNodeLimit = SetVNodeLimit(kMaxNodeCount);
+    for (nodeCount = 10; nodeCount <= kMaxNodeCount; nodeCount *= 10) {
+        startTime = CFAbsoluteTimeGetCurrent();
+        for (nodeIndex = 0; nodeIndex < nodeCount; nodeIndex++) {
+            TestHashForkCore(1, kMFSFirstFileInodeName + nodeIndex, 0, false);
+        }
+        createTime = CFAbsoluteTimeGetCurrent() - startTime;
+        
+        lookupCount = 0;
+        startTime = CFAbsoluteTimeGetCurrent();
+        do {
+            TestHashForkCore(1, kMFSFirstFileInodeName + (random() % nodeCount), 0, false);
+            lookupCount += 1;
+        } while ( CFAbsoluteTimeGetCurrent() < (startTime + kSecondsPerRun) );
+        
+        HNodeGetChainStatistics(&stats);
+        assert(stats.nodeCount >= nodeCount);
+
+        printf("    %7zu nodes: %7zu chains, longest %zu, %.0f creates per second, %.0f lookups per second\n", 
+            nodeCount, 
+            stats.bucketCount, 
+            stats.longestChain, 
+            ((double) nodeCount) / createTime, 
+            ((double) lookupCount) / kSecondsPerRun
+        );
+    }
+    
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+    
+}
+
+static void TestHashLookupManyBenchmark(void)
+    // Compares the cost of materialising and looking up the vnodes for a 
+    // directory's worth of files one at a time and in a batch.
+{
+    size_t              oldVNodeLimit;
+    size_t              requestIndex;
+    size_t              passIndex;
+    CFAbsoluteTime      startTime;
+    double              singleCreateTime;
+    double              batchCreateTime;
+    double              singleLookupTime;
+    double              batchLookupTime;
+    enum {
+        kEntryCount = 1000,
+        kPasses     = 100
+    };
+    static HNodeLookupRequest requests[kEntryCount];
+    
+    oldVNodeLimit = SetVNodeLimit(kEntryCount);
+    DisposeAllVNodes();
+
+    // First materialise the vnodes one at a time.
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        TestHashForkCore(2, kMFSFirstFileInodeName + requestIndex, 0, false);
+    }
+    singleCreateTime = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (passIndex = 0; passIndex < kPasses; passIndex++) {
+        for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+            TestHashForkCore(2, kMFSFirstFileInodeName + requestIndex, 0, false);
+        }
+    }
+    singleLookupTime = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    DisposeAllVNodes();
+    
+    // Then do it again in a batch.
+    
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        requests[requestIndex].dev       = 2;
+        requests[requestIndex].ino       = kMFSFirstFileInodeName + requestIndex;
+        requests[requestIndex].forkIndex = 0;
+    }
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    HNodeLookupMany(requests, kEntryCount);
+    for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+        TestHashLookupManyAttach(&requests[requestIndex]);
+    }
+    batchCreateTime = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (passIndex = 0; passIndex < kPasses; passIndex++) {
+        HNodeLookupMany(requests, kEntryCount);
+        for (requestIndex = 0; requestIndex < kEntryCount; requestIndex++) {
+            assert(requests[requestIndex].vn != NULL);
+            vnode_put(requests[requestIndex].vn);
+        }
+    }
+    batchLookupTime = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    DisposeAllVNodes();
+    (void) SetVNodeLimit(oldVNodeLimit);
+    
+    printf("    %d entries: create single %.3f ms, batch %.3f ms; lookup single %.3f ms, batch %.3f ms\n", 
+        (int) kEntryCount, 
+        singleCreateTime * 1000.0, 
+        batchCreateTime * 1000.0, 
+        (singleLookupTime / kPasses) * 1000.0, 
+        (batchLookupTime / kPasses) * 1000.0
+    );
+}
+
 /////////////////////////////////////////////////////////////////////
 #pragma mark ***** Test MFSCore
 
@@ -495,6 +998,62 @@ static void TestMFSCoreInit(void)
     }
 }
 
+// SampleVolumeInfo holds the volume geometry returned by MFSMDBCheck for the 
+// sample volume.
+
+struct SampleVolumeInfo {
+    size_t      mdbAndVABMSizeInBytes;
+    uint16_t    directoryStartBlock;
+    uint16_t    directoryBlockCount;
+    uint16_t    allocationBlocksStartBlock;
+    uint32_t    allocationBlockSizeInBytes;
+};
+typedef struct SampleVolumeInfo SampleVolumeInfo;
+
+static void TestMFSCoreGetSampleVolume(SampleVolumeInfo *volume)
+    // Checks the sample volume's MDB and returns its geometry in *volume.
+{
+    int     err;
+    
+    err = MFSMDBCheck(
+        gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
+        gSampleDataSize / kSampleDataBlockSize,
+        &volume->mdbAndVABMSizeInBytes,
+        &volume->directoryStartBlock,
+        &volume->directoryBlockCount,
+        &volume->allocationBlocksStartBlock,
+        &volume->allocationBlockSizeInBytes
+    );
+    assert(err == 0);
+}
+
+static void * TestMFSCoreGetSampleDirectoryIndex(const SampleVolumeInfo *volume, MFSDirectoryIndex *index)
+    // Builds a directory index for the sample volume, as returned by 
+    // TestMFSCoreGetSampleVolume.  Returns the buffer that holds the index; the 
+    // caller must free it.
+{
+    int         err;
+    size_t      bufferSize;
+    void *      buffer;
+    
+    bufferSize = MFSDirectoryIndexGetBufferSize(volume->directoryBlockCount, kSampleDataBlockSize);
+    buffer = malloc(bufferSize);
+    assert(buffer != NULL);
+    err = MFSDirectoryIndexBuild(
+        gSampleData + volume->directoryStartBlock * kSampleDataBlockSize, 
+        volume->directoryStartBlock, 
+        volume->directoryBlockCount, 
+        kSampleDataBlockSize, 
+        kMFSTextEncodingMacRoman, 
+        buffer, 
+        bufferSize, 
+        index
+    );
+    assert(err == 0);
+    
+    return buffer;
+}
+
 static void TestMFSCoreMacRoman(void)
 {
     int     err;
@@ -522,28 +1081,28 @@ static void TestMFSCoreMacRoman(void)
     
     // basics
     
-    assert( MFSNameToUTF8("\phello", utf8, sizeof(utf8)) == 6 );
+    assert( MFSNameToUTF8("\phello", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 6 );
     assert( strcmp(utf8, "hello") == 0);
 
     // empty name
 
-    assert( MFSNameToUTF8("\p", utf8, sizeof(utf8)) == 1 );
+    assert( MFSNameToUTF8("\p", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 1 );
     assert( strcmp(utf8, "") == 0);
     
     // name longer than 127 (that is, could suffer a signed mixup)
 
-    assert( MFSNameToUTF8("\p0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789", utf8, sizeof(utf8)) == 131 );
+    assert( MFSNameToUTF8("\p0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 131 );
     assert( strcmp(utf8, "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789") == 0);
     
     // name with embedded null
     
-    assert( MFSNameToUTF8("\phello\000cruel", utf8, sizeof(utf8)) == 11 );
+    assert( MFSNameToUTF8("\phello\000cruel", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 11 );
     assert( strcmp(utf8, "hellocruel") == 0);
     
     // standard truncation
     
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phello cruel world", utf8, 6) == 18 );
+    assert( MFSNameToUTF8("\phello cruel world", kMFSTextEncodingMacRoman, utf8, 6) == 18 );
     assert( strcmp(utf8, "hello") == 0);
     for (i = 6; i < sizeof(utf8); i++) {
         assert(utf8[i] == 'X');
@@ -551,103 +1110,181 @@ static void TestMFSCoreMacRoman(void)
     
     // utf-8 expansion
     
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, sizeof(utf8)) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 20 );
     assert( strcmp(utf8, "hell\xEF\xA3\xBF cruel world") == 0);
     
     // result should be decomposed (normal form D)
     // MacRoman 0x9F (u umlaut) -> U+0075 (LATIN SMALL LETTER U) U+0308 (COMBINING DIARESIS) -> UTF-8 0x75 0xCC 0x88
     
-    assert( MFSNameToUTF8("\phello cr" "\x9f" "el world", utf8, sizeof(utf8)) == 20 );
+    assert( MFSNameToUTF8("\phello cr" "\x9f" "el world", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) == 20 );
     assert( strcmp(utf8, "hello cr" "\x75\xCC\x88" "el world") == 0);
         
     // tricky truncation
     
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 4) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 4) == 20 );
     assert( strcmp(utf8, "hel") == 0);
     assert(utf8[4] == 'X');
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 5) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 5) == 20 );
     assert( strcmp(utf8, "hell") == 0);
     assert(utf8[5] == 'X');
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 6) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 6) == 20 );
     assert( strcmp(utf8, "hell") == 0);
     assert(utf8[5] == 'X');
     assert(utf8[6] == 'X');
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 7) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 7) == 20 );
     assert( strcmp(utf8, "hell") == 0);
     assert(utf8[5] == 'X');
     assert(utf8[6] == 'X');
     assert(utf8[7] == 'X');
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 8) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 8) == 20 );
     assert( strcmp(utf8, "hell\xEF\xA3\xBF") == 0);
     assert(utf8[8] == 'X');
     memset(utf8, 'X', sizeof(utf8));
-    assert( MFSNameToUTF8("\phell\xf0 cruel world", utf8, 9) == 20 );
+    assert( MFSNameToUTF8("\phell\xf0 cruel world", kMFSTextEncodingMacRoman, utf8, 9) == 20 );
     assert( strcmp(utf8, "hell\xEF\xA3\xBF ") == 0);
     assert(utf8[9] == 'X');
+    
+    // truncation at every buffer size, for a name with ASCII runs longer than a word, 
+    // embedded nulls, and high-bit characters at various alignments; the result must 
+    // always be the full conversion cut at the longest MacRoman character boundary 
+    // that fits
+    
+    {
+        static const uint8_t kMixedName[] = "\p" "hello cruel world\x8e" "0123456789\000abcdefghijklmnop\xf0\xa5" "xyz";
+        char                 full[1024];
+        size_t               fullLen;
+        size_t               prefixLens[256];
+        uint8_t              prefix[256];
+        size_t               charCount;
+        size_t               bufSize;
+        
+        fullLen = MFSNameToUTF8(kMixedName, kMFSTextEncodingMacRoman, full, sizeof(full)) - 1;
+        assert(fullLen == strlen(full));
+        
+        for (charCount = 0; charCount <= kMixedName[0]; charCount++) {
+            prefix[0] = (uint8_t) charCount;
+            memcpy(&prefix[1], &kMixedName[1], charCount);
+            prefixLens[charCount] = MFSNameToUTF8(prefix, kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) - 1;
+            assert(strncmp(utf8, full, prefixLens[charCount]) == 0);
+        }
+        assert(prefixLens[kMixedName[0]] == fullLen);
+
+        for (bufSize = 1; bufSize <= (fullLen + 2); bufSize++) {
+            size_t  expectedLen;
+            
+            expectedLen = 0;
+            for (charCount = 0; charCount <= kMixedName[0]; charCount++) {
+                if (prefixLens[charCount] < bufSize) {
+                    expectedLen = prefixLens[charCount];
+                }
+            }
+            memset(utf8, 'X', sizeof(utf8));
+            assert( MFSNameToUTF8(kMixedName, kMFSTextEncodingMacRoman, utf8, bufSize) == (fullLen + 1) );
+            assert( strlen(utf8) == expectedLen );
+            assert( strncmp(utf8, full, expectedLen) == 0 );
+            assert( utf8[expectedLen + 1] == 'X' );
+        }
+    }
 
     // ***** UTF8ToMFSName
 
     // basics
     
-    assert( UTF8ToMFSName("hello", strlen("hello"), tempBuffer, mfsName) == 0 );
+    assert( UTF8ToMFSName("hello", strlen("hello"), kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
     assert( mfsName[0] == 5 );
     assert( strncmp( (char *) &mfsName[1], "hello", 5) == 0 );
 
     // empty string
     
-    assert( UTF8ToMFSName("", 0, tempBuffer, mfsName) == 0 );
+    assert( UTF8ToMFSName("", 0, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
     assert( mfsName[0] == 0 );
     
     // long name
     
     assert(strlen(kLongStr) == 255);
-    assert( UTF8ToMFSName(kLongStr, 255, tempBuffer, mfsName) == 0 );
+    assert( UTF8ToMFSName(kLongStr, 255, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
     assert( mfsName[0] == strlen(kLongStr) );
     assert( strncmp( (char *) &mfsName[1], kLongStr, strlen(kLongStr)) == 0 );
 
     // too long name
     
     assert(strlen(kTooLongStr) == 256);
-    err = UTF8ToMFSName(kTooLongStr, 256, tempBuffer, mfsName);
+    err = UTF8ToMFSName(kTooLongStr, 256, kMFSTextEncodingMacRoman, tempBuffer, mfsName);
     assert(err == ENAMETOOLONG );
 
     // correct UTF-8 
     
-    assert( UTF8ToMFSName("hello" "\xEF\xA3\xBF" "cruel", 13, tempBuffer, mfsName) == 0 );
+    assert( UTF8ToMFSName("hello" "\xEF\xA3\xBF" "cruel", 13, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
     assert( mfsName[0] == 11 );
     assert( strncmp( (char *) &mfsName[1], "hello" "\xf0" "cruel", 11) == 0 );
 
-    assert( UTF8ToMFSName("hello" "\xC2\xA0" "cruel", 12, tempBuffer, mfsName) == 0 );          // first entry in table
+    assert( UTF8ToMFSName("hello" "\xC2\xA0" "cruel", 12, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );          // first entry in table
     assert( mfsName[0] == 11 );
     assert( strncmp( (char *) &mfsName[1], "hello" "\xca" "cruel", 11) == 0 );
-    assert( UTF8ToMFSName("hello" "\xEF\xAC\x82" "cruel", 13, tempBuffer, mfsName) == 0 );      // last entry in table
+    assert( UTF8ToMFSName("hello" "\xEF\xAC\x82" "cruel", 13, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );      // last entry in table
     assert( mfsName[0] == 11 );
     assert( strncmp( (char *) &mfsName[1], "hello" "\xdf" "cruel", 11) == 0 );
 
     // char that has no mapping in MacRoman (U+00F0)
 
-    assert( UTF8ToMFSName("hello" "\xc3\xB0" "cruel", 12, tempBuffer, mfsName) == EINVAL );
+    assert( UTF8ToMFSName("hello" "\xc3\xB0" "cruel", 12, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
+    
+    // chars that have no mapping, one in a page that has mappings (U+00A4) and 
+    // one in a page that has none (U+2600)
+    
+    assert( UTF8ToMFSName("\xc2\xA4", 2, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
+    assert( UTF8ToMFSName("\xe2\x98\x80", 3, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
+    
+    // every high-bit MacRoman character round trips
+    
+    for (i = 128; i < 256; i++) {
+        uint8_t     singleCharName[2];
+        
+        singleCharName[0] = 1;
+        singleCharName[1] = (uint8_t) i;
+        (void) MFSNameToUTF8(singleCharName, kMFSTextEncodingMacRoman, utf8, sizeof(utf8));
+        assert( UTF8ToMFSName(utf8, strlen(utf8), kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
+        assert( mfsName[0] == 1 );
+        assert( mfsName[1] == i );
+    }
     
     // bogus UTF-8
 
-    assert( UTF8ToMFSName("hello" "\x80\x80\x80" "cruel", 13, tempBuffer, mfsName) == EINVAL );
+    assert( UTF8ToMFSName("hello" "\x80\x80\x80" "cruel", 13, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
+
+    // a non-ASCII character at every position of a name that's longer than a 
+    // word, to exercise both halves of the ASCII fast path check; "\xc3\xa9" is 
+    // U+00E9 (LATIN SMALL LETTER E WITH ACUTE), which is MacRoman 0x8E
+    
+    for (i = 0; i < 18; i++) {
+        char    accented[32];
+        
+        memset(accented, 'a', 19);
+        accented[i]     = '\xc3';
+        accented[i + 1] = '\xa9';
+        assert( UTF8ToMFSName(accented, 19, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
+        assert( mfsName[0] == 18 );
+        assert( mfsName[i + 1] == 0x8e );
+        assert( mfsName[1] == ((i == 0) ? 0x8e : 'a') );
+        assert( mfsName[18] == ((i == 17) ? 0x8e : 'a') );
+    }
 
     // composition ("\xcc\x88" = U+0308 = COMBINING DIAERESIS, which should compose with the 
     // preceding "o" to form U+00F6 which converts to MacRoman 0x9A)
 
-    assert( UTF8ToMFSName("hello" "\xcc\x88" "cruel", 12, tempBuffer, mfsName) == 0 );
+    assert( UTF8ToMFSName("hello" "\xcc\x88" "cruel", 12, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == 0 );
     assert( mfsName[0] == 10 );
     assert( strncmp( (char *) &mfsName[1], "hell" "\x9a" "cruel", 10) == 0 );
 
     // composites that don't yield MacRoman; the diaeresis won't compose with the preceding 
     // "l", so the UTF-16 array has U+0308 in it, which isn't mappable to MacRoman
     
-    assert( UTF8ToMFSName("hell" "\xcc\x88" "cruel", 12, tempBuffer, mfsName) == EINVAL );
+    assert( UTF8ToMFSName("hell" "\xcc\x88" "cruel", 12, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
     
     // round trip fidelity (for everything except the null character; can't do round trip 
     // for the null character, because a UTF-8 C string is terminated by a null)
@@ -660,9 +1297,9 @@ static void TestMFSCoreMacRoman(void)
         macRoman[0] = 1;
         macRoman[1] = (uint8_t) i;
         
-        assert( MFSNameToUTF8(macRoman, utf8, sizeof(utf8)) <= sizeof(utf8));
+        assert( MFSNameToUTF8(macRoman, kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) <= sizeof(utf8));
         
-        err = UTF8ToMFSName( (const char *) utf8, strlen( (const char *) utf8), tempBuffer, macRoman2);
+        err = UTF8ToMFSName( (const char *) utf8, strlen( (const char *) utf8), kMFSTextEncodingMacRoman, tempBuffer, macRoman2);
         assert(err == 0);
         
         assert( macRoman[0] == macRoman2[0] );
@@ -674,25 +1311,25 @@ static void TestMFSCoreMacRoman(void)
     
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "hello");
-    MFSNameToUpper(mfsName);
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacRoman);
     assert(mfsName[0] == 5);
     assert(strncmp( (char *) &mfsName[1], "HELLO", 5) == 0);
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "HELLO");
-    MFSNameToUpper(mfsName);
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacRoman);
     assert(mfsName[0] == 5);
     assert(strncmp( (char *) &mfsName[1], "HELLO", 5) == 0);
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "h" "\x8e" "llo");
-    MFSNameToUpper(mfsName);
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacRoman);
     assert(mfsName[0] == 5);
     assert(strncmp( (char *) &mfsName[1], "H" "\x83" "LLO", 5) == 0);
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "H" "\x83" "LLO");
-    MFSNameToUpper(mfsName);
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacRoman);
     assert(mfsName[0] == 5);
     assert(strncmp( (char *) &mfsName[1], "H" "\x83" "LLO", 5) == 0);
     
@@ -703,65 +1340,375 @@ static void TestMFSCoreMacRoman(void)
     
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "hello");
-    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "HELLO");
-    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
     
     mfsName[0] = 4;
     strcpy( (char *) &mfsName[1], "hell");
-    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "hellx");
-    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "Xello");
-    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
 
     mfsNameUpper[0] = 5;
     strcpy( (char *) &mfsNameUpper[1],  "H" "\x83" "LLO");
 
     mfsName[0] = 5;
     strcpy( (char *) &mfsName[1], "h" "\x8e" "llo");
-    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
     
     assert(strlen(kLongStr) == 255);
     mfsNameUpper[0] = 255;
     memcpy(&mfsNameUpper[1], kLongStr, 255);
-    MFSNameToUpper(mfsNameUpper);
+    MFSNameToUpper(mfsNameUpper, kMFSTextEncodingMacRoman);
 
     mfsName[0] = 255;
     memcpy(&mfsName[1], kLongStr, 255);
 
-    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper) );
+    assert( MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
 
     mfsName[255] = 'X';
-    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper) );
-}
-
-static boolean_t TimeSpecCheck(const struct timespec *ts, int year, int month, int day, int hour, int minute, int second)
-{
-    struct tm   tm;
+    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
     
-    assert(ts->tv_nsec == 0);
+    // word-at-a-time folding must match character-at-a-time folding (which is 
+    // what you get for a single character name) for every length and alignment, 
+    // with and without high-bit characters
     
-    (void) gmtime_r(&ts->tv_sec, &tm);
-
-    return ((tm.tm_year + 1900) == year) 
-        && ((tm.tm_mon + 1)  == month)
-        && (tm.tm_mday == day)
-        && (tm.tm_hour == hour)
-        && (tm.tm_min  == minute)
-        && (tm.tm_sec  == second)
-        ;
+    {
+        uint8_t     upperMap[256];
+        uint32_t    seed;
+        int         len;
+        int         trial;
+        int         charIndex;
+        
+        for (i = 0; i < 256; i++) {
+            mfsName[0] = 1;
+            mfsName[1] = (uint8_t) i;
+            MFSNameToUpper(mfsName, kMFSTextEncodingMacRoman);
+            upperMap[i] = mfsName[1];
+        }
+        assert(upperMap['a'] == 'A');
+        assert(upperMap['z'] == 'Z');
+        assert(upperMap['`'] == '`');
+        assert(upperMap['{'] == '{');
+        assert(upperMap[0x8e] == 0x83);
+        
+        seed = 1;
+        for (len = 0; len <= 40; len++) {
+            for (trial = 0; trial < 64; trial++) {
+                mfsName[0] = (uint8_t) len;
+                for (charIndex = 1; charIndex <= len; charIndex++) {
+                    seed = (seed * 1103515245) + 12345;
+                    if ( (trial % 2) == 0 ) {
+                        mfsName[charIndex] = (uint8_t) ((seed >> 16) & 0x7F);
+                    } else {
+                        mfsName[charIndex] = (uint8_t) (seed >> 16);
+                    }
+                }
+                memcpy(mfsNameUpper, mfsName, len + 1);
+                MFSNameToUpper(mfsNameUpper, kMFSTextEncodingMacRoman);
+                
+                assert(mfsNameUpper[0] == len);
+                for (charIndex = 1; charIndex <= len; charIndex++) {
+                    assert(mfsNameUpper[charIndex] == upperMap[mfsName[charIndex]]);
+                }
+                assert( MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
+                
+                // changing any one character to one that folds differently must 
+                // break the match
+                
+                for (charIndex = 1; charIndex <= len; charIndex++) {
+                    uint8_t     oldChar;
+                    
+                    oldChar = mfsName[charIndex];
+                    mfsName[charIndex] = (upperMap[oldChar] == 'Q') ? 'r' : 'q';
+                    assert( ! MFSNameEqualToUpper(mfsName, mfsNameUpper, kMFSTextEncodingMacRoman) );
+                    mfsName[charIndex] = oldChar;
+                }
+            }
+        }
+    }
 }
 
-static void TestMFSCoreMDB(void)
+static void TestMFSCoreTextEncodings(void)
 {
-    int             err;
+    int                 err;
+    MFSTextEncoding     encoding;
+    int                 ch;
+    uint8_t             singleCharName[2];
+    char                utf8[MAXPATHLEN];
+    char                tempBuffer[kUTF8ToMFSNameTempBufferSize];
+    uint8_t             mfsName[256];
+    uint8_t             mfsNameUpper[256];
+    struct vnode_attr   attr;
+    
+    // MacCyrillic
+    
+    assert( MFSNameToUTF8("\p\x8F\xF0\xE8\xE2\xE5\xF2", kMFSTextEncodingMacCyrillic, utf8, sizeof(utf8)) == 13 );
+    assert( strcmp(utf8, "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82") == 0 );
+    assert( UTF8ToMFSName(utf8, strlen(utf8), kMFSTextEncodingMacCyrillic, tempBuffer, mfsName) == 0 );
+    assert( memcmp(mfsName, "\p\x8F\xF0\xE8\xE2\xE5\xF2", 7) == 0 );
+
+    // The same bytes mean something completely different in MacRoman, and a 
+    // Cyrillic name can't be represented in MacRoman at all.
+    
+    assert( MFSNameToUTF8("\p\x8F\xF0\xE8\xE2\xE5\xF2", kMFSTextEncodingMacRoman, utf8, sizeof(utf8)) != 13 );
+    assert( UTF8ToMFSName("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82", 12, kMFSTextEncodingMacRoman, tempBuffer, mfsName) == EINVAL );
+    assert( UTF8ToMFSName("\xc3\xa9", 2, kMFSTextEncodingMacCyrillic, tempBuffer, mfsName) == EINVAL );
+
+    // Cyrillic short I decomposes to 4 bytes of UTF-8, the longest of any supported 
+    // encoding; make sure that it goes both ways, and that it's truncated as a unit.
+    
+    assert( MFSNameToUTF8("\pa\x89", kMFSTextEncodingMacCyrillic, utf8, sizeof(utf8)) == 6 );
+    assert( strcmp(utf8, "a\xD0\x98\xCC\x86") == 0 );
+    assert( MFSNameToUTF8("\pa\x89", kMFSTextEncodingMacCyrillic, utf8, 5) == 6 );
+    assert( strcmp(utf8, "a") == 0 );
+    assert( UTF8ToMFSName("a\xD0\x99", 3, kMFSTextEncodingMacCyrillic, tempBuffer, mfsName) == 0 );
+    assert( memcmp(mfsName, "\pa\x89", 3) == 0 );
+
+    memcpy(mfsName, "\p\xEF\xF0\xE8\xE2\xE5\xF2", 7);
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacCyrillic);
+    assert( memcmp(mfsName, "\p\x8F\x90\x88\x82\x85\x92", 7) == 0 );
+    assert(   MFSNameEqualToUpper("\p\x8F\xF0\xE8\xE2\xE5\xF2", mfsName, kMFSTextEncodingMacCyrillic) );
+    assert( ! MFSNameEqualToUpper("\p\x8F\xF0\xE8\xE2\xE5\xF2", mfsName, kMFSTextEncodingMacRoman) );
+    
+    // MacCentralEurope
+    
+    assert( MFSNameToUTF8("\p\xFC\x97\x64\x90", kMFSTextEncodingMacCentralEurope, utf8, sizeof(utf8)) == 10 );
+    assert( strcmp(utf8, "\xC5\x81\x6F\xCC\x81\x64\x7A\xCC\x81") == 0 );
+    assert( UTF8ToMFSName("\xC5\x82\xC3\xB3\x64\xC5\xBA", 7, kMFSTextEncodingMacCentralEurope, tempBuffer, mfsName) == 0 );
+    assert( memcmp(mfsName, "\p\xB8\x97\x64\x90", 5) == 0 );
+    MFSNameToUpper(mfsName, kMFSTextEncodingMacCentralEurope);
+    assert( MFSNameEqualToUpper("\p\xFC\x97\x64\x90", mfsName, kMFSTextEncodingMacCentralEurope) );
+    
+    // Every character of every encoding must survive a round trip through UTF-8, 
+    // and upper casing must be idempotent.
+    
+    for (encoding = 0; encoding < kMFSTextEncodingCount; encoding++) {
+        for (ch = 1; ch < 256; ch++) {
+            singleCharName[0] = 1;
+            singleCharName[1] = (uint8_t) ch;
+            (void) MFSNameToUTF8(singleCharName, encoding, utf8, sizeof(utf8));
+            assert( UTF8ToMFSName(utf8, strlen(utf8), encoding, tempBuffer, mfsName) == 0 );
+            assert( (mfsName[0] == 1) && (mfsName[1] == ch) );
+            
+            memcpy(mfsNameUpper, singleCharName, sizeof(singleCharName));
+            MFSNameToUpper(mfsNameUpper, encoding);
+            assert( MFSNameEqualToUpper(singleCharName, mfsNameUpper, encoding) );
+            memcpy(mfsName, mfsNameUpper, sizeof(singleCharName));
+            MFSNameToUpper(mfsName, encoding);
+            assert( mfsName[1] == mfsNameUpper[1] );
+        }
+    }
+    
+    // The directory entry routines report the encoding in va_encoding.
+    
+    VATTR_INIT(&attr);
+    VATTR_WANTED(&attr, va_encoding);
+    VATTR_WANTED(&attr, va_name);
+    attr.va_name = utf8;
+    err = MFSDirectoryEntryGetAttr(
+        gSampleData + 4 * kSampleDataBlockSize,
+        0x3A,                                               // "TN.002.Compatibility" file
+        kMFSTextEncodingMacCyrillic,
+        &attr
+    );
+    assert(err == 0);
+    assert(attr.va_encoding == 7);
+    assert( strcmp(attr.va_name, "TN.002.Compatibility") == 0 );
+}
+
+static boolean_t TimeSpecCheck(const struct timespec *ts, int year, int month, int day, int hour, int minute, int second)
+{
+    struct tm   tm;
+    
+    assert(ts->tv_nsec == 0);
+    
+    (void) gmtime_r(&ts->tv_sec, &tm);
+
+    return ((tm.tm_year + 1900) == year) 
+        && ((tm.tm_mon + 1)  == month)
+        && (tm.tm_mday == day)
+        && (tm.tm_hour == hour)
+        && (tm.tm_min  == minute)
+        && (tm.tm_sec  == second)
+        ;
+}
+
+static int CFUTF8DecodeStr(const uint8_t *utf8p, size_t utf8len, uint16_t *ucsp, size_t *ucslen, size_t buflen)
+    // This was our original user space implementation of utf8_decodestr, which 
+    // does the work using CFStringNormalize.  We keep it around as a reference for 
+    // testing the table-driven implementation, and as a baseline for benchmarking it.
+{
+    int                 err;
+    CFStringRef         str;
+    CFMutableStringRef  tmpStr;
+    CFIndex             utf16Count;
+
+    err = 0;
+    tmpStr = NULL;
+    str = CFStringCreateWithBytes(NULL, utf8p, utf8len, kCFStringEncodingUTF8, false);
+    if (str == NULL) {
+        err = EINVAL;
+    }
+    if (err == 0) {
+        tmpStr = CFStringCreateMutableCopy(NULL, 0, str);
+        assert(tmpStr != NULL);
+        CFStringNormalize(tmpStr, kCFStringNormalizationFormC);
+        
+        utf16Count = CFStringGetLength(tmpStr);
+        if (utf16Count > (buflen / 2)) {
+            utf16Count = (buflen / 2);
+            err = ENAMETOOLONG;
+        }
+        CFStringGetCharacters(tmpStr, CFRangeMake(0, utf16Count), ucsp);
+        *ucslen = utf16Count * sizeof(uint16_t);
+    }
+    
+    if (tmpStr != NULL) {
+        CFRelease(tmpStr);
+    }
+    if (str != NULL) {
+        CFRelease(str);
+    }
+    return err;
+}
+
+static void TestMFSCoreUTF8DecodeStr(void)
+{
+    int         err;
+    int         refErr;
+    uint16_t    utf16[256];
+    uint16_t    refUTF16[256];
+    size_t      utf16Len;
+    size_t      refUTF16Len;
+    uint32_t    ch;
+    size_t      caseIndex;
+    size_t      bufSize;
+    static const struct {
+        const char *    utf8;
+        size_t          utf8Len;
+        int             err;
+    } kValidityCases[] = {
+        { "",                      0, 0      },
+        { "abc",                   3, 0      },
+        { "a\000b",                3, 0      },     // embedded null
+        { "\xc2\xa9",              2, 0      },     // U+00A9
+        { "\xef\xbf\xbd",          3, 0      },     // U+FFFD
+        { "\xf0\x9f\x98\x80",      4, 0      },     // U+1F600, needs a surrogate pair
+        { "\xf4\x8f\xbf\xbf",      4, 0      },     // U+10FFFF
+        { "\x80",                  1, EINVAL },     // stray continuation byte
+        { "\xc0\x80",              2, EINVAL },     // overlong
+        { "\xc1\xbf",              2, EINVAL },     // overlong
+        { "\xe0\x9f\xbf",          3, EINVAL },     // overlong
+        { "\xf0\x8f\xbf\xbf",      4, EINVAL },     // overlong
+        { "\xed\xa0\x80",          3, EINVAL },     // surrogate
+        { "\xf4\x90\x80\x80",      4, EINVAL },     // beyond U+10FFFF
+        { "\xf5\x80\x80\x80",      4, EINVAL },     // never valid
+        { "\xe2\x82",              2, EINVAL },     // truncated
+        { "a\xe2\x82" "b",          4, EINVAL },     // truncated
+    };
+    
+    // validity checking
+    
+    for (caseIndex = 0; caseIndex < (sizeof(kValidityCases) / sizeof(kValidityCases[0])); caseIndex++) {
+        err = utf8_decodestr( (const uint8_t *) kValidityCases[caseIndex].utf8, kValidityCases[caseIndex].utf8Len, utf16, &utf16Len, sizeof(utf16), 0, UTF_PRECOMPOSED);
+        assert(err == kValidityCases[caseIndex].err);
+    }
+    err = utf8_decodestr( (const uint8_t *) "\xf0\x9f\x98\x80", 4, utf16, &utf16Len, sizeof(utf16), 0, UTF_PRECOMPOSED);
+    assert(err == 0);
+    assert(utf16Len == (2 * sizeof(uint16_t)));
+    assert( (utf16[0] == 0xD83D) && (utf16[1] == 0xDE00) );
+    
+    // Every BMP character, decomposed (which is how Mac OS X sends them to us), must 
+    // precompose to the same thing as it does using CF.
+    
+    for (ch = 0; ch < 0x10000; ch++) {
+        UniChar             uch;
+        CFStringRef         str;
+        CFMutableStringRef  decomposed;
+        uint8_t             utf8[64];
+        CFIndex             utf8Len;
+        
+        if ( (ch >= 0xD800) && (ch <= 0xDFFF) ) {
+            continue;
+        }
+        uch = (UniChar) ch;
+        str = CFStringCreateWithCharacters(NULL, &uch, 1);
+        assert(str != NULL);
+        decomposed = CFStringCreateMutableCopy(NULL, 0, str);
+        assert(decomposed != NULL);
+        CFStringNormalize(decomposed, kCFStringNormalizationFormD);
+        
+        (void) CFStringGetBytes(decomposed, CFRangeMake(0, CFStringGetLength(decomposed)), kCFStringEncodingUTF8, 0, false, utf8, sizeof(utf8), &utf8Len);
+        
+        err    = utf8_decodestr(utf8, utf8Len, utf16, &utf16Len, sizeof(utf16), 0, UTF_PRECOMPOSED);
+        refErr = CFUTF8DecodeStr(utf8, utf8Len, refUTF16, &refUTF16Len, sizeof(refUTF16));
+        assert(err == 0);
+        assert(refErr == 0);
+        assert(utf16Len == refUTF16Len);
+        assert(memcmp(utf16, refUTF16, utf16Len) == 0);
+        
+        CFRelease(decomposed);
+        CFRelease(str);
+    }
+    
+    // Truncation at every buffer size, including in the middle of a surrogate pair 
+    // and just before a combining character that composes with the previous one.
+    
+    {
+        static const char kMixed[] = "Re\xcc\x81sume\xcc\x81 \xf0\x9f\x98\x80 \xe1\x84\x92\xe1\x85\xa1\xe1\x86\xab";
+        
+        for (bufSize = 0; bufSize <= 40; bufSize++) {
+            err    = utf8_decodestr( (const uint8_t *) kMixed, sizeof(kMixed) - 1, utf16, &utf16Len, bufSize, 0, UTF_PRECOMPOSED);
+            refErr = CFUTF8DecodeStr( (const uint8_t *) kMixed, sizeof(kMixed) - 1, refUTF16, &refUTF16Len, bufSize);
+            assert(err == refErr);
+            assert(utf16Len == refUTF16Len);
+            assert(memcmp(utf16, refUTF16, utf16Len) == 0);
+        }
+        assert(err == 0);
+        assert(utf16Len == (11 * sizeof(uint16_t)));
+        assert(utf16[10] == 0xD55C);        // U+1112 U+1161 U+11AB composes to U+D55C
+    }
+    
+    // Multiple combining marks.  Precomposition is pairwise, like the kernel's 
+    // utf8_decodestr, so a mark only composes with the character immediately before 
+    // it.  That gets the same answer as NFC when each mark composes in turn, but 
+    // not when an uncomposable mark of a lower combining class sits between the 
+    // base and a mark that would compose with it.
+    
+    {
+        static const struct {
+            const char *    utf8;
+            size_t          utf16Count;
+            uint16_t        utf16[3];
+        } kMultiMarkCases[] = {
+            { "e\xcc\xa7\xcc\x86", 1, { 0x1E1D } },                   // e U+0327 U+0306, composes twice
+            { "o\xcc\x82\xcc\x81", 1, { 0x1ED1 } },                   // o U+0302 U+0301, composes twice
+            { "a\xcc\x81\xcc\x96", 2, { 0x00E1, 0x0316 } },           // a U+0301 U+0316, composes once
+            { "a\xcc\x96\xcc\x81", 3, { 0x0061, 0x0316, 0x0301 } },   // a U+0316 U+0301; NFC gives U+00E1 U+0316
+        };
+        
+        for (caseIndex = 0; caseIndex < (sizeof(kMultiMarkCases) / sizeof(kMultiMarkCases[0])); caseIndex++) {
+            err = utf8_decodestr( (const uint8_t *) kMultiMarkCases[caseIndex].utf8, strlen(kMultiMarkCases[caseIndex].utf8), utf16, &utf16Len, sizeof(utf16), 0, UTF_PRECOMPOSED);
+            assert(err == 0);
+            assert(utf16Len == (kMultiMarkCases[caseIndex].utf16Count * sizeof(uint16_t)));
+            assert(memcmp(utf16, kMultiMarkCases[caseIndex].utf16, utf16Len) == 0);
+        }
+    }
+}
+
+static void TestMFSCoreMDB(void)
+{
+    int             err;
     size_t          mdbAndVABMSizeInBytes;
     uint16_t        directoryStartBlock;
     uint16_t        directoryBlockCount;
@@ -831,7 +1778,7 @@ static void TestMFSCoreMDB(void)
 
     attr.f_vol_name = volName;
 
-    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, &attr);
+    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, kMFSTextEncodingMacRoman, &attr);
     assert(err == 0);
     
     assert(VFSATTR_IS_SUPPORTED(&attr, f_objcount));
@@ -973,6 +1920,7 @@ static void TestMFSCoreDirIterate(void)
     uint16_t        dirBlock;
     struct vfs_attr attr;
     size_t          dirOffset;
+    uint8_t         bitmap[kSampleDataBlockSize / 16];
     
     err = MFSMDBCheck(
         gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
@@ -993,6 +1941,7 @@ static void TestMFSCoreDirIterate(void)
                 gSampleData + dirBlock * kSampleDataBlockSize,
                 kSampleDataBlockSize,
                 &dirOffset,
+                kMFSTextEncodingMacRoman,
                 NULL
             );
             assert( (err == 0) || (err == ENOENT) );
@@ -1006,7 +1955,7 @@ static void TestMFSCoreDirIterate(void)
     VFSATTR_INIT(&attr);
     VFSATTR_WANTED(&attr, f_objcount);
 
-    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, &attr);
+    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, kMFSTextEncodingMacRoman, &attr);
     assert(err == 0);
 
     assert( fileCount == attr.f_filecount );
@@ -1023,6 +1972,7 @@ static void TestMFSCoreDirIterate(void)
             gSampleData + 4 * kSampleDataBlockSize,
             0x1d2,
             &dirOffset,
+            kMFSTextEncodingMacRoman,
             NULL
         );
         assert( (err == 0) || (err == ENOENT) );
@@ -1042,6 +1992,7 @@ static void TestMFSCoreDirIterate(void)
             gSampleData + 5 * kSampleDataBlockSize,
             0x0c6,
             &dirOffset,
+            kMFSTextEncodingMacRoman,
             NULL
         );
         assert( (err == 0) || (err == ENOENT) );
@@ -1072,6 +2023,28 @@ static void TestMFSCoreDirIterate(void)
         );
         assert( (err == 0) == valid[dirOffset] );
     }
+    
+    // Check MFSDirectoryBlockOffsetBitmapCheckDirOffset, first against the 
+    // known offsets in block 4 and then against MFSDirectoryBlockCheckDirOffset 
+    // for every offset in every directory block.
+    
+    assert(MFSDirectoryBlockGetOffsetBitmapSize(kSampleDataBlockSize) == sizeof(bitmap));
+    
+    MFSDirectoryBlockBuildOffsetBitmap(gSampleData + 4 * kSampleDataBlockSize, kSampleDataBlockSize, bitmap);
+    for (dirOffset = 0; dirOffset < kSampleDataBlockSize; dirOffset++) {
+        err = MFSDirectoryBlockOffsetBitmapCheckDirOffset(bitmap, kSampleDataBlockSize, dirOffset);
+        assert( (err == 0) == valid[dirOffset] );
+    }
+    
+    for (dirBlock = directoryStartBlock; dirBlock < (directoryStartBlock + directoryBlockCount); dirBlock++) {
+        MFSDirectoryBlockBuildOffsetBitmap(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, bitmap);
+        for (dirOffset = 0; dirOffset < kSampleDataBlockSize; dirOffset++) {
+            assert( 
+                   MFSDirectoryBlockOffsetBitmapCheckDirOffset(bitmap, kSampleDataBlockSize, dirOffset) 
+                == MFSDirectoryBlockCheckDirOffset(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, dirOffset)
+            );
+        }
+    }
 }
 
 static void TestMFSCoreGetAttr(void)
@@ -1116,6 +2089,7 @@ static void TestMFSCoreGetAttr(void)
     err = MFSDirectoryEntryGetAttr(
         gSampleData + 4 * kSampleDataBlockSize,
         0x3A,                                               // "TN.002.Compatibility" file
+        kMFSTextEncodingMacRoman,
         &attr
     );
     assert(err == 0);
@@ -1194,222 +2168,1793 @@ static void TestMFSCoreGetFinderInfo(void)
     assert(success);
 }
 
-static void TestMFSCoreExtent(void)
+static void TestMFSCoreDirectoryIndex(void)
+{
+    int                 err;
+    SampleVolumeInfo    volume;
+    size_t              bufferSize;
+    uint32_t *          buffer;
+    MFSDirectoryIndex   index;
+    uint16_t            dirBlock;
+    size_t              dirOffset;
+    size_t              entryIndex;
+    size_t              forkIndex;
+    const uint8_t *     dirRec;
+    struct vnode_attr   attr;
+    MFSForkInfo         forkInfo;
+    uint8_t             finderInfo[16];
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    bufferSize = MFSDirectoryIndexGetBufferSize(volume.directoryBlockCount, kSampleDataBlockSize);
+    buffer = malloc(bufferSize);
+    assert(buffer != NULL);
+
+    // A buffer that's too small is an error.
+    
+    err = MFSDirectoryIndexBuild(gSampleData + volume.directoryStartBlock * kSampleDataBlockSize, volume.directoryStartBlock, volume.directoryBlockCount, kSampleDataBlockSize, kMFSTextEncodingMacRoman, buffer, bufferSize - 1, &index);
+    assert(err == EINVAL);
+
+    err = MFSDirectoryIndexBuild(gSampleData + volume.directoryStartBlock * kSampleDataBlockSize, volume.directoryStartBlock, volume.directoryBlockCount, kSampleDataBlockSize, kMFSTextEncodingMacRoman, buffer, bufferSize, &index);
+    assert(err == 0);
+    assert(index.entryCount == OSReadBigInt16(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, 12));
+
+    // Iterate the directory the old way and check that each entry matches the 
+    // corresponding index entry.
+    
+    entryIndex = 0;
+    for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+        dirOffset = kMFSDirectoryBlockIterateFromStart;
+        do {
+            VATTR_INIT(&attr);
+            VATTR_WANTED(&attr, va_fileid);
+            VATTR_WANTED(&attr, va_flags);
+            VATTR_WANTED(&attr, va_create_time);
+            VATTR_WANTED(&attr, va_modify_time);
+            err = MFSDirectoryBlockIterate(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, &dirOffset, kMFSTextEncodingMacRoman, &attr);
+            assert( (err == 0) || (err == ENOENT) );
+            
+            if (err == 0) {
+                assert(entryIndex < index.entryCount);
+                assert(index.dirBlocks[entryIndex]  == dirBlock);
+                assert(index.dirOffsets[entryIndex] == dirOffset);
+                assert(index.fileNumbers[entryIndex] == (attr.va_fileid + 1 - kMFSFirstFileInodeName));
+                assert( ((index.attributes[entryIndex] & 0x01) != 0) == (attr.va_flags != 0) );
+                assert(MFSDateTimeToTimeSpec(index.creationDates[entryIndex]).tv_sec     == attr.va_create_time.tv_sec);
+                assert(MFSDateTimeToTimeSpec(index.modificationDates[entryIndex]).tv_sec == attr.va_modify_time.tv_sec);
+                
+                for (forkIndex = 0; forkIndex < 2; forkIndex++) {
+                    err = MFSDirectoryEntryGetForkInfo(gSampleData + dirBlock * kSampleDataBlockSize, dirOffset, forkIndex, &forkInfo);
+                    assert(err == 0);
+                    assert(index.forkInfos[forkIndex][entryIndex].firstAllocationBlock  == forkInfo.firstAllocationBlock);
+                    assert(index.forkInfos[forkIndex][entryIndex].lengthInBytes         == forkInfo.lengthInBytes);
+                    assert(index.forkInfos[forkIndex][entryIndex].physicalLengthInBytes == forkInfo.physicalLengthInBytes);
+                }
+                
+                err = MFSDirectoryEntryGetFinderInfo(gSampleData + dirBlock * kSampleDataBlockSize, dirOffset, finderInfo);
+                assert(err == 0);
+                assert(memcmp(&index.finderInfos[entryIndex * 16], finderInfo, sizeof(finderInfo)) == 0);
+                
+                // The name is at offset 50 in the directory entry.
+                
+                dirRec = gSampleData + dirBlock * kSampleDataBlockSize + dirOffset;
+                assert(index.upperNames[index.upperNameOffsets[entryIndex]] == dirRec[50]);
+                assert( MFSNameEqualToUpper(&dirRec[50], &index.upperNames[index.upperNameOffsets[entryIndex]], kMFSTextEncodingMacRoman) );
+                
+                entryIndex += 1;
+            }
+        } while (err == 0);
+    }
+    assert(entryIndex == index.entryCount);
+    
+    free(buffer);
+}
+
+static void TestMFSCoreDirectoryBlockDecodeAll(void)
+{
+    int                     err;
+    SampleVolumeInfo        volume;
+    uint16_t                dirBlock;
+    const void *            dirBlockPtr;
+    size_t                  dirOffset;
+    MFSDirectoryEntryInfo   entries[kSampleDataBlockSize / 52];
+    size_t                  entryCount;
+    size_t                  entryIndex;
+    size_t                  shortEntryCount;
+    struct vnode_attr       attr;
+    char                    name[MAXPATHLEN];
+    char                    decodedName[MAXPATHLEN];
+    uint8_t                 finderInfo[16];
+    MFSForkInfo             forkInfos[2];
+    size_t                  forkIndex;
+
+    TestMFSCoreGetSampleVolume(&volume);
+    
+    assert(MFSDirectoryBlockGetMaximumEntryCount(kSampleDataBlockSize) == (sizeof(entries) / sizeof(entries[0])));
+
+    // Check that each decoded entry matches what you get from the per-entry 
+    // routines.
+    
+    for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+        dirBlockPtr = gSampleData + dirBlock * kSampleDataBlockSize;
+
+        err = MFSDirectoryBlockDecodeAll(dirBlockPtr, kSampleDataBlockSize, entries, sizeof(entries) / sizeof(entries[0]), &entryCount);
+        assert(err == 0);
+        
+        entryIndex = 0;
+        dirOffset = kMFSDirectoryBlockIterateFromStart;
+        do {
+            VATTR_INIT(&attr);
+            attr.va_name = name;
+            VATTR_WANTED(&attr, va_name);
+            VATTR_WANTED(&attr, va_fileid);
+            VATTR_WANTED(&attr, va_flags);
+            VATTR_WANTED(&attr, va_create_time);
+            VATTR_WANTED(&attr, va_modify_time);
+
+            err = MFSDirectoryBlockIterate(dirBlockPtr, kSampleDataBlockSize, &dirOffset, kMFSTextEncodingMacRoman, &attr);
+            if (err == 0) {
+                assert(entryIndex < entryCount);
+                assert(entries[entryIndex].dirOffset == dirOffset);
+                assert( (entries[entryIndex].fileNumber - 1 + kMFSFirstFileInodeName) == attr.va_fileid );
+                assert( ((entries[entryIndex].attributes & 0x01) != 0) == (attr.va_flags != 0) );
+                assert( MFSDateTimeToTimeSpec(entries[entryIndex].creationDate).tv_sec     == attr.va_create_time.tv_sec );
+                assert( MFSDateTimeToTimeSpec(entries[entryIndex].modificationDate).tv_sec == attr.va_modify_time.tv_sec );
+
+                (void) MFSNameToUTF8(entries[entryIndex].name, kMFSTextEncodingMacRoman, decodedName, sizeof(decodedName));
+                assert(strcmp(decodedName, name) == 0);
+                
+                err = MFSDirectoryEntryGetFinderInfo(dirBlockPtr, dirOffset, finderInfo);
+                assert(err == 0);
+                assert(memcmp(entries[entryIndex].finderInfo, finderInfo, sizeof(finderInfo)) == 0);
+
+                err = MFSDirectoryEntryGetForkInfo(dirBlockPtr, dirOffset, 0, &forkInfos[0]);
+                assert(err == 0);
+                err = MFSDirectoryEntryGetForkInfo(dirBlockPtr, dirOffset, 1, &forkInfos[1]);
+                assert(err == 0);
+                for (forkIndex = 0; forkIndex < 2; forkIndex++) {
+                    assert(entries[entryIndex].forkInfos[forkIndex].firstAllocationBlock  == forkInfos[forkIndex].firstAllocationBlock);
+                    assert(entries[entryIndex].forkInfos[forkIndex].lengthInBytes         == forkInfos[forkIndex].lengthInBytes);
+                    assert(entries[entryIndex].forkInfos[forkIndex].physicalLengthInBytes == forkInfos[forkIndex].physicalLengthInBytes);
+                }
+                
+                entryIndex += 1;
+            }
+        } while (err == 0);
+        assert(err == ENOENT);
+        assert(entryIndex == entryCount);
+        
+        // A short array gets the right count, and no entries are written 
+        // beyond its end.
+        
+        if (entryCount > 1) {
+            memset(entries, 0xAA, sizeof(entries));
+            err = MFSDirectoryBlockDecodeAll(dirBlockPtr, kSampleDataBlockSize, entries, 1, &shortEntryCount);
+            assert(err == 0);
+            assert(shortEntryCount == entryCount);
+            assert(entries[1].fileNumber == 0xAAAAAAAA);
+        }
+        err = MFSDirectoryBlockDecodeAll(dirBlockPtr, kSampleDataBlockSize, NULL, 0, &shortEntryCount);
+        assert(err == 0);
+        assert(shortEntryCount == entryCount);
+    }
+}
+
+static void TestMFSCoreDirectoryNameHash(void)
+{
+    int                 err;
+    SampleVolumeInfo    volume;
+    uint32_t *          buffer;
+    MFSDirectoryIndex   index;
+    uint32_t *          slots;
+    size_t              slotCount;
+    size_t              entryIndex;
+    size_t              foundEntryIndex;
+    char                tempBuffer[kMFSDirectoryBlockFindEntryByNameTempBufferSize];
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
+
+    slotCount = MFSDirectoryNameHashGetSlotCount(index.entryCount);
+    assert( (slotCount & (slotCount - 1)) == 0 );
+    assert(slotCount >= (index.entryCount * 2));
+    slots = malloc(slotCount * sizeof(*slots));
+    assert(slots != NULL);
+    MFSDirectoryNameHashBuild(&index, slots, slotCount);
+
+    // Every name in the directory must be found, at its own index.
+    
+    for (entryIndex = 0; entryIndex < index.entryCount; entryIndex++) {
+        err = MFSDirectoryNameHashLookup(&index, slots, slotCount, &index.upperNames[index.upperNameOffsets[entryIndex]], &foundEntryIndex);
+        assert(err == 0);
+        assert(foundEntryIndex == entryIndex);
+    }
+    
+    // Lookups are case insensitive, and fail for names that aren't there or 
+    // can't be represented in MacRoman.
+    
+    err = MFSDirectoryNameHashLookupUTF8(&index, slots, slotCount, "tn.002.compatibility", 20, tempBuffer, &foundEntryIndex);
+    assert(err == 0);
+    assert(index.dirBlocks[foundEntryIndex]  == 4);
+    assert(index.dirOffsets[foundEntryIndex] == 0x3A);
+
+    err = MFSDirectoryNameHashLookupUTF8(&index, slots, slotCount, "TN.002.Compatibilit", 19, tempBuffer, &foundEntryIndex);
+    assert(err == ENOENT);
+    err = MFSDirectoryNameHashLookupUTF8(&index, slots, slotCount, "\xE4\xB8\x80", 3, tempBuffer, &foundEntryIndex);    // U+4E00 is not in MacRoman
+    assert(err == EINVAL);
+    err = MFSDirectoryNameHashLookupUTF8(&index, slots, slotCount, "", 0, tempBuffer, &foundEntryIndex);
+    assert(err == EINVAL);
+
+    free(slots);
+    free(buffer);
+}
+
+static void TestMFSCoreDirectoryNameCache(void)
+{
+    int                     err;
+    SampleVolumeInfo        volume;
+    const char *            directoryPtr;
+    uint32_t *              buffer;
+    MFSDirectoryIndex       index;
+    size_t                  cacheBufferSize;
+    void *                  cacheBuffer;
+    MFSDirectoryNameCache   cache;
+    size_t                  entryIndex;
+    size_t                  foundEntryIndex;
+    const char *            cachedName;
+    size_t                  cachedNameLen;
+    char                    utf8[MAXPATHLEN];
+    size_t                  utf8Size;
+    struct vnode_attr       attr;
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    directoryPtr = gSampleData + volume.directoryStartBlock * kSampleDataBlockSize;
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
+
+    // A buffer that's too small is rejected.
+    
+    cacheBufferSize = MFSDirectoryNameCacheGetBufferSize(&index);
+    cacheBuffer = malloc(cacheBufferSize);
+    assert(cacheBuffer != NULL);
+
+    err = MFSDirectoryNameCacheInit(&index, directoryPtr, volume.directoryStartBlock, kSampleDataBlockSize, cacheBuffer, cacheBufferSize - 1, &cache);
+    assert(err == EINVAL);
+    err = MFSDirectoryNameCacheInit(&index, directoryPtr, volume.directoryStartBlock, kSampleDataBlockSize, cacheBuffer, cacheBufferSize, &cache);
+    assert(err == 0);
+
+    // Every entry can be found by its location, and its cached name matches 
+    // what MFSDirectoryEntryGetAttr returns.  Asking again gives back the same string 
+    // without converting it again.
+    
+    for (entryIndex = 0; entryIndex < index.entryCount; entryIndex++) {
+        err = MFSDirectoryIndexFindEntry(&index, index.dirBlocks[entryIndex], index.dirOffsets[entryIndex], &foundEntryIndex);
+        assert(err == 0);
+        assert(foundEntryIndex == entryIndex);
+
+        VATTR_INIT(&attr);
+        attr.va_name = utf8;
+        VATTR_WANTED(&attr, va_name);
+        err = MFSDirectoryEntryGetAttr(
+            directoryPtr + (index.dirBlocks[entryIndex] - volume.directoryStartBlock) * kSampleDataBlockSize, 
+            index.dirOffsets[entryIndex], 
+            kMFSTextEncodingMacRoman, 
+            &attr
+        );
+        assert(err == 0);
+        utf8Size = strlen(utf8) + 1;
+        
+        assert(cache.utf8NameLengths[entryIndex] == kMFSDirectoryNameCacheNotConverted);
+        cachedName = MFSDirectoryNameCacheGetName(&cache, entryIndex, &cachedNameLen);
+        assert(cachedNameLen == (utf8Size - 1));
+        assert(strcmp(cachedName, utf8) == 0);
+        assert(MFSDirectoryNameCacheGetName(&cache, entryIndex, NULL) == cachedName);
+    }
+    
+    // Locations that aren't the start of a directory entry aren't found.
+    
+    err = MFSDirectoryIndexFindEntry(&index, index.dirBlocks[0], index.dirOffsets[0] + 1, &foundEntryIndex);
+    assert(err == ENOENT);
+    err = MFSDirectoryIndexFindEntry(&index, volume.directoryStartBlock + volume.directoryBlockCount, 0, &foundEntryIndex);
+    assert(err == ENOENT);
+
+    free(cacheBuffer);
+    free(buffer);
+}
+
+static void TestMFSCoreDirectoryFileNumberTable(void)
+{
+    int                 err;
+    SampleVolumeInfo    volume;
+    uint32_t *          buffer;
+    MFSDirectoryIndex   index;
+    uint32_t            firstFileNumber;
+    uint32_t *          slots;
+    size_t              slotCount;
+    size_t              entryIndex;
+    size_t              foundEntryIndex;
+    struct vnode_attr   attr;
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
+    assert(index.entryCount != 0);
+
+    slotCount = MFSDirectoryFileNumberTableGetSlotCount(&index, &firstFileNumber);
+    assert(slotCount >= index.entryCount);
+    assert(slotCount <= kMFSDirectoryFileNumberTableMaximumSlotCount);
+    slots = malloc(slotCount * sizeof(*slots));
+    assert(slots != NULL);
+    MFSDirectoryFileNumberTableBuild(&index, firstFileNumber, slots, slotCount);
+
+    // Every entry must be found, both with the table and with the fall back 
+    // search, and its file number must match the va_fileid reported by 
+    // MFSDirectoryEntryGetAttr.
+    
+    for (entryIndex = 0; entryIndex < index.entryCount; entryIndex++) {
+        err = MFSDirectoryFileNumberTableLookup(&index, firstFileNumber, slots, slotCount, index.fileNumbers[entryIndex], &foundEntryIndex);
+        assert(err == 0);
+        assert(foundEntryIndex == entryIndex);
+
+        err = MFSDirectoryFileNumberTableLookup(&index, 0, NULL, 0, index.fileNumbers[entryIndex], &foundEntryIndex);
+        assert(err == 0);
+        assert(foundEntryIndex == entryIndex);
+
+        VATTR_INIT(&attr);
+        VATTR_WANTED(&attr, va_fileid);
+        err = MFSDirectoryEntryGetAttr(gSampleData + index.dirBlocks[entryIndex] * kSampleDataBlockSize, index.dirOffsets[entryIndex], kMFSTextEncodingMacRoman, &attr);
+        assert(err == 0);
+        assert(attr.va_fileid == (index.fileNumbers[entryIndex] - 1 + kMFSFirstFileInodeName));
+    }
+    
+    // File numbers either side of the range, and zero, aren't there.
+    
+    err = MFSDirectoryFileNumberTableLookup(&index, firstFileNumber, slots, slotCount, firstFileNumber - 1, &foundEntryIndex);
+    assert(err == ENOENT);
+    err = MFSDirectoryFileNumberTableLookup(&index, firstFileNumber, slots, slotCount, firstFileNumber + (uint32_t) slotCount, &foundEntryIndex);
+    assert(err == ENOENT);
+    err = MFSDirectoryFileNumberTableLookup(&index, firstFileNumber, slots, slotCount, 0, &foundEntryIndex);
+    assert(err == ENOENT);
+    err = MFSDirectoryFileNumberTableLookup(&index, 0, NULL, 0, 0, &foundEntryIndex);
+    assert(err == ENOENT);
+
+    free(slots);
+    free(buffer);
+}
+
+static void TestMFSCoreExtent(void)
+{
+    int         err;
+    MFSForkInfo forkInfo;
+    uint32_t    offsetFromFirstAllocationBlockInBytes;
+    uint32_t    contiguousPhysicalBytes;
+    
+    // Data fork of desktop is empty.
+
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0, 0, &forkInfo);
+    assert(err == 0);
+    assert(forkInfo.firstAllocationBlock  == 0);
+    assert(forkInfo.lengthInBytes         == 0);
+    assert(forkInfo.physicalLengthInBytes == 0);
+    
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == EINVAL);
+
+    // Ask for the resource fork of the "TN.002.Compatibility" file.  The first call
+    // returns entire fork.  This tests the single allocation block case.
+
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, 1, &forkInfo);
+    assert(err == 0);
+    assert(forkInfo.firstAllocationBlock  == 0x0006);
+    assert(forkInfo.lengthInBytes         == 0x00000341);
+    assert(forkInfo.physicalLengthInBytes == 0x00000400);
+    
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == 4096);
+    assert(contiguousPhysicalBytes == 0x00000400);
+    
+    // Second call fails because we've hit the end of the fork.
+    
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0x00000400,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == EPIPE);
+
+    // Now do the same for the data fork of the "TN.002.Compatibility" file.  This is nice and long.
+    
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, 0, &forkInfo);
+    assert(err == 0);
+    assert(forkInfo.firstAllocationBlock  == 0x0007);
+    assert(forkInfo.lengthInBytes         == 0x0000334a);
+    assert(forkInfo.physicalLengthInBytes == 0x00003400);
+
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == 5120);
+    assert(contiguousPhysicalBytes == 0x00003400);
+
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0x00003400,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == EPIPE);
+
+    // Now start with an offset two allocation blocks in.
+
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        2048,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 2048));
+    assert(contiguousPhysicalBytes == (0x00003400 - 2048));
+
+    // Now test the last allocation block of the resource fork.
+
+    err = MFSForkGetExtent(
+        gSampleData + 2 * kSampleDataBlockSize,
+        &forkInfo,
+        0x00003400 - 1024,
+        &offsetFromFirstAllocationBlockInBytes,
+        &contiguousPhysicalBytes
+    );
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 0x00003400 - 1024));
+    assert(contiguousPhysicalBytes == 1024);
+}
+
+static void TestMFSCoreExtentMap(void)
+{
+    int             err;
+    MFSForkInfo     forkInfo;
+    MFSForkExtent   extents[4];
+    size_t          extentCount;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+
+    // Data fork of desktop is empty.
+
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0, 0, &forkInfo);
+    assert(err == 0);
+
+    err = MFSForkGetExtentMap(gSampleData + 2 * kSampleDataBlockSize, &forkInfo, extents, 4, &extentCount);
+    assert(err == EINVAL);
+
+    // Data fork of the "TN.002.Compatibility" file is a single extent.  First
+    // check that we can get the count without supplying a buffer.
+
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, 0, &forkInfo);
+    assert(err == 0);
+
+    err = MFSForkGetExtentMap(gSampleData + 2 * kSampleDataBlockSize, &forkInfo, NULL, 0, &extentCount);
+    assert(err == 0);
+    assert(extentCount == 1);
+
+    err = MFSForkGetExtentMap(gSampleData + 2 * kSampleDataBlockSize, &forkInfo, extents, 4, &extentCount);
+    assert(err == 0);
+    assert(extentCount == 1);
+    assert(extents[0].forkOffsetInBytes                     == 0);
+    assert(extents[0].offsetFromFirstAllocationBlockInBytes == 5120);
+    assert(extents[0].contiguousPhysicalBytes               == 0x00003400);
+
+    // Look up the start, an offset two allocation blocks in, an offset that's not
+    // allocation block aligned, the last byte, and then off the end.
+
+    err = MFSForkExtentMapLookup(extents, extentCount, 0, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == 5120);
+    assert(contiguousPhysicalBytes == 0x00003400);
+
+    err = MFSForkExtentMapLookup(extents, extentCount, 2048, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 2048));
+    assert(contiguousPhysicalBytes == (0x00003400 - 2048));
+
+    err = MFSForkExtentMapLookup(extents, extentCount, 2560, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 2560));
+    assert(contiguousPhysicalBytes == (0x00003400 - 2560));
+
+    err = MFSForkExtentMapLookup(extents, extentCount, 0x00003400 - 1, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+    assert(err == 0);
+    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 0x00003400 - 1));
+    assert(contiguousPhysicalBytes == 1);
+
+    err = MFSForkExtentMapLookup(extents, extentCount, 0x00003400, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+    assert(err == EPIPE);
+}
+
+// The following build a synthetic MDB and VABM with a single, pathologically
+// fragmented, fork, so that we can compare the cost of extracting it extent by
+// extent using MFSForkGetExtent against building an extent map once.
+
+enum {
+    kFragmentedAllocationBlockCount = 4000,
+    kFragmentedAllocationBlockSize  = 1024,
+    kFragmentedMDBAndVABMSize       = 64 + ((kFragmentedAllocationBlockCount * 3 + 1) / 2)
+};
+
+static void VABMSetEntry(uint8_t *vabmBase, uint16_t allocationBlock, uint16_t nextAllocationBlock)
+    // Sets the VABM entry for allocationBlock to nextAllocationBlock.  This is the
+    // inverse of MFSVABMNextAllocationBlock in "MFSCore.c".
+{
+    size_t  byteIndex;
+
+    byteIndex = (allocationBlock - 2) * 3 / 2;
+    if ( ((allocationBlock - 2) % 2) == 0 ) {
+        vabmBase[byteIndex]     = (uint8_t) (nextAllocationBlock >> 4);
+        vabmBase[byteIndex + 1] = (uint8_t) ((vabmBase[byteIndex + 1] & 0x0F) | ((nextAllocationBlock & 0x0F) << 4));
+    } else {
+        vabmBase[byteIndex]     = (uint8_t) ((vabmBase[byteIndex] & 0xF0) | ((nextAllocationBlock >> 8) & 0x0F));
+        vabmBase[byteIndex + 1] = (uint8_t) nextAllocationBlock;
+    }
+}
+
+static uint8_t * CreateFragmentedMDBAndVABM(MFSForkInfo *forkInfo)
+    // Returns a malloc'd MDB and VABM where the whole volume is one fork that
+    // visits the even allocation blocks and then the odd ones, so that every
+    // allocation block is an extent in its own right.
+{
+    uint8_t *   mdbAndVABM;
+    uint16_t    allocationBlock;
+    uint16_t    previousAllocationBlock;
+
+    mdbAndVABM = calloc(1, kFragmentedMDBAndVABMSize);
+    assert(mdbAndVABM != NULL);
+
+    memcpy(mdbAndVABM, gSampleData + kMFSMDBBlock * kSampleDataBlockSize, 64);
+    OSWriteBigInt16(mdbAndVABM, 18, kFragmentedAllocationBlockCount);       // allocationBlockCount
+    OSWriteBigInt32(mdbAndVABM, 20, kFragmentedAllocationBlockSize);        // allocationBlockSizeInBytes
+    OSWriteBigInt16(mdbAndVABM, 34, 0);                                     // freeAllocationBlockCount
+
+    previousAllocationBlock = 0;
+    for (allocationBlock = 2; allocationBlock < (2 + kFragmentedAllocationBlockCount); allocationBlock += 2) {
+        if (previousAllocationBlock != 0) {
+            VABMSetEntry(mdbAndVABM + 64, previousAllocationBlock, allocationBlock);
+        }
+        previousAllocationBlock = allocationBlock;
+    }
+    for (allocationBlock = 3; allocationBlock < (2 + kFragmentedAllocationBlockCount); allocationBlock += 2) {
+        VABMSetEntry(mdbAndVABM + 64, previousAllocationBlock, allocationBlock);
+        previousAllocationBlock = allocationBlock;
+    }
+    VABMSetEntry(mdbAndVABM + 64, previousAllocationBlock, 1);
+
+    forkInfo->firstAllocationBlock  = 2;
+    forkInfo->lengthInBytes         = kFragmentedAllocationBlockCount * kFragmentedAllocationBlockSize;
+    forkInfo->physicalLengthInBytes = kFragmentedAllocationBlockCount * kFragmentedAllocationBlockSize;
+
+    return mdbAndVABM;
+}
+
+static void TestMFSCoreExtentMapFragmented(void)
+    // Checks that, on the fragmented fork, the extent map agrees with walking 
+    // the chain extent by extent using MFSForkGetExtent.
+{
+    int             err;
+    uint8_t *       mdbAndVABM;
+    MFSForkInfo     forkInfo;
+    MFSForkExtent * extents;
+    size_t          extentCount;
+    size_t          extentIndex;
+    uint32_t        forkOffset;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+    uint32_t *      expected;
+
+    mdbAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    expected = malloc(kFragmentedAllocationBlockCount * sizeof(*expected));
+    assert(expected != NULL);
+
+    extentIndex = 0;
+    forkOffset = 0;
+    do {
+        err = MFSForkGetExtent(mdbAndVABM, &forkInfo, forkOffset, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+        if (err == 0) {
+            assert(contiguousPhysicalBytes == kFragmentedAllocationBlockSize);
+            assert(extentIndex < kFragmentedAllocationBlockCount);
+            expected[extentIndex] = offsetFromFirstAllocationBlockInBytes;
+            extentIndex += 1;
+            forkOffset += contiguousPhysicalBytes;
+        }
+    } while ( (err == 0) && (forkOffset < forkInfo.physicalLengthInBytes) );
+    assert(err == 0);
+    assert(extentIndex == kFragmentedAllocationBlockCount);
+
+    extents = malloc(kFragmentedAllocationBlockCount * sizeof(*extents));
+    assert(extents != NULL);
+
+    err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, extents, kFragmentedAllocationBlockCount, &extentCount);
+    assert(err == 0);
+    assert(extentCount == kFragmentedAllocationBlockCount);
+    for (extentIndex = 0; extentIndex < extentCount; extentIndex++) {
+        err = MFSForkExtentMapLookup(
+            extents,
+            extentCount,
+            (uint32_t) (extentIndex * kFragmentedAllocationBlockSize),
+            &offsetFromFirstAllocationBlockInBytes,
+            &contiguousPhysicalBytes
+        );
+        assert(err == 0);
+        assert(offsetFromFirstAllocationBlockInBytes == expected[extentIndex]);
+        assert(contiguousPhysicalBytes == kFragmentedAllocationBlockSize);
+    }
+
+    // A chain that loops must be reported as an error, not loop forever.
+
+    VABMSetEntry(mdbAndVABM + 64, 1 + kFragmentedAllocationBlockCount, 2);
+    err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, NULL, 0, &extentCount);
+    assert(err == EIO);
+
+    free(extents);
+    free(expected);
+    free(mdbAndVABM);
+}
+
+static void TestMFSCoreExtentCursor(void)
+{
+    int                 err;
+    uint8_t *           mdbAndVABM;
+    uint16_t *          vabmTable;
+    MFSForkInfo         forkInfo;
+    MFSForkExtent *     extents;
+    size_t              extentCount;
+    size_t              extentIndex;
+    MFSForkExtentCursor cursor;
+    MFSForkExtent       extent;
+
+    // Empty forks are rejected, just like for MFSForkGetExtentMap.
+
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0, 0, &forkInfo);
+    assert(err == 0);
+    err = MFSForkExtentCursorInit(&cursor, gSampleData + 2 * kSampleDataBlockSize, &forkInfo);
+    assert(err == EINVAL);
+
+    // On the fragmented fork, the cursor must return exactly the extent map, 
+    // whether it uses the packed VABM or a decoded table.
+
+    mdbAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    vabmTable = malloc(kFragmentedAllocationBlockCount * sizeof(*vabmTable));
+    extents   = malloc(kFragmentedAllocationBlockCount * sizeof(*extents));
+    assert( (vabmTable != NULL) && (extents != NULL) );
+
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, kFragmentedAllocationBlockCount);
+    assert(err == 0);
+    err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, extents, kFragmentedAllocationBlockCount, &extentCount);
+    assert(err == 0);
+
+    err = MFSForkExtentCursorInit(&cursor, mdbAndVABM, &forkInfo);
+    assert(err == 0);
+    for (extentIndex = 0; extentIndex < extentCount; extentIndex++) {
+        err = MFSForkExtentCursorNext(&cursor, &extent);
+        assert(err == 0);
+        assert(memcmp(&extent, &extents[extentIndex], sizeof(extent)) == 0);
+    }
+    err = MFSForkExtentCursorNext(&cursor, &extent);
+    assert(err == EPIPE);
+    err = MFSForkExtentCursorNext(&cursor, &extent);        // and it stays at the end
+    assert(err == EPIPE);
+
+    err = MFSForkExtentCursorInitWithVABMTable(&cursor, mdbAndVABM, vabmTable, &forkInfo);
+    assert(err == 0);
+    extentIndex = 0;
+    do {
+        err = MFSForkExtentCursorNext(&cursor, &extent);
+        if (err == 0) {
+            assert(memcmp(&extent, &extents[extentIndex], sizeof(extent)) == 0);
+            extentIndex += 1;
+        }
+    } while (err == 0);
+    assert(err == EPIPE);
+    assert(extentIndex == extentCount);
+
+    // A chain that loops must be reported as an error, not loop forever.
+
+    VABMSetEntry(mdbAndVABM + 64, 1 + kFragmentedAllocationBlockCount, 2);
+    err = MFSForkExtentCursorInit(&cursor, mdbAndVABM, &forkInfo);
+    assert(err == 0);
+    do {
+        err = MFSForkExtentCursorNext(&cursor, &extent);
+    } while (err == 0);
+    assert(err == EIO);
+
+    free(extents);
+    free(vabmTable);
+    free(mdbAndVABM);
+}
+
+static void TestMFSCoreVABMDecode(void)
+{
+    int             err;
+    const uint8_t * mdbAndVABM;
+    uint16_t        vabmTable[(652 - 64) / 3 * 2];
+    size_t          allocationBlockCount;
+    size_t          forkIndex;
+    MFSForkInfo     forkInfo;
+    MFSForkExtent   extents[4];
+    MFSForkExtent   tableExtents[4];
+    size_t          extentCount;
+    size_t          tableExtentCount;
+    uint32_t        forkOffset;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+    uint32_t        tableOffsetFromFirstAllocationBlockInBytes;
+    uint32_t        tableContiguousPhysicalBytes;
+    uint8_t *       fragmentedMDBAndVABM;
+    uint16_t *      fragmentedVABMTable;
+    MFSForkExtent * fragmentedExtents;
+    MFSForkExtent * fragmentedTableExtents;
+
+    mdbAndVABM = gSampleData + kMFSMDBBlock * kSampleDataBlockSize;
+    allocationBlockCount = OSReadBigInt16(mdbAndVABM, 18);
+    assert(allocationBlockCount <= (sizeof(vabmTable) / sizeof(vabmTable[0])));
+
+    // A table that's too small is an error.
+
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, allocationBlockCount - 1);
+    assert(err == EINVAL);
+
+    // Decode it properly and then, for both forks of the "TN.002.Compatibility" 
+    // file, check that the table variants return exactly what the packed 
+    // VABM variants return.
+
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, sizeof(vabmTable) / sizeof(vabmTable[0]));
+    assert(err == 0);
+
+    for (forkIndex = 0; forkIndex < 2; forkIndex++) {
+        err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, forkIndex, &forkInfo);
+        assert(err == 0);
+
+        forkOffset = 0;
+        do {
+            err = MFSForkGetExtent(mdbAndVABM, &forkInfo, forkOffset, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+            assert( (err == 0) || (err == EPIPE) );
+            assert(err == MFSForkGetExtentWithVABMTable(mdbAndVABM, vabmTable, &forkInfo, forkOffset, &tableOffsetFromFirstAllocationBlockInBytes, &tableContiguousPhysicalBytes));
+            if (err == 0) {
+                assert(tableOffsetFromFirstAllocationBlockInBytes == offsetFromFirstAllocationBlockInBytes);
+                assert(tableContiguousPhysicalBytes == contiguousPhysicalBytes);
+                forkOffset += 1024;
+            }
+        } while (err == 0);
+
+        err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, extents, 4, &extentCount);
+        assert(err == 0);
+        err = MFSForkGetExtentMapWithVABMTable(mdbAndVABM, vabmTable, &forkInfo, tableExtents, 4, &tableExtentCount);
+        assert(err == 0);
+        assert(tableExtentCount == extentCount);
+        assert(memcmp(tableExtents, extents, extentCount * sizeof(extents[0])) == 0);
+    }
+
+    // Do the same for the extent map of the fragmented fork, where every 
+    // allocation block is an extent.
+
+    fragmentedMDBAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    fragmentedVABMTable    = malloc(kFragmentedAllocationBlockCount * sizeof(*fragmentedVABMTable));
+    fragmentedExtents      = malloc(kFragmentedAllocationBlockCount * sizeof(*fragmentedExtents));
+    fragmentedTableExtents = malloc(kFragmentedAllocationBlockCount * sizeof(*fragmentedTableExtents));
+    assert( (fragmentedVABMTable != NULL) && (fragmentedExtents != NULL) && (fragmentedTableExtents != NULL) );
+
+    err = MFSVABMDecode(fragmentedMDBAndVABM, fragmentedVABMTable, kFragmentedAllocationBlockCount);
+    assert(err == 0);
+    err = MFSForkGetExtentMap(fragmentedMDBAndVABM, &forkInfo, fragmentedExtents, kFragmentedAllocationBlockCount, &extentCount);
+    assert(err == 0);
+    assert(extentCount == kFragmentedAllocationBlockCount);
+    err = MFSForkGetExtentMapWithVABMTable(fragmentedMDBAndVABM, fragmentedVABMTable, &forkInfo, fragmentedTableExtents, kFragmentedAllocationBlockCount, &tableExtentCount);
+    assert(err == 0);
+    assert(tableExtentCount == extentCount);
+    assert(memcmp(fragmentedTableExtents, fragmentedExtents, extentCount * sizeof(fragmentedExtents[0])) == 0);
+
+    free(fragmentedTableExtents);
+    free(fragmentedExtents);
+    free(fragmentedVABMTable);
+    free(fragmentedMDBAndVABM);
+}
+
+static void MarkFork(uint16_t dirBlock, uint32_t dirOffset, size_t forkIndex, uint32_t allocationBlockSizeInBytes, uint32_t *blockMap)
+{
+    int             err;
+    MFSForkInfo     forkInfo;
+    uint32_t        forkOffset;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+    uint32_t        startBlock;
+    uint32_t        contiguousBlocks;
+    uint32_t        blockIndex;
+    
+    err = MFSDirectoryEntryGetForkInfo(gSampleData + dirBlock * kSampleDataBlockSize, dirOffset, forkIndex, &forkInfo);
+    assert(err == 0);
+    
+    forkOffset = 0;
+    do {
+        err = MFSForkGetExtent(
+            gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
+            &forkInfo,
+            forkOffset,
+            &offsetFromFirstAllocationBlockInBytes,
+            &contiguousPhysicalBytes
+        );
+        if (err == 0) {
+            assert((offsetFromFirstAllocationBlockInBytes & (allocationBlockSizeInBytes - 1)) == 0);
+            assert((contiguousPhysicalBytes & (allocationBlockSizeInBytes - 1)) == 0);
+
+            startBlock       = offsetFromFirstAllocationBlockInBytes / allocationBlockSizeInBytes;
+            contiguousBlocks = contiguousPhysicalBytes / allocationBlockSizeInBytes;
+            
+            for (blockIndex = startBlock; blockIndex < (startBlock + contiguousBlocks); blockIndex++) {
+                blockMap[blockIndex] = 1;
+            }
+        
+            forkOffset += contiguousPhysicalBytes;
+        }
+    } while (err == 0);
+    assert( (err == EINVAL) || (err == EPIPE) );
+}
+
+static void TestMFSCoreAllocationCheck(void)
+{
+    int             err;
+    size_t          mdbAndVABMSizeInBytes;
+    uint16_t        directoryStartBlock;
+    uint16_t        directoryBlockCount;
+    uint16_t        allocationBlocksStartBlock;
+    uint32_t        allocationBlockSizeInBytes;
+    struct vfs_attr attr;
+    uint32_t *      blockMap;
+    size_t          dirOffset;
+    size_t          freeBlocks;
+    size_t          blockIndex;
+    uint16_t        dirBlock;
+    
+    err = MFSMDBCheck(
+        gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
+        gSampleDataSize / kSampleDataBlockSize,
+        &mdbAndVABMSizeInBytes,
+        &directoryStartBlock,
+        &directoryBlockCount,
+        &allocationBlocksStartBlock,
+        &allocationBlockSizeInBytes
+    );
+    assert(err == 0);
+    
+    VFSATTR_INIT(&attr);
+    VFSATTR_WANTED(&attr, f_blocks);
+    VFSATTR_WANTED(&attr, f_bfree);
+
+    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, kMFSTextEncodingMacRoman, &attr);
+    assert(err == 0);
+
+    blockMap = calloc(attr.f_blocks, sizeof(*blockMap));
+    assert(blockMap != NULL);
+    
+    // Go through every file in the directory and mark each block taken by that file as in use.
+    
+    for (dirBlock = directoryStartBlock; dirBlock < (directoryStartBlock + directoryBlockCount); dirBlock++) {
+        dirOffset = kMFSDirectoryBlockIterateFromStart;
+        do {
+            err = MFSDirectoryBlockIterate(
+                gSampleData + dirBlock * kSampleDataBlockSize,
+                kSampleDataBlockSize,
+                &dirOffset,
+                kMFSTextEncodingMacRoman,
+                NULL
+            );
+            assert( (err == 0) || (err == ENOENT) );
+            
+            if (err == 0) {
+                MarkFork(dirBlock, dirOffset, 0, allocationBlockSizeInBytes, blockMap);
+                MarkFork(dirBlock, dirOffset, 1, allocationBlockSizeInBytes, blockMap);
+            }
+        } while (err == 0);
+    }
+    
+    // Go through the block map to find the blocks that didn't get marked.  The 
+    // could of these should be equal to the free blocks.
+    
+    freeBlocks = 0;
+    for (blockIndex = 0; blockIndex < attr.f_blocks; blockIndex++) {
+        if (blockMap[blockIndex] == 0) {
+            freeBlocks += 1;
+        }
+    }
+    assert(freeBlocks == attr.f_bfree);
+}
+
+static bool FindAllocationBlockOwnerByScan(uint16_t directoryStartBlock, uint16_t directoryBlockCount, uint32_t allocationBlockSizeInBytes, size_t blockIndex, uint32_t *fileNumberPtr, uint32_t *forkIndexPtr)
+    // Finds the owner of an allocation block the hard way, by scanning the 
+    // entire directory and walking every fork's chain.  This is what you had 
+    // to do before MFSAllocationMapAddDirectoryBlock.
+{
+    int             err;
+    bool            found;
+    uint16_t        dirBlock;
+    size_t          dirOffset;
+    size_t          forkIndex;
+    struct vnode_attr attr;
+    MFSForkInfo     forkInfo;
+    uint32_t        forkOffset;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+
+    found = false;
+    for (dirBlock = directoryStartBlock; !found && (dirBlock < (directoryStartBlock + directoryBlockCount)); dirBlock++) {
+        dirOffset = kMFSDirectoryBlockIterateFromStart;
+        do {
+            VATTR_INIT(&attr);
+            VATTR_WANTED(&attr, va_fileid);
+            err = MFSDirectoryBlockIterate(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, &dirOffset, kMFSTextEncodingMacRoman, &attr);
+            assert( (err == 0) || (err == ENOENT) );
+            
+            for (forkIndex = 0; (err == 0) && !found && (forkIndex < 2); forkIndex++) {
+                err = MFSDirectoryEntryGetForkInfo(gSampleData + dirBlock * kSampleDataBlockSize, dirOffset, forkIndex, &forkInfo);
+                assert(err == 0);
+                
+                forkOffset = 0;
+                while ( !found && (forkOffset < forkInfo.physicalLengthInBytes) ) {
+                    err = MFSForkGetExtent(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, &forkInfo, forkOffset, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+                    assert(err == 0);
+                    
+                    if ( (blockIndex >= (offsetFromFirstAllocationBlockInBytes / allocationBlockSizeInBytes)) 
+                      && (blockIndex < ((offsetFromFirstAllocationBlockInBytes + contiguousPhysicalBytes) / allocationBlockSizeInBytes)) ) {
+                        *fileNumberPtr = (uint32_t) (attr.va_fileid + 1 - kMFSFirstFileInodeName);
+                        *forkIndexPtr  = (uint32_t) forkIndex;
+                        found = true;
+                    }
+                    forkOffset += contiguousPhysicalBytes;
+                }
+            }
+        } while ( (err == 0) && !found );
+    }
+    return found;
+}
+
+static void TestMFSCoreAllocationMap(void)
+{
+    int                         err;
+    const uint8_t *             mdbAndVABM;
+    SampleVolumeInfo            volume;
+    size_t                      allocationBlockCount;
+    uint16_t *                  vabmTable;
+    MFSAllocationBlockOwner *   owners;
+    uint16_t                    dirBlock;
+    size_t                      blockIndex;
+    size_t                      freeBlocks;
+    bool                        found;
+    uint32_t                    fileNumber;
+    uint32_t                    forkIndex;
+
+    mdbAndVABM = gSampleData + kMFSMDBBlock * kSampleDataBlockSize;
+
+    TestMFSCoreGetSampleVolume(&volume);
+    allocationBlockCount = OSReadBigInt16(mdbAndVABM, 18);
+
+    vabmTable = malloc(allocationBlockCount * sizeof(*vabmTable));
+    owners    = malloc(allocationBlockCount * sizeof(*owners));
+    assert( (vabmTable != NULL) && (owners != NULL) );
+
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, allocationBlockCount);
+    assert(err == 0);
+
+    // A map that's too small is an error.
+    
+    err = MFSAllocationMapInit(mdbAndVABM, owners, allocationBlockCount - 1);
+    assert(err == EINVAL);
+
+    // Build the map and check that it agrees with the MDB's free count.
+
+    err = MFSAllocationMapInit(mdbAndVABM, owners, allocationBlockCount);
+    assert(err == 0);
+    for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+        err = MFSAllocationMapAddDirectoryBlock(mdbAndVABM, vabmTable, gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, owners);
+        assert(err == 0);
+    }
+    freeBlocks = 0;
+    for (blockIndex = 0; blockIndex < allocationBlockCount; blockIndex++) {
+        if (owners[blockIndex].fileNumber == 0) {
+            freeBlocks += 1;
+        }
+    }
+    assert(freeBlocks == OSReadBigInt16(mdbAndVABM, 34));
+
+    // Check every entry against the hard way.
+
+    for (blockIndex = 0; blockIndex < allocationBlockCount; blockIndex++) {
+        found = FindAllocationBlockOwnerByScan(volume.directoryStartBlock, volume.directoryBlockCount, volume.allocationBlockSizeInBytes, blockIndex, &fileNumber, &forkIndex);
+        assert(found == (owners[blockIndex].fileNumber != 0));
+        if (found) {
+            assert(fileNumber == owners[blockIndex].fileNumber);
+            assert(forkIndex  == owners[blockIndex].forkIndex);
+        }
+    }
+
+    // Spot check the "TN.002.Compatibility" file, whose resource fork is 
+    // allocation block 6 and whose data fork starts at allocation block 7.
+
+    assert(owners[6 - 2].forkIndex == 1);
+    assert(owners[7 - 2].forkIndex == 0);
+    assert(owners[6 - 2].fileNumber == owners[7 - 2].fileNumber);
+
+    // Cross-link its resource fork into its data fork and check that we 
+    // notice.
+
+    assert(vabmTable[6 - 2] == 1);
+    vabmTable[6 - 2] = 7;
+    err = MFSAllocationMapInit(mdbAndVABM, owners, allocationBlockCount);
+    assert(err == 0);
+    err = MFSAllocationMapAddDirectoryBlock(mdbAndVABM, vabmTable, gSampleData + 4 * kSampleDataBlockSize, kSampleDataBlockSize, owners);
+    assert(err == EIO);
+
+    free(owners);
+    free(vabmTable);
+}
+
+static void TestMFSCoreVolumeVerify(void)
+{
+    int                     err;
+    SampleVolumeInfo        volume;
+    uint8_t *               mdbAndVABM;
+    uint8_t *               directory;
+    uint8_t                 tempBuffer[kMFSVolumeVerifyTempBufferSize];
+    MFSVolumeVerifyReport   report;
+    MFSVolumeVerifyReport   goodReport;
+    enum {
+        kTN002DirOffset = 0x3a,
+        kRsrcPhysicalLengthOffset = 38  // offset of rsrcPhysicalLengthInBytes within a directory entry
+    };
+
+    TestMFSCoreGetSampleVolume(&volume);
+    
+    // Work on copies of the MDB/VABM and the directory, so that we can corrupt them.
+
+    mdbAndVABM = malloc(volume.mdbAndVABMSizeInBytes);
+    directory  = malloc(volume.directoryBlockCount * kSampleDataBlockSize);
+    assert( (mdbAndVABM != NULL) && (directory != NULL) );
+
+    memcpy(mdbAndVABM, gSampleData + kMFSMDBBlock * kSampleDataBlockSize, volume.mdbAndVABMSizeInBytes);
+    memcpy(directory,  gSampleData + volume.directoryStartBlock * kSampleDataBlockSize, volume.directoryBlockCount * kSampleDataBlockSize);
+
+    // The sample volume is consistent.
+
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &goodReport);
+    assert(err == 0);
+
+    assert(goodReport.fileCount == OSReadBigInt16(mdbAndVABM, 12));
+    assert(goodReport.forkCount > 0);
+    assert(goodReport.freeAllocationBlockCount == OSReadBigInt16(mdbAndVABM, 34));
+    assert(goodReport.mdbFreeAllocationBlockCount == goodReport.freeAllocationBlockCount);
+    assert( (goodReport.usedAllocationBlockCount + goodReport.freeAllocationBlockCount) == OSReadBigInt16(mdbAndVABM, 18) );
+    assert(goodReport.firstBadFileNumber == 0);
+
+    // The "TN.002.Compatibility" file's resource fork is the single allocation 
+    // block 6, and its data fork starts at allocation block 7.  Point the 
+    // resource fork at itself, then at the data fork, then at a free allocation 
+    // block.
+
+    VABMSetEntry(mdbAndVABM + 64, 6, 6);
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == EIO);
+    assert(report.loopCount == 1);
+    assert(report.crossLinkCount == 0);
+    assert(report.firstBadFileNumber == OSReadBigInt32(directory, (4 - volume.directoryStartBlock) * kSampleDataBlockSize + kTN002DirOffset + 18));
+
+    VABMSetEntry(mdbAndVABM + 64, 6, 7);
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == EIO);
+    assert(report.loopCount == 0);
+    assert( (report.crossLinkCount + report.lengthMismatchCount) >= 1 );
+
+    VABMSetEntry(mdbAndVABM + 64, 6, (uint16_t) (OSReadBigInt16(mdbAndVABM, 18) + 2));
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == EIO);
+    assert(report.badChainCount == 1);
+
+    VABMSetEntry(mdbAndVABM + 64, 6, 1);
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == 0);
+    
+    // Now mess with the resource fork's physical length.
+    
+    OSWriteBigInt32(directory, (4 - volume.directoryStartBlock) * kSampleDataBlockSize + kTN002DirOffset + kRsrcPhysicalLengthOffset, 2 * volume.allocationBlockSizeInBytes);
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == EIO);
+    assert(report.lengthMismatchCount == 1);
+    OSWriteBigInt32(directory, (4 - volume.directoryStartBlock) * kSampleDataBlockSize + kTN002DirOffset + kRsrcPhysicalLengthOffset, volume.allocationBlockSizeInBytes);
+
+    // And finally the MDB's free count.
+
+    OSWriteBigInt16(mdbAndVABM, 34, (uint16_t) (goodReport.mdbFreeAllocationBlockCount + 1));
+    err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+    assert(err == EIO);
+    assert(report.mdbFreeAllocationBlockCount == (goodReport.freeAllocationBlockCount + 1));
+    assert(report.firstBadFileNumber == 0);
+
+    free(directory);
+    free(mdbAndVABM);
+}
+
+/////////////////////////////////////////////////////////////////////
+#pragma mark ***** Benchmark MFSCore
+
+// These only measure performance; the matching tests in the MFSCore group 
+// check the results.
+
+static void TestMFSCoreExtentMapBenchmark(void)
+    // Compares the cost of extracting the fragmented fork extent by extent using 
+    // MFSForkGetExtent, each call of which walks the chain from the start, against 
+    // building an extent map once and then looking up each extent.
+{
+    int             err;
+    uint8_t *       mdbAndVABM;
+    MFSForkInfo     forkInfo;
+    MFSForkExtent * extents;
+    size_t          extentCount;
+    size_t          extentIndex;
+    uint32_t        forkOffset;
+    uint32_t        offsetFromFirstAllocationBlockInBytes;
+    uint32_t        contiguousPhysicalBytes;
+    CFAbsoluteTime  startTime;
+    CFAbsoluteTime  chainTime;
+    CFAbsoluteTime  mapTime;
+
+    mdbAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    extents = malloc(kFragmentedAllocationBlockCount * sizeof(*extents));
+    assert(extents != NULL);
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    forkOffset = 0;
+    do {
+        err = MFSForkGetExtent(mdbAndVABM, &forkInfo, forkOffset, &offsetFromFirstAllocationBlockInBytes, &contiguousPhysicalBytes);
+        if (err == 0) {
+            forkOffset += contiguousPhysicalBytes;
+        }
+    } while ( (err == 0) && (forkOffset < forkInfo.physicalLengthInBytes) );
+    assert(err == 0);
+    chainTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, extents, kFragmentedAllocationBlockCount, &extentCount);
+    assert(err == 0);
+    for (extentIndex = 0; extentIndex < extentCount; extentIndex++) {
+        err = MFSForkExtentMapLookup(
+            extents,
+            extentCount,
+            (uint32_t) (extentIndex * kFragmentedAllocationBlockSize),
+            &offsetFromFirstAllocationBlockInBytes,
+            &contiguousPhysicalBytes
+        );
+        assert(err == 0);
+    }
+    mapTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    printf("    %d extents: chain walk %.3f ms, extent map %.3f ms\n", (int) kFragmentedAllocationBlockCount, chainTime * 1000.0, mapTime * 1000.0);
+
+    free(extents);
+    free(mdbAndVABM);
+}
+
+static void TestMFSCoreVABMDecodeBenchmark(void)
+    // Compares building the fragmented fork's extent map from the packed VABM 
+    // against decoding the VABM and building it from the table.
+{
+    int             err;
+    uint8_t *       mdbAndVABM;
+    uint16_t *      vabmTable;
+    MFSForkInfo     forkInfo;
+    MFSForkExtent * extents;
+    MFSForkExtent * tableExtents;
+    size_t          extentCount;
+    int             iteration;
+    CFAbsoluteTime  startTime;
+    CFAbsoluteTime  packedTime;
+    CFAbsoluteTime  decodeTime;
+    CFAbsoluteTime  tableTime;
+    enum {
+        kIterations = 1000
+    };
+
+    mdbAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    vabmTable    = malloc(kFragmentedAllocationBlockCount * sizeof(*vabmTable));
+    extents      = malloc(kFragmentedAllocationBlockCount * sizeof(*extents));
+    tableExtents = malloc(kFragmentedAllocationBlockCount * sizeof(*tableExtents));
+    assert( (vabmTable != NULL) && (extents != NULL) && (tableExtents != NULL) );
+
+    // Build the extent map from the packed VABM...
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = MFSForkGetExtentMap(mdbAndVABM, &forkInfo, extents, kFragmentedAllocationBlockCount, &extentCount);
+        assert(err == 0);
+    }
+    packedTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    // ... then decode the VABM ...
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = MFSVABMDecode(mdbAndVABM, vabmTable, kFragmentedAllocationBlockCount);
+        assert(err == 0);
+    }
+    decodeTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    // ... and build it from the table.
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = MFSForkGetExtentMapWithVABMTable(mdbAndVABM, vabmTable, &forkInfo, tableExtents, kFragmentedAllocationBlockCount, &extentCount);
+        assert(err == 0);
+    }
+    tableTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    printf(
+        "    %d extents x %d: packed VABM %.3f ms, decode %.3f ms, decoded table %.3f ms\n", 
+        (int) kFragmentedAllocationBlockCount, 
+        (int) kIterations, 
+        packedTime * 1000.0, 
+        decodeTime * 1000.0, 
+        tableTime  * 1000.0
+    );
+
+    free(tableExtents);
+    free(extents);
+    free(vabmTable);
+    free(mdbAndVABM);
+}
+
+static void TestMFSCoreUTF8ToMFSNameBenchmark(void)
+    // Compares UTF8ToMFSName on a pure ASCII name, which takes the fast path, 
+    // against a name of the same length with an accented character.
+{
+    int             err;
+    char            tempBuffer[kUTF8ToMFSNameTempBufferSize];
+    uint8_t         mfsName[256];
+    int             iteration;
+    CFAbsoluteTime  startTime;
+    CFAbsoluteTime  asciiTime;
+    CFAbsoluteTime  accentedTime;
+    static const char kASCIIName[]    = "TN.002.Compatibility";
+    static const char kAccentedName[] = "TN.002.Compatibilit\xc3\xa9";
+    enum {
+        kIterations = 1000000
+    };
+
+    // Convert a pure ASCII name, which takes the fast path...
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = UTF8ToMFSName(kASCIIName, sizeof(kASCIIName) - 1, kMFSTextEncodingMacRoman, tempBuffer, mfsName);
+        assert(err == 0);
+    }
+    asciiTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(mfsName[0] == (sizeof(kASCIIName) - 1));
+
+    // ... and a name of the same length with an accented character, which doesn't.
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = UTF8ToMFSName(kAccentedName, sizeof(kAccentedName) - 1, kMFSTextEncodingMacRoman, tempBuffer, mfsName);
+        assert(err == 0);
+    }
+    accentedTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(mfsName[0] == (sizeof(kASCIIName) - 1));
+
+    printf(
+        "    %d conversions: ASCII %.0f per second, accented %.0f per second\n", 
+        (int) kIterations, 
+        kIterations / asciiTime, 
+        kIterations / accentedTime
+    );
+}
+
+static void TestMFSCoreUTF8DecodeStrBenchmark(void)
+    // Compares the table-driven utf8_decodestr against the CF-based reference 
+    // implementation on a decomposed name.
+{
+    int             err;
+    uint16_t        utf16[256];
+    size_t          utf16Len;
+    int             iteration;
+    CFAbsoluteTime  startTime;
+    CFAbsoluteTime  tableTime;
+    CFAbsoluteTime  cfTime;
+    static const char kDecomposedName[] = "Re\xcc\x81sume\xcc\x81 fu\xcc\x88r Franc\xcc\xa7ois (Bro\xcc\x82ne\xcc\x81)";
+    enum {
+        kIterations = 100000
+    };
+
+    // Decode a decomposed name using the table-driven utf8_decodestr...
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = utf8_decodestr( (const uint8_t *) kDecomposedName, sizeof(kDecomposedName) - 1, utf16, &utf16Len, sizeof(utf16), 0, UTF_PRECOMPOSED);
+        assert(err == 0);
+    }
+    tableTime = CFAbsoluteTimeGetCurrent() - startTime;
+    
+    // ... and using CF.
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = CFUTF8DecodeStr( (const uint8_t *) kDecomposedName, sizeof(kDecomposedName) - 1, utf16, &utf16Len, sizeof(utf16));
+        assert(err == 0);
+    }
+    cfTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    printf(
+        "    %d decodes of %d bytes: table %.0f per second (%.1f MB/s), CF %.0f per second (%.1f MB/s)\n", 
+        (int) kIterations, 
+        (int) (sizeof(kDecomposedName) - 1), 
+        kIterations / tableTime, 
+        (kIterations * (sizeof(kDecomposedName) - 1)) / tableTime / 1000000.0, 
+        kIterations / cfTime, 
+        (kIterations * (sizeof(kDecomposedName) - 1)) / cfTime / 1000000.0
+    );
+}
+
+static void TestMFSCoreDirectoryBlockDecodeAllBenchmark(void)
+{
+    int                     err;
+    SampleVolumeInfo        volume;
+    uint16_t                dirBlock;
+    const void *            dirBlockPtr;
+    size_t                  dirOffset;
+    MFSDirectoryEntryInfo   entries[kSampleDataBlockSize / 52];
+    size_t                  entryCount;
+    size_t                  entryIndex;
+    size_t                  totalEntryCount;
+    struct vnode_attr       attr;
+    char                    name[MAXPATHLEN];
+    uint8_t                 finderInfo[16];
+    MFSForkInfo             forkInfos[2];
+    int                     pass;
+    CFAbsoluteTime          startTime;
+    CFAbsoluteTime          perEntryTime;
+    CFAbsoluteTime          perBlockTime;
+    enum {
+        kPasses = 1000
+    };
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    totalEntryCount = 0;
+    for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+        err = MFSDirectoryBlockDecodeAll(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, NULL, 0, &entryCount);
+        assert(err == 0);
+        totalEntryCount += entryCount;
+    }
+
+    // Compare the time it takes to gather the information needed to list the 
+    // directory the old way (five calls per entry) with one call per block.
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (pass = 0; pass < kPasses; pass++) {
+        for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+            dirBlockPtr = gSampleData + dirBlock * kSampleDataBlockSize;
+            dirOffset = kMFSDirectoryBlockIterateFromStart;
+            do {
+                err = MFSDirectoryBlockIterate(dirBlockPtr, kSampleDataBlockSize, &dirOffset, kMFSTextEncodingMacRoman, NULL);
+                if (err == 0) {
+                    VATTR_INIT(&attr);
+                    attr.va_name = name;
+                    VATTR_WANTED(&attr, va_name);
+                    VATTR_WANTED(&attr, va_fileid);
+                    VATTR_WANTED(&attr, va_create_time);
+                    VATTR_WANTED(&attr, va_modify_time);
+                    (void) MFSDirectoryEntryGetAttr(dirBlockPtr, dirOffset, kMFSTextEncodingMacRoman, &attr);
+                    (void) MFSDirectoryEntryGetFinderInfo(dirBlockPtr, dirOffset, finderInfo);
+                    (void) MFSDirectoryEntryGetForkInfo(dirBlockPtr, dirOffset, 0, &forkInfos[0]);
+                    (void) MFSDirectoryEntryGetForkInfo(dirBlockPtr, dirOffset, 1, &forkInfos[1]);
+                }
+            } while (err == 0);
+        }
+    }
+    perEntryTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (pass = 0; pass < kPasses; pass++) {
+        for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+            dirBlockPtr = gSampleData + dirBlock * kSampleDataBlockSize;
+            err = MFSDirectoryBlockDecodeAll(dirBlockPtr, kSampleDataBlockSize, entries, sizeof(entries) / sizeof(entries[0]), &entryCount);
+            assert(err == 0);
+            for (entryIndex = 0; entryIndex < entryCount; entryIndex++) {
+                (void) MFSNameToUTF8(entries[entryIndex].name, kMFSTextEncodingMacRoman, name, sizeof(name));
+            }
+        }
+    }
+    perBlockTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    printf("    %d listings of %zu entries: per entry %.3f ms, per block %.3f ms\n", (int) kPasses, totalEntryCount, perEntryTime * 1000.0, perBlockTime * 1000.0);
+}
+
+static void TestMFSCoreDirectoryNameHashBenchmark(void)
+{
+    int                 err;
+    SampleVolumeInfo    volume;
+    uint32_t *          buffer;
+    MFSDirectoryIndex   index;
+    uint32_t *          slots;
+    size_t              slotCount;
+    size_t              foundEntryIndex;
+    char                tempBuffer[kMFSDirectoryBlockFindEntryByNameTempBufferSize];
+    char                name[32];
+    int                 probe;
+    int                 hits;
+    uint16_t            dirBlock;
+    size_t              dirOffset;
+    CFAbsoluteTime      startTime;
+    CFAbsoluteTime      scanTime;
+    CFAbsoluteTime      hashTime;
+    enum {
+        kProbes = 10000
+    };
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
+
+    slotCount = MFSDirectoryNameHashGetSlotCount(index.entryCount);
+    slots = malloc(slotCount * sizeof(*slots));
+    assert(slots != NULL);
+    MFSDirectoryNameHashBuild(&index, slots, slotCount);
+
+    // Time a workload that's mostly misses, comparing the directory scan with 
+    // the hash.  One probe in 100 is for a name that exists.
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    hits = 0;
+    for (probe = 0; probe < kProbes; probe++) {
+        if ( (probe % 100) == 0 ) {
+            snprintf(name, sizeof(name), "TN.002.Compatibility");
+        } else {
+            snprintf(name, sizeof(name), "Missing %d", probe);
+        }
+        tempBuffer[0] = 0;
+        err = ENOENT;
+        for (dirBlock = volume.directoryStartBlock; (err == ENOENT) && (dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount)); dirBlock++) {
+            err = MFSDirectoryBlockFindEntryByName(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, name, strlen(name), kMFSTextEncodingMacRoman, tempBuffer, &dirOffset, NULL);
+        }
+        assert( (err == 0) || (err == ENOENT) );
+        if (err == 0) {
+            hits += 1;
+        }
+    }
+    scanTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(hits == (kProbes / 100));
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    hits = 0;
+    for (probe = 0; probe < kProbes; probe++) {
+        if ( (probe % 100) == 0 ) {
+            snprintf(name, sizeof(name), "TN.002.Compatibility");
+        } else {
+            snprintf(name, sizeof(name), "Missing %d", probe);
+        }
+        err = MFSDirectoryNameHashLookupUTF8(&index, slots, slotCount, name, strlen(name), tempBuffer, &foundEntryIndex);
+        assert( (err == 0) || (err == ENOENT) );
+        if (err == 0) {
+            hits += 1;
+        }
+    }
+    hashTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(hits == (kProbes / 100));
+
+    printf("    %d lookups: directory scan %.3f ms, name hash %.3f ms\n", (int) kProbes, scanTime * 1000.0, hashTime * 1000.0);
+
+    free(slots);
+    free(buffer);
+}
+
+static void TestMFSCoreDirectoryNameCacheBenchmark(void)
+{
+    int                     err;
+    SampleVolumeInfo        volume;
+    const char *            directoryPtr;
+    uint32_t *              buffer;
+    MFSDirectoryIndex       index;
+    size_t                  cacheBufferSize;
+    void *                  cacheBuffer;
+    MFSDirectoryNameCache   cache;
+    size_t                  entryIndex;
+    size_t                  cachedNameLen;
+    char                    utf8[MAXPATHLEN];
+    struct vnode_attr       attr;
+    int                     pass;
+    size_t                  totalLen;
+    CFAbsoluteTime          startTime;
+    CFAbsoluteTime          convertTime;
+    CFAbsoluteTime          cacheTime;
+    enum {
+        kPasses = 1000
+    };
+
+    TestMFSCoreGetSampleVolume(&volume);
+
+    directoryPtr = gSampleData + volume.directoryStartBlock * kSampleDataBlockSize;
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
+
+    cacheBufferSize = MFSDirectoryNameCacheGetBufferSize(&index);
+    cacheBuffer = malloc(cacheBufferSize);
+    assert(cacheBuffer != NULL);
+    err = MFSDirectoryNameCacheInit(&index, directoryPtr, volume.directoryStartBlock, kSampleDataBlockSize, cacheBuffer, cacheBufferSize, &cache);
+    assert(err == 0);
+
+    // Time listing the directory repeatedly, converting each name every time 
+    // (as readdir used to do) versus getting it from the cache.
+    
+    startTime = CFAbsoluteTimeGetCurrent();
+    totalLen = 0;
+    for (pass = 0; pass < kPasses; pass++) {
+        for (entryIndex = 0; entryIndex < index.entryCount; entryIndex++) {
+            VATTR_INIT(&attr);
+            attr.va_name = utf8;
+            VATTR_WANTED(&attr, va_name);
+            err = MFSDirectoryEntryGetAttr(
+                directoryPtr + (index.dirBlocks[entryIndex] - volume.directoryStartBlock) * kSampleDataBlockSize, 
+                index.dirOffsets[entryIndex], 
+                kMFSTextEncodingMacRoman, 
+                &attr
+            );
+            assert(err == 0);
+            totalLen += strlen(utf8);
+        }
+    }
+    convertTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (pass = 0; pass < kPasses; pass++) {
+        for (entryIndex = 0; entryIndex < index.entryCount; entryIndex++) {
+            (void) MFSDirectoryNameCacheGetName(&cache, entryIndex, &cachedNameLen);
+            totalLen -= cachedNameLen;
+        }
+    }
+    cacheTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(totalLen == 0);
+
+    printf("    %d listings: convert %.3f ms, name cache %.3f ms\n", (int) kPasses, convertTime * 1000.0, cacheTime * 1000.0);
+
+    free(cacheBuffer);
+    free(buffer);
+}
+
+static void TestMFSCoreDirectoryFileNumberTableBenchmark(void)
 {
-    int         err;
-    MFSForkInfo forkInfo;
-    uint32_t    offsetFromFirstAllocationBlockInBytes;
-    uint32_t    contiguousPhysicalBytes;
-    
-    // Data fork of desktop is empty.
+    int                 err;
+    SampleVolumeInfo    volume;
+    uint32_t *          buffer;
+    MFSDirectoryIndex   index;
+    uint32_t            firstFileNumber;
+    uint32_t *          slots;
+    size_t              slotCount;
+    size_t              foundEntryIndex;
+    struct vnode_attr   attr;
+    int                 probe;
+    uint32_t            fileNumber;
+    uint16_t            dirBlock;
+    size_t              dirOffset;
+    CFAbsoluteTime      startTime;
+    CFAbsoluteTime      scanTime;
+    CFAbsoluteTime      tableTime;
+    enum {
+        kProbes = 10000
+    };
 
-    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0, 0, &forkInfo);
-    assert(err == 0);
-    assert(forkInfo.firstAllocationBlock  == 0);
-    assert(forkInfo.lengthInBytes         == 0);
-    assert(forkInfo.physicalLengthInBytes == 0);
-    
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
-    assert(err == EINVAL);
+    TestMFSCoreGetSampleVolume(&volume);
 
-    // Ask for the resource fork of the "TN.002.Compatibility" file.  The first call
-    // returns entire fork.  This tests the single allocation block case.
+    buffer = TestMFSCoreGetSampleDirectoryIndex(&volume, &index);
 
-    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, 1, &forkInfo);
-    assert(err == 0);
-    assert(forkInfo.firstAllocationBlock  == 0x0006);
-    assert(forkInfo.lengthInBytes         == 0x00000341);
-    assert(forkInfo.physicalLengthInBytes == 0x00000400);
-    
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
-    assert(err == 0);
-    assert(offsetFromFirstAllocationBlockInBytes == 4096);
-    assert(contiguousPhysicalBytes == 0x00000400);
-    
-    // Second call fails because we've hit the end of the fork.
+    slotCount = MFSDirectoryFileNumberTableGetSlotCount(&index, &firstFileNumber);
+    slots = malloc(slotCount * sizeof(*slots));
+    assert(slots != NULL);
+    MFSDirectoryFileNumberTableBuild(&index, firstFileNumber, slots, slotCount);
+
+    // Time looking up every file on the volume, first by iterating through 
+    // the directory blocks (which is what the kext used to do) and then with 
+    // the table.
     
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0x00000400,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (probe = 0; probe < kProbes; probe++) {
+        fileNumber = index.fileNumbers[probe % index.entryCount];
+        err = ENOENT;
+        for (dirBlock = volume.directoryStartBlock; (err == ENOENT) && (dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount)); dirBlock++) {
+            dirOffset = kMFSDirectoryBlockIterateFromStart;
+            do {
+                VATTR_INIT(&attr);
+                VATTR_WANTED(&attr, va_fileid);
+                err = MFSDirectoryBlockIterate(gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, &dirOffset, kMFSTextEncodingMacRoman, &attr);
+            } while ( (err == 0) && (attr.va_fileid != (fileNumber - 1 + kMFSFirstFileInodeName)) );
+        }
+        assert(err == 0);
+    }
+    scanTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (probe = 0; probe < kProbes; probe++) {
+        fileNumber = index.fileNumbers[probe % index.entryCount];
+        err = MFSDirectoryFileNumberTableLookup(&index, firstFileNumber, slots, slotCount, fileNumber, &foundEntryIndex);
+        assert(err == 0);
+    }
+    tableTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    printf(
+        "    %d lookups: directory scan %.0f lookups/s, file number table %.0f lookups/s\n", 
+        (int) kProbes, 
+        (scanTime  > 0.0) ? (kProbes / scanTime)  : 0.0, 
+        (tableTime > 0.0) ? (kProbes / tableTime) : 0.0
     );
-    assert(err == EPIPE);
 
-    // Now do the same for the data fork of the "TN.002.Compatibility" file.  This is nice and long.
-    
-    err = MFSDirectoryEntryGetForkInfo(gSampleData + 4 * kSampleDataBlockSize, 0x3a, 0, &forkInfo);
+    free(slots);
+    free(buffer);
+}
+
+static void TestMFSCoreAllocationMapBenchmark(void)
+    // Compares building the allocation map and reading every entry against 
+    // finding the owner of each allocation block by scanning the directory.
+{
+    int                         err;
+    const uint8_t *             mdbAndVABM;
+    SampleVolumeInfo            volume;
+    size_t                      allocationBlockCount;
+    uint16_t *                  vabmTable;
+    MFSAllocationBlockOwner *   owners;
+    uint16_t                    dirBlock;
+    size_t                      blockIndex;
+    size_t                      freeBlocks;
+    uint32_t                    fileNumber;
+    uint32_t                    forkIndex;
+    CFAbsoluteTime              startTime;
+    CFAbsoluteTime              scanTime;
+    CFAbsoluteTime              mapTime;
+
+    mdbAndVABM = gSampleData + kMFSMDBBlock * kSampleDataBlockSize;
+
+    TestMFSCoreGetSampleVolume(&volume);
+    allocationBlockCount = OSReadBigInt16(mdbAndVABM, 18);
+
+    vabmTable = malloc(allocationBlockCount * sizeof(*vabmTable));
+    owners    = malloc(allocationBlockCount * sizeof(*owners));
+    assert( (vabmTable != NULL) && (owners != NULL) );
+
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, allocationBlockCount);
     assert(err == 0);
-    assert(forkInfo.firstAllocationBlock  == 0x0007);
-    assert(forkInfo.lengthInBytes         == 0x0000334a);
-    assert(forkInfo.physicalLengthInBytes == 0x00003400);
 
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
+    startTime = CFAbsoluteTimeGetCurrent();
+    err = MFSAllocationMapInit(mdbAndVABM, owners, allocationBlockCount);
     assert(err == 0);
-    assert(offsetFromFirstAllocationBlockInBytes == 5120);
-    assert(contiguousPhysicalBytes == 0x00003400);
+    for (dirBlock = volume.directoryStartBlock; dirBlock < (volume.directoryStartBlock + volume.directoryBlockCount); dirBlock++) {
+        err = MFSAllocationMapAddDirectoryBlock(mdbAndVABM, vabmTable, gSampleData + dirBlock * kSampleDataBlockSize, kSampleDataBlockSize, owners);
+        assert(err == 0);
+    }
+    freeBlocks = 0;
+    for (blockIndex = 0; blockIndex < allocationBlockCount; blockIndex++) {
+        if (owners[blockIndex].fileNumber == 0) {
+            freeBlocks += 1;
+        }
+    }
+    mapTime = CFAbsoluteTimeGetCurrent() - startTime;
+    assert(freeBlocks == OSReadBigInt16(mdbAndVABM, 34));
 
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0x00003400,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
-    assert(err == EPIPE);
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (blockIndex = 0; blockIndex < allocationBlockCount; blockIndex++) {
+        (void) FindAllocationBlockOwnerByScan(volume.directoryStartBlock, volume.directoryBlockCount, volume.allocationBlockSizeInBytes, blockIndex, &fileNumber, &forkIndex);
+    }
+    scanTime = CFAbsoluteTimeGetCurrent() - startTime;
 
-    // Now start with an offset two allocation blocks in.
+    printf("    %zu allocation blocks: directory scan %.3f ms, allocation map %.3f ms\n", allocationBlockCount, scanTime * 1000.0, mapTime * 1000.0);
 
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        2048,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
-    assert(err == 0);
-    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 2048));
-    assert(contiguousPhysicalBytes == (0x00003400 - 2048));
+    free(owners);
+    free(vabmTable);
+}
 
-    // Now test the last allocation block of the resource fork.
+static void TestMFSCoreVolumeVerifyBenchmark(void)
+    // Times verifying the sample volume, to get an idea of how MFSVolumeVerify 
+    // would cope with a large ingest.
+{
+    int                     err;
+    const uint8_t *         mdbAndVABM;
+    const uint8_t *         directory;
+    uint8_t                 tempBuffer[kMFSVolumeVerifyTempBufferSize];
+    MFSVolumeVerifyReport   report;
+    SampleVolumeInfo        volume;
+    int                     iteration;
+    CFAbsoluteTime          startTime;
+    enum {
+        kIterations = 10000
+    };
 
-    err = MFSForkGetExtent(
-        gSampleData + 2 * kSampleDataBlockSize,
-        &forkInfo,
-        0x00003400 - 1024,
-        &offsetFromFirstAllocationBlockInBytes,
-        &contiguousPhysicalBytes
-    );
-    assert(err == 0);
-    assert(offsetFromFirstAllocationBlockInBytes == (5120 + 0x00003400 - 1024));
-    assert(contiguousPhysicalBytes == 1024);
+    TestMFSCoreGetSampleVolume(&volume);
+
+    mdbAndVABM = gSampleData + kMFSMDBBlock * kSampleDataBlockSize;
+    directory  = gSampleData + volume.directoryStartBlock * kSampleDataBlockSize;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for (iteration = 0; iteration < kIterations; iteration++) {
+        err = MFSVolumeVerify(mdbAndVABM, directory, kSampleDataBlockSize, tempBuffer, &report);
+        assert(err == 0);
+    }
+    printf("    %d verifications: %.3f ms\n", (int) kIterations, (CFAbsoluteTimeGetCurrent() - startTime) * 1000.0);
 }
 
-static void MarkFork(uint16_t dirBlock, uint32_t dirOffset, size_t forkIndex, uint32_t allocationBlockSizeInBytes, uint32_t *blockMap)
+static void TestMFSCoreExtentCursorBenchmark(void)
+    // Times walking the fragmented fork with the extent cursor, using the 
+    // packed VABM and then a decoded table.
 {
-    int             err;
-    MFSForkInfo     forkInfo;
-    uint32_t        forkOffset;
-    uint32_t        offsetFromFirstAllocationBlockInBytes;
-    uint32_t        contiguousPhysicalBytes;
-    uint32_t        startBlock;
-    uint32_t        contiguousBlocks;
-    uint32_t        blockIndex;
-    
-    err = MFSDirectoryEntryGetForkInfo(gSampleData + dirBlock * kSampleDataBlockSize, dirOffset, forkIndex, &forkInfo);
+    int                 err;
+    uint8_t *           mdbAndVABM;
+    uint16_t *          vabmTable;
+    MFSForkInfo         forkInfo;
+    MFSForkExtentCursor cursor;
+    MFSForkExtent       extent;
+    size_t              extentCount;
+    CFAbsoluteTime      startTime;
+    CFAbsoluteTime      packedTime;
+    CFAbsoluteTime      tableTime;
+
+    mdbAndVABM = CreateFragmentedMDBAndVABM(&forkInfo);
+
+    vabmTable = malloc(kFragmentedAllocationBlockCount * sizeof(*vabmTable));
+    assert(vabmTable != NULL);
+    err = MFSVABMDecode(mdbAndVABM, vabmTable, kFragmentedAllocationBlockCount);
     assert(err == 0);
-    
-    forkOffset = 0;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    err = MFSForkExtentCursorInit(&cursor, mdbAndVABM, &forkInfo);
+    assert(err == 0);
+    extentCount = 0;
     do {
-        err = MFSForkGetExtent(
-            gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
-            &forkInfo,
-            forkOffset,
-            &offsetFromFirstAllocationBlockInBytes,
-            &contiguousPhysicalBytes
-        );
+        err = MFSForkExtentCursorNext(&cursor, &extent);
         if (err == 0) {
-            assert((offsetFromFirstAllocationBlockInBytes & (allocationBlockSizeInBytes - 1)) == 0);
-            assert((contiguousPhysicalBytes & (allocationBlockSizeInBytes - 1)) == 0);
-
-            startBlock       = offsetFromFirstAllocationBlockInBytes / allocationBlockSizeInBytes;
-            contiguousBlocks = contiguousPhysicalBytes / allocationBlockSizeInBytes;
-            
-            for (blockIndex = startBlock; blockIndex < (startBlock + contiguousBlocks); blockIndex++) {
-                blockMap[blockIndex] = 1;
-            }
-        
-            forkOffset += contiguousPhysicalBytes;
+            extentCount += 1;
         }
     } while (err == 0);
-    assert( (err == EINVAL) || (err == EPIPE) );
-}
+    assert(err == EPIPE);
+    packedTime = CFAbsoluteTimeGetCurrent() - startTime;
 
-static void TestMFSCoreAllocationCheck(void)
-{
-    int             err;
-    size_t          mdbAndVABMSizeInBytes;
-    uint16_t        directoryStartBlock;
-    uint16_t        directoryBlockCount;
-    uint16_t        allocationBlocksStartBlock;
-    uint32_t        allocationBlockSizeInBytes;
-    struct vfs_attr attr;
-    uint32_t *      blockMap;
-    size_t          dirOffset;
-    size_t          freeBlocks;
-    size_t          blockIndex;
-    uint16_t        dirBlock;
-    
-    err = MFSMDBCheck(
-        gSampleData + kMFSMDBBlock * kSampleDataBlockSize,
-        gSampleDataSize / kSampleDataBlockSize,
-        &mdbAndVABMSizeInBytes,
-        &directoryStartBlock,
-        &directoryBlockCount,
-        &allocationBlocksStartBlock,
-        &allocationBlockSizeInBytes
-    );
+    startTime = CFAbsoluteTimeGetCurrent();
+    err = MFSForkExtentCursorInitWithVABMTable(&cursor, mdbAndVABM, vabmTable, &forkInfo);
     assert(err == 0);
-    
-    VFSATTR_INIT(&attr);
-    VFSATTR_WANTED(&attr, f_blocks);
-    VFSATTR_WANTED(&attr, f_bfree);
+    do {
+        err = MFSForkExtentCursorNext(&cursor, &extent);
+    } while (err == 0);
+    assert(err == EPIPE);
+    tableTime = CFAbsoluteTimeGetCurrent() - startTime;
 
-    err = MFSMDBGetAttr(gSampleData + kMFSMDBBlock * kSampleDataBlockSize, &attr);
-    assert(err == 0);
+    printf("    %zu extents: packed VABM cursor %.3f ms, decoded table cursor %.3f ms\n", extentCount, packedTime * 1000.0, tableTime * 1000.0);
 
-    blockMap = calloc(attr.f_blocks, sizeof(*blockMap));
-    assert(blockMap != NULL);
-    
-    // Go through every file in the directory and mark each block taken by that file as in use.
-    
-    for (dirBlock = directoryStartBlock; dirBlock < (directoryStartBlock + directoryBlockCount); dirBlock++) {
-        dirOffset = kMFSDirectoryBlockIterateFromStart;
-        do {
-            err = MFSDirectoryBlockIterate(
-                gSampleData + dirBlock * kSampleDataBlockSize,
-                kSampleDataBlockSize,
-                &dirOffset,
-                NULL
-            );
-            assert( (err == 0) || (err == ENOENT) );
-            
-            if (err == 0) {
-                MarkFork(dirBlock, dirOffset, 0, allocationBlockSizeInBytes, blockMap);
-                MarkFork(dirBlock, dirOffset, 1, allocationBlockSizeInBytes, blockMap);
-            }
-        } while (err == 0);
-    }
-    
-    // Go through the block map to find the blocks that didn't get marked.  The 
-    // could of these should be equal to the free blocks.
-    
-    freeBlocks = 0;
-    for (blockIndex = 0; blockIndex < attr.f_blocks; blockIndex++) {
-        if (blockMap[blockIndex] == 0) {
-            freeBlocks += 1;
-        }
-    }
-    assert(freeBlocks == attr.f_bfree);
+    free(vabmTable);
+    free(mdbAndVABM);
 }
 
 /////////////////////////////////////////////////////////////////////
@@ -1439,8 +3984,7 @@ static void ExtractAllFilesFromImage(const char *sourcePath, const char *destRoo
     char                destDir[MAXPATHLEN];
     char *              cursor;
     char *              nextSlash;
-    struct vnode_attr   attr;
-    char                name[MAXPATHLEN];
+    const char *        name;
     size_t              destDirLen;
     size_t              nameIndex;
 
@@ -1491,7 +4035,7 @@ static void ExtractAllFilesFromImage(const char *sourcePath, const char *destRoo
     
     pmount = NULL;
     
-    err = MFSPMountCreate(sourcePath, &pmount);
+    err = MFSPMountCreate(sourcePath, kMFSTextEncodingMacRoman, &pmount);
     assert(err == 0);
     
     err = MFSPMountListFiles(pmount, files, sizeof(files) / sizeof(*files), &fileCount);
@@ -1499,15 +4043,7 @@ static void ExtractAllFilesFromImage(const char *sourcePath, const char *destRoo
     assert(fileCount < (sizeof(files) / sizeof(*files)));
 
     for (fileIndex = 0; fileIndex < fileCount; fileIndex++) {
-        VATTR_INIT(&attr);
-        attr.va_name = name;
-        VATTR_WANTED(&attr, va_name);
-                
-        err = MFSDirectoryEntryGetAttr(
-            files[fileIndex].dirBlockPtr,
-            files[fileIndex].dirOffset,
-            &attr
-        );
+        err = MFSPMountGetFileName(pmount, files[fileIndex].dirBlockPtr, files[fileIndex].dirOffset, &name);
         assert(err == 0);
         
         destDir[destDirLen] = 0;            // trim destDir back to its original length
@@ -3033,8 +5569,12 @@ static const Test kHashTests[] = {
     { "TwiceBasic",         TestHashTwiceBasic },
     { "RepeatBasic",        TestHashRepeatBasic },
     { "AttachFail",         TestHashAttachFail },
+    { "Statistics",         TestHashStatistics },
+    { "LookupMany",         TestHashLookupMany },
     { "HighForks",          TestHashHighForks },
     { "HashChain",          TestHashHashChain },
+    { "ChainStats",         TestHashChainStats },
+    { "TableSize",          TestHashTableSize },
     { "AttachStall",        TestHashAttachStall },
     { "Stress",             TestHashStress },
 #if TEST_HASH_STRESS_LONG
@@ -3043,15 +5583,51 @@ static const Test kHashTests[] = {
     { NULL }
 };
 
+static const Test kHashBenchmarkTests[] = {
+    { "LookupMany",         TestHashLookupManyBenchmark },
+    { "TableSize",          TestHashTableSizeBenchmark },
+    { "Stress",             TestHashStressBenchmark },
+    { "HotFiles",           TestHashHotFilesBenchmark },
+    { NULL }
+};
+
 static const Test kMFSCoreTests[] = {
     { "MacRoman",           TestMFSCoreMacRoman },
+    { "TextEncodings",      TestMFSCoreTextEncodings },
+    { "UTF8DecodeStr",      TestMFSCoreUTF8DecodeStr },
     { "MDB",                TestMFSCoreMDB },
     { "DateTime",           TestMFSCoreDateTime },
     { "DirIterate",         TestMFSCoreDirIterate },
     { "GetAttr",            TestMFSCoreGetAttr },
     { "GetFinderInfo",      TestMFSCoreGetFinderInfo },
+    { "DirectoryIndex",     TestMFSCoreDirectoryIndex },
+    { "DecodeAll",          TestMFSCoreDirectoryBlockDecodeAll },
+    { "DirectoryNameHash",  TestMFSCoreDirectoryNameHash },
+    { "DirectoryNameCache", TestMFSCoreDirectoryNameCache },
+    { "FileNumberTable",    TestMFSCoreDirectoryFileNumberTable },
     { "Extent",             TestMFSCoreExtent },
+    { "ExtentMap",          TestMFSCoreExtentMap },
+    { "ExtentMapFragmented", TestMFSCoreExtentMapFragmented },
+    { "ExtentCursor",       TestMFSCoreExtentCursor },
+    { "VABMDecode",         TestMFSCoreVABMDecode },
     { "AllocationCheck",    TestMFSCoreAllocationCheck },
+    { "AllocationMap",      TestMFSCoreAllocationMap },
+    { "VolumeVerify",       TestMFSCoreVolumeVerify },
+    { NULL }
+};
+
+static const Test kMFSCoreBenchmarkTests[] = {
+    { "ExtentMap",          TestMFSCoreExtentMapBenchmark },
+    { "VABMDecode",         TestMFSCoreVABMDecodeBenchmark },
+    { "UTF8ToMFSName",      TestMFSCoreUTF8ToMFSNameBenchmark },
+    { "UTF8DecodeStr",      TestMFSCoreUTF8DecodeStrBenchmark },
+    { "DecodeAll",          TestMFSCoreDirectoryBlockDecodeAllBenchmark },
+    { "DirectoryNameHash",  TestMFSCoreDirectoryNameHashBenchmark },
+    { "DirectoryNameCache", TestMFSCoreDirectoryNameCacheBenchmark },
+    { "FileNumberTable",    TestMFSCoreDirectoryFileNumberTableBenchmark },
+    { "AllocationMap",      TestMFSCoreAllocationMapBenchmark },
+    { "VolumeVerify",       TestMFSCoreVolumeVerifyBenchmark },
+    { "ExtentCursor",       TestMFSCoreExtentCursorBenchmark },
     { NULL }
 };
 
@@ -3092,6 +5668,7 @@ struct TestGroup {
     const Test *    tests;
     InitTermProc    initProc;
     InitTermProc    termProc;
+    bool            benchmark;      // if true, "all" skips the group; you must name it
 };
 typedef struct TestGroup TestGroup;
 
@@ -3100,12 +5677,14 @@ static void NOP(void)
 }
 
 static const TestGroup kTestGroups[] = {
-    { "Hash",               kHashTests,                     TestHashInit,           TestHashTerm },
-    { "MFSCore",            kMFSCoreTests,                  TestMFSCoreInit,        NOP },
-    { "AllImages",          kAllImagesTests,                NOP,                    NOP },
-    { "BSD",                kBSDTests,                      TestBSDInit,            TestBSDTerm },
-    { "FileManager",        kFileManagerTests,              TestFileManagerInit,    NOP },
-    { "ResourceManager",    kResourceManagerManagerTests,   TestFileManagerInit,    NOP },
+    { "Hash",               kHashTests,                     TestHashInit,           TestHashTerm,   false },
+    { "MFSCore",            kMFSCoreTests,                  TestMFSCoreInit,        NOP,            false },
+    { "AllImages",          kAllImagesTests,                NOP,                    NOP,            false },
+    { "BSD",                kBSDTests,                      TestBSDInit,            TestBSDTerm,    false },
+    { "FileManager",        kFileManagerTests,              TestFileManagerInit,    NOP,            false },
+    { "ResourceManager",    kResourceManagerManagerTests,   TestFileManagerInit,    NOP,            false },
+    { "HashBenchmark",      kHashBenchmarkTests,            TestHashInit,           TestHashTerm,   true  },
+    { "MFSCoreBenchmark",   kMFSCoreBenchmarkTests,         TestMFSCoreInit,        NOP,            true  },
     { NULL },
 };
 
@@ -3126,7 +5705,7 @@ static void PrintUsage(const char *argv0)
 
     groupIndex = 0;
     while ( kTestGroups[groupIndex].name != NULL ) {
-        fprintf(stderr, "        %s\n", kTestGroups[groupIndex].name);
+        fprintf(stderr, "        %s%s\n", kTestGroups[groupIndex].name, kTestGroups[groupIndex].benchmark ? " (not run by all)" : "");
 
         testIndex = 0;
         while ( kTestGroups[groupIndex].tests[testIndex].name != NULL ) {
@@ -3180,6 +5759,14 @@ int main(int argc, char **argv)
     } else if ( (argc == 2) && (strcasecmp(argv[1], "all") == 0) ) {
         groupIndex = 0;
         while ( kTestGroups[groupIndex].name != NULL ) {
+            // The benchmarks take a long time and check nothing that the other 
+            // groups don't, so they only run if you ask for them by name.
+            
+            if (kTestGroups[groupIndex].benchmark) {
+                groupIndex += 1;
+                continue;
+            }
+            
             printf("%s\n", kTestGroups[groupIndex].name);
             fflush(stdout);
 
@@ -63,6 +63,8 @@ struct __OSMallocTag__ {
 
 static struct __OSMallocTag__ gOneTrueTag;
 
+static volatile size_t gOSMallocCount;
+
 extern OSMallocTag      OSMalloc_Tagalloc(const char * str, uint32_t flags)
 {
     assert(str != NULL);
@@ -80,6 +82,15 @@ extern void *           OSMalloc(uint32_t size, OSMallocTag tag)
 {
     #pragma unused(tag)
     
+    (void) __sync_fetch_and_add(&gOSMallocCount, 1);
+    return malloc(size);
+}
+
+extern void *           OSMalloc_noblock(uint32_t size, OSMallocTag tag)
+{
+    #pragma unused(tag)
+    
+    (void) __sync_fetch_and_add(&gOSMallocCount, 1);
     return malloc(size);
 }
 
@@ -91,6 +102,35 @@ extern void             OSFree(void * addr, uint32_t size, OSMallocTag tag)
     free(addr);
 }
 
+extern size_t GetOSMallocCount(void)
+{
+    return gOSMallocCount;
+}
+
+#pragma mark ----- <libkern/OSAtomic.h>
+
+// Like their kernel counterparts, these return the value before the operation.
+
+extern int32_t          OSIncrementAtomic(volatile int32_t * address)
+{
+    return __sync_fetch_and_add(address, 1);
+}
+
+extern int32_t          OSDecrementAtomic(volatile int32_t * address)
+{
+    return __sync_fetch_and_sub(address, 1);
+}
+
+extern int64_t          OSAddAtomic64(int64_t amount, volatile int64_t * address)
+{
+    return __sync_fetch_and_add(address, amount);
+}
+
+extern void             OSMemoryBarrier(void)
+{
+    __sync_synchronize();
+}
+
 #pragma mark ----- <kern/locks.h.h>
 
 struct __lck_grp__ {
@@ -192,6 +232,13 @@ extern void             lck_mtx_assert(
     }
 }
 
+#pragma mark ----- <kern/thread.h>
+
+extern void *           current_thread(void)
+{
+    return (void *) pthread_self();
+}
+
 #pragma mark ----- <sys/vnode.h>
 
 int desiredvnodes = 8000;
@@ -229,6 +276,17 @@ extern void SetReclaimCallback(ReclaimCallback callback)
     gReclaimCallback = callback;
 }
 
+extern size_t SetVNodeLimit(size_t limit)
+{
+    size_t  oldLimit;
+    
+    assert(limit != 0);
+    
+    oldLimit = gVNodesMax;
+    gVNodesMax = limit;
+    return oldLimit;
+}
+
 extern errno_t vnode_create(int flavor, size_t size, void *data, vnode_t *vnPtr)
 {
     int         err;
@@ -508,114 +566,173 @@ extern void FREE(void *addr, int type)
 
 #pragma mark ----- <sys/proc.h>
 
-static CFMutableDictionaryRef gChannelToCond;
-    // keys are wait channels (void *)
-    // values are pthread_cond_t *
+// Each wait channel that has threads sleeping on it has a wait queue, which is 
+// just a condition variable and a count of the waiters.  The wait queues live in 
+// a small hash table, each bucket of which has its own lock, and free wait queues 
+// are kept on a per-bucket free list for reuse.  So, wakeup only has to lock the 
+// bucket for its channel, and it only wakes threads sleeping on that channel.  This 
+// is much like the kernel's own wait queues.
+//
+// We used to keep a condition variable per channel in a global CFDictionary, 
+// protected by a global lock.  That lock was a bottleneck, and we never freed the 
+// condition variables, so we leaked one for every HNode that anyone ever waited on.
+
+struct WaitQueue {
+    struct WaitQueue *  next;           // next wait queue in the bucket's active or free list
+    void *              chan;           // wait channel; NULL if the wait queue is free
+    size_t              waiterCount;    // number of threads in msleep on chan
+    pthread_cond_t      cond;           // signalled by wakeup; always used with the bucket's lock
+};
+typedef struct WaitQueue WaitQueue;
+
+struct WaitQueueBucket {
+    pthread_mutex_t     lock;           // protects all of the fields of the bucket and its wait queues
+    WaitQueue *         active;         // wait queues that have waiters
+    WaitQueue *         free;           // wait queues available for reuse
+};
+typedef struct WaitQueueBucket WaitQueueBucket;
+
+enum {
+    kWaitQueueBucketCount = 64
+};
 
-static pthread_mutex_t  gChannelToCondLock;
+static WaitQueueBucket gWaitQueueBuckets[kWaitQueueBucketCount];
 
-static void InitChannelToCond(void)
+static void InitWaitQueueBuckets(void)
 {
     int     junk;
+    size_t  bucketIndex;
     
-    junk = pthread_mutex_init(&gChannelToCondLock, NULL);
-    assert(junk == 0);
-    
-    gChannelToCond = CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
-    assert(gChannelToCond != NULL);
+    for (bucketIndex = 0; bucketIndex < kWaitQueueBucketCount; bucketIndex++) {
+        junk = pthread_mutex_init(&gWaitQueueBuckets[bucketIndex].lock, NULL);
+        assert(junk == 0);
+    }
 }
 
-static pthread_cond_t * ChannelToCond(void *chan)
+static WaitQueueBucket * ChannelToBucket(void *chan)
 {
-    int                 err;
-    int                 junk;
-    pthread_cond_t *    cond;
-    pthread_cond_t *    newCond;
-    static pthread_once_t sChannelToCondControl = PTHREAD_ONCE_INIT;
+    int                     junk;
+    uintptr_t               hash;
+    static pthread_once_t   sWaitQueueBucketsControl = PTHREAD_ONCE_INIT;
 
-    newCond = NULL;
+    // Lazy init of gWaitQueueBuckets.
     
-    // Lazy init of gChannelToCond.
-    
-    junk = pthread_once(&sChannelToCondControl, InitChannelToCond);
+    junk = pthread_once(&sWaitQueueBucketsControl, InitWaitQueueBuckets);
     assert(junk == 0);
     
-    // Look up the channel to find or create the associated conditional variable.
-    
-    junk = pthread_mutex_lock(&gChannelToCondLock);
-    assert(junk == 0);
+    // Channels are typically addresses of heap blocks, so the low bits are 
+    // mostly zero; mix the higher bits down.
     
-    do {
-        err = 0;
-
-        cond = (pthread_cond_t *) CFDictionaryGetValue(gChannelToCond, chan);
-        if (cond == NULL) {
-            if (newCond == NULL) {
-                junk = pthread_mutex_unlock(&gChannelToCondLock);
-                assert(junk == 0);
-
-                newCond = (pthread_cond_t *) malloc(sizeof(*newCond));
-                assert(newCond != NULL);
-                
-                junk = pthread_cond_init(newCond, NULL);
-                assert(junk == 0);
-                
-                err = EAGAIN;
-
-                junk = pthread_mutex_lock(&gChannelToCondLock);
-                assert(junk == 0);
-            } else {
-                CFDictionaryAddValue(gChannelToCond, chan, newCond);
-                cond = newCond;
-                newCond = NULL;
-            }
-        }
-    } while (err == EAGAIN);
-    
-    junk = pthread_mutex_unlock(&gChannelToCondLock);
-    assert(junk == 0);
-    
-    // If we created newCond but didn't use it, free it now.
-    
-    if (newCond != NULL) {
-        junk = pthread_cond_destroy(newCond);
-        assert(junk == 0);
-        
-        free(newCond);
-    }
-    
-    return cond;
+    hash = (uintptr_t) chan;
+    hash ^= hash >> 7;
+    hash ^= hash >> 13;
+    return &gWaitQueueBuckets[hash % kWaitQueueBucketCount];
 }
 
 extern int  msleep(void *chan, lck_mtx_t *mtx, int pri, const char *wmesg, struct timespec * ts)
+    // Like the kernel version, this registers the thread as a waiter before 
+    // dropping mtx, so a wakeup done with mtx held can't be lost.
 {
     #pragma unused(pri)
     #pragma unused(wmesg)
     int                 junk;
-    pthread_cond_t *    cond;
+    WaitQueueBucket *   bucket;
+    WaitQueue *         wq;
+    WaitQueue **        link;
 
+    assert(chan != NULL);
     assert(mtx != NULL);
     assert(pri == PINOD);
     assert(ts == NULL);
 
-    cond = ChannelToCond(chan);
-    assert(cond != NULL);
+    bucket = ChannelToBucket(chan);
+
+    junk = pthread_mutex_lock(&bucket->lock);
+    assert(junk == 0);
+    
+    // Find the wait queue for this channel, creating it if necessary.
+    
+    for (wq = bucket->active; wq != NULL; wq = wq->next) {
+        if (wq->chan == chan) {
+            break;
+        }
+    }
+    if (wq == NULL) {
+        wq = bucket->free;
+        if (wq != NULL) {
+            bucket->free = wq->next;
+        } else {
+            wq = (WaitQueue *) malloc(sizeof(*wq));
+            assert(wq != NULL);
+            
+            junk = pthread_cond_init(&wq->cond, NULL);
+            assert(junk == 0);
+        }
+        wq->chan = chan;
+        wq->waiterCount = 0;
+        wq->next = bucket->active;
+        bucket->active = wq;
+    }
+    wq->waiterCount += 1;
+    
+    // Now that we're registered, drop the caller's mutex and wait.  pthread_cond_wait 
+    // can return spuriously but, as with the kernel's msleep, callers have to recheck 
+    // their condition anyway.
+    
+    lck_mtx_unlock(mtx);
+
+    junk = pthread_cond_wait(&wq->cond, &bucket->lock);
+    assert(junk == 0);
+    
+    // Deregister, putting the wait queue back on the free list if we were the 
+    // last waiter.
+    
+    wq->waiterCount -= 1;
+    if (wq->waiterCount == 0) {
+        link = &bucket->active;
+        while (*link != wq) {
+            link = &(*link)->next;
+        }
+        *link = wq->next;
+        
+        wq->chan = NULL;
+        wq->next = bucket->free;
+        bucket->free = wq;
+    }
     
-    junk = pthread_cond_wait(cond, &mtx->mtx);
+    junk = pthread_mutex_unlock(&bucket->lock);
     assert(junk == 0);
     
+    // We must drop the bucket lock before retaking mtx, because wakeup takes them 
+    // in the other order.
+    
+    lck_mtx_lock(mtx);
+    
     return 0;
 }
 
 extern void wakeup(void *chan)
 {
     int                 junk;
-    pthread_cond_t *    cond;
+    WaitQueueBucket *   bucket;
+    WaitQueue *         wq;
+    
+    assert(chan != NULL);
     
-    cond = ChannelToCond(chan);
-    assert(cond != NULL);
+    bucket = ChannelToBucket(chan);
+
+    junk = pthread_mutex_lock(&bucket->lock);
+    assert(junk == 0);
+    
+    for (wq = bucket->active; wq != NULL; wq = wq->next) {
+        if (wq->chan == chan) {
+            junk = pthread_cond_broadcast(&wq->cond);
+            assert(junk == 0);
+            break;
+        }
+    }
     
-    junk = pthread_cond_broadcast(cond);
+    junk = pthread_mutex_unlock(&bucket->lock);
     assert(junk == 0);
 }
 
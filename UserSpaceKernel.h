@@ -84,8 +84,16 @@ extern OSMallocTag      OSMalloc_Tagalloc(const char * str, uint32_t flags);
 extern void             OSMalloc_Tagfree(OSMallocTag tag);
 
 extern void *           OSMalloc(uint32_t size, OSMallocTag tag);
+extern void *           OSMalloc_noblock(uint32_t size, OSMallocTag tag);
 extern void             OSFree(void * addr, uint32_t size, OSMallocTag tag); 
 
+#pragma mark ----- <libkern/OSAtomic.h>
+
+extern int32_t          OSIncrementAtomic(volatile int32_t * address);
+extern int32_t          OSDecrementAtomic(volatile int32_t * address);
+extern int64_t          OSAddAtomic64(int64_t amount, volatile int64_t * address);
+extern void             OSMemoryBarrier(void);
+
 #pragma mark ----- <machine/locks.h>
 
 typedef struct __lck_mtx__      lck_mtx_t;
@@ -118,6 +126,13 @@ extern void             lck_mtx_assert(
 #define LCK_MTX_ASSERT_OWNED    0x01
 #define LCK_MTX_ASSERT_NOTOWNED 0x02
 
+#pragma mark ----- <kern/thread.h>
+
+// In the kernel this returns a thread_t, but in user space that's a Mach port, 
+// so we return an opaque pointer instead.
+
+extern void *           current_thread(void);
+
 #pragma mark ----- <sys/types.h.h>
 
 typedef uint32_t ino_t;
@@ -159,6 +174,15 @@ typedef void (*ReclaimCallback)(vnode_t vn);
 
 extern void SetReclaimCallback(ReclaimCallback callback);
 
+extern size_t SetVNodeLimit(size_t limit);
+    // Sets the number of vnodes that vnode_create will allocate before it starts 
+    // recycling them, returning the previous limit.  The default is very small, 
+    // to force lots of recycling.  Like DisposeAllVNodes, this isn't thread safe.
+
+extern size_t GetOSMallocCount(void);
+    // Returns the number of times that OSMalloc and OSMalloc_noblock have been 
+    // called, which lets tests measure how hard code is hitting the allocator.
+
 // extern int vnode_recycle(vnode_t vn);
 
 extern void DisposeAllVNodes(void);